@@ -4,6 +4,15 @@
 #include "../util/object.h"
 #include "../dataframe/sorer.h"
 #include "../dataframe/dataframe.h"
+#include "../dataframe/shipping.h"
+#include "../dataframe/group_by.h"
+#include "../dataframe/join.h"
+#include "../dataframe/sort.h"
+#include "../dataframe/semi_join.h"
+#include "../dataframe/plan.h"
+#include "../dataframe/view.h"
+#include "../dataframe/expr.h"
+#include "../dataframe/index.h"
 #include "../kvstore/keyvaluestore.h"
 
 /**
@@ -19,6 +28,8 @@ class Application : public Object{
 
         Application(KVStore& kvs) : kv(kvs), config_() {
             node_idx_ = kv.node_index();
+            // run the rowers that other nodes ship to this one
+            RowerExecutor::install(&kv);
         }
 
         ~Application() { }
@@ -59,6 +70,26 @@ class Application : public Object{
             // return sorer.read(0, 1000 * 1000 * 1000);
             return sorer.read();
         }
+
+        // reads the file into a dataframe whose chunks are placed by the given placement
+        DataFrame* fromFile(const char* filename, Key* key, KVStore* kvs, Placement& placement) {
+            SOR sorer(filename, key, kvs, placement);
+            return sorer.read();
+        }
+
+        // Reads the file on every node at once, each node parses part of it with threads threads and
+        // keeps the chunks of the rows it parsed. Every node has to call this with the same arguments.
+        DataFrame* fromFileDistributed(const char* filename, Key* key, size_t threads) {
+            SOR sorer(filename, key, &kv);
+            return sorer.read_distributed(threads);
+        }
+
+        // like fromFileDistributed, but only the given fields of the file are read, see SOR.select
+        DataFrame* fromFileDistributed(const char* filename, Key* key, size_t threads, const size_t* fields, size_t num_fields) {
+            SOR sorer(filename, key, &kv);
+            sorer.select(fields, num_fields);
+            return sorer.read_distributed(threads);
+        }
         
         // what is the index of this node.
         virtual size_t this_node() {
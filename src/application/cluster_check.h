@@ -0,0 +1,153 @@
+#include <stdlib.h>
+
+#include "../dataframe/dataframe.h"
+#include "../dataframe/group_by.h"
+#include "../dataframe/join.h"
+#include "../dataframe/sort.h"
+#include "../kvstore/keyvalue.h"
+#include "application.h"
+
+static const size_t CLUSTER_ROWS = 5000;
+
+/**
+ * Runs the operators that move rows between nodes on a real cluster, every node runs this. Node 0
+ * writes a dataframe whose chunks are spread over all nodes, then every node repartitions, groups,
+ * joins and sorts it, so every node sends its rows to the others with put_async at the same time.
+ * Every operator runs twice under the same key, so a node that is ahead runs the second call while
+ * the others still run the first. Each node checks the rows it got and node 0 prints whether every
+ * node agreed.
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class ClusterCheck : public Application {
+    public:
+        Key input_;
+        Key parted_;
+        Key groups_;
+        Key joined_;
+        Key sorted_;
+
+        ClusterCheck(KVStore& kvs) : Application(kvs), input_(0, "cluster-in"), parted_(0, "cluster-parted"),
+                groups_(0, "cluster-groups"), joined_(0, "cluster-joined"), sorted_(0, "cluster-sorted") { }
+
+        void run_() override {
+            DataFrame* df = this_node() == 0 ? producer() : getAndWait(input_);
+            bool ok = true;
+            for (size_t call = 0; call < 2; call++) {
+                // every check runs on every node, whatever the checks before it found
+                ok = check_repartition(*df) && ok;
+                ok = check_group_join(*df) && ok;
+                ok = check_sort(*df) && ok;
+            }
+            report(ok);
+            delete df;
+        }
+
+        // the number of input rows with the given value in column 1
+        size_t rows_of(int value) {
+            return CLUSTER_ROWS / 97 + ((size_t) value < CLUSTER_ROWS % 97 ? 1 : 0);
+        }
+
+        // the input rows: <i><i % 97><name of i % 7>
+        DataFrame* producer() {
+            Schema schema("IIS");
+            DataFrame* df = new DataFrame(schema, input_, &kv, false);
+            Row row(schema);
+            char name[16];
+            for (size_t i = 0; i < CLUSTER_ROWS; i++) {
+                snprintf(name, sizeof(name), "name%zu", i % 7);
+                String s(name);
+                row.set(0, (int) i);
+                row.set(1, (int) (i % 97));
+                row.set(2, &s);
+                df->add_row(row, false, false);
+            }
+            df->commit();
+            df->add_self_to_kv_();
+            return df;
+        }
+
+        // every row is on the node its value in column 1 hashes to, and no row is lost
+        bool check_repartition(DataFrame& df) {
+            DataFrame* parted = df.repartition(1, parted_);
+            bool ok = parted->nrows() == CLUSTER_ROWS;
+            Row row(parted->get_schema());
+            KeyEncoder keys;
+            size_t key_col = 1;
+            size_t start = 0;
+            size_t end = 0;
+            while (parted->cols_[0]->get_next_local_rows(start, end)) {
+                for (size_t i = start; i < end; i++) {
+                    parted->fill_row(i, row);
+                    ok = ok && keys.node_of(row, &key_col, 1, kv.num_nodes()) == this_node();
+                    row.delete_strings();
+                }
+            }
+            delete parted;
+            return ok;
+        }
+
+        // there is a group for every value of column 1, and joining the rows with it adds the size of their group
+        bool check_group_join(DataFrame& df) {
+            size_t key_col = 1;
+            Aggregate count = Aggregate::count();
+            DataFrame* groups = df.group_by(&key_col, 1, &count, 1, groups_);
+            bool ok = groups->nrows() == 97;
+            size_t total = 0;
+            for (size_t i = 0; i < groups->nrows(); i++) {
+                total += groups->get_int(1, i);
+                ok = ok && (size_t) groups->get_int(1, i) == rows_of(groups->get_int(0, i));
+            }
+            ok = ok && total == CLUSTER_ROWS;
+
+            DataFrame* joined = df.join(*groups, 1, 0, joined_);
+            ok = ok && joined->nrows() == CLUSTER_ROWS;
+            size_t start = 0;
+            size_t end = 0;
+            while (joined->cols_[0]->get_next_local_rows(start, end)) {
+                for (size_t i = start; i < end; i++) {
+                    ok = ok && (size_t) joined->get_int(3, i) == rows_of(joined->get_int(1, i));
+                }
+            }
+            delete joined;
+            delete groups;
+            return ok;
+        }
+
+        // the sorted rows are the input rows in the order of column 0
+        bool check_sort(DataFrame& df) {
+            DataFrame* sorted = df.sort_by(0, sorted_);
+            bool ok = sorted->nrows() == CLUSTER_ROWS;
+            for (size_t i = 0; ok && i < sorted->nrows(); i++) {
+                ok = sorted->get_int(0, i) == (int) i;
+            }
+            delete sorted;
+            return ok;
+        }
+
+        // every node sends node 0 whether its checks passed, node 0 prints the result
+        void report(bool ok) {
+            StrBuff name;
+            name.c("cluster-ok-").c(this_node());
+            String* s = name.get();
+            Key key(0, s->c_str());
+            char flag = ok ? '1' : '0';
+            Value v(1, &flag);
+            kv.put(key, v);
+            delete s;
+
+            if (this_node() == 0) {
+                bool all = true;
+                for (size_t n = 0; n < kv.num_nodes(); n++) {
+                    StrBuff node_name;
+                    node_name.c("cluster-ok-").c(n);
+                    String* node_s = node_name.get();
+                    Key node_key(0, node_s->c_str());
+                    Value* node_v = kv.getAndWait(node_key);
+                    all = all && node_v->get()[0] == '1';
+                    delete node_v;
+                    delete node_s;
+                }
+                pln(all ? "Cluster check: SUCCESS" : "Cluster check: FAILURE");
+            }
+        }
+};
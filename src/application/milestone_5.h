@@ -98,6 +98,8 @@ class SetUpdater : public Reader {
             return false; 
         }
 
+        bool reads_column(size_t col) override { return col == 0; }
+
 };
 
 /*****************************************************************************
@@ -130,7 +132,8 @@ class SetWriter: public Writer {
  *    project_id X written_user_id x commited_user_id
  *    pid x uid x uid
  * where the pid is the identifier of a project and the uids are the
- * identifiers of the author and committer. If the author is a collaborator
+ * identifiers of the author and committer. Only the pid and the author are
+ * read from the file. If the author is a collaborator
  * of Linus, then the project is added to the set. If the project was
  * already tagged then it is not added to the set of newProjects.
  *************************************************************************/
@@ -157,6 +160,9 @@ class ProjectsTagger : public Reader {
         }
         return false;
     }
+
+    /** Only the pid and the author are read. */
+    bool reads_column(size_t col) override { return col < 2; }
 };
 
 /***************************************************************************
@@ -187,6 +193,8 @@ class UsersTagger : public Reader {
             }
             return false;
         }
+
+        bool reads_column(size_t col) override { return col < 2; }
 };
 
 /*************************************************************************
@@ -214,7 +222,7 @@ class Linus : public Application {
 
         DataFrame* projects; //  pid x project name  -- 'IS'
         DataFrame* users;  // uid x user name        -- 'IS'
-        DataFrame* commits;  // pid x uid x uid      -- 'III'  -- project x author x commiter
+        DataFrame* commits;  // pid x uid            -- 'II'   -- project x author, the commiter is not read
         Set* uSet; // Linus' collaborators
         Set* pSet; // projects of collaborators
 
@@ -227,34 +235,57 @@ class Linus : public Application {
             print("Milestone5: DONE\n");
         }
 
-        /** Node 0 reads three files, cointainng projects, users and commits, and
-         *  creates thre dataframes. All other nodes wait and load the three
+        /** Node 0 reads two files, cointainng projects and users, and creates
+         *  two dataframes. The commits file is read by all nodes together, each
+         *  node parses part of it. All other nodes wait and load the
          *  dataframes. Once we know the size of users and projects, we create
          *  sets of each (uSet and pSet). We also output a data frame with a the
          *  'tagged' users. At this point the dataframe consists of only
-         *  Linus. **/
+         *  Linus. If the nodes were restored from a snapshot, node 0 gets the
+         *  three dataframes from its store instead of reading the files. **/
         void readInput() {
             Key pK("projs");
             Key uK("usrs");
             Key cK("comts");
-            if (this_node() == 0) {
-                pln("Reading...");
-                projects = fromFile(PROJ, pK.clone(), &kv);
-                print("    %zu projects\n", projects->nrows());
-
-                users = fromFile(USER, uK.clone(), &kv);
-                print("    %zu users\n", users->nrows());
-
-                commits = fromFile(COMM, cK.clone(), &kv);
-                print("    %zu commits\n", commits->nrows());
-                
-                // This dataframe contains the id of Linus.
-                delete DataFrame::fromScalar(new Key("users-0-0"), &kv, LINUS);
+            if (this_node() == 0 && kv.restored()) {
+                // the dataframes were restored from a snapshot, there is nothing to parse
+                pln("Restored from snapshot...");
+                projects = get(pK);
+                users = get(uK);
+                commits = get(cK);
+                abort_if_not(projects != nullptr && users != nullptr && commits != nullptr, "Linus: snapshot does not have the input dataframes");
+            } else if (!kv.restored()) {
+                // the largest file is split between the nodes, every node keeps the rows it parsed.
+                // The taggers only look at the pid and the author, the committer is never read.
+                size_t commit_fields[] = {0, 1};
+                commits = fromFileDistributed(COMM, cK.clone(), kv.get_config().INGEST_THREADS, commit_fields, 2);
+                if (this_node() == 0) {
+                    pln("Reading...");
+                    print("    %zu commits\n", commits->nrows());
+                    // projects and users are read on every node, so every node keeps a copy of them
+                    Placement* broadcast = Placement::broadcast(kv.num_nodes());
+                    projects = fromFile(PROJ, pK.clone(), &kv, *broadcast);
+                    print("    %zu projects\n", projects->nrows());
+
+                    users = fromFile(USER, uK.clone(), &kv, *broadcast);
+                    delete broadcast;
+                    print("    %zu users\n", users->nrows());
+
+                    // This dataframe contains the id of Linus.
+                    delete DataFrame::fromScalar(new Key("users-0-0"), &kv, LINUS);
+                } else {
+                    projects = getAndWait(pK);
+                    users = getAndWait(uK);
+                }
             } else {
                 projects = getAndWait(pK);
                 users = getAndWait(uK);
                 commits = getAndWait(cK);
             }
+            // every chunk of the inputs is stored once the descriptors can be read, so snapshot them for the next run
+            if (!kv.restored() && kv.get_config().SNAPSHOT_DIR[0] != '\0') {
+                kv.snapshot(kv.get_config().SNAPSHOT_DIR);
+            }
             uSet = new Set(users);
             pSet = new Set(projects);
         }
@@ -3,6 +3,7 @@
 
 #include <stdarg.h>
 #include <stdlib.h>
+#include <limits.h>
 
 #include "../util/string.h"
 #include "../util/object.h"
@@ -14,6 +15,8 @@
 
 #include "../util/config.h"
 
+#include "placement.h"
+
 enum ColumnType {
     UNKNOWN = 0,
     BOOL = 'B', 
@@ -93,6 +96,177 @@ String* as_string(char* c) {
 }
 
 
+// The functions below work on a field of len chars that is not null terminated, e.g. a
+// field inside of a mapped file.
+
+bool is_int(const char* c, size_t len) {
+    if (len == 0) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (i == 0 && (c[i] == '+' || c[i] == '-')) {
+            continue;
+        } else if (!isdigit(c[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool is_double(const char* c, size_t len) {
+    if (len == 0) {
+        return false;
+    }
+    bool has_decimal = false;
+    for (size_t i = 0; i < len; i++) {
+        if (i == 0 && (c[i] == '+' || c[i] == '-')) {
+            continue;
+        } else if (c[i] == '.' && has_decimal) {
+            return false;
+        } else if (c[i] == '.') {
+            has_decimal = true;
+        } else if (!isdigit(c[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool as_bool(const char* c, size_t len) {
+    return len > 0 && *c == '1';
+}
+
+// The parse functions validate and convert a field in one pass. They return false if the field
+// would be inferred as a wider type than the one asked for, e.g. "1.5" is not an int. out is
+// set either way, to the value of the longest valid prefix like atoi and atof do.
+
+// a bool field is "0" or "1"
+bool parse_bool(const char* c, size_t len, bool& out) {
+    out = len > 0 && *c == '1';
+    return len == 1 && (*c == '0' || *c == '1');
+}
+
+// an int field is an optional sign followed by digits, and does not overflow an int
+bool parse_int(const char* c, size_t len, int& out) {
+    size_t i = 0;
+    bool negative = false;
+    if (len > 0 && (c[0] == '+' || c[0] == '-')) {
+        negative = c[0] == '-';
+        i++;
+    }
+    // the largest magnitude that fits, one more for negative numbers
+    unsigned int limit = negative ? (unsigned int) INT_MAX + 1 : (unsigned int) INT_MAX;
+    bool overflow = false;
+    unsigned int ret = 0;
+    for (; i < len; i++) {
+        unsigned int digit = (unsigned char) c[i] - '0';
+        if (digit > 9) {
+            break;
+        }
+        overflow = overflow || ret > (limit - digit) / 10;
+        ret = ret * 10 + digit;
+    }
+    out = negative ? (int) -ret : (int) ret;
+    return len > 0 && i == len && !overflow;
+}
+
+// like atof, for a field that is not null terminated
+double atof_(const char* c, size_t len) {
+    char buf[64];
+    if (len < sizeof(buf)) {
+        memcpy(buf, c, len);
+        buf[len] = '\0';
+        return atof(buf);
+    }
+    char* big = new char[len + 1];
+    memcpy(big, c, len);
+    big[len] = '\0';
+    double ret = atof(big);
+    delete[] big;
+    return ret;
+}
+
+// a double field is an optional sign followed by digits with at most one '.'
+// Values whose digits fit in a double exactly, and that have at most 22 digits after the '.',
+// are one exactly rounded division, which is what atof returns. Anything else goes to atof.
+bool parse_double(const char* c, size_t len, double& out) {
+    static const double POW10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    static const unsigned long long MAX_EXACT = 1ULL << 53;
+
+    size_t i = 0;
+    bool negative = false;
+    if (len > 0 && (c[0] == '+' || c[0] == '-')) {
+        negative = c[0] == '-';
+        i++;
+    }
+    unsigned long long mantissa = 0;
+    size_t frac_digits = 0;
+    bool has_decimal = false;
+    bool exact = true;
+    for (; i < len; i++) {
+        unsigned int digit = (unsigned char) c[i] - '0';
+        if (digit <= 9) {
+            if (mantissa > (MAX_EXACT - digit) / 10) {
+                exact = false;
+            } else {
+                mantissa = mantissa * 10 + digit;
+            }
+            frac_digits += has_decimal;
+        } else if (c[i] == '.' && !has_decimal) {
+            has_decimal = true;
+        } else {
+            break;
+        }
+    }
+    bool valid = len > 0 && i == len;
+    if (!valid || !exact || frac_digits > 22) {
+        out = atof_(c, len);
+        return valid;
+    }
+    double ret = (double) mantissa / POW10[frac_digits];
+    out = negative ? -ret : ret;
+    return true;
+}
+
+// like atoi, but stops after len chars
+int as_int(const char* c, size_t len) {
+    int ret;
+    parse_int(c, len, ret);
+    return ret;
+}
+
+// like atof, but stops after len chars
+double as_double(const char* c, size_t len) {
+    double ret;
+    parse_double(c, len, ret);
+    return ret;
+}
+
+String* as_string(const char* c, size_t len) {
+    char* buf = new char[len + 1];
+    memcpy(buf, c, len);
+    buf[len] = '\0';
+    return new String(true, buf, len);
+}
+
+// returns the inferred typing of the field, nullptr is a missing value
+char infer_type(const char* c, size_t len) {
+    if (c == nullptr) {
+        return BOOL;
+    }
+    if (len == 1 && (*c == '0' || *c == '1')) {
+        return BOOL;
+    }
+    if (is_int(c, len)) {
+        return INT;
+    }
+    if (is_double(c, len)) {
+        return DOUBLE;
+    }
+    return STRING;
+}
+
 // returns the inferred typing of the char*
 char infer_type(char *c) {
     // missing values
@@ -116,6 +290,122 @@ char infer_type(char *c) {
     return STRING;
 }
 
+// the narrowest type that holds the values of both types: BOOL < INT < DOUBLE < STRING
+char widen_type(char a, char b) {
+    return column_type_to_num(a) < column_type_to_num(b) ? b : a;
+}
+
+// the type after t, a column is promoted to it when a value does not fit t
+char next_type(char t) {
+    switch (t) {
+        case BOOL:
+            return INT;
+        case INT:
+            return DOUBLE;
+        default:
+            return STRING;
+    }
+}
+
+// Writes the text of a double that reads back as the same double, with as few digits as possible.
+// Returns the length of the text.
+size_t format_double(double d, char* buf, size_t cap) {
+    size_t len = 0;
+    for (int precision = 15; precision <= 17; precision++) {
+        len = snprintf(buf, cap, "%.*g", precision, d);
+        if (strtod(buf, nullptr) == d) {
+            break;
+        }
+    }
+    return len;
+}
+
+// Converts a chunk of rows values encoded as type from into a chunk encoded as type to, to has to be
+// at least as wide as from. The new chunk is laid out like push_back lays out chunks of type to:
+// INT and DOUBLE chunks hold chunk_size values, STRING chunks hold exactly rows strings. Strings are
+// written in the shortest form that reads back as the same value, bools as 0 and 1.
+// Returned value is owned by the caller.
+Value* reencode_chunk(const char* chunk, char from, char to, size_t rows, size_t chunk_size) {
+    if (column_type_to_num(to) < column_type_to_num(from) || to == BOOL) {
+        Sys::fail("reencode_chunk(): can not convert %c to %c", from, to);
+    }
+    char* out = nullptr;
+    size_t bytes = 0;
+    size_t cap = 0;
+    if (to == INT || to == DOUBLE) {
+        bytes = chunk_size * (to == INT ? sizeof(int) : sizeof(double));
+        out = new char[bytes];
+        memset(out, 0, bytes);
+    } else {
+        cap = rows * 8 + 1;
+        out = new char[cap];
+    }
+    char text[32];
+    for (size_t r = 0; r < rows; r++) {
+        int n = 0;
+        double d = 0.0;
+        switch (from) {
+            case BOOL:
+            {
+                size_t word;
+                memcpy(&word, chunk + r / (sizeof(size_t) * 8) * sizeof(size_t), sizeof(size_t));
+                n = (word >> (r % (sizeof(size_t) * 8))) & 1;
+                d = n;
+                break;
+            }
+            case INT:
+                memcpy(&n, chunk + r * sizeof(int), sizeof(int));
+                d = n;
+                break;
+            case DOUBLE:
+                memcpy(&d, chunk + r * sizeof(double), sizeof(double));
+                break;
+            default:
+                Sys::fail("reencode_chunk(): can not convert %c to %c", from, to);
+        }
+        switch (to) {
+            case INT:
+                memcpy(out + r * sizeof(int), &n, sizeof(int));
+                break;
+            case DOUBLE:
+                memcpy(out + r * sizeof(double), &d, sizeof(double));
+                break;
+            default:
+            {
+                size_t len = from == DOUBLE ? format_double(d, text, sizeof(text)) : snprintf(text, sizeof(text), "%d", n);
+                if (bytes + len + 1 > cap) {
+                    cap = (bytes + len + 1) * 2;
+                    char* grown = new char[cap];
+                    memcpy(grown, out, bytes);
+                    delete[] out;
+                    out = grown;
+                }
+                // every string is followed by its null terminator, like StringColumn lays them out
+                memcpy(out + bytes, text, len + 1);
+                bytes += len + 1;
+                break;
+            }
+        }
+    }
+    return new Value(bytes, out, true);
+}
+
+// the bytes of a chunk of chunk_size values of the given type as push_back lays it out, 0 for
+// strings whose chunks are as long as their strings
+size_t fixed_chunk_bytes(char type, size_t chunk_size) {
+    switch (type) {
+        case BOOL:
+            // bits packed into size_t words, like BoolColumn.push_back
+            return (chunk_size + 8 * sizeof(size_t) - 1) / (8 * sizeof(size_t)) * sizeof(size_t);
+        case INT:
+            return chunk_size * sizeof(int);
+        case DOUBLE:
+            return chunk_size * sizeof(double);
+        default:
+            return 0;
+    }
+}
+
 class StringColumn;
 class DoubleColumn;
 class IntColumn;
@@ -127,13 +417,20 @@ class BoolColumn;
  * This abstract class defines methods overriden in subclasses. There is
  * one subclass per element type. Columns are mutable, equality is pointer
  * equality. 
+ *
+ * A column can be promoted to a wider type while it is built (see promoted). Its chunks are
+ * not rewritten then: the column records the type each chunk was encoded as, and converts the
+ * chunks of narrower types when they are read.
  * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
  * */
 class Column : public Object {
     public:
         KVStore* kv_;  // external
         KeyBuff* key_buff_;  // owned
-        Array<Key>* chunk_keys_;
+
+        size_t num_chunks_;  // number of chunks that have been created
+        Placement* placement_;  // owned; homes chunks on nodes
+        size_t append_seg_;  // the segment that the next pushed value goes to (only used by segmented placements)
 
         size_t cached_chunk_idx_;
         Value* cached_chunk_value_;  // owned
@@ -142,11 +439,20 @@ class Column : public Object {
 
         size_t len_;
 
+        char* encodings_;  // owned; the type each chunk slot is encoded as, nullptr if every chunk is of the column type
+        size_t encodings_len_;  // chunk slots in encodings_, later slots are of the column type
+
         // this is only used to abstract common Column constructor
-        Column(size_t len, KVStore* kv, String* col_name) {
+        // NOTE: takes ownership of placement
+        Column(size_t len, size_t num_chunks, Placement* placement, KVStore* kv, String* col_name) {
             len_ = len;
             kv_ = kv;
             key_buff_ = new KeyBuff(col_name);
+            num_chunks_ = num_chunks;
+            placement_ = placement;
+            append_seg_ = 0;
+            encodings_ = nullptr;
+            encodings_len_ = 0;
 
             dirty_cache_ = false;
             cached_chunk_idx_ = Config::MAX_SIZE_T;
@@ -156,14 +462,11 @@ class Column : public Object {
             // overwrite whatever is in the kvstore when this chunk is commited
         }
 
-        Column(String* col_name, KVStore* kv) : Column(0, kv, col_name) {
-            chunk_keys_ = new Array<Key>();
-        }
+        Column(String* col_name, KVStore* kv) : Column(0, 0, Placement::round_robin(kv->num_nodes()), kv, col_name) { }
 
-        // NOTE: takes ownership of chunk_keys and the keys inside the Array
-        Column(size_t len, Array<Key>* chunk_keys, String* col_name, KVStore* kv) : Column(len, kv, col_name) {
-            chunk_keys_ = chunk_keys;
-        }
+        // builds a column over chunks that already exist in the kvstore, used by deserialize
+        // NOTE: takes ownership of placement
+        Column(size_t len, size_t num_chunks, Placement* placement, String* col_name, KVStore* kv) : Column(len, num_chunks, placement, kv, col_name) { }
 
         ~Column() {
             if (cached_chunk_value_ != nullptr) {
@@ -171,33 +474,53 @@ class Column : public Object {
             }
 
             delete key_buff_;
-            for (size_t i = 0; i < chunk_keys_->size(); i++) {
-                delete chunk_keys_->get(i);
-            }
+            delete placement_;
+            delete[] encodings_;
+        }
 
-            delete chunk_keys_;
+        // sets how the chunks of this column are placed, only valid before anything is pushed
+        void set_placement(Placement& placement) {
+            abort_if_not(len_ == 0, "Column.set_placement(): column is not empty");
+            delete placement_;
+            placement_ = placement.clone_empty();
         }
 
-        virtual size_t get_chunk_idx(size_t idx) {
-            return idx / kv_->get_config().CHUNK_SIZE;
+        Placement& get_placement() {
+            return *placement_;
         }
 
-        virtual size_t get_item_idx(size_t idx) {
-            return idx % kv_->get_config().CHUNK_SIZE;
+        // sets the segment that the next pushed values are added to (only used by segmented placements)
+        void set_append_seg(size_t seg) {
+            append_seg_ = seg;
         }
 
-        // checks if the chunk array needs to be expanded and expands it if true
+        // finds the chunk holding the value at idx and the offset of that value in the chunk
+        void locate_(size_t idx, size_t& chunk_idx, size_t& offset) {
+            placement_->locate(idx, kv_->get_config().CHUNK_SIZE, chunk_idx, offset);
+        }
+
+        // finds the chunk and offset in that chunk where the next pushed value goes
+        void append_slot_(size_t& chunk_idx, size_t& offset) {
+            placement_->append_slot(len_, append_seg_, kv_->get_config().CHUNK_SIZE, chunk_idx, offset);
+        }
+
+        // records that a value was pushed
+        void appended_() {
+            placement_->appended(append_seg_);
+            len_++;
+        }
+
+        // checks if the next push needs a new chunk and creates it if true
         // the initial_chunk_size is the size of the new Value that is created during expansion
         virtual void check_and_reallocate_(size_t initial_chunk_size) {
+            size_t chunk_idx, offset;
+            append_slot_(chunk_idx, offset);
             // when the latest chunk is full
-            if (len_ % kv_->get_config().CHUNK_SIZE == 0) {
-                size_t chunk_idx = get_chunk_idx(len_);
-
-                Key* k = generate_chunk_key(chunk_idx);
+            if (offset == 0) {
                 Value v(initial_chunk_size);
-                kv_->put(*k, v);
+                put_(chunk_idx, v);
 
-                chunk_keys_->push_back(k);
+                num_chunks_++;
             }
         }
 
@@ -215,8 +538,8 @@ class Column : public Object {
         template <class T>
         void push_back_(T val, bool commit) {
             check_and_reallocate_(kv_->get_config().CHUNK_SIZE * sizeof(T));
-            size_t chunk_idx = get_chunk_idx(len_);
-            size_t item_idx = get_item_idx(len_);
+            size_t chunk_idx, item_idx;
+            append_slot_(chunk_idx, item_idx);
 
             // if getting a chunk with a different chunk_index than the cached chunk
             // index, function get_chunk_ will commit the old cached value
@@ -230,13 +553,13 @@ class Column : public Object {
                 commit_cache();
             }
 
-            len_++;
+            appended_();
         }
 
         template<class T>
         T get_(size_t idx) {
-            size_t chunk_idx = get_chunk_idx(idx);
-            size_t item_idx = get_item_idx(idx);
+            size_t chunk_idx, item_idx;
+            locate_(idx, chunk_idx, item_idx);
 
             Value* val = get_chunk_(chunk_idx);
 
@@ -247,16 +570,160 @@ class Column : public Object {
             return rv;
         }
 
-        // puts the given value into the KVStore with the correct chunk key
+        // the type that the given chunk is encoded as in the kvstore
+        char chunk_encoding(size_t chunk_idx) {
+            return chunk_idx < encodings_len_ ? encodings_[chunk_idx] : get_type();
+        }
+
+        // records that the given chunk is encoded as type
+        void set_chunk_encoding_(size_t chunk_idx, char type) {
+            if (chunk_idx >= encodings_len_) {
+                if (type == get_type()) {
+                    return;
+                }
+                size_t len = chunk_idx + 1 > encodings_len_ * 2 ? chunk_idx + 1 : encodings_len_ * 2;
+                char* grown = new char[len];
+                memcpy(grown, encodings_, encodings_len_);
+                memset(grown + encodings_len_, get_type(), len - encodings_len_);
+                delete[] encodings_;
+                encodings_ = grown;
+                encodings_len_ = len;
+            }
+            encodings_[chunk_idx] = type;
+        }
+
+        // converts a chunk read from the kvstore to the type of this column if it was encoded as a
+        // narrower type, see reencode_chunk. Takes ownership of chunk, returned value is owned by the caller
+        Value* decode_(size_t chunk_idx, Value* chunk) {
+            char encoding = chunk_encoding(chunk_idx);
+            if (chunk == nullptr || encoding == get_type()) {
+                return chunk;
+            }
+            size_t chunk_size = kv_->get_config().CHUNK_SIZE;
+            size_t rows = placement_->chunk_rows(chunk_idx, len_, chunk_size);
+            Value* ret = reencode_chunk(chunk->get(), encoding, get_type(), rows, chunk_size);
+            delete chunk;
+            return ret;
+        }
+
+        // puts the given value into the KVStore with the correct chunk key, on every replica of the chunk
         void put_(size_t chunk_idx, Value& value) {
-            Key* chunk_key = chunk_keys_->get(chunk_idx);
-            kv_->put(*chunk_key, value);
+            set_chunk_encoding_(chunk_idx, get_type());
+            for (size_t i = 0; i < placement_->replicas(); i++) {
+                Key chunk_key(placement_->replica(chunk_idx, i), key_buff_->get_base_id(), chunk_idx);
+                kv_->put(chunk_key, value);
+            }
+        }
+
+        // puts the given chunk on every replica in the background, see KVStore.put_async
+        // NOTE: takes ownership of value
+        void put_async_(size_t chunk_idx, Value* value) {
+            set_chunk_encoding_(chunk_idx, get_type());
+            for (size_t i = 1; i < placement_->replicas(); i++) {
+                kv_->put_async(new Key(placement_->replica(chunk_idx, i), key_buff_->get_base_id(), chunk_idx), value->clone());
+            }
+            kv_->put_async(new Key(placement_->replica(chunk_idx, 0), key_buff_->get_base_id(), chunk_idx), value);
+        }
+
+        // Appends a chunk of rows values that was encoded outside of the column, it has to be laid
+        // out like the chunks that push_back builds. The column has to end on a chunk boundary. The
+        // chunk is put in the background, KVStore.flush_puts() has to be called before it is read.
+        // NOTE: takes ownership of chunk
+        void append_chunk_(Value* chunk, size_t rows) {
+            size_t chunk_idx, offset;
+            append_slot_(chunk_idx, offset);
+            abort_if_not(offset == 0, "Column.append_chunk_(): column does not end on a chunk boundary");
+            abort_if_not(rows <= kv_->get_config().CHUNK_SIZE, "Column.append_chunk_(): too many rows for a chunk");
+            put_async_(chunk_idx, chunk);
+            placement_->appended(append_seg_, rows);
+            len_ += rows;
+            num_chunks_++;
+        }
+
+        // a copy of the given chunk with any pending changes committed, owned by the caller
+        Value* read_chunk(size_t chunk_idx) {
+            abort_if_not(has_chunk(chunk_idx), "Column.read_chunk(): chunk %zu out of bounds", chunk_idx);
+            commit_cache();
+            Key chunk_key(placement_->nearest(chunk_idx, kv_->node_index()), key_buff_->get_base_id(), chunk_idx);
+            return decode_(chunk_idx, kv_->get(chunk_key));
+        }
+
+        // hands the keys of the chunks stored on this node to KVStore.retire, see DataFrame.retire_
+        void retire_local_chunks_() {
+            size_t node = kv_->node_index();
+            for (size_t i = 0; i < chunk_slots(); i++) {
+                if (!has_chunk(i)) {
+                    continue;
+                }
+                for (size_t r = 0; r < placement_->replicas(); r++) {
+                    if (placement_->replica(i, r) == node) {
+                        kv_->retire(new Key(node, key_buff_->get_base_id(), i));
+                    }
+                }
+            }
+        }
+
+        // Makes this empty column refer to chunks that were put with put_() directly, rather than
+        // built by pushing values. placement is cloned with the row counts it holds.
+        void set_chunks_(size_t len, size_t num_chunks, Placement& placement) {
+            abort_if_not(len_ == 0, "Column.set_chunks_(): column is not empty");
+            len_ = len;
+            num_chunks_ = num_chunks;
+            delete placement_;
+            placement_ = placement.clone();
+        }
+
+        // Adds the segments of other, a column with the same name and placement that was filled
+        // separately, to this column. other can not be of a wider type than this column.
+        void add_segs_(Column& other) {
+            abort_if_not(column_type_to_num(other.get_type()) <= column_type_to_num(get_type()), "Column.add_segs_(): %c column is wider than %c", other.get_type(), get_type());
+            commit_cache();
+            for (size_t i = 0; i < other.chunk_slots(); i++) {
+                if (other.has_chunk(i)) {
+                    set_chunk_encoding_(i, other.chunk_encoding(i));
+                }
+            }
+            placement_->add_segs(*other.placement_);
+            len_ += other.len_;
+            num_chunks_ += other.num_chunks_;
+        }
+
+        // A column of the given wider type over the chunks of this one. The chunks are left as they
+        // are and converted when they are read. Returned column is owned by the caller.
+        Column* promoted(char type) {
+            abort_if_not(column_type_to_num(type) >= column_type_to_num(get_type()), "Column.promoted(): %c is narrower than %c", type, get_type());
+            commit_cache();
+            String name(key_buff_->get_base_c_str());
+            Column* ret = create(type, len_, num_chunks_, placement_->clone(), &name, kv_);
+            ret->append_seg_ = append_seg_;
+            for (size_t i = 0; i < chunk_slots(); i++) {
+                ret->set_chunk_encoding_(i, chunk_encoding(i));
+            }
+            return ret;
+        }
+
+        // the node index that the given chunk is stored on
+        size_t chunk_home(size_t chunk_idx) {
+            return placement_->home(chunk_idx);
+        }
+
+        size_t num_chunks() {
+            return num_chunks_;
         }
 
-        // colname:0x<hex_representation>
+        // one more than the largest chunk index, segmented placements leave gaps below it
+        size_t chunk_slots() {
+            return placement_->chunk_slots(len_, kv_->get_config().CHUNK_SIZE);
+        }
+
+        bool has_chunk(size_t chunk_idx) {
+            return placement_->has_chunk(chunk_idx, len_, kv_->get_config().CHUNK_SIZE);
+        }
+
+        // compact chunk key of (column id, chunk_idx, home node), returned key is owned by the caller
         Key* generate_chunk_key(size_t chunk_idx) {
-            key_buff_->set_node_index(chunk_idx % kv_->num_nodes());
-            return key_buff_->get(chunk_idx);
+            key_buff_->set_node_index(chunk_home(chunk_idx));
+            return key_buff_->get_chunk(chunk_idx);
         }
 
         // chunk returned is owned by this column 
@@ -270,8 +737,9 @@ class Column : public Object {
                     delete cached_chunk_value_;
                 }
                 cached_chunk_idx_ = chunk_idx;
-                Key* chunk_key = chunk_keys_->get(chunk_idx);
-                cached_chunk_value_ = kv_->get(*chunk_key);  // returns the cloned value from KVStore
+                // read from the closest copy, this is local if the chunk is replicated here
+                Key chunk_key(placement_->nearest(chunk_idx, kv_->node_index()), key_buff_->get_base_id(), chunk_idx);
+                cached_chunk_value_ = decode_(chunk_idx, kv_->get(chunk_key));  // returns the cloned value from KVStore
                 dirty_cache_ = false;
             }
             return cached_chunk_value_;
@@ -346,32 +814,40 @@ class Column : public Object {
 
         // get the next set of rows that are after the given end row index (inclusive) 
         // will set start_row_idx to the first row in the set, and end_row_idx to the row
-        // after the the las row in the local set
+        // after the the las row in the local set. Contiguous local chunks are returned as one set.
         bool get_next_local_rows(size_t &start_row_idx, size_t &end_row_idx) {
-            if (end_row_idx >= size()) {
-                return false;
-            }
-            size_t chunk_idx = get_chunk_idx(end_row_idx);
-            for (size_t i = chunk_idx; i < chunk_keys_->size(); i++) {
-                if (chunk_keys_->get(i)->get_index() == kv_->node_index()) {
-                    start_row_idx = i * kv_->get_config().CHUNK_SIZE;
-                    end_row_idx = start_row_idx + kv_->get_config().CHUNK_SIZE;
-                    end_row_idx = end_row_idx < size() ? end_row_idx : size();
-                    return true;
-                }
-            }
-            return false;
+            return placement_->next_local_rows(kv_->node_index(), size(), kv_->get_config().CHUNK_SIZE, start_row_idx, end_row_idx);
         }
 
+        // the descriptor does not list chunk keys, they are derived from the name and placement
         size_t serial_buf_size() {
-            size_t ret = 1 + sizeof(size_t) + key_buff_->base_size() + 1; // char for type and size_t for length and the name of column
-            for (size_t i = 0; i < chunk_keys_->size(); i++) {
-                ret += chunk_keys_->get(i)->serial_buf_size();
+            // char for type, size_t for length and number of chunks, the placement, the chunk encodings and the name of column
+            size_t encodings = 2 * sizeof(size_t) + encoding_runs_() * (sizeof(size_t) + 1);
+            return 1 + 2 * sizeof(size_t) + placement_->serial_buf_size() + encodings + key_buff_->base_size() + 1;
+        }
+
+        // chunk slots up to the last one that is not encoded as the column type
+        size_t encoded_slots_() {
+            size_t ret = encodings_len_;
+            while (ret > 0 && encodings_[ret - 1] == get_type()) {
+                ret--;
             }
             return ret;
         }
 
-        // <type><len_><name>[key...] 
+        // number of runs of chunks with the same encoding, chunks are mostly promoted in order so there are few
+        size_t encoding_runs_() {
+            size_t runs = 0;
+            size_t slots = encoded_slots_();
+            for (size_t i = 0; i < slots; i++) {
+                if (i == 0 || encodings_[i] != encodings_[i - 1]) {
+                    runs++;
+                }
+            }
+            return runs;
+        }
+
+        // <type><len_><num_chunks_><placement><encoded slots><num_runs>[<first chunk><encoding>...]<name>
         char* serialize(char* buf) {
             char* buf_pointer = buf;
             buf_pointer[0] = get_type();
@@ -380,23 +856,40 @@ class Column : public Object {
             memcpy(buf_pointer, &len_, sizeof(size_t));
             buf_pointer += sizeof(size_t);
 
-            memcpy(buf_pointer, key_buff_->get_base_c_str(), key_buff_->base_size() + 1);
-            buf_pointer += key_buff_->base_size() + 1;
-            
-            for (size_t i = 0; i < chunk_keys_->size(); i++) {
-                chunk_keys_->get(i)->serialize(buf_pointer);
-                buf_pointer += chunk_keys_->get(i)->serial_buf_size();
+            memcpy(buf_pointer, &num_chunks_, sizeof(size_t));
+            buf_pointer += sizeof(size_t);
+
+            placement_->serialize(buf_pointer);
+            buf_pointer += placement_->serial_buf_size();
+
+            size_t slots = encoded_slots_();
+            size_t runs = encoding_runs_();
+            memcpy(buf_pointer, &slots, sizeof(size_t));
+            memcpy(buf_pointer + sizeof(size_t), &runs, sizeof(size_t));
+            buf_pointer += 2 * sizeof(size_t);
+            for (size_t i = 0; i < slots; i++) {
+                if (i == 0 || encodings_[i] != encodings_[i - 1]) {
+                    memcpy(buf_pointer, &i, sizeof(size_t));
+                    buf_pointer[sizeof(size_t)] = encodings_[i];
+                    buf_pointer += sizeof(size_t) + 1;
+                }
             }
+
+            memcpy(buf_pointer, key_buff_->get_base_c_str(), key_buff_->base_size() + 1);
             return buf;
         }
 
-        // <type><len_><name>[key...] 
+        // <type><len_><num_chunks_><placement><encoded slots><num_runs>[<first chunk><encoding>...]<name>
         char* serialize() {
             char* buf = new char[serial_buf_size()];
             return serialize(buf);
         }
 
         static Column* deserialize(const char* buf, KVStore* kvs);
+
+        // a column of the given type over chunks that already exist in the kvstore
+        // NOTE: takes ownership of placement
+        static Column* create(char type, size_t len, size_t num_chunks, Placement* placement, String* col_name, KVStore* kvs);
 };
   
 
@@ -420,21 +913,18 @@ class BoolColumn : public Column {
             commit_cache();
         } 
         
-        // NOTE: takes ownership of chunk_keys and the keys inside the Array
-        BoolColumn(size_t len, Array<Key>* chunk_keys, String* col_name, KVStore* kv) : Column(len, chunk_keys, col_name, kv) { }
+        // builds a column over chunks that already exist in the kvstore
+        // NOTE: takes ownership of placement
+        BoolColumn(size_t len, size_t num_chunks, Placement* placement, String* col_name, KVStore* kv) : Column(len, num_chunks, placement, col_name, kv) { }
 
         ~BoolColumn() { }
 
-        // which size_t to look for the bit in
-        size_t get_item_idx(size_t idx) {
-            return (idx % kv_->get_config().CHUNK_SIZE) / (sizeof(size_t) * 8);
-        }
-
         virtual void push_back(bool val, bool commit) {
             check_and_reallocate_(kv_->get_config().CHUNK_SIZE / 8);
-            size_t chunk_idx = get_chunk_idx(len_);
-            size_t item_idx = get_item_idx(len_);
-            size_t bit_idx = len_ % (sizeof(size_t) * 8);  // 8 bits per byte
+            size_t chunk_idx, offset;
+            append_slot_(chunk_idx, offset);
+            size_t item_idx = offset / (sizeof(size_t) * 8);  // which size_t to look for the bit in
+            size_t bit_idx = offset % (sizeof(size_t) * 8);  // 8 bits per byte
 
             Value* value = get_chunk_(chunk_idx);
             char* v = value->get();
@@ -456,16 +946,17 @@ class BoolColumn : public Column {
                 commit_cache();
             }
 
-            len_++;
+            appended_();
         }
 
         // gets the bool at the index idx
         // if idx is out of bounds, exit
         bool get(size_t idx) {
             abort_if_not(idx < size(), "BoolColumn.get(): out of bounds");
-            size_t chunk_idx = get_chunk_idx(idx);
-            size_t item_idx = get_item_idx(idx);
-            size_t bit_idx = idx % (sizeof(size_t) * 8); // number of bits in size_t
+            size_t chunk_idx, offset;
+            locate_(idx, chunk_idx, offset);
+            size_t item_idx = offset / (sizeof(size_t) * 8);
+            size_t bit_idx = offset % (sizeof(size_t) * 8); // number of bits in size_t
             
             Value* value = get_chunk_(chunk_idx);
             char* v = value->get();
@@ -507,8 +998,9 @@ class IntColumn : public Column {
             commit_cache();
         }
         
-        // NOTE: takes ownership of chunk_keys and the keys inside the Array
-        IntColumn(size_t len, Array<Key>* chunk_keys, String* col_name, KVStore* kv) : Column(len, chunk_keys, col_name, kv) { }
+        // builds a column over chunks that already exist in the kvstore
+        // NOTE: takes ownership of placement
+        IntColumn(size_t len, size_t num_chunks, Placement* placement, String* col_name, KVStore* kv) : Column(len, num_chunks, placement, col_name, kv) { }
 
         ~IntColumn() {
         }
@@ -554,8 +1046,9 @@ class DoubleColumn : public Column {
             commit_cache();
         }
         
-        // NOTE: takes ownership of chunk_keys and the keys inside the Array
-        DoubleColumn(size_t len, Array<Key>* chunk_keys, String* col_name, KVStore* kv) : Column(len, chunk_keys, col_name, kv) { }
+        // builds a column over chunks that already exist in the kvstore
+        // NOTE: takes ownership of placement
+        DoubleColumn(size_t len, size_t num_chunks, Placement* placement, String* col_name, KVStore* kv) : Column(len, num_chunks, placement, col_name, kv) { }
 
         ~DoubleColumn() { }
         
@@ -607,8 +1100,9 @@ class StringColumn : public Column {
             commit_cache();
         }
         
-        // NOTE: takes ownership of chunk_keys and the keys inside the Array
-        StringColumn(size_t len, Array<Key>* chunk_keys, String* col_name, KVStore* kv) : Column(len, chunk_keys, col_name, kv), string_cache_() { }
+        // builds a column over chunks that already exist in the kvstore
+        // NOTE: takes ownership of placement
+        StringColumn(size_t len, size_t num_chunks, Placement* placement, String* col_name, KVStore* kv) : Column(len, num_chunks, placement, col_name, kv), string_cache_() { }
 
         ~StringColumn() { 
             clear_cache_();
@@ -682,12 +1176,11 @@ class StringColumn : public Column {
         String* get(size_t idx) {
             abort_if_not(idx < size(), "StringColumn.get(): index out of bounds");
             
-            size_t chunk_idx = get_chunk_idx(idx);
+            size_t chunk_idx, item_idx;
+            locate_(idx, chunk_idx, item_idx);
 
             update_string_cache(chunk_idx);
 
-            size_t item_idx = get_item_idx(idx);
-
             abort_if_not(item_idx < string_cache_.size(), "StringColumn.get(): Tried to get item %zu from chunk %zu with size %zu", item_idx, chunk_idx, string_cache_.size());
             return string_cache_.get(item_idx)->clone();
         }
@@ -696,7 +1189,9 @@ class StringColumn : public Column {
             abort_if_not(val != nullptr, "StringColumn.push_back(): val is nullptr");
             check_and_reallocate_(0);
 
-            update_string_cache(get_chunk_idx(len_));
+            size_t chunk_idx, offset;
+            append_slot_(chunk_idx, offset);
+            update_string_cache(chunk_idx);
 
             string_cache_.push_back(val->clone());
             dirty_cache_ = true;
@@ -704,7 +1199,7 @@ class StringColumn : public Column {
             if (commit) {
                 commit_cache();
             }
-            len_++;
+            appended_();
         }
 
         char get_type_() override {
@@ -716,6 +1211,8 @@ class StringColumn : public Column {
 Column* Column::deserialize(const char* buf, KVStore* kvs) {
     char type;
     size_t len;
+    size_t num_chunks;
+    Placement* placement;
     String* name;
 
     const char* buf_pointer = buf;
@@ -725,38 +1222,51 @@ Column* Column::deserialize(const char* buf, KVStore* kvs) {
     memcpy(&len, buf_pointer, sizeof(size_t));
     buf_pointer += sizeof(size_t);
 
-    name = new String(buf_pointer);
-    buf_pointer += name->size() + 1;
+    memcpy(&num_chunks, buf_pointer, sizeof(size_t));
+    buf_pointer += sizeof(size_t);
+
+    placement = Placement::deserialize(buf_pointer);
+    buf_pointer += placement->serial_buf_size();
 
-    Array<Key>* keys = new Array<Key>();
+    size_t encodings_len, runs;
+    memcpy(&encodings_len, buf_pointer, sizeof(size_t));
+    memcpy(&runs, buf_pointer + sizeof(size_t), sizeof(size_t));
+    buf_pointer += 2 * sizeof(size_t);
+    const char* encodings = buf_pointer;
+    buf_pointer += runs * (sizeof(size_t) + 1);
 
-    if (len != 0) {
-        for (size_t i = 0; i < (len / kvs->get_config().CHUNK_SIZE) + 1; i++) {
-            keys->push_back(Key::deserialize(buf_pointer));
-            buf_pointer += keys->get(i)->serial_buf_size();
+    name = new String(buf_pointer);
+
+    Column* ret = create(type, len, num_chunks, placement, name, kvs);
+    // a run lasts until the next one starts, the last one until encodings_len
+    for (size_t r = 0; r < runs; r++) {
+        const char* run = encodings + r * (sizeof(size_t) + 1);
+        size_t first, last = encodings_len;
+        memcpy(&first, run, sizeof(size_t));
+        if (r + 1 < runs) {
+            memcpy(&last, run + sizeof(size_t) + 1, sizeof(size_t));
+        }
+        for (size_t i = first; i < last; i++) {
+            ret->set_chunk_encoding_(i, run[sizeof(size_t)]);
         }
     }
 
-    Column* ret = nullptr;
+    delete name;  // was cloned when creating the column
+    return ret;
+}
 
+Column* Column::create(char type, size_t len, size_t num_chunks, Placement* placement, String* col_name, KVStore* kvs) {
     switch (type) {
         case BOOL:
-            ret = new BoolColumn(len, keys, name, kvs);
-            break;
+            return new BoolColumn(len, num_chunks, placement, col_name, kvs);
         case INT:
-            ret = new IntColumn(len, keys, name, kvs);
-            break;
+            return new IntColumn(len, num_chunks, placement, col_name, kvs);
         case DOUBLE:
-            ret = new DoubleColumn(len, keys, name, kvs);
-            break;
+            return new DoubleColumn(len, num_chunks, placement, col_name, kvs);
         case STRING:
-            ret = new StringColumn(len, keys, name, kvs);
-            break;
+            return new StringColumn(len, num_chunks, placement, col_name, kvs);
         default:
-            Sys::fail("Column:deserialize, invalid type of column");
-            break;
+            Sys::fail("Column:create, invalid type of column");
+            return nullptr;
     }
-
-    delete name;  // was cloned when creating the column
-    return ret;
-}
\ No newline at end of file
+}
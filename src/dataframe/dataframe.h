@@ -2,6 +2,11 @@
 #pragma once
 
 #include <stdlib.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "row.h"
 #include "schema.h"
@@ -15,9 +20,44 @@
 #include "../kvstore/keyvaluestore.h"
 #include "../kvstore/keyvalue.h"
 
+class Aggregate;
+class DataFrame;
+class LazyFrame;
+class FrameView;
+class RowIds;
+template <class D> class Expr;
+
+// first bytes of every file written by DataFrame::save()
+static const char* DF_FILE_MAGIC = "EAU2DF01";
+static const size_t DF_FILE_MAGIC_LEN = 8;
+
 /*****************************************************************************
 Helper classes for DataFrame
 *****************************************************************************/
+/*
+ * RowIndex is kept up to date with the rows that are appended to a dataframe, which owns it.
+ * See ColumnIndex.
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class RowIndex : public Object {
+    public:
+        // the column that is indexed
+        virtual size_t col() = 0;
+
+        // the row was appended at offset of segment seg, or at row offset if the rows are not segmented
+        virtual void add(Row& row, size_t seg, size_t offset) = 0;
+
+        // stores what was added since the last flush
+        virtual void flush() = 0;
+
+        // the number of buckets the index is split into, recorded in the descriptor of the dataframe
+        virtual size_t num_buckets() = 0;
+};
+
+// reopens the index of column col of a deserialized dataframe, whose num_buckets buckets are
+// already stored. Returned index is owned by the caller, see DataFrame.index_opener_
+typedef RowIndex* (*IndexOpener)(DataFrame& df, size_t col, size_t num_buckets);
+
 /*
  * DataFrameAddFielder is a subclass of Fielder
  * Used to add Rows to a DataFrame
@@ -78,6 +118,30 @@ class DataFrameAddFielder : public Fielder {
         }
 };
 
+/*
+ * CopyRowFielder is a subclass of Fielder
+ * Used to copy the fields of a Row into another Row with the same schema, Strings are cloned
+ */
+class CopyRowFielder : public Fielder {
+    public:
+        Row& target_;  // external
+        size_t idx_;
+
+        CopyRowFielder(Row& target) : Fielder(), target_(target) {
+            idx_ = 0;
+        }
+
+        void start(size_t r) {
+            target_.set_idx(r);
+            idx_ = 0;
+        }
+
+        void accept(bool b) { target_.set(idx_++, b); }
+        void accept(double d) { target_.set(idx_++, d); }
+        void accept(int i) { target_.set(idx_++, i); }
+        void accept(String* s) { target_.set(idx_++, s->clone()); }
+};
+
 /*
  * PrintDataFrameFielder is a subclass of Fielder
  * Used to help print fields in a DataFrame
@@ -173,6 +237,15 @@ class DataFrame : public Object {
         size_t num_cols_owned_; // this is used to tell which columns we have to delete
         KVStore* kv_;  // external
         Key* key_;  // owned
+        Placement* placement_;  // owned; how the chunks of new columns are placed
+
+        // rows of a HASH placed dataframe that are waiting to be added, one Array per node,
+        // so that each node's chunks are filled one after the other
+        Array<Row>** staged_;  // owned, nullptr unless HASH placement
+        size_t* staged_len_;  // owned, number of staged rows in use per node
+        size_t local_seg_;  // the segment that rows are added to under LOCAL placement
+        size_t sorted_col_;  // the column that the rows are in ascending order of, MAX_SIZE_T if unordered
+        Array<RowIndex> indexes_;  // owns the indexes of the columns, see build_index
 
         /** Create a data frame with the same columns as the given df but with no rows or rownames */
         DataFrame(DataFrame& df, Key& key) : schema_() {
@@ -182,6 +255,9 @@ class DataFrame : public Object {
 
             kv_ = df.kv_;
             key_ = key.clone();
+            placement_ = df.placement_->clone_empty();
+            sorted_col_ = Config::MAX_SIZE_T;
+            init_staging_();
             
             cols_cap_ = schema_.width() < 4 ? 4: schema_.width();
             cols_len_ = schema_.width();
@@ -196,11 +272,27 @@ class DataFrame : public Object {
         DataFrame(Schema& schema, Key& key, KVStore* kv) : DataFrame(schema, key, kv, true) { }
 
         DataFrame(Schema& schema, Key& key, KVStore* kv, bool add_self) : schema_(schema) {
+            placement_ = Placement::round_robin(kv->num_nodes());
+            init_(key, kv, add_self);
+        }
+
+        /** Create a data frame from a schema whose chunks are placed with the given placement.
+         * All columns are created empty. */
+        DataFrame(Schema& schema, Key& key, KVStore* kv, Placement& placement, bool add_self) : schema_(schema) {
+            abort_if_not(placement.kind() != HASH || placement.key_col() < schema.width(), "DataFrame(): HASH key column out of bounds");
+            placement_ = placement.clone_empty();
+            init_(key, kv, add_self);
+        }
+
+        // common code of the schema constructors
+        void init_(Key& key, KVStore* kv, bool add_self) {
             cols_cap_ = schema_.width() < 4 ? 4: schema_.width();
             cols_len_ = schema_.width();
             num_cols_owned_ = schema_.width();
             key_ = key.clone();
             kv_ = kv;
+            sorted_col_ = Config::MAX_SIZE_T;
+            init_staging_();
             
             create_columns_by_schema_();
 
@@ -209,7 +301,39 @@ class DataFrame : public Object {
             }
         }
 
+        void init_staging_() {
+            local_seg_ = placement_->kind() == LOCAL ? kv_->node_index() * placement_->arg_ : 0;
+            staged_ = nullptr;
+            staged_len_ = nullptr;
+            if (placement_->kind() == HASH) {
+                staged_ = new Array<Row>*[placement_->num_nodes()];
+                staged_len_ = new size_t[placement_->num_nodes()];
+                for (size_t i = 0; i < placement_->num_nodes(); i++) {
+                    staged_[i] = new Array<Row>();
+                    staged_len_[i] = 0;
+                }
+            }
+        }
+
+        // NOTE: rows that are still staged are dropped, call commit() to keep them
         ~DataFrame() {
+            if (staged_ != nullptr) {
+                for (size_t i = 0; i < placement_->num_nodes(); i++) {
+                    for (size_t j = 0; j < staged_[i]->size(); j++) {
+                        if (j < staged_len_[i]) {
+                            staged_[i]->get(j)->delete_strings();
+                        }
+                        delete staged_[i]->get(j);
+                    }
+                    delete staged_[i];
+                }
+                delete[] staged_;
+                delete[] staged_len_;
+            }
+            for (size_t i = 0; i < indexes_.size(); i++) {
+                delete indexes_.get(i);
+            }
+            delete placement_;
             delete key_;
             // do not own any of the columns in this data frame
             // just release the memory for the array holding the column pointers
@@ -227,11 +351,66 @@ class DataFrame : public Object {
         }
 
         void commit() {
+            commit_chunks();
+            add_self_to_kv_();
+        }
+
+        // Frees the chunks that this node stores of a dataframe that an operation only uses itself,
+        // once no node reads them any more: they are removed at the end of the next exchange
+        // between the nodes, see KVStore.retire. Every node has to call this when it is done with
+        // the dataframe, before the operation moves on to its next exchange.
+        void retire_() {
+            for (size_t i = 0; i < ncols(); i++) {
+                cols_[i]->retire_local_chunks_();
+            }
+        }
+
+        // puts every pending row and chunk in the kvstore, without the descriptor
+        void commit_chunks() {
+            flush_staged_();
             // force columns to commit
             for (size_t i = 0; i < ncols(); i++) {
                 cols_[i]->commit_cache();
             }
-            add_self_to_kv_();
+            flush_indexes_();
+        }
+
+        void flush_indexes_() {
+            for (size_t i = 0; i < indexes_.size(); i++) {
+                indexes_.get(i)->flush();
+            }
+        }
+
+        // where the next row of the given segment goes: the segment and the offset in it, or
+        // segment 0 and the row index if the rows are not segmented
+        void append_pos_(size_t seg, size_t& index_seg, size_t& offset) {
+            Placement& p = cols_[0]->get_placement();
+            index_seg = p.segmented() ? seg : 0;
+            offset = p.segmented() ? p.seg_len(seg) : nrows();
+        }
+
+        // adds the rows at offsets [from, to) of segment seg, which were just appended, to the indexes
+        void index_appended_(size_t seg, size_t from, size_t to) {
+            if (indexes_.size() == 0 || from == to) {
+                return;
+            }
+            Placement& p = cols_[0]->get_placement();
+            size_t start = p.segmented() ? p.seg_start(seg) : 0;
+            bool* cols = new bool[cols_len_];
+            memset(cols, 0, cols_len_ * sizeof(bool));
+            for (size_t i = 0; i < indexes_.size(); i++) {
+                cols[indexes_.get(i)->col()] = true;
+            }
+            Row row(schema_);
+            for (size_t i = from; i < to; i++) {
+                fill_row(start + i, row, cols);
+                for (size_t j = 0; j < indexes_.size(); j++) {
+                    indexes_.get(j)->add(row, seg, i);
+                }
+                row.delete_strings();
+            }
+            delete[] cols;
+            flush_indexes_();
         }
 
         Key* get_key() {
@@ -273,6 +452,7 @@ class DataFrame : public Object {
                     default:
                         fail("DataFrame(): bad schema");
                 }
+                cols_[i]->set_placement(*placement_);
             }
         }
 
@@ -294,6 +474,11 @@ class DataFrame : public Object {
             return schema_;
         }
 
+        /** Returns how the chunks of this DataFrame are placed on nodes. */
+        Placement& get_placement() {
+            return *placement_;
+        }
+
         /** Adds a column this DataFrame, updates the schema, the new column
         * is external, and appears as the last column of the DataFrame, the
         * name is optional and external. A nullptr colum is undefined. */
@@ -307,6 +492,7 @@ class DataFrame : public Object {
         void add_column(Column* col, bool add_self) {
             abort_if_not(col != nullptr, "DataFrame.add_column(): col is nullptr");
             abort_if_not(cols_len_ == 0 || col->size() == nrows(), "DataFrame.add_column(): DataFrame is not rectangular");
+            abort_if_not(cols_len_ == 0 || col->get_placement().equals(&cols_[0]->get_placement()), "DataFrame.add_column(): column is placed differently");
             schema_.add_column(col->get_type());
             for (size_t i = nrows(); cols_len_ == 0 && i < col->size(); i++) {
                 // only add rows if it is the first column to be added
@@ -347,21 +533,30 @@ class DataFrame : public Object {
         * DataFrame, results are undefined.
         */
         void fill_row(size_t idx, Row& row) {
+            fill_row(idx, row, nullptr);
+        }
+
+        /** Sets only the fields of the given row whose columns are true in cols,
+         *  nullptr for every column. The chunks of the other columns are not
+         *  fetched, their fields are set to zeros (nullptr for strings).
+         */
+        void fill_row(size_t idx, Row& row, const bool* cols) {
             abort_if_not(idx < nrows(), "DataFrame.fill_row(): row index is out of bounds");
             row.set_idx(idx);
             for (size_t i = 0; i < cols_len_; i++) {
+                bool read = cols == nullptr || cols[i];
                 switch (schema_.col_type(i)) {
                     case BOOL:
-                        row.set(i, cols_[i]->as_bool()->get(idx));
+                        row.set(i, read ? cols_[i]->as_bool()->get(idx) : false);
                         break;                   
                     case INT:
-                        row.set(i, cols_[i]->as_int()->get(idx));
+                        row.set(i, read ? cols_[i]->as_int()->get(idx) : 0);
                         break;
                     case DOUBLE:
-                        row.set(i, cols_[i]->as_double()->get(idx));
+                        row.set(i, read ? cols_[i]->as_double()->get(idx) : 0.0);
                         break;
                     case STRING:
-                        row.set(i, cols_[i]->as_string()->get(idx));
+                        row.set(i, read ? cols_[i]->as_string()->get(idx) : nullptr);
                         break;                
                     default:
                         fail("DataFrame.fill_row(): bad schema");
@@ -369,17 +564,194 @@ class DataFrame : public Object {
             }
         }
 
+        // the columns that the rower reads, nullptr if it reads all of them. Owned by the caller
+        bool* columns_read_by_(Rower& r) {
+            bool* ret = new bool[cols_len_];
+            bool all = true;
+            for (size_t i = 0; i < cols_len_; i++) {
+                ret[i] = r.reads_column(i);
+                all = all && ret[i];
+            }
+            if (all) {
+                delete[] ret;
+                return nullptr;
+            }
+            return ret;
+        }
+
+        // the given columns as a mask over the columns of this dataframe. Owned by the caller
+        bool* columns_mask_(const size_t* cols, size_t num_cols) {
+            bool* ret = new bool[cols_len_];
+            memset(ret, 0, cols_len_ * sizeof(bool));
+            for (size_t i = 0; i < num_cols; i++) {
+                abort_if_not(cols[i] < cols_len_, "DataFrame: column %zu out of bounds", cols[i]);
+                ret[cols[i]] = true;
+            }
+            return ret;
+        }
+
         /** Add a row at the end of this dataframe. The row is expected to have
-         *  the right schema and be filled with values, otherwise undedined.  */
+         *  the right schema and be filled with values, otherwise undedined. 
+         *  For a HASH placed DataFrame the row goes to the end of the segment of its
+         *  node, if commit is false it is staged until that node has a full chunk of rows
+         *  or until commit() is called. */
         void add_row(Row& row, bool add_self, bool commit) {
+            if (staged_ != nullptr && !commit) {
+                stage_row_(row);
+            } else {
+                add_row_to_seg_(row, partition_of(row), commit);
+            }
+            if (add_self) {
+                add_self_to_kv_();
+            }
+        }
+
+        /** The segment that the given row is added to. Only HASH placement looks at the row. */
+        size_t partition_of(Row& row) {
+            if (placement_->kind() == LOCAL) {
+                return local_seg_;
+            }
+            if (placement_->kind() != HASH) {
+                return 0;
+            }
+            return placement_->node_of_hash(row.hash_field(placement_->key_col()));
+        }
+
+        // adds the row to the end of the given segment of every column
+        void add_row_to_seg_(Row& row, size_t seg, bool commit) {
+            sorted_col_ = Config::MAX_SIZE_T;
+            for (size_t i = 0; i < cols_len_; i++) {
+                cols_[i]->set_append_seg(seg);
+            }
+            size_t index_seg = 0;
+            size_t offset = 0;
+            if (indexes_.size() > 0) {
+                append_pos_(seg, index_seg, offset);
+            }
             DataFrameAddFielder f(cols_len_, cols_, commit); 
             row.visit(nrows(), f); // add data to columns
             if (cols_len_ > 0 && cols_[0]->size() > schema_.length()) {
                 schema_.add_row(); // nameless row
             }
-            if (add_self) {
-                add_self_to_kv_();
+            for (size_t i = 0; i < indexes_.size(); i++) {
+                indexes_.get(i)->add(row, index_seg, offset);
+                if (commit) {
+                    indexes_.get(i)->flush();
+                }
+            }
+        }
+
+        // copies the row into the staging area of its node, the node is flushed once it has a chunk of rows
+        void stage_row_(Row& row) {
+            sorted_col_ = Config::MAX_SIZE_T;
+            size_t seg = partition_of(row);
+            Array<Row>* rows = staged_[seg];
+            if (staged_len_[seg] == rows->size()) {
+                rows->push_back(new Row(schema_));
             }
+            CopyRowFielder f(*rows->get(staged_len_[seg]));
+            row.visit(row.get_idx(), f);
+            staged_len_[seg]++;
+
+            if (staged_len_[seg] == kv_->get_config().CHUNK_SIZE) {
+                flush_staged_(seg);
+            }
+        }
+
+        // adds every staged row of the given node to the columns
+        void flush_staged_(size_t seg) {
+            for (size_t i = 0; i < staged_len_[seg]; i++) {
+                Row* r = staged_[seg]->get(i);
+                add_row_to_seg_(*r, seg, false);
+                r->delete_strings();
+            }
+            staged_len_[seg] = 0;
+        }
+
+        // adds every staged row to the columns
+        void flush_staged_() {
+            if (staged_ == nullptr) {
+                return;
+            }
+            for (size_t i = 0; i < placement_->num_nodes(); i++) {
+                flush_staged_(i);
+            }
+        }
+
+        // appends rows rows that were encoded into one chunk per column, see Column.append_chunk_
+        // NOTE: takes ownership of the chunks, not of the array
+        void append_chunks_(Value** chunks, size_t rows) {
+            abort_if_not(staged_ == nullptr, "DataFrame.append_chunks_(): rows are being staged");
+            sorted_col_ = Config::MAX_SIZE_T;
+            size_t index_seg = 0;
+            size_t offset = 0;
+            if (indexes_.size() > 0) {
+                append_pos_(cols_[0]->append_seg_, index_seg, offset);
+            }
+            for (size_t i = 0; i < cols_len_; i++) {
+                cols_[i]->append_chunk_(chunks[i], rows);
+            }
+            schema_.num_rows_ += rows;
+            index_appended_(index_seg, offset, offset + rows);
+        }
+
+        // appends rows rows, encoded into one chunk per column, to the given segment of a segmented
+        // dataframe, see append_chunks_
+        // NOTE: takes ownership of the chunks, not of the array
+        void append_chunks_to_(size_t seg, Value** chunks, size_t rows) {
+            abort_if_not(placement_->segmented() && seg < placement_->num_segs(), "DataFrame.append_chunks_to_(): no segment %zu", seg);
+            for (size_t i = 0; i < cols_len_; i++) {
+                cols_[i]->set_append_seg(seg);
+            }
+            append_chunks_(chunks, rows);
+        }
+
+        // Widens column col to type, unless it already is at least as wide. The rows that were
+        // added keep their chunks, which are converted when they are read, see Column.promoted.
+        // Staged rows are added first. The key column of a HASH placement can only be widened
+        // while the dataframe is empty, the rows were placed by the hash of their old values.
+        void promote_column_(size_t col, char type) {
+            if (column_type_to_num(type) <= column_type_to_num(schema_.col_type(col))) {
+                return;
+            }
+            flush_staged_();
+            abort_if_not(placement_->kind() != HASH || placement_->key_col() != col || nrows() == 0, "DataFrame.promote_column_(): can not widen the HASH key column %zu", col);
+            for (size_t i = 0; i < indexes_.size(); i++) {
+                abort_if_not(indexes_.get(i)->col() != col, "DataFrame.promote_column_(): can not widen the indexed column %zu", col);
+            }
+            Column* old = cols_[col];
+            cols_[col] = old->promoted(type);
+            delete old;
+            schema_.set_col_type(col, type);
+            // the staged rows were built for the old schema
+            for (size_t i = 0; staged_ != nullptr && i < placement_->num_nodes(); i++) {
+                for (size_t j = 0; j < staged_[i]->size(); j++) {
+                    delete staged_[i]->get(j);
+                }
+                staged_[i]->clear();
+            }
+        }
+
+        // Adds the segments of part, a dataframe with the same key and segmented placement whose rows
+        // were added separately (see SOR.read_distributed), to this one. Columns are widened to the
+        // types of part.
+        void add_segs_(DataFrame& part) {
+            abort_if_not(part.ncols() == ncols(), "DataFrame.add_segs_(): %zu columns, not %zu", part.ncols(), ncols());
+            sorted_col_ = Config::MAX_SIZE_T;
+            size_t num_segs = cols_len_ > 0 ? cols_[0]->get_placement().num_segs() : 0;
+            size_t* old_lens = new size_t[num_segs > 0 ? num_segs : 1];
+            for (size_t i = 0; i < num_segs; i++) {
+                old_lens[i] = cols_[0]->get_placement().seg_len(i);
+            }
+            for (size_t i = 0; i < cols_len_; i++) {
+                promote_column_(i, part.schema_.col_type(i));
+                cols_[i]->add_segs_(*part.cols_[i]);
+            }
+            schema_.num_rows_ += part.nrows();
+            for (size_t i = 0; i < num_segs; i++) {
+                index_appended_(i, old_lens[i], cols_[0]->get_placement().seg_len(i));
+            }
+            delete[] old_lens;
         }
 
         /** Add a row at the end of this dataframe. The row is expected to have
@@ -401,9 +773,16 @@ class DataFrame : public Object {
 
         // maps over rows start to end using rower. start is inclusive and end is exclusive [start, end)
         void map_rows_(size_t start, size_t end, Rower& r) {
+            bool* cols = columns_read_by_(r);
+            map_rows_(start, end, r, cols);
+            delete[] cols;
+        }
+
+        // maps over rows start to end, only the columns in cols are filled in (nullptr for every column)
+        void map_rows_(size_t start, size_t end, Rower& r, const bool* cols) {
             Row row(schema_);
             for (size_t i = start; i < end; i++) {
-                fill_row(i, row);
+                fill_row(i, row, cols);
                 r.accept(row);  
                 // fill row will copy strings into it so delete them
                 row.delete_strings();
@@ -411,12 +790,32 @@ class DataFrame : public Object {
             // add_self_to_kv_();
         }
 
-        /** Visit rows in order */
+        /** Visit rows in order, only the columns that the rower reads are fetched */
         void map(Rower& r) {
             map_rows_(0, nrows(), r);
         }
 
+        /** Visit rows in order, only the given columns are fetched */
+        void map(Rower& r, const size_t* cols, size_t num_cols) {
+            bool* mask = columns_mask_(cols, num_cols);
+            map_rows_(0, nrows(), r, mask);
+            delete[] mask;
+        }
+
         void local_map(Rower& rower) {
+            bool* cols = columns_read_by_(rower);
+            local_map_(rower, cols);
+            delete[] cols;
+        }
+
+        // like local_map, only the given columns are fetched
+        void local_map(Rower& rower, const size_t* cols, size_t num_cols) {
+            bool* mask = columns_mask_(cols, num_cols);
+            local_map_(rower, mask);
+            delete[] mask;
+        }
+
+        void local_map_(Rower& rower, const bool* cols) {
             // maps over rows that are in this node ownly
             // calls rower.accept() row  -- ignores the return value
             if (ncols() == 0 ) {
@@ -425,7 +824,7 @@ class DataFrame : public Object {
             size_t start = 0;
             size_t end = 0;
             while (cols_[0]->get_next_local_rows(start, end)) {
-                map_rows_(start, end, rower);
+                map_rows_(start, end, rower, cols);
             }
         }
 
@@ -450,14 +849,15 @@ class DataFrame : public Object {
         }
 
         size_t serial_buf_size() {
-            size_t ret = key_->serial_buf_size() + sizeof(size_t); // key size and size_t for num columns
+            size_t ret = key_->serial_buf_size() + 3 * sizeof(size_t); // key size, size_t for num columns, the sorted column and num indexes
+            ret += indexes_.size() * 2 * sizeof(size_t);
             for (size_t i = 0; i < ncols(); i++) {
                 ret += cols_[i]->serial_buf_size();
             }
             return ret;
         }
 
-        // <key><num_cols>[cols...]
+        // <key><num_cols><sorted_col><num_indexes>[<indexed col><num buckets>...][cols...]
         char* serialize(char* buf) {
             char* buf_pointer = buf;
             key_->serialize(buf_pointer);
@@ -466,6 +866,18 @@ class DataFrame : public Object {
             memcpy(buf_pointer, &cols_len_, sizeof(size_t));
             buf_pointer += sizeof(size_t);
 
+            memcpy(buf_pointer, &sorted_col_, sizeof(size_t));
+            buf_pointer += sizeof(size_t);
+
+            size_t num_indexes = indexes_.size();
+            memcpy(buf_pointer, &num_indexes, sizeof(size_t));
+            buf_pointer += sizeof(size_t);
+            for (size_t i = 0; i < num_indexes; i++) {
+                size_t index_spec[2] = {indexes_.get(i)->col(), indexes_.get(i)->num_buckets()};
+                memcpy(buf_pointer, index_spec, sizeof(index_spec));
+                buf_pointer += sizeof(index_spec);
+            }
+
             for (size_t i = 0; i < ncols(); i++) {
                 cols_[i]->serialize(buf_pointer);
                 buf_pointer += cols_[i]->serial_buf_size();
@@ -474,7 +886,7 @@ class DataFrame : public Object {
             return buf;
         }
 
-        // <key><num_cols>[cols...]
+        // <key><num_cols><sorted_col><num_indexes>[<indexed col><num buckets>...][cols...]
         char* serialize() {
             char* buf = new char[serial_buf_size()];
             return serialize(buf);
@@ -496,22 +908,298 @@ class DataFrame : public Object {
         * The given key is the name of the returned dataframe.
         * */
         DataFrame* filter(Rower& r, Key& key) {
+            bool* cols = columns_read_by_(r);
+            DataFrame* df = filter_(r, key, cols);
+            delete[] cols;
+            return df;
+        }
+
+        /** Like filter, the rower is given only the given columns. */
+        DataFrame* filter(Rower& r, Key& key, const size_t* cols, size_t num_cols) {
+            bool* mask = columns_mask_(cols, num_cols);
+            DataFrame* df = filter_(r, key, mask);
+            delete[] mask;
+            return df;
+        }
+
+        // The rower sees only the columns in cols (nullptr for every column). The other columns
+        // are fetched only for the rows that are kept.
+        DataFrame* filter_(Rower& r, Key& key, const bool* cols) {
             DataFrame* df = new DataFrame(*this, key);
             Row row(schema_);
+            bool* rest = nullptr;
+            if (cols != nullptr) {
+                rest = new bool[cols_len_];
+                for (size_t i = 0; i < cols_len_; i++) {
+                    rest[i] = !cols[i];
+                }
+            }
             for (size_t i = 0; i < nrows(); i++) {
-                fill_row(i, row);
-                if (r.accept(row)) {
-                    df->add_row(row);
+                fill_row(i, row, cols);
+                if (!r.accept(row)) {
+                    row.delete_strings();
+                    continue;
+                }
+                if (rest != nullptr) {
+                    fill_rest_(i, row, rest);
+                }
+                df->add_row(row);
+                row.delete_strings();
+            }
+            delete[] rest;
+            return df;
+        }
+
+        // sets the fields of the columns in cols, leaves the other fields of the row as they are
+        void fill_rest_(size_t idx, Row& row, const bool* cols) {
+            for (size_t i = 0; i < cols_len_; i++) {
+                if (!cols[i]) {
+                    continue;
+                }
+                switch (schema_.col_type(i)) {
+                    case BOOL:
+                        row.set(i, cols_[i]->as_bool()->get(idx));
+                        break;
+                    case INT:
+                        row.set(i, cols_[i]->as_int()->get(idx));
+                        break;
+                    case DOUBLE:
+                        row.set(i, cols_[i]->as_double()->get(idx));
+                        break;
+                    default:
+                        row.set(i, cols_[i]->as_string()->get(idx));
+                        break;
                 }
             }
+        }
+
+        /** The column that the rows are in ascending order of, Config::MAX_SIZE_T if they are not
+         *  known to be ordered. Only sort_by orders a dataframe, adding rows forgets the order. */
+        size_t sorted_by() {
+            return sorted_col_;
+        }
+
+        /** Returns the rows whose value in col is in [lo, hi] under the given key. If the
+         *  dataframe is sorted by col only the chunks that hold those rows are read, otherwise
+         *  every row is looked at. The result keeps the order. */
+        DataFrame* filter_range(size_t col, int lo, int hi, Key& key) {
+            Schema bound_schema("I");
+            Row low(bound_schema);
+            Row high(bound_schema);
+            low.set(0, lo);
+            high.set(0, hi);
+            return filter_range_(col, low, high, key);
+        }
+
+        DataFrame* filter_range(size_t col, double lo, double hi, Key& key) {
+            Schema bound_schema("D");
+            Row low(bound_schema);
+            Row high(bound_schema);
+            low.set(0, lo);
+            high.set(0, hi);
+            return filter_range_(col, low, high, key);
+        }
+
+        DataFrame* filter_range(size_t col, const char* lo, const char* hi, Key& key) {
+            Schema bound_schema("S");
+            Row low(bound_schema);
+            Row high(bound_schema);
+            String low_str(lo);
+            String high_str(hi);
+            low.set(0, &low_str);
+            high.set(0, &high_str);
+            return filter_range_(col, low, high, key);
+        }
+
+        // lo and hi are rows with a single field of the type of col
+        DataFrame* filter_range_(size_t col, Row& lo, Row& hi, Key& key) {
+            abort_if_not(col < ncols(), "DataFrame.filter_range(): column %zu out of bounds", col);
+            abort_if_not(schema_.col_type(col) == lo.col_type(0), "DataFrame.filter_range(): bounds are not of the type of column %zu", col);
+            bool* cols = columns_mask_(&col, 1);
+            bool* rest = new bool[cols_len_];
+            for (size_t i = 0; i < cols_len_; i++) {
+                rest[i] = !cols[i];
+            }
+            size_t start = 0;
+            size_t end = nrows();
+            if (sorted_col_ == col) {
+                // the rows in range are next to each other, finding them reads about log(chunks) chunks
+                start = first_row_after_(col, lo, cols, false);
+                end = first_row_after_(col, hi, cols, true);
+            }
+            DataFrame* df = new DataFrame(*this, key);
+            Row row(schema_);
+            for (size_t i = start; i < end; i++) {
+                fill_row(i, row, cols);
+                if (row.compare_field(col, lo, 0) >= 0 && row.compare_field(col, hi, 0) <= 0) {
+                    fill_rest_(i, row, rest);
+                    df->add_row(row, false, false);
+                }
+                row.delete_strings();
+            }
+            df->commit_chunks();
+            df->sorted_col_ = sorted_col_ == col ? col : Config::MAX_SIZE_T;
+            df->add_self_to_kv_();
+            delete[] cols;
+            delete[] rest;
             return df;
         }
 
+        // the first row whose value in col is at least bound, or greater than bound if inclusive.
+        // The rows have to be sorted by col
+        size_t first_row_after_(size_t col, Row& bound, const bool* cols, bool inclusive) {
+            size_t lo = 0;
+            size_t hi = nrows();
+            Row row(schema_);
+            while (lo < hi) {
+                size_t mid = lo + (hi - lo) / 2;
+                fill_row(mid, row, cols);
+                int c = row.compare_field(col, bound, 0);
+                row.delete_strings();
+                if (c < 0 || (inclusive && c == 0)) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            return lo;
+        }
+
         /** This method clones the Rower and executes the map in parallel. Join is
          * used at the end to merge the results. 
          * */
         void pmap(Rower& r);
 
+        /** Runs the rower registered as name on every node, over the rows of the chunks that
+         *  are stored on that node, and joins the partial results into r with join_delete. The
+         *  chunks are not moved, only the descriptor of this dataframe and the results are.
+         *  args are handed to the factory of the rower on every node.
+         *  Implemented in shipping.h
+         */
+        void ship(const char* name, Rower& r, const char* args, size_t args_len);
+
+        void ship(const char* name, Rower& r) {
+            ship(name, r, nullptr, 0);
+        }
+
+        /** Returns the rows that pred holds for under the given key, in order. pred is an
+         *  expression such as col<int>(0) > 5 && col<const char*>(2) == "linux", see Expr. It
+         *  is compiled into one loop over the raw chunks of the columns it reads, which writes the
+         *  indices of the rows that pass into a selection vector; only those rows are boxed and
+         *  copied. Fails if pred reads a column that is out of bounds or reads a column as
+         *  another type than its own. Implemented in expr.h
+         */
+        template <class E>
+        DataFrame* where(const Expr<E>& pred, Key& key);
+
+        /** The number of rows that pred holds for, see where. Implemented in expr.h */
+        template <class E>
+        size_t count_where(const Expr<E>& pred);
+
+        /** Like where, but returns a view of the rows instead of copying them, see FrameView.
+         *  Implemented in expr.h
+         */
+        template <class E>
+        FrameView* where_view(const Expr<E>& pred);
+
+        /** Like filter, but returns a view of the rows the rower accepts instead of copying them.
+         *  The view is owned by the caller and must not outlive this dataframe, see FrameView. */
+        FrameView* filter_view(Rower& r) {
+            return filter_view_(r, false);
+        }
+
+        /** Like filter_view, but only the rows stored on this node are filtered. */
+        FrameView* local_filter_view(Rower& r) {
+            return filter_view_(r, true);
+        }
+
+        // Implemented in view.h
+        FrameView* filter_view_(Rower& r, bool local);
+
+        /** Builds a hash index of the values of col, which is kept up to date as rows are
+         *  appended. Every node has to call this with the same arguments. The index is split into
+         *  buckets by the hash of the values, each bucket is a value in the kvstore on the node
+         *  it is homed on and lists the rows of its values. Implemented in index.h
+         */
+        void build_index(size_t col);
+
+        /** The rows whose value in col is value, in ascending order, owned by the caller. If col
+         *  has an index this fetches one bucket of it, otherwise every row is looked at.
+         *  Implemented in index.h
+         */
+        RowIds* lookup(size_t col, int value);
+        RowIds* lookup(size_t col, double value);
+        RowIds* lookup(size_t col, const char* value);
+
+        /** The rows whose INT value in col is in [lo, hi], like lookup. Every bucket of the index
+         *  that holds one of the values is fetched once. Implemented in index.h
+         */
+        RowIds* lookup_range(size_t col, int lo, int hi);
+
+        /** A plan over this dataframe that runs when its result is asked for, see LazyFrame.
+         *  Implemented in plan.h
+         */
+        LazyFrame lazy();
+
+        // The operators below move rows between nodes. Every node has to run the same operators in
+        // the same order, as the nodes match up their exchanges by the order they run in. A key
+        // holds the result of one call at a time: calling an operator with the key of a dataframe
+        // that is still in use overwrites its chunks, so use a new key for every call. The keys and
+        // chunks that an operator only uses itself are removed while it runs, only the small
+        // descriptions of its last exchange stay until the next exchange has read them.
+
+        /** Returns the rows whose value in col is one of the values in member_col of membership,
+         *  under the given key. Every node has to call this with the same arguments. The keys of
+         *  membership are broadcast as a bitmap that is tested while the rows are scanned: an exact
+         *  bitmap of the range of an INT column if that is no bigger than a Bloom filter of them,
+         *  a Bloom filter otherwise. The rows that pass a Bloom filter are checked against the keys
+         *  on the node their key hashes to, so only they and the keys are moved.
+         *  Implemented in semi_join.h
+         */
+        DataFrame* semi_join(size_t col, DataFrame& membership, size_t member_col, Key& key);
+
+        /** Returns a copy of this dataframe under the given key with the rows in ascending order of
+         *  col. Every node has to call this with the same arguments. It is a sample sort: the
+         *  nodes sample their values of col to pick splitters, send every row to the node whose
+         *  range it falls in, and sort the rows they get. Node n keeps the n-th range, so the
+         *  result is range partitioned and its descriptor records that it is sorted by col.
+         *  Implemented in sort.h
+         */
+        DataFrame* sort_by(size_t col, Key& key);
+
+        /** Returns a copy of this dataframe under the given key in which every row is stored on the
+         *  node that its value in col hashes to, so rows with the same value are on the same node
+         *  and local_map sees all of them there. Every node has to call this with the same
+         *  arguments: each node sends its local rows in whole chunks, a put per column, and
+         *  waits for the rows of the other nodes.
+         *  Implemented in shuffle.h
+         */
+        DataFrame* repartition(size_t col, Key& key);
+
+        /** Groups the rows by the values of the key columns and aggregates every group. Returns a
+         *  dataframe with the key columns first and then one column for each aggregate, with one
+         *  row per group, under the given key. Every node has to call this with the same arguments:
+         *  each node aggregates its local rows, sends the partial groups to the node their key
+         *  hashes to and merges the groups it gets. The merged groups stay on that node.
+         *  Implemented in group_by.h
+         */
+        DataFrame* group_by(const size_t* key_cols, size_t num_keys, Aggregate* aggs, size_t num_aggs, Key& key);
+
+        /** Joins the rows of this dataframe and other whose values in left_col and right_col are
+         *  equal. Returns a dataframe with the given columns of this dataframe first and then the
+         *  given columns of other, with one row for every pair of matching rows, under the given
+         *  key. Every node has to call this with the same arguments: both sides are partitioned by
+         *  the hash of their join column, moving only the columns that are joined, then each node
+         *  builds a hash table of its part of the smaller side and probes it with its part of the
+         *  other side. The joined rows stay on the node they were joined on.
+         *  Implemented in join.h
+         */
+        DataFrame* join(DataFrame& other, size_t left_col, size_t right_col, const size_t* left_cols, size_t num_left,
+                const size_t* right_cols, size_t num_right, Key& key);
+
+        /** Like join, with every column of this dataframe and every column of other but right_col */
+        DataFrame* join(DataFrame& other, size_t left_col, size_t right_col, Key& key);
+
         template <class T>
         static DataFrame* fromArray_(Key* k, KVStore* kvs, size_t size, Schema &s, T* vals) {
             DataFrame* df = new DataFrame(s, *k, kvs, false);
@@ -578,6 +1266,190 @@ class DataFrame : public Object {
             return df;
         }
 
+        // a visitor that builds a DataFrame placed with the given placement
+        static DataFrame* fromVisitor(Key* k, KVStore* kvs, const char* schema, Writer& writer, Placement& placement) {
+            Schema s(schema);
+            DataFrame* df = new DataFrame(s, *k, kvs, placement, false);
+            Row row(s);
+            
+            while (!writer.done()) {
+                writer.visit(row); // updates the row
+                df->add_row(row, false, false);
+                writer.clean_up_row(row);
+            }
+            
+            df->commit();
+            return df;
+        }
+
+        // sets the segment that rows are added to under LOCAL placement, it has to be one of the
+        // segments of this node
+        void set_local_seg(size_t seg) {
+            abort_if_not(placement_->kind() == LOCAL && placement_->seg_node(seg) == kv_->node_index(), "DataFrame.set_local_seg(): segment %zu is not local", seg);
+            local_seg_ = seg;
+        }
+
+        // replaces the placement used for new columns, does not touch existing columns
+        void set_placement_(Placement& placement) {
+            abort_if_not(staged_ == nullptr, "DataFrame.set_placement_(): rows are being staged");
+            delete placement_;
+            placement_ = placement.clone_empty();
+            init_staging_();
+        }
+
+        // Writes the dataframe to a binary columnar file at path. The file is self describing:
+        // <magic><chunk_size><nrows><ncols><schema types><placement size><placement>
+        //     [per column: <num_chunks>[<chunk_idx><offset><size>...]] [chunk bytes...]
+        // Chunks are written exactly as they are stored in the kvstore, offsets are from the start
+        // of the file. Segmented placements skip chunk indices, so every chunk records its index.
+        void save(const char* path) {
+            commit();
+            FILE* file = fopen(path, "w");
+            abort_if_not(file != NULL, "DataFrame.save(): failed to open %s", path);
+
+            size_t chunk_size = kv_->get_config().CHUNK_SIZE;
+            size_t rows = nrows();
+            size_t num_cols = ncols();
+            Placement& placement = num_cols > 0 ? cols_[0]->get_placement() : *placement_;
+            size_t placement_size = placement.serial_buf_size();
+            char* placement_buf = new char[placement_size];
+            placement.serialize(placement_buf);
+
+            bool ok = fwrite(DF_FILE_MAGIC, 1, DF_FILE_MAGIC_LEN, file) == DF_FILE_MAGIC_LEN;
+            ok = ok && fwrite(&chunk_size, sizeof(size_t), 1, file) == 1;
+            ok = ok && fwrite(&rows, sizeof(size_t), 1, file) == 1;
+            ok = ok && fwrite(&num_cols, sizeof(size_t), 1, file) == 1;
+            for (size_t i = 0; i < num_cols && ok; i++) {
+                char type = schema_.col_type(i);
+                ok = fwrite(&type, 1, 1, file) == 1;
+            }
+            ok = ok && fwrite(&placement_size, sizeof(size_t), 1, file) == 1;
+            ok = ok && fwrite(placement_buf, 1, placement_size, file) == placement_size;
+            delete[] placement_buf;
+
+            // the directory is filled in once the chunks have been written
+            size_t dir_start = ftell(file);
+            size_t dir_len = 0;
+            for (size_t i = 0; i < num_cols; i++) {
+                dir_len += 1 + 3 * cols_[i]->num_chunks();
+            }
+            size_t* dir = new size_t[dir_len];
+            memset(dir, 0, dir_len * sizeof(size_t));
+            ok = ok && fwrite(dir, sizeof(size_t), dir_len, file) == dir_len;
+
+            size_t offset = dir_start + dir_len * sizeof(size_t);
+            size_t dir_idx = 0;
+            for (size_t i = 0; i < num_cols && ok; i++) {
+                dir[dir_idx++] = cols_[i]->num_chunks();
+                for (size_t c = 0; c < cols_[i]->chunk_slots() && ok; c++) {
+                    if (!cols_[i]->has_chunk(c)) {
+                        continue;
+                    }
+                    Value* chunk = cols_[i]->read_chunk(c);
+                    abort_if_not(chunk != nullptr, "DataFrame.save(): chunk %zu of column %zu is missing", c, i);
+                    ok = fwrite(chunk->get(), 1, chunk->size(), file) == chunk->size();
+                    dir[dir_idx++] = c;
+                    dir[dir_idx++] = offset;
+                    dir[dir_idx++] = chunk->size();
+                    offset += chunk->size();
+                    delete chunk;
+                }
+            }
+
+            ok = ok && fseek(file, dir_start, SEEK_SET) == 0;
+            ok = ok && fwrite(dir, sizeof(size_t), dir_len, file) == dir_len;
+            ok = fclose(file) == 0 && ok;
+            abort_if_not(ok, "DataFrame.save(): failed to write %s", path);
+            delete[] dir;
+        }
+
+        // Loads a dataframe written by save() and puts it in the kvstore with the given key. The file
+        // is mapped into memory and every chunk is put straight from the mapping, nothing is parsed.
+        // The chunks are placed like they were when the file was saved, on this kvstore's nodes.
+        static DataFrame* load(Key* k, KVStore* kvs, const char* path) {
+            int fd = open(path, O_RDONLY);
+            if (fd < 0) {
+                fail("DataFrame.load(): failed to open %s", path);
+            }
+            struct stat st;
+            if (fstat(fd, &st) != 0) {
+                fail("DataFrame.load(): failed to stat %s", path);
+            }
+            size_t file_len = st.st_size;
+            if (file_len < DF_FILE_MAGIC_LEN + 3 * sizeof(size_t)) {
+                fail("DataFrame.load(): %s is too short", path);
+            }
+
+            char* mapped = (char*) mmap(nullptr, file_len, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                fail("DataFrame.load(): failed to map %s", path);
+            }
+            madvise(mapped, file_len, MADV_SEQUENTIAL);
+            if (memcmp(mapped, DF_FILE_MAGIC, DF_FILE_MAGIC_LEN) != 0) {
+                fail("DataFrame.load(): %s is not a dataframe file", path);
+            }
+
+            const char* pos = mapped + DF_FILE_MAGIC_LEN;
+            size_t chunk_size, rows, num_cols, placement_size;
+            memcpy(&chunk_size, pos, sizeof(size_t));
+            memcpy(&rows, pos + sizeof(size_t), sizeof(size_t));
+            memcpy(&num_cols, pos + 2 * sizeof(size_t), sizeof(size_t));
+            pos += 3 * sizeof(size_t);
+            if (chunk_size != kvs->get_config().CHUNK_SIZE) {
+                fail("DataFrame.load(): %s has chunks of %zu, not %zu", path, chunk_size, kvs->get_config().CHUNK_SIZE);
+            }
+
+            char* types = new char[num_cols + 1];
+            memcpy(types, pos, num_cols);
+            types[num_cols] = '\0';
+            pos += num_cols;
+            Schema schema(types);
+            delete[] types;
+
+            memcpy(&placement_size, pos, sizeof(size_t));
+            pos += sizeof(size_t);
+            Placement* saved = Placement::deserialize(pos);
+            pos += placement_size;
+            Placement* placement = saved;
+            if (saved->num_nodes() != kvs->num_nodes()) {
+                // the rows of a segmented placement are laid out by node, so they can only be loaded on as many nodes
+                if (saved->segmented()) {
+                    fail("DataFrame.load(): %s is hashed over %zu nodes, not %zu", path, saved->num_nodes(), kvs->num_nodes());
+                }
+                placement = new Placement(saved->kind(), kvs->num_nodes(), saved->arg_);
+                placement->set_replicas(saved->replicas() < kvs->num_nodes() ? saved->replicas() : kvs->num_nodes());
+                delete saved;
+            }
+
+            DataFrame* df = new DataFrame(schema, *k, kvs, *placement, false);
+            // the directory is not aligned, so it is read with memcpy
+            size_t num_chunks, chunk_idx, offset, size;
+            for (size_t i = 0; i < num_cols; i++) {
+                memcpy(&num_chunks, pos, sizeof(size_t));
+                pos += sizeof(size_t);
+                for (size_t c = 0; c < num_chunks; c++) {
+                    memcpy(&chunk_idx, pos, sizeof(size_t));
+                    memcpy(&offset, pos + sizeof(size_t), sizeof(size_t));
+                    memcpy(&size, pos + 2 * sizeof(size_t), sizeof(size_t));
+                    pos += 3 * sizeof(size_t);
+                    if (offset + size > file_len) {
+                        fail("DataFrame.load(): %s is truncated", path);
+                    }
+                    Value* chunk = Value::borrow(size, mapped + offset);
+                    df->cols_[i]->put_(chunk_idx, *chunk);
+                    delete chunk;
+                }
+                df->cols_[i]->set_chunks_(rows, num_chunks, *placement);
+            }
+            df->schema_.num_rows_ = rows;
+            df->add_self_to_kv_();
+
+            delete placement;
+            munmap(mapped, file_len);
+            close(fd);
+            return df;
+        }
+
         // this is implemented at the bottom of sorer.h
         // static DataFrame* fromFile(const char* filename, Key* key, KVStore* kvs);
 
@@ -592,6 +1464,17 @@ class DataFrame : public Object {
             memcpy(&num_cols, buf_pointer, sizeof(size_t));
             buf_pointer += sizeof(size_t);
 
+            size_t sorted_col;
+            memcpy(&sorted_col, buf_pointer, sizeof(size_t));
+            buf_pointer += sizeof(size_t);
+
+            // the indexes are reopened once the columns are there
+            size_t num_indexes;
+            memcpy(&num_indexes, buf_pointer, sizeof(size_t));
+            buf_pointer += sizeof(size_t);
+            const char* index_specs = buf_pointer;
+            buf_pointer += num_indexes * 2 * sizeof(size_t);
+
             // do not add the dataframe to the kvstore
             DataFrame* df = new DataFrame(schema, *k, kvs, false);
             Column* new_col;
@@ -602,10 +1485,28 @@ class DataFrame : public Object {
             }
 
             df->num_cols_owned_ = df->ncols();
+            if (num_cols > 0) {
+                df->set_placement_(df->cols_[0]->get_placement());
+            }
+            df->sorted_col_ = sorted_col;
+            for (size_t i = 0; i < num_indexes; i++) {
+                size_t index_spec[2];
+                memcpy(index_spec, index_specs + i * sizeof(index_spec), sizeof(index_spec));
+                if (index_opener_() == nullptr) {
+                    Sys::fail("DataFrame.deserialize(): the dataframe has an index, but index.h is not included");
+                }
+                df->indexes_.push_back(index_opener_()(*df, index_spec[0], index_spec[1]));
+            }
 
             delete k;
             return df;
         }
+
+        // reopens the indexes that deserialize reads from a descriptor, set by index.h
+        static IndexOpener& index_opener_() {
+            static IndexOpener opener = nullptr;
+            return opener;
+        }
 };
 
 // MapThread is a subclass of Thread
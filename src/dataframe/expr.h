@@ -0,0 +1,536 @@
+//lang:Cpp
+#pragma once
+
+#include <type_traits>
+
+#include "row.h"
+#include "schema.h"
+#include "column.h"
+#include "dataframe.h"
+#include "view.h"
+
+#include "../util/object.h"
+
+#include "../kvstore/keyvalue.h"
+
+/**
+ * The chunks that hold one chunk's worth of rows of a dataframe, for the columns that an
+ * expression reads. The values are read straight from the chunk buffers, as they are laid out in
+ * the kvstore, without boxing them into a Row. next() walks the chunks in the order of the rows.
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class ChunkBatch : public Object {
+    public:
+        DataFrame& df_;  // external
+        bool* cols_;  // owned; the columns that are loaded
+        Value** chunks_;  // owned; the chunk of every loaded column, nullptr for the others
+        const char*** strings_;  // owned; the start of every string of a loaded string column
+        size_t* strings_cap_;  // owned
+        size_t chunk_idx_;  // the chunk that is loaded
+        size_t first_row_;  // the row of the dataframe that is the first row of the chunk
+        size_t rows_;  // rows in the chunk
+        size_t next_row_;  // the first row of the next chunk
+
+        // loads the given columns, nullptr for every column
+        ChunkBatch(DataFrame& df, const bool* cols) : df_(df) {
+            size_t width = df.ncols();
+            cols_ = new bool[width > 0 ? width : 1];
+            chunks_ = new Value*[width > 0 ? width : 1];
+            strings_ = new const char**[width > 0 ? width : 1];
+            strings_cap_ = new size_t[width > 0 ? width : 1];
+            for (size_t i = 0; i < width; i++) {
+                cols_[i] = cols == nullptr || cols[i];
+                chunks_[i] = nullptr;
+                strings_[i] = nullptr;
+                strings_cap_[i] = 0;
+            }
+            chunk_idx_ = 0;
+            first_row_ = 0;
+            rows_ = 0;
+            next_row_ = 0;
+        }
+
+        ~ChunkBatch() {
+            for (size_t i = 0; i < df_.ncols(); i++) {
+                delete chunks_[i];
+                delete[] strings_[i];
+            }
+            delete[] cols_;
+            delete[] chunks_;
+            delete[] strings_;
+            delete[] strings_cap_;
+        }
+
+        // loads the chunk that holds the given row, which has to be the first row of a chunk
+        void load(size_t row) {
+            abort_if_not(row < df_.nrows(), "ChunkBatch.load(): row %zu out of bounds", row);
+            Column* first = df_.cols_[0];
+            size_t offset;
+            first->locate_(row, chunk_idx_, offset);
+            abort_if_not(offset == 0, "ChunkBatch.load(): row %zu does not start a chunk", row);
+            first_row_ = row;
+            rows_ = first->get_placement().chunk_rows(chunk_idx_, first->size(), df_.kv_->get_config().CHUNK_SIZE);
+            next_row_ = row + rows_;
+            for (size_t i = 0; i < df_.ncols(); i++) {
+                delete chunks_[i];
+                chunks_[i] = nullptr;
+                if (!cols_[i]) {
+                    continue;
+                }
+                chunks_[i] = df_.cols_[i]->read_chunk(chunk_idx_);
+                if (df_.get_schema().col_type(i) == STRING) {
+                    index_strings_(i);
+                }
+            }
+        }
+
+        // finds where every string of the loaded chunk of col starts
+        void index_strings_(size_t col) {
+            if (strings_cap_[col] < rows_) {
+                delete[] strings_[col];
+                strings_cap_[col] = rows_;
+                strings_[col] = new const char*[rows_];
+            }
+            const char* pos = chunks_[col]->get();
+            for (size_t i = 0; i < rows_; i++) {
+                strings_[col][i] = pos;
+                pos += strlen(pos) + 1;
+            }
+        }
+
+        // loads the chunk after the one that is loaded, false if there is none
+        bool next() {
+            if (next_row_ >= df_.nrows()) {
+                return false;
+            }
+            load(next_row_);
+            return true;
+        }
+
+        // the rows of the chunk, from the first row of the dataframe that it holds
+        size_t rows() {
+            return rows_;
+        }
+
+        size_t first_row() {
+            return first_row_;
+        }
+
+        bool get_bool(size_t col, size_t i) {
+            size_t word;
+            memcpy(&word, chunks_[col]->get() + (i / (sizeof(size_t) * 8)) * sizeof(size_t), sizeof(size_t));
+            return (word >> (i % (sizeof(size_t) * 8))) & 1;
+        }
+
+        int get_int(size_t col, size_t i) {
+            int ret;
+            memcpy(&ret, chunks_[col]->get() + i * sizeof(int), sizeof(int));
+            return ret;
+        }
+
+        double get_double(size_t col, size_t i) {
+            double ret;
+            memcpy(&ret, chunks_[col]->get() + i * sizeof(double), sizeof(double));
+            return ret;
+        }
+
+        const char* get_string(size_t col, size_t i) {
+            return strings_[col][i];
+        }
+};
+
+/**
+ * The base of the nodes of a predicate expression, see col(). Every node has
+ *   eval(batch, i)  its value for row i of the loaded chunk of batch
+ *   columns(schema, mask)   sets mask[c] for every column c that it reads, after checking
+ *                           that the column is in the schema with the type it is read as
+ * The nodes are templates, so a whole expression is compiled into one inlined loop.
+ */
+template <class D>
+class Expr {
+    public:
+        const D& self() const {
+            return static_cast<const D&>(*this);
+        }
+};
+
+// the value of a column, of type T: bool, int, double or const char* for strings
+template <class T>
+class ColRef : public Expr<ColRef<T>> {
+    public:
+        size_t col_;
+
+        explicit ColRef(size_t col) {
+            col_ = col;
+        }
+
+        T eval(ChunkBatch& b, size_t i) const;
+
+        void columns(Schema& schema, bool* mask) const;
+};
+
+// the column type that is read as T
+template <class T>
+char ref_type();
+
+template <>
+inline char ref_type<bool>() {
+    return BOOL;
+}
+
+template <>
+inline char ref_type<int>() {
+    return INT;
+}
+
+template <>
+inline char ref_type<double>() {
+    return DOUBLE;
+}
+
+template <>
+inline char ref_type<const char*>() {
+    return STRING;
+}
+
+template <class T>
+void ColRef<T>::columns(Schema& schema, bool* mask) const {
+    if (col_ >= schema.width()) {
+        Sys::fail("col(): column %zu out of bounds", col_);
+    }
+    if (schema.col_type(col_) != ref_type<T>()) {
+        Sys::fail("col(): column %zu is of type %c, not %c", col_, schema.col_type(col_), ref_type<T>());
+    }
+    mask[col_] = true;
+}
+
+template <>
+inline bool ColRef<bool>::eval(ChunkBatch& b, size_t i) const {
+    return b.get_bool(col_, i);
+}
+
+template <>
+inline int ColRef<int>::eval(ChunkBatch& b, size_t i) const {
+    return b.get_int(col_, i);
+}
+
+template <>
+inline double ColRef<double>::eval(ChunkBatch& b, size_t i) const {
+    return b.get_double(col_, i);
+}
+
+template <>
+inline const char* ColRef<const char*>::eval(ChunkBatch& b, size_t i) const {
+    return b.get_string(col_, i);
+}
+
+// the column col of type T, the leaf of a predicate: col<int>(0) > 5 && col<const char*>(2) == "linux"
+template <class T>
+ColRef<T> col(size_t col) {
+    return ColRef<T>(col);
+}
+
+// a constant in a predicate
+template <class T>
+class Lit : public Expr<Lit<T>> {
+    public:
+        T val_;
+
+        explicit Lit(T val) : val_(val) { }
+
+        T eval(ChunkBatch& b, size_t i) const {
+            return val_;
+        }
+
+        void columns(Schema& schema, bool* mask) const { }
+};
+
+// the comparisons of a predicate, strings are compared byte by byte
+class LessOp {
+    public:
+        template <class A, class B>
+        static bool apply(A a, B b) { return a < b; }
+        static bool apply(const char* a, const char* b) { return strcmp(a, b) < 0; }
+};
+
+class LessEqOp {
+    public:
+        template <class A, class B>
+        static bool apply(A a, B b) { return a <= b; }
+        static bool apply(const char* a, const char* b) { return strcmp(a, b) <= 0; }
+};
+
+class GreaterOp {
+    public:
+        template <class A, class B>
+        static bool apply(A a, B b) { return a > b; }
+        static bool apply(const char* a, const char* b) { return strcmp(a, b) > 0; }
+};
+
+class GreaterEqOp {
+    public:
+        template <class A, class B>
+        static bool apply(A a, B b) { return a >= b; }
+        static bool apply(const char* a, const char* b) { return strcmp(a, b) >= 0; }
+};
+
+class EqOp {
+    public:
+        template <class A, class B>
+        static bool apply(A a, B b) { return a == b; }
+        static bool apply(const char* a, const char* b) { return strcmp(a, b) == 0; }
+};
+
+class NotEqOp {
+    public:
+        template <class A, class B>
+        static bool apply(A a, B b) { return a != b; }
+        static bool apply(const char* a, const char* b) { return strcmp(a, b) != 0; }
+};
+
+template <class L, class R, class Op>
+class Compare : public Expr<Compare<L, R, Op>> {
+    public:
+        L l_;
+        R r_;
+
+        Compare(const L& l, const R& r) : l_(l), r_(r) { }
+
+        bool eval(ChunkBatch& b, size_t i) const {
+            return Op::apply(l_.eval(b, i), r_.eval(b, i));
+        }
+
+        void columns(Schema& schema, bool* mask) const {
+            l_.columns(schema, mask);
+            r_.columns(schema, mask);
+        }
+};
+
+template <class L, class R>
+class And : public Expr<And<L, R>> {
+    public:
+        L l_;
+        R r_;
+
+        And(const L& l, const R& r) : l_(l), r_(r) { }
+
+        bool eval(ChunkBatch& b, size_t i) const {
+            return l_.eval(b, i) && r_.eval(b, i);
+        }
+
+        void columns(Schema& schema, bool* mask) const {
+            l_.columns(schema, mask);
+            r_.columns(schema, mask);
+        }
+};
+
+template <class L, class R>
+class Or : public Expr<Or<L, R>> {
+    public:
+        L l_;
+        R r_;
+
+        Or(const L& l, const R& r) : l_(l), r_(r) { }
+
+        bool eval(ChunkBatch& b, size_t i) const {
+            return l_.eval(b, i) || r_.eval(b, i);
+        }
+
+        void columns(Schema& schema, bool* mask) const {
+            l_.columns(schema, mask);
+            r_.columns(schema, mask);
+        }
+};
+
+template <class E>
+class Not : public Expr<Not<E>> {
+    public:
+        E e_;
+
+        explicit Not(const E& e) : e_(e) { }
+
+        bool eval(ChunkBatch& b, size_t i) const {
+            return !e_.eval(b, i);
+        }
+
+        void columns(Schema& schema, bool* mask) const {
+            e_.columns(schema, mask);
+        }
+};
+
+// constants that can be compared with a column
+template <class V>
+class IsLiteral {
+    public:
+        static const bool value = std::is_arithmetic<V>::value || std::is_same<V, const char*>::value || std::is_same<V, char*>::value;
+};
+
+// the type a constant is kept as in an expression
+template <class V>
+class LiteralOf {
+    public:
+        typedef typename std::conditional<std::is_same<V, char*>::value, const char*, V>::type type;
+};
+
+template <class A, class B>
+Compare<A, B, LessOp> operator<(const Expr<A>& a, const Expr<B>& b) {
+    return Compare<A, B, LessOp>(a.self(), b.self());
+}
+
+template <class A, class V, class = typename std::enable_if<IsLiteral<V>::value>::type>
+Compare<A, Lit<typename LiteralOf<V>::type>, LessOp> operator<(const Expr<A>& a, V v) {
+    return Compare<A, Lit<typename LiteralOf<V>::type>, LessOp>(a.self(), Lit<typename LiteralOf<V>::type>(v));
+}
+
+template <class A, class B>
+Compare<A, B, LessEqOp> operator<=(const Expr<A>& a, const Expr<B>& b) {
+    return Compare<A, B, LessEqOp>(a.self(), b.self());
+}
+
+template <class A, class V, class = typename std::enable_if<IsLiteral<V>::value>::type>
+Compare<A, Lit<typename LiteralOf<V>::type>, LessEqOp> operator<=(const Expr<A>& a, V v) {
+    return Compare<A, Lit<typename LiteralOf<V>::type>, LessEqOp>(a.self(), Lit<typename LiteralOf<V>::type>(v));
+}
+
+template <class A, class B>
+Compare<A, B, GreaterOp> operator>(const Expr<A>& a, const Expr<B>& b) {
+    return Compare<A, B, GreaterOp>(a.self(), b.self());
+}
+
+template <class A, class V, class = typename std::enable_if<IsLiteral<V>::value>::type>
+Compare<A, Lit<typename LiteralOf<V>::type>, GreaterOp> operator>(const Expr<A>& a, V v) {
+    return Compare<A, Lit<typename LiteralOf<V>::type>, GreaterOp>(a.self(), Lit<typename LiteralOf<V>::type>(v));
+}
+
+template <class A, class B>
+Compare<A, B, GreaterEqOp> operator>=(const Expr<A>& a, const Expr<B>& b) {
+    return Compare<A, B, GreaterEqOp>(a.self(), b.self());
+}
+
+template <class A, class V, class = typename std::enable_if<IsLiteral<V>::value>::type>
+Compare<A, Lit<typename LiteralOf<V>::type>, GreaterEqOp> operator>=(const Expr<A>& a, V v) {
+    return Compare<A, Lit<typename LiteralOf<V>::type>, GreaterEqOp>(a.self(), Lit<typename LiteralOf<V>::type>(v));
+}
+
+template <class A, class B>
+Compare<A, B, EqOp> operator==(const Expr<A>& a, const Expr<B>& b) {
+    return Compare<A, B, EqOp>(a.self(), b.self());
+}
+
+template <class A, class V, class = typename std::enable_if<IsLiteral<V>::value>::type>
+Compare<A, Lit<typename LiteralOf<V>::type>, EqOp> operator==(const Expr<A>& a, V v) {
+    return Compare<A, Lit<typename LiteralOf<V>::type>, EqOp>(a.self(), Lit<typename LiteralOf<V>::type>(v));
+}
+
+template <class A, class B>
+Compare<A, B, NotEqOp> operator!=(const Expr<A>& a, const Expr<B>& b) {
+    return Compare<A, B, NotEqOp>(a.self(), b.self());
+}
+
+template <class A, class V, class = typename std::enable_if<IsLiteral<V>::value>::type>
+Compare<A, Lit<typename LiteralOf<V>::type>, NotEqOp> operator!=(const Expr<A>& a, V v) {
+    return Compare<A, Lit<typename LiteralOf<V>::type>, NotEqOp>(a.self(), Lit<typename LiteralOf<V>::type>(v));
+}
+
+template <class A, class B>
+And<A, B> operator&&(const Expr<A>& a, const Expr<B>& b) {
+    return And<A, B>(a.self(), b.self());
+}
+
+template <class A, class B>
+Or<A, B> operator||(const Expr<A>& a, const Expr<B>& b) {
+    return Or<A, B>(a.self(), b.self());
+}
+
+template <class A>
+Not<A> operator!(const Expr<A>& a) {
+    return Not<A>(a.self());
+}
+
+// Writes the rows of the loaded chunk of b that pred holds for into sel, which needs room for
+// b.rows() rows. Returns how many there are. The loop has no branch on the predicate
+template <class E>
+size_t select_rows(const Expr<E>& pred, ChunkBatch& b, size_t* sel) {
+    const E& e = pred.self();
+    size_t n = 0;
+    for (size_t i = 0; i < b.rows(); i++) {
+        sel[n] = i;
+        n += e.eval(b, i) ? 1 : 0;
+    }
+    return n;
+}
+
+// The columns pred reads as a mask over the columns of df, owned by the caller. Fails if pred
+// reads a column that df does not have, or reads a column as a type it is not of
+template <class E>
+bool* expr_columns(const Expr<E>& pred, DataFrame& df) {
+    size_t width = df.ncols();
+    bool* ret = new bool[width > 0 ? width : 1];
+    memset(ret, 0, (width > 0 ? width : 1) * sizeof(bool));
+    pred.self().columns(df.get_schema(), ret);
+    return ret;
+}
+
+// this declaration must come after the declaration of select_rows
+template <class E>
+size_t DataFrame::count_where(const Expr<E>& pred) {
+    bool* cols = expr_columns(pred, *this);
+    if (nrows() == 0) {
+        delete[] cols;
+        return 0;
+    }
+    ChunkBatch batch(*this, cols);
+    size_t* sel = new size_t[kv_->get_config().CHUNK_SIZE];
+    size_t ret = 0;
+    while (batch.next()) {
+        ret += select_rows(pred, batch, sel);
+    }
+    delete[] sel;
+    delete[] cols;
+    return ret;
+}
+
+template <class E>
+DataFrame* DataFrame::where(const Expr<E>& pred, Key& key) {
+    bool* cols = expr_columns(pred, *this);
+    DataFrame* df = new DataFrame(*this, key);
+    if (nrows() == 0) {
+        delete[] cols;
+        return df;
+    }
+    ChunkBatch batch(*this, cols);
+    size_t* sel = new size_t[kv_->get_config().CHUNK_SIZE];
+    Row row(schema_);
+    while (batch.next()) {
+        size_t n = select_rows(pred, batch, sel);
+        // only the rows that are kept are boxed
+        for (size_t i = 0; i < n; i++) {
+            fill_row(batch.first_row() + sel[i], row);
+            df->add_row(row, false, false);
+            row.delete_strings();
+        }
+    }
+    df->commit();
+    delete[] sel;
+    delete[] cols;
+    return df;
+}
+
+template <class E>
+FrameView* DataFrame::where_view(const Expr<E>& pred) {
+    bool* cols = expr_columns(pred, *this);
+    FrameView* view = new FrameView(*this, false);
+    if (nrows() == 0) {
+        delete[] cols;
+        return view;
+    }
+    ChunkBatch batch(*this, cols);
+    size_t* sel = new size_t[kv_->get_config().CHUNK_SIZE];
+    // the selection vector of every chunk is the view
+    while (batch.next()) {
+        view->add_chunk(batch.first_row(), sel, select_rows(pred, batch, sel));
+    }
+    delete[] sel;
+    delete[] cols;
+    return view;
+}
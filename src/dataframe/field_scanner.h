@@ -0,0 +1,253 @@
+//lang:Cpp
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "../util/object.h"
+#include "../util/helper.h"
+#include "../util/config.h"
+
+/**
+ * Finds the fields of a SoR line. The line is classified 32 bytes at a time into bitmasks of
+ * the bytes that matter to the grammar ('<', '>', '"' and ' '), with AVX2 or SSE2 when the
+ * compiler targets them and a byte loop otherwise. The fields are then found by walking the set
+ * bits of the masks, so the bytes inside a value are never looked at one by one.
+ *
+ * The start and length of every field are written into buffers that are reused for every line,
+ * one FieldScanner per thread. A field is a pointer into the line, nullptr for a missing value.
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class FieldScanner : public Object {
+    public:
+        static const size_t BLOCK = 32;  // bytes classified at a time
+
+        // where the scan is in the grammar
+        enum State {
+            OUTSIDE,   // between fields, looking for '<'
+            LEADING,   // after '<', skipping spaces up to the value
+            QUOTED,    // in a quoted value, looking for the closing '"'
+            UNQUOTED   // in a value, looking for '>' or ' '
+        };
+
+        const char** starts_;  // owned; start of each field, nullptr for a missing value
+        size_t* lens_;  // owned; length of each field
+        size_t cap_;
+        size_t len_;  // fields found in the last line
+        bool scalar_;  // classify with the byte loop even if SIMD is available
+
+        FieldScanner() {
+            cap_ = 16;
+            starts_ = new const char*[cap_];
+            lens_ = new size_t[cap_];
+            len_ = 0;
+            scalar_ = false;
+        }
+
+        ~FieldScanner() {
+            delete[] starts_;
+            delete[] lens_;
+        }
+
+        const char* field(size_t i) {
+            return starts_[i];
+        }
+
+        size_t field_len(size_t i) {
+            return lens_[i];
+        }
+
+        size_t size() {
+            return len_;
+        }
+
+        void grow_() {
+            cap_ *= 2;
+            const char** starts = new const char*[cap_];
+            size_t* lens = new size_t[cap_];
+            memcpy(starts, starts_, len_ * sizeof(const char*));
+            memcpy(lens, lens_, len_ * sizeof(size_t));
+            delete[] starts_;
+            delete[] lens_;
+            starts_ = starts;
+            lens_ = lens;
+        }
+
+        void add_(const char* start, size_t len) {
+            if (len_ == cap_) {
+                grow_();
+            }
+            starts_[len_] = start;
+            lens_[len_] = len;
+            len_++;
+        }
+
+        // sets the bits of the bytes of block that are '<', '>', '"' and ' '
+        static void classify_scalar_(const char* block, uint32_t& lt, uint32_t& gt, uint32_t& quote, uint32_t& space) {
+            lt = gt = quote = space = 0;
+            for (size_t i = 0; i < BLOCK; i++) {
+                uint32_t bit = (uint32_t) 1 << i;
+                switch (block[i]) {
+                    case '<':
+                        lt |= bit;
+                        break;
+                    case '>':
+                        gt |= bit;
+                        break;
+                    case '"':
+                        quote |= bit;
+                        break;
+                    case ' ':
+                        space |= bit;
+                        break;
+                }
+            }
+        }
+
+#ifdef __SSE2__
+        static uint32_t match_sse2_(__m128i lo, __m128i hi, char c) {
+            __m128i target = _mm_set1_epi8(c);
+            uint32_t low = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(lo, target));
+            uint32_t high = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(hi, target));
+            return low | (high << 16);
+        }
+
+        static void classify_sse2_(const char* block, uint32_t& lt, uint32_t& gt, uint32_t& quote, uint32_t& space) {
+            __m128i lo = _mm_loadu_si128((const __m128i*) block);
+            __m128i hi = _mm_loadu_si128((const __m128i*) (block + 16));
+            lt = match_sse2_(lo, hi, '<');
+            gt = match_sse2_(lo, hi, '>');
+            quote = match_sse2_(lo, hi, '"');
+            space = match_sse2_(lo, hi, ' ');
+        }
+#endif
+
+#ifdef __AVX2__
+        static uint32_t match_avx2_(__m256i bytes, char c) {
+            return (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(c)));
+        }
+
+        static void classify_avx2_(const char* block, uint32_t& lt, uint32_t& gt, uint32_t& quote, uint32_t& space) {
+            __m256i bytes = _mm256_loadu_si256((const __m256i*) block);
+            lt = match_avx2_(bytes, '<');
+            gt = match_avx2_(bytes, '>');
+            quote = match_avx2_(bytes, '"');
+            space = match_avx2_(bytes, ' ');
+        }
+#endif
+
+        // classifies BLOCK bytes starting at block, the best instruction set that was compiled in is used
+        void classify_(const char* block, uint32_t& lt, uint32_t& gt, uint32_t& quote, uint32_t& space) {
+            if (scalar_) {
+                classify_scalar_(block, lt, gt, quote, space);
+                return;
+            }
+#if defined(__AVX2__)
+            classify_avx2_(block, lt, gt, quote, space);
+#elif defined(__SSE2__)
+            classify_sse2_(block, lt, gt, quote, space);
+#else
+            classify_scalar_(block, lt, gt, quote, space);
+#endif
+        }
+
+        // Finds the fields of the line from line up to eol. Returns the number of fields.
+        // A field starts at '<'; spaces before its value are skipped. A quoted value runs to the
+        // closing '"', any other value up to the next '>' or ' '. Anything after a value up to the
+        // next '<' is ignored. A '<' before the value is malformed input.
+        size_t scan(const char* line, const char* eol) {
+            return scan(line, eol, Config::MAX_SIZE_T);
+        }
+
+        // Finds at most max_fields fields of the line, the bytes after the last of them are not
+        // looked at.
+        size_t scan(const char* line, const char* eol, size_t max_fields) {
+            len_ = 0;
+            State state = OUTSIDE;
+            const char* value = nullptr;
+            char tail[BLOCK];
+
+            for (const char* block = line; block < eol && len_ < max_fields; block += BLOCK) {
+                size_t block_len = (size_t) (eol - block);
+                const char* bytes = block;
+                uint32_t valid = ~(uint32_t) 0;
+                if (block_len < BLOCK) {
+                    // never load past the end of the line, it can be the end of the mapping
+                    memset(tail, 0, BLOCK);
+                    memcpy(tail, block, block_len);
+                    bytes = tail;
+                    valid = ((uint32_t) 1 << block_len) - 1;
+                }
+
+                uint32_t lt, gt, quote, space;
+                classify_(bytes, lt, gt, quote, space);
+                uint32_t value_end = gt | space;
+                uint32_t non_space = ~space & valid;
+
+                size_t pos = 0;
+                while (pos < BLOCK && len_ < max_fields) {
+                    uint32_t ahead = (~(uint32_t) 0 << pos) & valid;
+                    uint32_t candidates;
+                    switch (state) {
+                        case OUTSIDE:
+                            candidates = lt & ahead;
+                            break;
+                        case LEADING:
+                            candidates = non_space & ahead;
+                            break;
+                        case QUOTED:
+                            candidates = quote & ahead;
+                            break;
+                        default:
+                            candidates = value_end & ahead;
+                            break;
+                    }
+                    if (candidates == 0) {
+                        break;
+                    }
+                    size_t i = __builtin_ctz(candidates);
+                    pos = i + 1;
+                    switch (state) {
+                        case OUTSIDE:
+                            state = LEADING;
+                            break;
+                        case LEADING:
+                            switch (bytes[i]) {
+                                case '<':
+                                    fail("Multiple opening <");
+                                case '>':
+                                    add_(nullptr, 0);  // missing value
+                                    state = OUTSIDE;
+                                    break;
+                                case '"':
+                                    value = block + i + 1;
+                                    state = QUOTED;
+                                    break;
+                                default:
+                                    value = block + i;
+                                    state = UNQUOTED;
+                            }
+                            break;
+                        default:
+                            add_(value, block + i - value);
+                            state = OUTSIDE;
+                            break;
+                    }
+                }
+            }
+
+            // the line ended inside a field
+            if (state == LEADING) {
+                add_(nullptr, 0);
+            } else if (state == QUOTED || state == UNQUOTED) {
+                add_(value, eol - value);
+            }
+            return len_;
+        }
+};
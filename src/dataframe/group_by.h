@@ -0,0 +1,307 @@
+//lang:Cpp
+#pragma once
+
+#include "row.h"
+#include "schema.h"
+#include "dataframe.h"
+#include "shuffle.h"
+
+#include "../util/object.h"
+#include "../util/string.h"
+#include "../util/map.h"
+
+#include "../kvstore/keyvalue.h"
+
+// how an aggregate combines the values of a group
+enum AggregateKind {
+    COUNT_AGG = 'C',  // number of rows in the group, an INT
+    SUM_AGG = 'S',    // sum of an INT, DOUBLE or BOOL column, bools are counted
+    MIN_AGG = 'N',    // smallest value of an INT or DOUBLE column
+    MAX_AGG = 'X'     // largest value of an INT or DOUBLE column
+};
+
+/**
+ * One aggregated column of DataFrame.group_by: the kind of aggregate and the column it reads.
+ * An aggregate folds the rows of a group into one field of the group's output row.
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class Aggregate : public Object {
+    public:
+        char kind_;
+        size_t col_;  // the column that is aggregated, not used by COUNT_AGG
+
+        Aggregate() : Aggregate(COUNT_AGG, 0) { }
+
+        Aggregate(char kind, size_t col) {
+            abort_if_not(kind == COUNT_AGG || kind == SUM_AGG || kind == MIN_AGG || kind == MAX_AGG, "Aggregate(): unknown aggregate %c", kind);
+            kind_ = kind;
+            col_ = col;
+        }
+
+        static Aggregate count() {
+            return Aggregate(COUNT_AGG, 0);
+        }
+
+        static Aggregate sum(size_t col) {
+            return Aggregate(SUM_AGG, col);
+        }
+
+        static Aggregate min(size_t col) {
+            return Aggregate(MIN_AGG, col);
+        }
+
+        static Aggregate max(size_t col) {
+            return Aggregate(MAX_AGG, col);
+        }
+
+        // the type of the output column when the aggregated column is of type col_type
+        char out_type(char col_type) {
+            switch (kind_) {
+                case COUNT_AGG:
+                    return INT;
+                case SUM_AGG:
+                    abort_if_not(col_type != STRING, "Aggregate: can not sum a STRING column");
+                    return col_type == DOUBLE ? DOUBLE : INT;
+                default:
+                    abort_if_not(col_type == INT || col_type == DOUBLE, "Aggregate: min and max need an INT or DOUBLE column");
+                    return col_type;
+            }
+        }
+
+        // the aggregate that combines partial results of this one that are in column col
+        Aggregate merged(size_t col) {
+            return Aggregate(kind_ == COUNT_AGG ? SUM_AGG : kind_, col);
+        }
+
+        // sets field of out to the aggregate of the single row in
+        void init(Row& out, size_t field, Row& in) {
+            if (kind_ == COUNT_AGG) {
+                out.set(field, 1);
+                return;
+            }
+            switch (in.col_type(col_)) {
+                case BOOL:
+                    out.set(field, in.get_bool(col_) ? 1 : 0);
+                    break;
+                case INT:
+                    out.set(field, in.get_int(col_));
+                    break;
+                default:
+                    out.set(field, in.get_double(col_));
+                    break;
+            }
+        }
+
+        // folds the row in into field of out
+        void fold(Row& out, size_t field, Row& in) {
+            if (kind_ == COUNT_AGG) {
+                out.set(field, out.get_int(field) + 1);
+                return;
+            }
+            if (out.col_type(field) == DOUBLE) {
+                double acc = out.get_double(field);
+                double d = in.get_double(col_);
+                switch (kind_) {
+                    case SUM_AGG:
+                        acc += d;
+                        break;
+                    case MIN_AGG:
+                        acc = d < acc ? d : acc;
+                        break;
+                    default:
+                        acc = d > acc ? d : acc;
+                        break;
+                }
+                out.set(field, acc);
+                return;
+            }
+            int acc = out.get_int(field);
+            int n = in.col_type(col_) == BOOL ? (in.get_bool(col_) ? 1 : 0) : in.get_int(col_);
+            switch (kind_) {
+                case SUM_AGG:
+                    acc += n;
+                    break;
+                case MIN_AGG:
+                    acc = n < acc ? n : acc;
+                    break;
+                default:
+                    acc = n > acc ? n : acc;
+                    break;
+            }
+            out.set(field, acc);
+        }
+};
+
+// a group of DataFrame.group_by: its output row, with the key fields and the aggregates so far
+class Group : public Object {
+    public:
+        Row* row_;  // owned, and so are its strings
+
+        Group(Schema& schema) {
+            row_ = new Row(schema);
+        }
+
+        ~Group() {
+            row_->delete_strings();
+            delete row_;
+        }
+};
+
+/**
+ * GroupByRower is a subclass of Rower
+ * Aggregates the rows it is given into groups by the values of the key columns. The output rows
+ * of the groups have the key columns first and then one column for every aggregate.
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class GroupByRower : public Rower {
+    public:
+        const size_t* key_cols_;  // external
+        size_t num_keys_;
+        Aggregate* aggs_;  // external
+        size_t num_aggs_;
+        Schema& out_;  // external; the schema of the output rows
+        Map<GroupKey, Group> groups_;  // owns the keys and the groups
+        KeyEncoder keys_;
+
+        GroupByRower(const size_t* key_cols, size_t num_keys, Aggregate* aggs, size_t num_aggs, Schema& out) : out_(out), groups_() {
+            key_cols_ = key_cols;
+            num_keys_ = num_keys;
+            aggs_ = aggs;
+            num_aggs_ = num_aggs;
+        }
+
+        ~GroupByRower() {
+            groups_.delete_and_clear_items();
+        }
+
+        bool accept(Row& r) {
+            size_t len = keys_.encode(r, key_cols_, num_keys_);
+            GroupKey lookup(keys_.bytes(), len, false);
+            Group* group = groups_.get(&lookup);
+            if (group == nullptr) {
+                group = new Group(out_);
+                for (size_t i = 0; i < num_keys_; i++) {
+                    set_key_(*group->row_, i, r, key_cols_[i]);
+                }
+                for (size_t i = 0; i < num_aggs_; i++) {
+                    aggs_[i].init(*group->row_, num_keys_ + i, r);
+                }
+                groups_.add(new GroupKey(keys_.bytes(), len), group);
+            } else {
+                for (size_t i = 0; i < num_aggs_; i++) {
+                    aggs_[i].fold(*group->row_, num_keys_ + i, r);
+                }
+            }
+            return true;
+        }
+
+        // copies column col of the row into field of out, strings are cloned
+        void set_key_(Row& out, size_t field, Row& r, size_t col) {
+            copy_field(out, field, r, col);
+            if (r.col_type(col) == STRING) {
+                out.set(field, r.get_string(col)->clone());
+            }
+        }
+
+        bool reads_column(size_t col) {
+            for (size_t i = 0; i < num_keys_; i++) {
+                if (key_cols_[i] == col) {
+                    return true;
+                }
+            }
+            for (size_t i = 0; i < num_aggs_; i++) {
+                if (aggs_[i].kind_ != COUNT_AGG && aggs_[i].col_ == col) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // sends every group to the node it is merged on, or to the given node if it is not -1
+        void send_groups(Shuffle& shuffle, size_t node) {
+            size_t num = groups_.size();
+            GroupKey** keys = groups_.keys();
+            for (size_t i = 0; i < num; i++) {
+                Group* group = groups_.get(keys[i]);
+                size_t to = node != Config::MAX_SIZE_T ? node : keys[i]->hash() % shuffle.num_nodes_;
+                shuffle.add(*group->row_, to);
+            }
+            delete[] keys;
+        }
+};
+
+// the schema of the output of group_by: the key columns of in and then one column per aggregate
+inline Schema* group_by_schema(Schema& in, const size_t* key_cols, size_t num_keys, Aggregate* aggs, size_t num_aggs) {
+    if (num_keys == 0) {
+        Sys::fail("DataFrame.group_by(): no key columns");
+    }
+    StrBuff types;
+    for (size_t i = 0; i < num_keys; i++) {
+        if (key_cols[i] >= in.width()) {
+            Sys::fail("DataFrame.group_by(): key column %zu out of bounds", key_cols[i]);
+        }
+        char type[2] = {in.col_type(key_cols[i]), '\0'};
+        types.c(type);
+    }
+    for (size_t i = 0; i < num_aggs; i++) {
+        if (aggs[i].kind_ != COUNT_AGG && aggs[i].col_ >= in.width()) {
+            Sys::fail("DataFrame.group_by(): aggregated column %zu out of bounds", aggs[i].col_);
+        }
+        char type[2] = {aggs[i].out_type(in.col_type(aggs[i].col_)), '\0'};
+        types.c(type);
+    }
+    String* type_str = types.get();
+    Schema* ret = new Schema(type_str->c_str());
+    delete type_str;
+    return ret;
+}
+
+// Sends the partial groups of local to the nodes they are merged on and merges the groups this
+// node gets. Returns the merged groups under key, they stay on the node that merged them
+inline DataFrame* merge_groups(GroupByRower& local, Key& key, KVStore* kvs) {
+    Schema& out = local.out_;
+    size_t num_keys = local.num_keys_;
+    size_t num_aggs = local.num_aggs_;
+
+    // every group is merged on the node its key hashes to
+    Key* partial_key = suffixed_key(kvs, key, "~partial");
+    Shuffle partial_shuffle(out, *partial_key, kvs);
+    partial_shuffle.intermediate();
+    local.send_groups(partial_shuffle, Config::MAX_SIZE_T);
+    DataFrame* partial = partial_shuffle.finish();
+
+    size_t* merge_keys = new size_t[num_keys];
+    for (size_t i = 0; i < num_keys; i++) {
+        merge_keys[i] = i;
+    }
+    Aggregate* merge_aggs = new Aggregate[num_aggs];
+    for (size_t i = 0; i < num_aggs; i++) {
+        merge_aggs[i] = local.aggs_[i].merged(num_keys + i);
+    }
+    GroupByRower merge(merge_keys, num_keys, merge_aggs, num_aggs, out);
+    partial->local_map(merge);
+    partial->retire_();
+
+    // the merged groups stay on this node
+    Shuffle result(out, key, kvs);
+    merge.send_groups(result, kvs->node_index());
+    DataFrame* ret = result.finish();
+
+    delete partial;
+    delete partial_key;
+    delete[] merge_keys;
+    delete[] merge_aggs;
+    return ret;
+}
+
+// this declaration must come after the declaration of GroupByRower
+DataFrame* DataFrame::group_by(const size_t* key_cols, size_t num_keys, Aggregate* aggs, size_t num_aggs, Key& key) {
+    Schema* out = group_by_schema(schema_, key_cols, num_keys, aggs, num_aggs);
+
+    // the partial groups of the rows on this node
+    GroupByRower local(key_cols, num_keys, aggs, num_aggs, *out);
+    local_map(local);
+    DataFrame* ret = merge_groups(local, key, kv_);
+    delete out;
+    return ret;
+}
@@ -0,0 +1,528 @@
+//lang:Cpp
+#pragma once
+
+#include <algorithm>
+
+#include "row.h"
+#include "schema.h"
+#include "column.h"
+#include "dataframe.h"
+#include "shuffle.h"
+
+#include "../util/object.h"
+#include "../util/string.h"
+
+#include "../kvstore/keyvalue.h"
+
+/**
+ * The row indices that a lookup found, in ascending order.
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class RowIds : public Object {
+    public:
+        size_t* ids_;  // owned
+        size_t len_;
+        size_t cap_;
+
+        RowIds() {
+            cap_ = 16;
+            len_ = 0;
+            ids_ = new size_t[cap_];
+        }
+
+        ~RowIds() {
+            delete[] ids_;
+        }
+
+        void push_back(size_t id) {
+            if (len_ == cap_) {
+                cap_ *= 2;
+                size_t* grown = new size_t[cap_];
+                memcpy(grown, ids_, len_ * sizeof(size_t));
+                delete[] ids_;
+                ids_ = grown;
+            }
+            ids_[len_++] = id;
+        }
+
+        size_t size() {
+            return len_;
+        }
+
+        size_t get(size_t i) {
+            abort_if_not(i < len_, "RowIds.get(): %zu out of bounds", i);
+            return ids_[i];
+        }
+
+        void sort_() {
+            std::sort(ids_, ids_ + len_);
+        }
+};
+
+// The entries of one bucket of a ColumnIndex, as they are stored in the kvstore. Every entry is
+// [key length][key][segment][offset]: the encoded value of a row and where the row is
+class IndexBucket : public Object {
+    public:
+        char* bytes_;  // owned
+        size_t len_;
+        size_t cap_;
+
+        IndexBucket() {
+            cap_ = 256;
+            len_ = 0;
+            bytes_ = new char[cap_];
+        }
+
+        ~IndexBucket() {
+            delete[] bytes_;
+        }
+
+        void reserve_(size_t len) {
+            if (len <= cap_) {
+                return;
+            }
+            cap_ = len * 2;
+            char* grown = new char[cap_];
+            memcpy(grown, bytes_, len_);
+            delete[] bytes_;
+            bytes_ = grown;
+        }
+
+        // adds entries that were serialized by another bucket
+        void append(const char* bytes, size_t len) {
+            reserve_(len_ + len);
+            memcpy(bytes_ + len_, bytes, len);
+            len_ += len;
+        }
+
+        void add(const char* key, size_t key_len, size_t seg, size_t offset) {
+            reserve_(len_ + key_len + 3 * sizeof(size_t));
+            memcpy(bytes_ + len_, &key_len, sizeof(size_t));
+            memcpy(bytes_ + len_ + sizeof(size_t), key, key_len);
+            memcpy(bytes_ + len_ + sizeof(size_t) + key_len, &seg, sizeof(size_t));
+            memcpy(bytes_ + len_ + 2 * sizeof(size_t) + key_len, &offset, sizeof(size_t));
+            len_ += key_len + 3 * sizeof(size_t);
+        }
+};
+
+/**
+ * IndexBuildRower is a subclass of Rower
+ * Adds the local rows it is given to a ColumnIndex, with the segment and offset of each row. The
+ * rows have to come in ascending order, as local_map gives them.
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class IndexBuildRower : public Rower {
+    public:
+        RowIndex& index_;  // external
+        Placement& placement_;  // external
+        size_t seg_;  // the segment of the last row
+        size_t seg_start_;
+        size_t seg_end_;
+
+        IndexBuildRower(RowIndex& index, Placement& placement) : index_(index), placement_(placement) {
+            seg_ = 0;
+            seg_start_ = 0;
+            seg_end_ = placement.segmented() ? placement.seg_len(0) : Config::MAX_SIZE_T;
+        }
+
+        bool accept(Row& r) {
+            size_t idx = r.get_idx();
+            while (idx >= seg_end_) {
+                seg_++;
+                seg_start_ = seg_end_;
+                seg_end_ += placement_.seg_len(seg_);
+            }
+            index_.add(r, seg_, idx - seg_start_);
+            return true;
+        }
+
+        bool reads_column(size_t col) {
+            return col == index_.col();
+        }
+};
+
+/**
+ * LookupRower is a subclass of Rower
+ * Finds the rows whose value in a column is the value of a one column row, or in the range of
+ * two INT rows, without an index.
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class LookupRower : public Rower {
+    public:
+        size_t col_;
+        Row* low_;  // external
+        Row* high_;  // external; nullptr for a point lookup
+        RowIds& ids_;  // external
+        KeyEncoder keys_;
+        KeyEncoder value_;
+
+        LookupRower(size_t col, Row* low, Row* high, RowIds& ids) : ids_(ids) {
+            col_ = col;
+            low_ = low;
+            high_ = high;
+        }
+
+        bool accept(Row& r) {
+            bool found;
+            if (high_ != nullptr) {
+                found = r.get_int(col_) >= low_->get_int(0) && r.get_int(col_) <= high_->get_int(0);
+            } else {
+                size_t value_col = 0;
+                size_t len = keys_.encode(r, &col_, 1);
+                found = len == value_.encode(*low_, &value_col, 1) && memcmp(keys_.bytes(), value_.bytes(), len) == 0;
+            }
+            if (found) {
+                ids_.push_back(r.get_idx());
+            }
+            return found;
+        }
+
+        bool reads_column(size_t col) {
+            return col == col_;
+        }
+};
+
+/**
+ * A hash index of the values of a column of a dataframe. The values are split into buckets by
+ * their hash and bucket b is a value in the kvstore on node b % num_nodes, so a lookup is one get
+ * from the node of its bucket. A bucket lists every row of its values as a segment and an offset
+ * in it, which are turned into the row index when it is looked up: rows that are appended to a
+ * segment move the rows of the segments after it. Rows that are appended to the dataframe are
+ * added to their buckets when the dataframe is committed, the bucket is read, extended and put
+ * again, so only one node at a time can append to an indexed dataframe.
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class ColumnIndex : public RowIndex {
+    public:
+        DataFrame& df_;  // external
+        KVStore* kv_;  // external
+        size_t col_;
+        size_t num_buckets_;
+        String* name_;  // owned; the keys of the buckets start with it
+        IndexBucket** pending_;  // owned; the entries of each bucket that are not stored yet, nullptr if none
+        KeyEncoder keys_;
+
+        ColumnIndex(DataFrame& df, size_t col, size_t num_buckets) : df_(df) {
+            kv_ = df.kv_;
+            col_ = col;
+            num_buckets_ = num_buckets;
+            String* df_name = df.key_->get_name();
+            StrBuff buf;
+            buf.c(*df_name);
+            buf.c("~index-");
+            buf.c(col);
+            name_ = buf.get();
+            delete df_name;
+            pending_ = new IndexBucket*[num_buckets];
+            for (size_t i = 0; i < num_buckets; i++) {
+                pending_[i] = nullptr;
+            }
+        }
+
+        ~ColumnIndex() {
+            for (size_t i = 0; i < num_buckets_; i++) {
+                delete pending_[i];
+            }
+            delete[] pending_;
+            delete name_;
+        }
+
+        size_t col() {
+            return col_;
+        }
+
+        size_t num_buckets() {
+            return num_buckets_;
+        }
+
+        // the key of bucket b, homed on the node that stores it. Owned by the caller
+        Key* bucket_key_(size_t b) {
+            StrBuff buf;
+            buf.c(*name_);
+            buf.c("-");
+            buf.c(b);
+            String* bucket_name = buf.get();
+            Key* ret = new Key(b % kv_->num_nodes(), bucket_name->c_str());
+            delete bucket_name;
+            return ret;
+        }
+
+        // the key that node from sends the entries of the buckets of node to while building
+        Key* build_key_(size_t node, size_t from) {
+            StrBuff buf;
+            buf.c(*name_);
+            buf.c("~build-");
+            buf.c(node);
+            buf.c("-");
+            buf.c(from);
+            String* build_name = buf.get();
+            Key* ret = new Key(node, build_name->c_str());
+            delete build_name;
+            return ret;
+        }
+
+        size_t bucket_of_(char* key, size_t len) {
+            GroupKey lookup(key, len, false);
+            return lookup.hash() % num_buckets_;
+        }
+
+        void add(Row& row, size_t seg, size_t offset) {
+            size_t len = keys_.encode(row, &col_, 1);
+            size_t b = bucket_of_(keys_.bytes(), len);
+            if (pending_[b] == nullptr) {
+                pending_[b] = new IndexBucket();
+            }
+            pending_[b]->add(keys_.bytes(), len, seg, offset);
+        }
+
+        // adds the pending entries to the buckets they belong to
+        void flush() {
+            for (size_t b = 0; b < num_buckets_; b++) {
+                if (pending_[b] == nullptr) {
+                    continue;
+                }
+                Key* key = bucket_key_(b);
+                Value* stored = kv_->getAndWait(*key);
+                IndexBucket bucket;
+                bucket.append(stored->get(), stored->size());
+                bucket.append(pending_[b]->bytes_, pending_[b]->len_);
+                Value v(bucket.len_, bucket.bytes_);
+                kv_->put(*key, v);
+                delete stored;
+                delete key;
+                delete pending_[b];
+                pending_[b] = nullptr;
+            }
+        }
+
+        // Indexes the rows of the dataframe. Every node has to call this: each node adds its local
+        // rows, sends the entries to the nodes of their buckets and stores the buckets it gets
+        void build() {
+            size_t num_nodes = kv_->num_nodes();
+            size_t node = kv_->node_index();
+            IndexBuildRower rower(*this, df_.cols_[0]->get_placement());
+            df_.local_map(rower);
+
+            // one value per node with the entries of its buckets: [bucket][length][entries] each
+            for (size_t n = 0; n < num_nodes; n++) {
+                IndexBucket out;
+                for (size_t b = n; b < num_buckets_; b += num_nodes) {
+                    if (pending_[b] == nullptr) {
+                        continue;
+                    }
+                    out.append((char*) &b, sizeof(size_t));
+                    out.append((char*) &pending_[b]->len_, sizeof(size_t));
+                    out.append(pending_[b]->bytes_, pending_[b]->len_);
+                    delete pending_[b];
+                    pending_[b] = nullptr;
+                }
+                Key* key = build_key_(n, node);
+                Value v(out.len_, out.bytes_);
+                kv_->put(*key, v);
+                delete key;
+            }
+
+            // the buckets of this node, with the entries of every node in the order of the nodes
+            size_t num_mine = num_buckets_ / num_nodes + 1;
+            IndexBucket** mine = new IndexBucket*[num_mine];
+            for (size_t i = 0; i < num_mine; i++) {
+                mine[i] = new IndexBucket();
+            }
+            for (size_t from = 0; from < num_nodes; from++) {
+                Key* key = build_key_(node, from);
+                Value* got = kv_->getAndWait(*key);
+                size_t pos = 0;
+                while (pos < got->size()) {
+                    size_t b, len;
+                    memcpy(&b, got->get() + pos, sizeof(size_t));
+                    memcpy(&len, got->get() + pos + sizeof(size_t), sizeof(size_t));
+                    mine[b / num_nodes]->append(got->get() + pos + 2 * sizeof(size_t), len);
+                    pos += 2 * sizeof(size_t) + len;
+                }
+                // the entries are in the buckets now, and no other node reads this key
+                kv_->remove(*key);
+                delete got;
+                delete key;
+            }
+            for (size_t b = node; b < num_buckets_; b += num_nodes) {
+                Key* key = bucket_key_(b);
+                Value v(mine[b / num_nodes]->len_, mine[b / num_nodes]->bytes_);
+                kv_->put(*key, v);
+                delete key;
+            }
+            for (size_t i = 0; i < num_mine; i++) {
+                delete mine[i];
+            }
+            delete[] mine;
+        }
+
+        // Adds the rows of the entries of bucket whose value is in [lo, hi] to ids. The values are
+        // INTs if high is not nullptr, otherwise the entries have to match the key exactly
+        void find_(Value& bucket, const char* key, size_t key_len, Row* low, Row* high, RowIds& ids) {
+            Placement& placement = df_.cols_[0]->get_placement();
+            size_t pos = 0;
+            while (pos < bucket.size()) {
+                size_t len, seg, offset;
+                const char* entry = bucket.get() + pos;
+                memcpy(&len, entry, sizeof(size_t));
+                memcpy(&seg, entry + sizeof(size_t) + len, sizeof(size_t));
+                memcpy(&offset, entry + 2 * sizeof(size_t) + len, sizeof(size_t));
+                pos += len + 3 * sizeof(size_t);
+                bool found;
+                if (high != nullptr) {
+                    int n;
+                    memcpy(&n, entry + sizeof(size_t), sizeof(int));
+                    found = n >= low->get_int(0) && n <= high->get_int(0);
+                } else {
+                    found = len == key_len && memcmp(entry + sizeof(size_t), key, len) == 0;
+                }
+                if (found) {
+                    ids.push_back(placement.segmented() ? placement.seg_start(seg) + offset : offset);
+                }
+            }
+        }
+
+        // the rows whose value is column 0 of value, one get from the node of its bucket
+        RowIds* lookup(Row& value) {
+            flush();
+            size_t value_col = 0;
+            size_t len = keys_.encode(value, &value_col, 1);
+            Key* key = bucket_key_(bucket_of_(keys_.bytes(), len));
+            Value* bucket = kv_->getAndWait(*key);
+            RowIds* ret = new RowIds();
+            find_(*bucket, keys_.bytes(), len, nullptr, nullptr, *ret);
+            ret->sort_();
+            delete bucket;
+            delete key;
+            return ret;
+        }
+
+        // the rows whose INT value is in [column 0 of low, column 0 of high], one get per bucket that
+        // holds one of the values
+        RowIds* lookup_range(Row& low, Row& high) {
+            flush();
+            bool* wanted = new bool[num_buckets_];
+            memset(wanted, 0, num_buckets_ * sizeof(bool));
+            Schema value_schema("I");
+            Row value(value_schema);
+            size_t value_col = 0;
+            size_t num_wanted = 0;
+            for (int n = low.get_int(0); n <= high.get_int(0) && num_wanted < num_buckets_; n++) {
+                value.set(0, n);
+                size_t b = bucket_of_(keys_.bytes(), keys_.encode(value, &value_col, 1));
+                num_wanted += wanted[b] ? 0 : 1;
+                wanted[b] = true;
+                if (n == high.get_int(0)) {
+                    break;
+                }
+            }
+            RowIds* ret = new RowIds();
+            for (size_t b = 0; b < num_buckets_; b++) {
+                if (!wanted[b]) {
+                    continue;
+                }
+                Key* key = bucket_key_(b);
+                Value* bucket = kv_->getAndWait(*key);
+                find_(*bucket, nullptr, 0, &low, &high, *ret);
+                delete bucket;
+                delete key;
+            }
+            ret->sort_();
+            delete[] wanted;
+            return ret;
+        }
+};
+
+// the index of column col of df, nullptr if it has none
+inline ColumnIndex* index_of(DataFrame& df, size_t col) {
+    for (size_t i = 0; i < df.indexes_.size(); i++) {
+        ColumnIndex* index = dynamic_cast<ColumnIndex*>(df.indexes_.get(i));
+        if (index != nullptr && index->col() == col) {
+            return index;
+        }
+    }
+    return nullptr;
+}
+
+// the rows of df whose value in col is column 0 of value, with the index of col if it has one
+inline RowIds* lookup_value(DataFrame& df, size_t col, Row& value) {
+    if (col >= df.ncols() || df.get_schema().col_type(col) != value.col_type(0)) {
+        Sys::fail("DataFrame.lookup(): column %zu is not of type %c", col, value.col_type(0));
+    }
+    ColumnIndex* index = index_of(df, col);
+    if (index != nullptr) {
+        return index->lookup(value);
+    }
+    RowIds* ret = new RowIds();
+    LookupRower rower(col, &value, nullptr, *ret);
+    df.map(rower);
+    return ret;
+}
+
+// reopens an index whose buckets are already stored, see DataFrame.index_opener_
+inline RowIndex* open_column_index(DataFrame& df, size_t col, size_t num_buckets) {
+    return new ColumnIndex(df, col, num_buckets);
+}
+
+// every program that can look rows up with an index reopens the indexes of the dataframes it deserializes
+static const bool column_index_opener_set = (DataFrame::index_opener_() = open_column_index, true);
+
+// this declaration must come after the declaration of ColumnIndex
+void DataFrame::build_index(size_t col) {
+    abort_if_not(col < ncols(), "DataFrame.build_index(): column %zu out of bounds", col);
+    abort_if_not(index_of(*this, col) == nullptr, "DataFrame.build_index(): column %zu already has an index", col);
+    commit_chunks();
+    size_t num_buckets = nrows() / Config::INDEX_BUCKET_ROWS;
+    if (num_buckets < kv_->num_nodes()) {
+        num_buckets = kv_->num_nodes();
+    }
+    ColumnIndex* index = new ColumnIndex(*this, col, num_buckets);
+    index->build();
+    indexes_.push_back(index);
+    // the descriptor records the index, so the copies of the dataframe that are read from it use it too
+    if (kv_->node_index() == 0) {
+        add_self_to_kv_();
+    }
+}
+
+RowIds* DataFrame::lookup(size_t col, int value) {
+    Schema value_schema("I");
+    Row row(value_schema);
+    row.set(0, value);
+    return lookup_value(*this, col, row);
+}
+
+RowIds* DataFrame::lookup(size_t col, double value) {
+    Schema value_schema("D");
+    Row row(value_schema);
+    row.set(0, value);
+    return lookup_value(*this, col, row);
+}
+
+RowIds* DataFrame::lookup(size_t col, const char* value) {
+    Schema value_schema("S");
+    Row row(value_schema);
+    String str(value);
+    row.set(0, &str);
+    return lookup_value(*this, col, row);
+}
+
+RowIds* DataFrame::lookup_range(size_t col, int lo, int hi) {
+    abort_if_not(col < ncols() && schema_.col_type(col) == INT, "DataFrame.lookup_range(): column %zu is not an INT column", col);
+    Schema bound_schema("I");
+    Row low(bound_schema);
+    Row high(bound_schema);
+    low.set(0, lo);
+    high.set(0, hi);
+    if (lo > hi) {
+        return new RowIds();
+    }
+    ColumnIndex* index = index_of(*this, col);
+    if (index != nullptr) {
+        return index->lookup_range(low, high);
+    }
+    RowIds* ret = new RowIds();
+    LookupRower rower(col, &low, &high, *ret);
+    map(rower);
+    return ret;
+}
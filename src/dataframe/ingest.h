@@ -0,0 +1,783 @@
+//lang:Cpp
+#pragma once
+
+#include <string.h>
+
+#include "dataframe.h"
+#include "schema.h"
+#include "column.h"
+#include "row.h"
+#include "field_scanner.h"
+
+#include "../util/object.h"
+#include "../util/queue.h"
+#include "../util/thread.h"
+
+/**
+ * The lines that the rows of a dataframe were parsed from, segment by segment in the order the
+ * rows were added, for the readers that add rows one at a time (see ParseBatch.add_rows_to). A
+ * column that becomes a string after some of its chunks were written gets the text of the file
+ * back from them, like ChunkEncoder does with its spans: "007" is not "7" and a missing value is
+ * not "0". The rows of a HASH placement are not in file order within their segment, so a line is
+ * kept for every row. The lines stay in the mapping of the file.
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class RowLines : public Object {
+    public:
+        size_t num_segs_;  // 1 for a dataframe whose rows are not segmented
+        size_t* fields_;  // owned; the field of the line each column is read from
+        size_t scan_fields_;  // fields of a line that are scanned to find every column, like ParseBatch
+        const char*** starts_;  // owned; the start of the line of each row of each segment, nullptr until the segment has a row
+        const char*** ends_;  // owned
+        size_t* lens_;  // owned; rows of each segment
+        size_t* caps_;  // owned
+
+        // fields is the field of the line that each of the width columns is read from, nullptr to
+        // read column i from field i, like for ParseBatch
+        RowLines(Placement& placement, size_t width, const size_t* fields) {
+            num_segs_ = placement.segmented() ? placement.num_segs() : 1;
+            fields_ = new size_t[width];
+            scan_fields_ = 0;
+            for (size_t i = 0; i < width; i++) {
+                fields_[i] = fields == nullptr ? i : fields[i];
+                if (fields_[i] + 1 > scan_fields_) {
+                    scan_fields_ = fields_[i] + 1;
+                }
+            }
+            starts_ = new const char**[num_segs_];
+            ends_ = new const char**[num_segs_];
+            lens_ = new size_t[num_segs_];
+            caps_ = new size_t[num_segs_];
+            for (size_t i = 0; i < num_segs_; i++) {
+                starts_[i] = nullptr;
+                ends_[i] = nullptr;
+                lens_[i] = 0;
+                caps_[i] = 0;
+            }
+        }
+
+        ~RowLines() {
+            for (size_t i = 0; i < num_segs_; i++) {
+                delete[] starts_[i];
+                delete[] ends_[i];
+            }
+            delete[] starts_;
+            delete[] ends_;
+            delete[] lens_;
+            delete[] caps_;
+            delete[] fields_;
+        }
+
+        // remembers the line from line up to eol as the next row of the given segment
+        void add(size_t seg, const char* line, const char* eol) {
+            abort_if_not(seg < num_segs_, "RowLines.add(): segment %zu out of bounds", seg);
+            if (lens_[seg] == caps_[seg]) {
+                caps_[seg] = caps_[seg] == 0 ? 1024 : caps_[seg] * 2;
+                const char** starts = new const char*[caps_[seg]];
+                const char** ends = new const char*[caps_[seg]];
+                if (lens_[seg] > 0) {
+                    memcpy(starts, starts_[seg], lens_[seg] * sizeof(const char*));
+                    memcpy(ends, ends_[seg], lens_[seg] * sizeof(const char*));
+                }
+                delete[] starts_[seg];
+                delete[] ends_[seg];
+                starts_[seg] = starts;
+                ends_[seg] = ends;
+            }
+            starts_[seg][lens_[seg]] = line;
+            ends_[seg][lens_[seg]] = eol;
+            lens_[seg]++;
+        }
+
+        // Puts every chunk of column col of df, which was just promoted to STRING, again with the
+        // text of its rows. Every row of df has to have been added here, and none were staged.
+        // Uses scanner, so the fields of the last scanned line are lost.
+        void restring(DataFrame* df, size_t col, FieldScanner& scanner) {
+            abort_if_not(df->get_schema().col_type(col) == STRING, "RowLines.restring(): column %zu is not a string column", col);
+            // chunks that are still being put in the background would replace the strings
+            df->kv_->flush_puts();
+            Column* column = df->cols_[col];
+            Placement& placement = column->get_placement();
+            size_t chunk_size = df->kv_->get_config().CHUNK_SIZE;
+            for (size_t seg = 0; seg < num_segs_; seg++) {
+                size_t len = placement.segmented() ? placement.seg_len(seg) : column->size();
+                abort_if_not(len == lens_[seg], "RowLines.restring(): segment %zu has %zu rows, not %zu", seg, len, lens_[seg]);
+                for (size_t from = 0; from < len; from += chunk_size) {
+                    size_t rows = len - from < chunk_size ? len - from : chunk_size;
+                    size_t chunk_idx = placement.segmented() ? (from / chunk_size) * num_segs_ + seg : from / chunk_size;
+                    Value* strings = strings_of_(col, seg, from, rows, scanner);
+                    column->put_(chunk_idx, *strings);
+                    delete strings;
+                }
+            }
+        }
+
+        // The text of column col of rows rows of the given segment starting at row from, laid out
+        // like a chunk of strings, see ChunkEncoder.strings_of_. Returned value is owned by the caller.
+        Value* strings_of_(size_t col, size_t seg, size_t from, size_t rows, FieldScanner& scanner) {
+            size_t cap = rows * 8 + 1;
+            size_t bytes = 0;
+            char* out = new char[cap];
+            size_t f = fields_[col];
+            for (size_t r = from; r < from + rows; r++) {
+                size_t num_fields = scanner.scan(starts_[seg][r], ends_[seg][r], scan_fields_);
+                const char* field = f < num_fields ? scanner.field(f) : nullptr;
+                size_t len = field != nullptr ? scanner.field_len(f) : 0;
+                if (bytes + len + 1 > cap) {
+                    cap = (bytes + len + 1) * 2;
+                    char* grown = new char[cap];
+                    memcpy(grown, out, bytes);
+                    delete[] out;
+                    out = grown;
+                }
+                if (len > 0) {
+                    memcpy(out + bytes, field, len);
+                }
+                out[bytes + len] = '\0';
+                bytes += len + 1;
+            }
+            return new Value(bytes, out, true);
+        }
+};
+
+/**
+ * A batch of lines of a SoR file and the rows that were parsed from them. The rows are kept
+ * column by column: bools, ints and doubles in arrays, strings back to back with a null
+ * terminator after each, which is how a string chunk is laid out. Batches are reused, reset()
+ * keeps the buffers. Column i is read from field fields_[i] of a line, the other fields are
+ * not converted, and the fields after the last one that is read are not even scanned.
+ *
+ * A batch starts with the types of the dataframe it is parsed for. A field that does not fit
+ * the type of its column widens the column (BOOL, INT, DOUBLE, STRING), the rows that were
+ * already parsed are parsed again from their lines, so no row is lost.
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class ParseBatch : public Object {
+    public:
+        size_t seq_;  // position of the batch in the file, set by whoever fills it
+        size_t width_;
+        char* types_;  // owned; the type of each column, columns are widened while parsing
+        size_t* fields_;  // owned; the field of the line each column is read from
+        size_t scan_fields_;  // fields of a line that have to be scanned to find every column
+
+        const char** line_starts_;  // owned
+        const char** line_ends_;  // owned
+        size_t num_lines_;
+        size_t cap_lines_;
+
+        size_t rows_;  // rows parsed from the lines, empty lines are skipped
+        size_t* row_lines_;  // owned; the line each row was parsed from
+        char** values_;  // owned; bool, int or double values of each column, room for a double per line
+        char** strings_;  // owned; strings of each string column back to back, nullptr until a column is a string
+        size_t* str_bytes_;  // owned; bytes used in strings_ by each string column
+        size_t* str_cap_;  // owned; bytes allocated in strings_ by each string column
+        size_t** str_ends_;  // owned; for each string column the end of each row's string, nullptr for other columns
+
+        ParseBatch(Schema& schema, size_t cap_lines) : ParseBatch(schema, cap_lines, nullptr) { }
+
+        // fields is the field of the line that each column of the schema is read from, nullptr to
+        // read column i from field i
+        ParseBatch(Schema& schema, size_t cap_lines, const size_t* fields) {
+            seq_ = 0;
+            width_ = schema.width();
+            cap_lines_ = cap_lines;
+            types_ = new char[width_ + 1];
+            fields_ = new size_t[width_];
+            scan_fields_ = 0;
+            for (size_t i = 0; i < width_; i++) {
+                fields_[i] = fields == nullptr ? i : fields[i];
+                if (fields_[i] + 1 > scan_fields_) {
+                    scan_fields_ = fields_[i] + 1;
+                }
+            }
+            line_starts_ = new const char*[cap_lines_];
+            line_ends_ = new const char*[cap_lines_];
+            row_lines_ = new size_t[cap_lines_];
+            values_ = new char*[width_];
+            strings_ = new char*[width_];
+            str_bytes_ = new size_t[width_];
+            str_cap_ = new size_t[width_];
+            str_ends_ = new size_t*[width_];
+            for (size_t i = 0; i < width_; i++) {
+                values_[i] = new char[cap_lines_ * sizeof(double)];
+                strings_[i] = nullptr;
+                str_bytes_[i] = 0;
+                str_cap_[i] = 0;
+                str_ends_[i] = nullptr;
+            }
+            types_[width_] = '\0';
+            reset(schema);
+        }
+
+        ~ParseBatch() {
+            for (size_t i = 0; i < width_; i++) {
+                delete[] values_[i];
+                delete[] strings_[i];
+                delete[] str_ends_[i];
+            }
+            delete[] values_;
+            delete[] strings_;
+            delete[] str_bytes_;
+            delete[] str_cap_;
+            delete[] str_ends_;
+            delete[] line_starts_;
+            delete[] line_ends_;
+            delete[] row_lines_;
+            delete[] types_;
+            delete[] fields_;
+        }
+
+        // forgets the lines and rows and starts over with the types of schema, the buffers are kept
+        // for the next batch
+        void reset(Schema& schema) {
+            num_lines_ = 0;
+            rows_ = 0;
+            for (size_t i = 0; i < width_; i++) {
+                set_type_(i, schema.col_type(i));
+            }
+        }
+
+        // sets the type of column col and makes sure that it has buffers for it
+        void set_type_(size_t col, char type) {
+            types_[col] = type;
+            str_bytes_[col] = 0;
+            if (type == STRING && strings_[col] == nullptr) {
+                str_cap_[col] = cap_lines_ * 16;
+                strings_[col] = new char[str_cap_[col]];
+                str_ends_[col] = new size_t[cap_lines_];
+            }
+        }
+
+        bool full() {
+            return num_lines_ == cap_lines_;
+        }
+
+        // adds the line from line up to eol, the batch must not be full
+        void add_line(const char* line, const char* eol) {
+            abort_if_not(!full(), "ParseBatch.add_line(): batch is full");
+            line_starts_[num_lines_] = line;
+            line_ends_[num_lines_] = eol;
+            num_lines_++;
+        }
+
+        // parses every line of the batch into rows
+        void parse(FieldScanner& scanner) {
+            for (size_t i = 0; i < num_lines_; i++) {
+                // every failed attempt widens a column, so this ends after at most 3 * width_ of them
+                while (!parse_line_(scanner, i)) { }
+            }
+        }
+
+        // Adds the given line as the next row. Every field is validated and converted in one pass
+        // over its chars. Strings fit any line, so they are only copied once every other field of
+        // the row was accepted. Returns false if a field did not fit its column, the column is
+        // widened then and the line has to be parsed again.
+        bool parse_line_(FieldScanner& scanner, size_t line) {
+            // current row could have more columns than infered - only the fields that are read are scanned
+            size_t num_fields = scanner.scan(line_starts_[line], line_ends_[line], scan_fields_);
+            // skipping rows with too few fields
+            if (num_fields == 0) {
+                return true;
+            }
+
+            bool has_strings = false;
+            for (size_t i = 0; i < width_; i++) {
+                if (types_[i] == STRING) {
+                    has_strings = true;
+                    continue;
+                }
+                size_t f = fields_[i];
+                const char* field = f < num_fields ? scanner.field(f) : nullptr;
+                size_t field_len = f < num_fields ? scanner.field_len(f) : 0;
+                if (!set_value_(i, rows_, field, field_len)) {
+                    char type = widen_type(types_[i], infer_type(field, field_len));
+                    // a value of the right shape that still does not fit, like an int that overflows
+                    widen(scanner, i, type == types_[i] ? next_type(type) : type);
+                    return false;
+                }
+            }
+
+            for (size_t i = 0; has_strings && i < width_; i++) {
+                if (types_[i] == STRING) {
+                    size_t f = fields_[i];
+                    set_value_(i, rows_, f < num_fields ? scanner.field(f) : nullptr, f < num_fields ? scanner.field_len(f) : 0);
+                }
+            }
+            row_lines_[rows_] = line;
+            rows_++;
+            return true;
+        }
+
+        // Converts the field into the given row of column col, a missing value is the zero of the
+        // type. Returns false if the field does not fit the type of the column. Strings have to be
+        // set in row order.
+        bool set_value_(size_t col, size_t row, const char* field, size_t len) {
+            switch (types_[col]) {
+                case BOOL:
+                {
+                    bool b = false;
+                    if (field != nullptr && !parse_bool(field, len, b)) {
+                        return false;
+                    }
+                    ((bool*) values_[col])[row] = b;
+                    return true;
+                }
+                case INT:
+                {
+                    int n = 0;
+                    if (field != nullptr && !parse_int(field, len, n)) {
+                        return false;
+                    }
+                    memcpy(values_[col] + row * sizeof(int), &n, sizeof(int));
+                    return true;
+                }
+                case DOUBLE:
+                {
+                    double d = 0.0;
+                    if (field != nullptr && !parse_double(field, len, d)) {
+                        return false;
+                    }
+                    memcpy(values_[col] + row * sizeof(double), &d, sizeof(double));
+                    return true;
+                }
+                default:
+                    add_string_(col, row, field != nullptr ? field : "", field != nullptr ? len : 0);
+                    return true;
+            }
+        }
+
+        // Widens column col to type and parses the rows that were already added again from their
+        // lines. Uses scanner, so the fields of the last scanned line are lost.
+        void widen(FieldScanner& scanner, size_t col, char type) {
+            set_type_(col, type);
+            size_t f = fields_[col];
+            for (size_t r = 0; r < rows_; r++) {
+                size_t num_fields = scanner.scan(line_starts_[row_lines_[r]], line_ends_[row_lines_[r]], f + 1);
+                // the value fit a narrower type, so it fits this one
+                set_value_(col, r, f < num_fields ? scanner.field(f) : nullptr, f < num_fields ? scanner.field_len(f) : 0);
+            }
+        }
+
+        // widens every column that is narrower than in schema
+        void widen_to(Schema& schema, FieldScanner& scanner) {
+            for (size_t i = 0; i < width_; i++) {
+                if (widen_type(types_[i], schema.col_type(i)) != types_[i]) {
+                    widen(scanner, i, schema.col_type(i));
+                }
+            }
+        }
+
+        // sets the string of the given row of column col, which has to be the row after the last one that was set
+        void add_string_(size_t col, size_t row, const char* s, size_t len) {
+            if (str_bytes_[col] + len + 1 > str_cap_[col]) {
+                str_cap_[col] = (str_bytes_[col] + len + 1) * 2;
+                char* grown = new char[str_cap_[col]];
+                memcpy(grown, strings_[col], str_bytes_[col]);
+                delete[] strings_[col];
+                strings_[col] = grown;
+            }
+            memcpy(strings_[col] + str_bytes_[col], s, len);
+            strings_[col][str_bytes_[col] + len] = '\0';
+            str_bytes_[col] += len + 1;
+            str_ends_[col][row] = str_bytes_[col];
+        }
+
+        bool get_bool(size_t col, size_t row) {
+            return ((bool*) values_[col])[row];
+        }
+
+        int get_int(size_t col, size_t row) {
+            int ret;
+            memcpy(&ret, values_[col] + row * sizeof(int), sizeof(int));
+            return ret;
+        }
+
+        double get_double(size_t col, size_t row) {
+            double ret;
+            memcpy(&ret, values_[col] + row * sizeof(double), sizeof(double));
+            return ret;
+        }
+
+        // offset of the string of the given row in strings_[col]
+        size_t string_start(size_t col, size_t row) {
+            return row == 0 ? 0 : str_ends_[col][row - 1];
+        }
+
+        // the string of the given row, owned by the batch
+        const char* get_string(size_t col, size_t row) {
+            return strings_[col] + string_start(col, row);
+        }
+
+        // Adds every row of the batch to the dataframe one at a time. The columns of the dataframe
+        // that are narrower than in the batch are widened first, and the other way around. The
+        // line of every row is added to lines, which gives a column that becomes a string the
+        // text of the rows that were added before.
+        void add_rows_to(DataFrame* df, FieldScanner& scanner, RowLines& lines) {
+            for (size_t i = 0; i < width_; i++) {
+                char old = df->get_schema().col_type(i);
+                df->promote_column_(i, types_[i]);
+                if (types_[i] == STRING && old != STRING && df->nrows() > 0) {
+                    lines.restring(df, i, scanner);
+                }
+            }
+            widen_to(df->get_schema(), scanner);
+
+            Row row(df->get_schema());
+            for (size_t r = 0; r < rows_; r++) {
+                for (size_t i = 0; i < width_; i++) {
+                    switch (types_[i]) {
+                        case BOOL:
+                            row.set(i, get_bool(i, r));
+                            break;
+                        case INT:
+                            row.set(i, get_int(i, r));
+                            break;
+                        case DOUBLE:
+                            row.set(i, get_double(i, r));
+                            break;
+                        default:
+                            row.set(i, new String(get_string(i, r), str_ends_[i][r] - string_start(i, r) - 1));
+                            break;
+                    }
+                }
+                lines.add(df->partition_of(row), line_starts_[row_lines_[r]], line_ends_[row_lines_[r]]);
+                df->add_row(row, false, false); // try not to add anything to the kvstore
+                row.delete_strings();
+            }
+        }
+};
+
+/**
+ * Encodes parsed rows straight into chunks of a DataFrame, without going through Rows or the
+ * chunk cache of its columns. A chunk is handed to the column as soon as it has CHUNK_SIZE rows,
+ * the column puts it in the background. The chunks are laid out exactly like push_back lays
+ * them out, so the columns can be appended to as usual afterwards. When a batch has a column of
+ * a wider type than the dataframe, the column of the dataframe is promoted. A number widened to
+ * a wider number is the same value, so the chunk being built is re-encoded and the chunks that
+ * were sealed are converted when they are read. A column that becomes a string has to keep the
+ * text of the file, "007" is not "7" and a missing value is not "0": the encoder remembers the
+ * lines of the rows of every chunk, which stay in the mapping of the file, and encodes the
+ * strings of the column again from them.
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class ChunkEncoder : public Object {
+    public:
+        DataFrame* df_;  // external
+        size_t chunk_size_;
+        size_t fill_;  // rows in the chunks being built
+        char** chunks_;  // owned; the chunk being built for each column
+        size_t* bytes_;  // owned; bytes used in each string chunk
+        size_t* cap_;  // owned; bytes allocated for each chunk
+        FieldScanner scanner_;  // parses the lines of batches that have narrower columns again
+        size_t* fields_;  // owned; the field of the line each column is read from
+        size_t scan_fields_;  // fields of a line that are scanned to find every column, like ParseBatch
+
+        // the lines that the rows of every sealed chunk were parsed from, from the start of the
+        // line of the first row to the end of the line of the last row, skipped lines included
+        const char** span_from_;  // owned
+        const char** span_to_;  // owned
+        size_t* span_chunk_;  // owned; the chunk index of each sealed chunk
+        size_t* span_rows_;  // owned
+        size_t num_spans_;
+        size_t cap_spans_;
+        const char* open_from_;  // lines of the chunks being built, nullptr while they are empty
+        const char* open_to_;
+
+        // fields is the field of the line that each column is read from, nullptr to read column i
+        // from field i, like for ParseBatch
+        ChunkEncoder(DataFrame* df, const size_t* fields) {
+            df_ = df;
+            chunk_size_ = df->kv_->get_config().CHUNK_SIZE;
+            fill_ = 0;
+            chunks_ = new char*[df->ncols()];
+            bytes_ = new size_t[df->ncols()];
+            cap_ = new size_t[df->ncols()];
+            fields_ = new size_t[df->ncols()];
+            scan_fields_ = 0;
+            for (size_t i = 0; i < df->ncols(); i++) {
+                cap_[i] = fixed_bytes_(i);
+                if (cap_[i] == 0) {
+                    cap_[i] = chunk_size_ * 16;
+                }
+                new_chunk_(i);
+                fields_[i] = fields == nullptr ? i : fields[i];
+                if (fields_[i] + 1 > scan_fields_) {
+                    scan_fields_ = fields_[i] + 1;
+                }
+            }
+            cap_spans_ = 16;
+            num_spans_ = 0;
+            span_from_ = new const char*[cap_spans_];
+            span_to_ = new const char*[cap_spans_];
+            span_chunk_ = new size_t[cap_spans_];
+            span_rows_ = new size_t[cap_spans_];
+            open_from_ = nullptr;
+            open_to_ = nullptr;
+        }
+
+        ~ChunkEncoder() {
+            for (size_t i = 0; i < df_->ncols(); i++) {
+                delete[] chunks_[i];
+            }
+            delete[] chunks_;
+            delete[] bytes_;
+            delete[] cap_;
+            delete[] fields_;
+            delete[] span_from_;
+            delete[] span_to_;
+            delete[] span_chunk_;
+            delete[] span_rows_;
+        }
+
+        // the bytes of a chunk of the given column, 0 for strings whose chunks grow as needed
+        size_t fixed_bytes_(size_t col) {
+            return fixed_chunk_bytes(df_->get_schema().col_type(col), chunk_size_);
+        }
+
+        void new_chunk_(size_t col) {
+            chunks_[col] = new char[cap_[col]];
+            memset(chunks_[col], 0, cap_[col]);
+            bytes_[col] = 0;
+        }
+
+        // Widens column col of the dataframe and the chunk being built for it to type. The strings
+        // of a column that becomes a string are read again from the lines of its rows.
+        void promote_(size_t col, char type) {
+            char old = df_->get_schema().col_type(col);
+            if (widen_type(old, type) == old) {
+                return;
+            }
+            df_->promote_column_(col, type);
+            Value* converted = nullptr;
+            if (type == STRING) {
+                restring_sealed_(col);
+                converted = strings_of_(col, open_from_, open_to_, fill_);
+            } else {
+                converted = reencode_chunk(chunks_[col], old, type, fill_, chunk_size_);
+            }
+            delete[] chunks_[col];
+            cap_[col] = fixed_bytes_(col);
+            if (cap_[col] == 0) {
+                cap_[col] = converted->size() * 2 > chunk_size_ * 16 ? converted->size() * 2 : chunk_size_ * 16;
+            }
+            new_chunk_(col);
+            memcpy(chunks_[col], converted->get(), converted->size());
+            bytes_[col] = type == STRING ? converted->size() : 0;
+            delete converted;
+        }
+
+        // Puts every sealed chunk of column col, which was just promoted to STRING, again with the
+        // strings of its rows. The chunks that are still being put in the background have to
+        // arrive first, or they would replace the strings.
+        void restring_sealed_(size_t col) {
+            if (num_spans_ == 0) {
+                return;
+            }
+            df_->kv_->flush_puts();
+            Column* column = df_->cols_[col];
+            for (size_t i = 0; i < num_spans_; i++) {
+                Value* strings = strings_of_(col, span_from_[i], span_to_[i], span_rows_[i]);
+                column->put_(span_chunk_[i], *strings);
+                delete strings;
+            }
+        }
+
+        // The text of column col of the rows parsed from the lines from from up to to, laid out like
+        // a chunk of strings: each string is followed by its null terminator, a missing value is
+        // "". The lines are scanned like ParseBatch scans them, so the same lines are skipped.
+        // Returned value is owned by the caller.
+        Value* strings_of_(size_t col, const char* from, const char* to, size_t rows) {
+            size_t cap = rows * 8 + 1;
+            size_t bytes = 0;
+            char* out = new char[cap];
+            size_t found = 0;
+            size_t f = fields_[col];
+            const char* line = from;
+            while (rows > 0 && line < to) {
+                const char* eol = (const char*) memchr(line, '\n', to - line);
+                if (eol == nullptr) {
+                    eol = to;
+                }
+                size_t num_fields = scanner_.scan(line, eol, scan_fields_);
+                if (num_fields > 0) {
+                    const char* field = f < num_fields ? scanner_.field(f) : nullptr;
+                    size_t len = field != nullptr ? scanner_.field_len(f) : 0;
+                    if (bytes + len + 1 > cap) {
+                        cap = (bytes + len + 1) * 2;
+                        char* grown = new char[cap];
+                        memcpy(grown, out, bytes);
+                        delete[] out;
+                        out = grown;
+                    }
+                    if (len > 0) {
+                        memcpy(out + bytes, field, len);
+                    }
+                    out[bytes + len] = '\0';
+                    bytes += len + 1;
+                    found++;
+                }
+                line = eol + 1;
+            }
+            abort_if_not(found == rows, "ChunkEncoder.strings_of_(): found %zu rows in the lines of %zu", found, rows);
+            return new Value(bytes, out, true);
+        }
+
+        // adds the rows of the batch, in order, sealing every chunk that fills up
+        void append(ParseBatch& batch) {
+            for (size_t i = 0; i < df_->ncols(); i++) {
+                promote_(i, batch.types_[i]);
+            }
+            batch.widen_to(df_->get_schema(), scanner_);
+
+            size_t r = 0;
+            while (r < batch.rows_) {
+                size_t n = batch.rows_ - r;
+                if (n > chunk_size_ - fill_) {
+                    n = chunk_size_ - fill_;
+                }
+                for (size_t i = 0; i < df_->ncols(); i++) {
+                    encode_(i, batch, r, n);
+                }
+                if (fill_ == 0) {
+                    open_from_ = batch.line_starts_[batch.row_lines_[r]];
+                }
+                open_to_ = batch.line_ends_[batch.row_lines_[r + n - 1]];
+                fill_ += n;
+                r += n;
+                if (fill_ == chunk_size_) {
+                    seal_();
+                }
+            }
+        }
+
+        // copies n rows of column col of the batch, starting at row r, into the chunk of the column
+        void encode_(size_t col, ParseBatch& batch, size_t r, size_t n) {
+            char* chunk = chunks_[col];
+            switch (df_->get_schema().col_type(col)) {
+                case BOOL:
+                {
+                    size_t one = 1;
+                    for (size_t k = 0; k < n; k++) {
+                        if (!batch.get_bool(col, r + k)) {
+                            continue;
+                        }
+                        size_t offset = fill_ + k;
+                        size_t item_idx = offset / (sizeof(size_t) * 8);
+                        size_t word;
+                        memcpy(&word, chunk + item_idx * sizeof(size_t), sizeof(size_t));
+                        word |= one << (offset % (sizeof(size_t) * 8));
+                        memcpy(chunk + item_idx * sizeof(size_t), &word, sizeof(size_t));
+                    }
+                    break;
+                }
+                case INT:
+                    memcpy(chunk + fill_ * sizeof(int), batch.values_[col] + r * sizeof(int), n * sizeof(int));
+                    break;
+                case DOUBLE:
+                    memcpy(chunk + fill_ * sizeof(double), batch.values_[col] + r * sizeof(double), n * sizeof(double));
+                    break;
+                default:
+                {
+                    size_t start = batch.string_start(col, r);
+                    size_t len = batch.str_ends_[col][r + n - 1] - start;
+                    if (bytes_[col] + len > cap_[col]) {
+                        cap_[col] = (bytes_[col] + len) * 2;
+                        char* grown = new char[cap_[col]];
+                        memcpy(grown, chunk, bytes_[col]);
+                        delete[] chunk;
+                        chunks_[col] = grown;
+                    }
+                    memcpy(chunks_[col] + bytes_[col], batch.strings_[col] + start, len);
+                    bytes_[col] += len;
+                    break;
+                }
+            }
+        }
+
+        // hands the chunks being built to the columns and starts new ones
+        void seal_() {
+            if (fill_ == 0) {
+                return;
+            }
+            add_span_();
+            Value** chunks = new Value*[df_->ncols()];
+            for (size_t i = 0; i < df_->ncols(); i++) {
+                size_t fixed = fixed_bytes_(i);
+                chunks[i] = new Value(fixed > 0 ? fixed : bytes_[i], chunks_[i], true);
+                if (fixed == 0) {
+                    // the next chunk of strings likely needs about as many bytes
+                    cap_[i] = bytes_[i] > 0 ? bytes_[i] : cap_[i];
+                }
+                new_chunk_(i);
+            }
+            df_->append_chunks_(chunks, fill_);
+            delete[] chunks;
+            fill_ = 0;
+            open_from_ = nullptr;
+            open_to_ = nullptr;
+        }
+
+        // remembers the lines of the chunks being built, which are about to be sealed
+        void add_span_() {
+            if (num_spans_ == cap_spans_) {
+                cap_spans_ *= 2;
+                const char** from = new const char*[cap_spans_];
+                const char** to = new const char*[cap_spans_];
+                size_t* chunk = new size_t[cap_spans_];
+                size_t* rows = new size_t[cap_spans_];
+                memcpy(from, span_from_, num_spans_ * sizeof(const char*));
+                memcpy(to, span_to_, num_spans_ * sizeof(const char*));
+                memcpy(chunk, span_chunk_, num_spans_ * sizeof(size_t));
+                memcpy(rows, span_rows_, num_spans_ * sizeof(size_t));
+                delete[] span_from_;
+                delete[] span_to_;
+                delete[] span_chunk_;
+                delete[] span_rows_;
+                span_from_ = from;
+                span_to_ = to;
+                span_chunk_ = chunk;
+                span_rows_ = rows;
+            }
+            size_t offset = 0;
+            df_->cols_[0]->append_slot_(span_chunk_[num_spans_], offset);
+            span_from_[num_spans_] = open_from_;
+            span_to_[num_spans_] = open_to_;
+            span_rows_[num_spans_] = fill_;
+            num_spans_++;
+        }
+
+        // hands the last, partly filled chunks to the columns
+        void finish() {
+            seal_();
+        }
+};
+
+// ParseThread is a subclass of Thread
+// ParseThreads take batches of lines from one queue, parse them and pass them on to the next.
+// The last ParseThread to finish closes the queue it passes batches on to.
+class ParseThread : public Thread {
+    public:
+        Queue<ParseBatch>* lines_;  // external
+        Queue<ParseBatch>* parsed_;  // external
+        size_t* running_;  // external; ParseThreads that have not finished, shared by all of them
+        FieldScanner scanner_;
+
+        ParseThread(Queue<ParseBatch>* lines, Queue<ParseBatch>* parsed, size_t* running) {
+            lines_ = lines;
+            parsed_ = parsed;
+            running_ = running;
+        }
+
+        /** Subclass responsibility, the body of the run method */
+        virtual void run() {
+            ParseBatch* batch = lines_->pop();
+            while (batch != nullptr) {
+                batch->parse(scanner_);
+                parsed_->push(batch);
+                batch = lines_->pop();
+            }
+            if (__sync_sub_and_fetch(running_, 1) == 0) {
+                parsed_->close();
+            }
+        }
+};
@@ -0,0 +1,255 @@
+//lang:Cpp
+#pragma once
+
+#include "row.h"
+#include "schema.h"
+#include "dataframe.h"
+#include "shuffle.h"
+
+#include "../util/object.h"
+#include "../util/string.h"
+#include "../util/array.h"
+#include "../util/map.h"
+
+#include "../kvstore/keyvalue.h"
+
+// the rows of the build side of a join that have the same key
+class JoinBucket : public Object {
+    public:
+        Array<Row> rows_;  // owns the rows and their strings
+
+        ~JoinBucket() {
+            for (size_t i = 0; i < rows_.size(); i++) {
+                Row* row = rows_.get(i);
+                row->delete_strings();
+                delete row;
+            }
+        }
+};
+
+/**
+ * JoinBuildRower is a subclass of Rower
+ * Builds the hash table of the build side of DataFrame.join. The rows it is given have the join
+ * key in column 0, every row is copied into the bucket of its key.
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class JoinBuildRower : public Rower {
+    public:
+        Schema& schema_;  // external; the schema of the rows that are built
+        Map<GroupKey, JoinBucket> table_;  // owns the keys and the buckets
+        KeyEncoder keys_;
+
+        JoinBuildRower(Schema& schema) : schema_(schema), table_() { }
+
+        ~JoinBuildRower() {
+            table_.delete_and_clear_items();
+        }
+
+        bool accept(Row& r) {
+            size_t key_col = 0;
+            size_t len = keys_.encode(r, &key_col, 1);
+            GroupKey lookup(keys_.bytes(), len, false);
+            JoinBucket* bucket = table_.get(&lookup);
+            if (bucket == nullptr) {
+                bucket = new JoinBucket();
+                table_.add(new GroupKey(keys_.bytes(), len), bucket);
+            }
+            Row* copy = new Row(schema_);
+            CopyRowFielder f(*copy);
+            r.visit(r.get_idx(), f);
+            bucket->rows_.push_back(copy);
+            return true;
+        }
+};
+
+/**
+ * JoinProbeRower is a subclass of Rower
+ * Looks up the rows of the probe side of DataFrame.join in the hash table of the build side and
+ * adds a joined row for every match to the result, on this node. Both sides have the join key in
+ * column 0 and the columns that are joined after it, the joined rows have the columns of the left
+ * side first and then the columns of the right side.
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class JoinProbeRower : public Rower {
+    public:
+        Map<GroupKey, JoinBucket>& table_;  // external
+        Shuffle& result_;  // external
+        bool probe_left_;  // whether the rows that are probed are the left side
+        size_t num_left_;
+        size_t num_right_;
+        Row* out_;  // owned; its strings belong to the probed and the built rows
+        KeyEncoder keys_;
+
+        JoinProbeRower(Map<GroupKey, JoinBucket>& table, Shuffle& result, bool probe_left, size_t num_left, size_t num_right) : table_(table), result_(result) {
+            probe_left_ = probe_left;
+            num_left_ = num_left;
+            num_right_ = num_right;
+            out_ = new Row(result.schema_);
+        }
+
+        ~JoinProbeRower() {
+            delete out_;
+        }
+
+        bool accept(Row& r) {
+            size_t key_col = 0;
+            GroupKey lookup(keys_.bytes(), keys_.encode(r, &key_col, 1), false);
+            JoinBucket* bucket = table_.get(&lookup);
+            if (bucket == nullptr) {
+                return false;
+            }
+            for (size_t i = 0; i < bucket->rows_.size(); i++) {
+                Row* built = bucket->rows_.get(i);
+                Row& left = probe_left_ ? r : *built;
+                Row& right = probe_left_ ? *built : r;
+                for (size_t j = 0; j < num_left_; j++) {
+                    copy_field(*out_, j, left, j + 1);
+                }
+                for (size_t j = 0; j < num_right_; j++) {
+                    copy_field(*out_, num_left_ + j, right, j + 1);
+                }
+                result_.add(*out_, result_.node_);
+            }
+            return true;
+        }
+};
+
+// the schema of the given columns of schema, in the given order
+inline Schema* projected_schema(Schema& schema, const size_t* cols, size_t num_cols) {
+    StrBuff types;
+    for (size_t i = 0; i < num_cols; i++) {
+        char type[2] = {schema.col_type(cols[i]), '\0'};
+        types.c(type);
+    }
+    String* type_str = types.get();
+    Schema* ret = new Schema(type_str->c_str());
+    delete type_str;
+    return ret;
+}
+
+// Joins the rows of left with the rows of right, see DataFrame.join. left is a DataFrame or a
+// FrameView: it is only asked for its schema, its kvstore and for its local rows
+template <class Left>
+DataFrame* hash_join(Left& left_side, DataFrame& other, size_t left_col, size_t right_col, const size_t* left_cols, size_t num_left,
+        const size_t* right_cols, size_t num_right, Key& key) {
+    Schema& left_types = left_side.get_schema();
+    Schema& right_types = other.get_schema();
+    KVStore* kvs = left_side.kv_;
+    if (left_col >= left_types.width()) {
+        Sys::fail("DataFrame.join(): left column %zu out of bounds", left_col);
+    }
+    if (right_col >= right_types.width()) {
+        Sys::fail("DataFrame.join(): right column %zu out of bounds", right_col);
+    }
+    if (left_types.col_type(left_col) != right_types.col_type(right_col)) {
+        Sys::fail("DataFrame.join(): the join columns have different types");
+    }
+    if (num_left + num_right == 0) {
+        Sys::fail("DataFrame.join(): no columns to join");
+    }
+
+    // the join column is sent first and then the columns that are joined, nothing else is fetched or moved
+    size_t* left_sent = new size_t[num_left + 1];
+    left_sent[0] = left_col;
+    for (size_t i = 0; i < num_left; i++) {
+        if (left_cols[i] >= left_types.width()) {
+            Sys::fail("DataFrame.join(): left column %zu out of bounds", left_cols[i]);
+        }
+        left_sent[i + 1] = left_cols[i];
+    }
+    size_t* right_sent = new size_t[num_right + 1];
+    right_sent[0] = right_col;
+    for (size_t i = 0; i < num_right; i++) {
+        if (right_cols[i] >= right_types.width()) {
+            Sys::fail("DataFrame.join(): right column %zu out of bounds", right_cols[i]);
+        }
+        right_sent[i + 1] = right_cols[i];
+    }
+    Schema* left_schema = projected_schema(left_types, left_sent, num_left + 1);
+    Schema* right_schema = projected_schema(right_types, right_sent, num_right + 1);
+
+    // both sides are partitioned by the hash of the join column, so matching rows meet on one node
+    Key* left_key = suffixed_key(kvs, key, "~left");
+    Shuffle left_shuffle(*left_schema, *left_key, kvs);
+    left_shuffle.intermediate();
+    PartitionRower left_partition(left_shuffle, left_sent, num_left + 1, left_col);
+    left_side.local_map(left_partition);
+    DataFrame* left = left_shuffle.finish();
+
+    Key* right_key = suffixed_key(kvs, key, "~right");
+    Shuffle right_shuffle(*right_schema, *right_key, kvs);
+    right_shuffle.intermediate();
+    PartitionRower right_partition(right_shuffle, right_sent, num_right + 1, right_col);
+    other.local_map(right_partition);
+    DataFrame* right = right_shuffle.finish();
+
+    StrBuff types;
+    for (size_t i = 0; i < num_left; i++) {
+        char type[2] = {left_types.col_type(left_cols[i]), '\0'};
+        types.c(type);
+    }
+    for (size_t i = 0; i < num_right; i++) {
+        char type[2] = {right_types.col_type(right_cols[i]), '\0'};
+        types.c(type);
+    }
+    String* type_str = types.get();
+    Schema out(type_str->c_str());
+    delete type_str;
+
+    // the smaller side is kept in memory, every node sees the same sizes so they pick the same side
+    bool build_left = left->nrows() < right->nrows();
+    DataFrame* build_side = build_left ? left : right;
+    DataFrame* probe_side = build_left ? right : left;
+    JoinBuildRower build(build_left ? *left_schema : *right_schema);
+    build_side->local_map(build);
+
+    // the joined rows stay on the node they were joined on
+    Shuffle result(out, key, kvs);
+    JoinProbeRower probe(build.table_, result, !build_left, num_left, num_right);
+    probe_side->local_map(probe);
+    left->retire_();
+    right->retire_();
+    DataFrame* ret = result.finish();
+
+    delete left;
+    delete right;
+    delete left_key;
+    delete right_key;
+    delete left_schema;
+    delete right_schema;
+    delete[] left_sent;
+    delete[] right_sent;
+    return ret;
+}
+
+// joins every column of left with every column of right but right_col, see DataFrame.join
+template <class Left>
+DataFrame* hash_join(Left& left_side, DataFrame& other, size_t left_col, size_t right_col, Key& key) {
+    size_t num_left = left_side.ncols();
+    size_t* left_cols = new size_t[num_left > 0 ? num_left : 1];
+    for (size_t i = 0; i < num_left; i++) {
+        left_cols[i] = i;
+    }
+    // the join column of the right side would repeat the one of the left side
+    size_t num_right = 0;
+    size_t* right_cols = new size_t[other.ncols() > 0 ? other.ncols() : 1];
+    for (size_t i = 0; i < other.ncols(); i++) {
+        if (i != right_col) {
+            right_cols[num_right++] = i;
+        }
+    }
+    DataFrame* ret = hash_join(left_side, other, left_col, right_col, left_cols, num_left, right_cols, num_right, key);
+    delete[] left_cols;
+    delete[] right_cols;
+    return ret;
+}
+
+// this declaration must come after the declaration of hash_join
+DataFrame* DataFrame::join(DataFrame& other, size_t left_col, size_t right_col, const size_t* left_cols, size_t num_left,
+        const size_t* right_cols, size_t num_right, Key& key) {
+    return hash_join(*this, other, left_col, right_col, left_cols, num_left, right_cols, num_right, key);
+}
+
+DataFrame* DataFrame::join(DataFrame& other, size_t left_col, size_t right_col, Key& key) {
+    return hash_join(*this, other, left_col, right_col, key);
+}
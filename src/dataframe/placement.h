@@ -0,0 +1,413 @@
+//lang:CwC
+#pragma once
+
+#include <stdlib.h>
+
+#include "../util/object.h"
+#include "../util/helper.h"
+
+// How the chunks of a column are assigned to nodes. The rule is stored in the
+// column descriptor so chunk keys can be derived instead of being serialized.
+enum PlacementKind {
+    ROUND_ROBIN = 'R',  // chunk i is homed on node i % num_nodes
+    RANGE = 'G',        // blocks of arg_ contiguous chunks are homed on the same node
+    HASH = 'H',         // rows are homed on the node given by the hash of the value in column arg_
+    SINGLE_NODE = 'O',  // every chunk is homed on node arg_
+    LOCAL = 'L'         // rows are homed on the node that added them, each node has arg_ segments
+};
+
+/*************************************************************************
+ * Placement::
+ * Maps the chunks of a column to the nodes that they are stored on, and the rows
+ * of a column to the chunk (and offset in the chunk) that holds them.
+ *
+ * For ROUND_ROBIN, RANGE and SINGLE_NODE, row i is in chunk i / chunk_size.
+ * HASH and LOCAL split the rows into segments. Segment s is stored in the chunks
+ * s, s + num_segs, s + 2 * num_segs, ... and all of them are homed on the node of the
+ * segment. The rows of a column are ordered segment by segment (all rows of segment 0,
+ * then all rows of segment 1, ...), so only the length of each segment needs to be kept.
+ * HASH has one segment per node. LOCAL has arg_ segments per node, segments
+ * n * arg_ ... (n + 1) * arg_ - 1 are homed on node n, so that every thread of every
+ * node can append to its own segment.
+ *
+ * Any placement can be replicated: a chunk homed on node n is also stored on the
+ * replicas_ - 1 nodes after n. Reads go to a local replica when there is one.
+ */
+class Placement : public Object {
+    public:
+        char kind_;
+        size_t num_nodes_;
+        size_t arg_;  // chunks per block for RANGE, key column for HASH, home node for SINGLE_NODE, segments per node for LOCAL
+        size_t replicas_;  // number of nodes that store a copy of each chunk (at least 1)
+        size_t* seg_len_;  // owned; only used by HASH and LOCAL, number of rows in each segment
+
+        Placement(char kind, size_t num_nodes, size_t arg) {
+            abort_if_not(num_nodes > 0, "Placement(): no nodes to place chunks on");
+            abort_if_not(kind != RANGE || arg > 0, "Placement(): RANGE needs at least one chunk per block");
+            abort_if_not(kind != SINGLE_NODE || arg < num_nodes, "Placement(): SINGLE_NODE home %zu out of bounds", arg);
+            abort_if_not(kind != LOCAL || arg > 0, "Placement(): LOCAL needs at least one segment per node");
+            kind_ = kind;
+            num_nodes_ = num_nodes;
+            arg_ = arg;
+            replicas_ = 1;
+            seg_len_ = nullptr;
+            if (segmented()) {
+                seg_len_ = new size_t[num_segs()];
+                memset(seg_len_, 0, num_segs() * sizeof(size_t));
+            }
+        }
+
+        Placement(size_t num_nodes) : Placement(ROUND_ROBIN, num_nodes, 0) { }
+
+        Placement(Placement& from) : Placement(from.kind_, from.num_nodes_, from.arg_) {
+            replicas_ = from.replicas_;
+            if (segmented()) {
+                memcpy(seg_len_, from.seg_len_, num_segs() * sizeof(size_t));
+            }
+        }
+
+        ~Placement() {
+            delete[] seg_len_;
+        }
+
+        static Placement* round_robin(size_t num_nodes) {
+            return new Placement(ROUND_ROBIN, num_nodes, 0);
+        }
+
+        static Placement* range(size_t num_nodes, size_t chunks_per_block) {
+            return new Placement(RANGE, num_nodes, chunks_per_block);
+        }
+
+        static Placement* hash(size_t num_nodes, size_t key_col) {
+            return new Placement(HASH, num_nodes, key_col);
+        }
+
+        static Placement* single_node(size_t num_nodes, size_t node) {
+            return new Placement(SINGLE_NODE, num_nodes, node);
+        }
+
+        static Placement* local(size_t num_nodes, size_t segs_per_node) {
+            return new Placement(LOCAL, num_nodes, segs_per_node);
+        }
+
+        // every chunk is stored on every node, for small tables that every node reads
+        static Placement* broadcast(size_t num_nodes) {
+            Placement* ret = new Placement(ROUND_ROBIN, num_nodes, 0);
+            ret->set_replicas(num_nodes);
+            return ret;
+        }
+
+        // sets how many nodes store each chunk, 0 means every node
+        void set_replicas(size_t replicas) {
+            abort_if_not(replicas <= num_nodes_, "Placement.set_replicas(): %zu replicas but only %zu nodes", replicas, num_nodes_);
+            replicas_ = replicas == 0 ? num_nodes_ : replicas;
+        }
+
+        size_t replicas() {
+            return replicas_;
+        }
+
+        // the node that holds the given copy of a chunk, copy 0 is the home of the chunk
+        size_t replica(size_t chunk_idx, size_t copy) {
+            return (home(chunk_idx) + copy) % num_nodes_;
+        }
+
+        // does the given node hold a copy of the chunk?
+        bool is_replica(size_t chunk_idx, size_t node) {
+            size_t dist = (node + num_nodes_ - home(chunk_idx)) % num_nodes_;
+            return dist < replicas_;
+        }
+
+        // the node to read the chunk from when reading on the given node: the node itself if
+        // it has a copy, the home of the chunk otherwise
+        size_t nearest(size_t chunk_idx, size_t node) {
+            return is_replica(chunk_idx, node) ? node : home(chunk_idx);
+        }
+
+        char kind() {
+            return kind_;
+        }
+
+        size_t num_nodes() {
+            return num_nodes_;
+        }
+
+        // are the rows split into segments?
+        bool segmented() {
+            return kind_ == HASH || kind_ == LOCAL;
+        }
+
+        // number of segments, 0 if the rows are not split into segments
+        size_t num_segs() {
+            switch (kind_) {
+                case HASH:
+                    return num_nodes_;
+                case LOCAL:
+                    return num_nodes_ * arg_;
+                default:
+                    return 0;
+            }
+        }
+
+        // the node that the given segment is homed on
+        size_t seg_node(size_t seg) {
+            return kind_ == LOCAL ? seg / arg_ : seg;
+        }
+
+        // the key column of a HASH placement
+        size_t key_col() {
+            abort_if_not(kind_ == HASH, "Placement.key_col(): not a HASH placement");
+            return arg_;
+        }
+
+        // a placement that does not have any rows yet
+        Placement* clone_empty() {
+            Placement* ret = new Placement(kind_, num_nodes_, arg_);
+            ret->replicas_ = replicas_;
+            return ret;
+        }
+
+        Placement* clone() {
+            return new Placement(*this);
+        }
+
+        bool equals(Object* o) {
+            Placement* other = dynamic_cast<Placement*>(o);
+            return other != nullptr && other->kind_ == kind_ && other->num_nodes_ == num_nodes_ && other->arg_ == arg_
+                && other->replicas_ == replicas_;
+        }
+
+        // the node index that the given chunk is stored on
+        size_t home(size_t chunk_idx) {
+            switch (kind_) {
+                case ROUND_ROBIN:
+                    return chunk_idx % num_nodes_;
+                case HASH:
+                case LOCAL:
+                    return seg_node(chunk_idx % num_segs());
+                case RANGE:
+                    return (chunk_idx / arg_) % num_nodes_;
+                case SINGLE_NODE:
+                    return arg_;
+                default:
+                    fail("Placement.home(): unknown placement %c", kind_);
+                    return 0;
+            }
+        }
+
+        // the node that a value with the given hash is homed on, only meaningful for HASH
+        size_t node_of_hash(size_t hash) {
+            return hash % num_nodes_;
+        }
+
+        // the first row of the given segment
+        size_t seg_start(size_t seg) {
+            size_t start = 0;
+            for (size_t i = 0; i < seg; i++) {
+                start += seg_len_[i];
+            }
+            return start;
+        }
+
+        size_t seg_len(size_t seg) {
+            return segmented() ? seg_len_[seg] : 0;
+        }
+
+        // adds the rows of every segment of other to the segments of this placement, used to
+        // combine segments that were filled separately
+        void add_segs(Placement& other) {
+            abort_if_not(segmented() && num_segs() == other.num_segs(), "Placement.add_segs(): segments do not match");
+            for (size_t i = 0; i < num_segs(); i++) {
+                seg_len_[i] += other.seg_len_[i];
+            }
+        }
+
+        // Finds the segment that holds row idx and the position of the row in it. Rows are only
+        // appended to the end of a segment, so the position stays the same while the row index
+        // moves when rows are appended to an earlier segment. Unsegmented rows are all in segment 0
+        void seg_pos(size_t idx, size_t& seg, size_t& offset) {
+            seg = 0;
+            if (segmented()) {
+                while (seg < num_segs() - 1 && idx >= seg_len_[seg]) {
+                    idx -= seg_len_[seg];
+                    seg++;
+                }
+            }
+            offset = idx;
+        }
+
+        // the row at the given position of the given segment, see seg_pos
+        size_t row_of(size_t seg, size_t offset) {
+            return segmented() ? seg_start(seg) + offset : offset;
+        }
+
+        // finds the chunk that holds row idx and the offset of the row in that chunk
+        void locate(size_t idx, size_t chunk_size, size_t& chunk_idx, size_t& offset) {
+            if (!segmented()) {
+                chunk_idx = idx / chunk_size;
+                offset = idx % chunk_size;
+                return;
+            }
+            size_t seg = 0;
+            while (seg < num_segs() - 1 && idx >= seg_len_[seg]) {
+                idx -= seg_len_[seg];
+                seg++;
+            }
+            chunk_idx = (idx / chunk_size) * num_segs() + seg;
+            offset = idx % chunk_size;
+        }
+
+        // finds the chunk and offset where the next row of the given segment goes, len is the
+        // number of rows in the column. The segment is ignored unless the rows are segmented
+        void append_slot(size_t len, size_t seg, size_t chunk_size, size_t& chunk_idx, size_t& offset) {
+            if (!segmented()) {
+                locate(len, chunk_size, chunk_idx, offset);
+                return;
+            }
+            abort_if_not(seg < num_segs(), "Placement.append_slot(): segment %zu out of bounds", seg);
+            chunk_idx = (seg_len_[seg] / chunk_size) * num_segs() + seg;
+            offset = seg_len_[seg] % chunk_size;
+        }
+
+        // records that a row was added to the given segment
+        void appended(size_t seg) {
+            appended(seg, 1);
+        }
+
+        // records that count rows were added to the given segment
+        void appended(size_t seg, size_t count) {
+            if (segmented()) {
+                seg_len_[seg] += count;
+            }
+        }
+
+        // one more than the largest chunk index of a column with len rows
+        size_t chunk_slots(size_t len, size_t chunk_size) {
+            if (!segmented()) {
+                return (len + chunk_size - 1) / chunk_size;
+            }
+            size_t ret = 0;
+            for (size_t i = 0; i < num_segs(); i++) {
+                size_t chunks = (seg_len_[i] + chunk_size - 1) / chunk_size;
+                if (chunks > 0 && (chunks - 1) * num_segs() + i + 1 > ret) {
+                    ret = (chunks - 1) * num_segs() + i + 1;
+                }
+            }
+            return ret;
+        }
+
+        // does a column with len rows have the given chunk? Segmented columns skip chunk indices
+        // of segments that have fewer rows than others
+        bool has_chunk(size_t chunk_idx, size_t len, size_t chunk_size) {
+            if (!segmented()) {
+                return chunk_idx * chunk_size < len;
+            }
+            size_t seg = chunk_idx % num_segs();
+            return (chunk_idx / num_segs()) * chunk_size < seg_len_[seg];
+        }
+
+        // the number of rows in the given chunk of a column with len rows
+        size_t chunk_rows(size_t chunk_idx, size_t len, size_t chunk_size) {
+            size_t start = chunk_idx * chunk_size;
+            if (segmented()) {
+                start = (chunk_idx / num_segs()) * chunk_size;
+                len = seg_len_[chunk_idx % num_segs()];
+            }
+            if (start >= len) {
+                return 0;
+            }
+            return len - start < chunk_size ? len - start : chunk_size;
+        }
+
+        // Finds the next run of rows homed on node that starts at or after end_row_idx. len is the
+        // number of rows in the column. Runs are as long as possible: contiguous local chunks are
+        // returned together. Sets start_row_idx to the first row of the run and end_row_idx to the
+        // row after the last row of the run.
+        bool next_local_rows(size_t node, size_t len, size_t chunk_size, size_t &start_row_idx, size_t &end_row_idx) {
+            if (end_row_idx >= len) {
+                return false;
+            }
+            if (segmented()) {
+                // local runs are the segments of this node, neighbouring local segments are one run
+                size_t start = 0;
+                for (size_t seg = 0; seg < num_segs(); seg++) {
+                    size_t end = start + seg_len_[seg];
+                    if (seg_node(seg) == node && end > end_row_idx) {
+                        while (seg + 1 < num_segs() && seg_node(seg + 1) == node) {
+                            seg++;
+                            end += seg_len_[seg];
+                        }
+                        if (end == start) {
+                            return false;
+                        }
+                        start_row_idx = start > end_row_idx ? start : end_row_idx;
+                        end_row_idx = end;
+                        return true;
+                    }
+                    start = end;
+                }
+                return false;
+            }
+            size_t num_chunks = (len + chunk_size - 1) / chunk_size;
+            size_t chunk_idx = end_row_idx / chunk_size;
+            for (size_t i = chunk_idx; i < num_chunks; i++) {
+                if (home(i) == node) {
+                    size_t last = i;
+                    while (last + 1 < num_chunks && home(last + 1) == node) {
+                        last++;
+                    }
+                    start_row_idx = i * chunk_size;
+                    end_row_idx = (last + 1) * chunk_size;
+                    end_row_idx = end_row_idx < len ? end_row_idx : len;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        size_t serial_buf_size() {
+            size_t ret = 1 + 3 * sizeof(size_t);
+            ret += num_segs() * sizeof(size_t);
+            return ret;
+        }
+
+        // <kind><num_nodes><arg><replicas>[seg_len...]
+        char* serialize(char* buf) {
+            char* buf_pointer = buf;
+            buf_pointer[0] = kind_;
+            buf_pointer += 1;
+
+            memcpy(buf_pointer, &num_nodes_, sizeof(size_t));
+            buf_pointer += sizeof(size_t);
+
+            memcpy(buf_pointer, &arg_, sizeof(size_t));
+            buf_pointer += sizeof(size_t);
+
+            memcpy(buf_pointer, &replicas_, sizeof(size_t));
+            buf_pointer += sizeof(size_t);
+
+            if (segmented()) {
+                memcpy(buf_pointer, seg_len_, num_segs() * sizeof(size_t));
+            }
+            return buf;
+        }
+
+        static Placement* deserialize(const char* buf) {
+            char kind = buf[0];
+            size_t num_nodes, arg, replicas;
+            memcpy(&num_nodes, buf + 1, sizeof(size_t));
+            memcpy(&arg, buf + 1 + sizeof(size_t), sizeof(size_t));
+            memcpy(&replicas, buf + 1 + 2 * sizeof(size_t), sizeof(size_t));
+
+            if (kind != ROUND_ROBIN && kind != RANGE && kind != HASH && kind != SINGLE_NODE && kind != LOCAL) {
+                fail("Placement.deserialize(): unknown placement %d", kind);
+            }
+
+            Placement* ret = new Placement(kind, num_nodes, arg);
+            ret->set_replicas(replicas);
+            if (ret->segmented()) {
+                memcpy(ret->seg_len_, buf + 1 + 3 * sizeof(size_t), ret->num_segs() * sizeof(size_t));
+            }
+            return ret;
+        }
+};
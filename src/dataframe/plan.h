@@ -0,0 +1,249 @@
+//lang:Cpp
+#pragma once
+
+#include "row.h"
+#include "schema.h"
+#include "dataframe.h"
+#include "shuffle.h"
+#include "group_by.h"
+
+#include "../util/object.h"
+#include "../util/array.h"
+
+#include "../kvstore/keyvalue.h"
+
+// what a stage of a LazyFrame does with the rows it gets
+enum PlanStageKind {
+    FILTER_STAGE = 'F',   // passes on the rows the rower accepts
+    PROJECT_STAGE = 'P',  // passes on some columns of every row
+    MAP_STAGE = 'M'       // shows every row to the rower and passes it on
+};
+
+// one stage of a LazyFrame
+class PlanStage : public Object {
+    public:
+        char kind_;
+        Rower* rower_;  // external, nullptr for a projection
+        size_t* cols_;  // owned; the columns a projection keeps, in their new order
+        size_t num_cols_;
+        Schema in_;  // the schema of the rows the stage gets
+
+        PlanStage(char kind, Rower* rower, const size_t* cols, size_t num_cols, Schema& in) : in_(in) {
+            kind_ = kind;
+            rower_ = rower;
+            num_cols_ = num_cols;
+            cols_ = new size_t[num_cols > 0 ? num_cols : 1];
+            for (size_t i = 0; i < num_cols; i++) {
+                cols_[i] = cols[i];
+            }
+        }
+
+        ~PlanStage() {
+            delete[] cols_;
+        }
+};
+
+/**
+ * PipelineRower is a subclass of Rower
+ * Runs the stages of a LazyFrame on every row it gets and hands the rows that come out of the
+ * last stage to the sink, so the stages are fused into one pass. It reads only the columns that
+ * a stage or the sink reads, traced back through the projections.
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class PipelineRower : public Rower {
+    public:
+        PlanStage** stages_;  // external
+        size_t num_stages_;
+        Rower& sink_;  // external
+        Row** rows_;  // owned; the output row of each projection, nullptr for the other stages
+        bool* reads_;  // owned; the columns of the source rows that are read
+
+        PipelineRower(PlanStage** stages, size_t num_stages, Schema& out, Rower& sink) : sink_(sink) {
+            stages_ = stages;
+            num_stages_ = num_stages;
+            rows_ = new Row*[num_stages > 0 ? num_stages : 1];
+            for (size_t i = 0; i < num_stages_; i++) {
+                rows_[i] = nullptr;
+                if (stages_[i]->kind_ == PROJECT_STAGE) {
+                    Schema* projected = i + 1 < num_stages_ ? &stages_[i + 1]->in_ : &out;
+                    rows_[i] = new Row(*projected);
+                }
+            }
+
+            // the columns the sink reads, then the columns every stage reads, from the last stage to the first
+            size_t width = out.width();
+            bool* need = new bool[width > 0 ? width : 1];
+            for (size_t c = 0; c < width; c++) {
+                need[c] = sink_.reads_column(c);
+            }
+            for (size_t i = num_stages_; i > 0; i--) {
+                PlanStage* stage = stages_[i - 1];
+                size_t in_width = stage->in_.width();
+                bool* in_need = new bool[in_width > 0 ? in_width : 1];
+                for (size_t c = 0; c < in_width; c++) {
+                    in_need[c] = stage->kind_ != PROJECT_STAGE && (need[c] || stage->rower_->reads_column(c));
+                }
+                for (size_t j = 0; stage->kind_ == PROJECT_STAGE && j < stage->num_cols_; j++) {
+                    in_need[stage->cols_[j]] = in_need[stage->cols_[j]] || need[j];
+                }
+                delete[] need;
+                need = in_need;
+            }
+            reads_ = need;
+        }
+
+        ~PipelineRower() {
+            for (size_t i = 0; i < num_stages_; i++) {
+                delete rows_[i];
+            }
+            delete[] rows_;
+            delete[] reads_;
+        }
+
+        bool accept(Row& r) {
+            Row* row = &r;
+            for (size_t i = 0; i < num_stages_; i++) {
+                PlanStage* stage = stages_[i];
+                switch (stage->kind_) {
+                    case FILTER_STAGE:
+                        if (!stage->rower_->accept(*row)) {
+                            return false;
+                        }
+                        break;
+                    case MAP_STAGE:
+                        stage->rower_->accept(*row);
+                        break;
+                    default:
+                        // the strings of the projected row belong to the row that was accepted
+                        for (size_t j = 0; j < stage->num_cols_; j++) {
+                            copy_field(*rows_[i], j, *row, stage->cols_[j]);
+                        }
+                        rows_[i]->set_idx(row->get_idx());
+                        row = rows_[i];
+                        break;
+                }
+            }
+            return sink_.accept(*row);
+        }
+
+        bool reads_column(size_t col) {
+            return reads_[col];
+        }
+};
+
+/**
+ * CollectRower is a subclass of Rower
+ * Adds the rows it gets to a shuffle, on this node.
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class CollectRower : public Rower {
+    public:
+        Shuffle& result_;  // external
+
+        CollectRower(Shuffle& result) : result_(result) { }
+
+        bool accept(Row& r) {
+            result_.add(r, result_.node_);
+            return true;
+        }
+};
+
+/**
+ * A query over a dataframe that runs only when its result is asked for. filter, project and map
+ * add stages to the plan and return the plan. local_map, collect and group_by run every stage on
+ * the rows of each local chunk in one pass, without a dataframe between the stages: a row that a
+ * filter drops is not looked at again, and only the columns that some stage reads are fetched.
+ * Rows are only stored where the plan ends in an exchange between nodes, by collect or group_by.
+ * The rowers of the stages are external and have to outlive the plan.
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class LazyFrame : public Object {
+    public:
+        DataFrame& df_;  // external
+        Array<PlanStage> stages_;  // owns the stages
+        Schema* schema_;  // owned; the schema of the rows that come out of the last stage
+
+        LazyFrame(DataFrame& df) : df_(df), stages_() {
+            schema_ = new Schema(df.get_schema());
+        }
+
+        // takes the stages of from, which is left without any
+        LazyFrame(LazyFrame&& from) : df_(from.df_), stages_() {
+            for (size_t i = 0; i < from.stages_.size(); i++) {
+                stages_.push_back(from.stages_.get(i));
+            }
+            from.stages_.clear();
+            schema_ = new Schema(*from.schema_);
+        }
+
+        ~LazyFrame() {
+            for (size_t i = 0; i < stages_.size(); i++) {
+                delete stages_.get(i);
+            }
+            delete schema_;
+        }
+
+        // keeps the rows that p accepts, p sees the columns of the stage before
+        LazyFrame& filter(Rower& p) {
+            stages_.push_back(new PlanStage(FILTER_STAGE, &p, nullptr, 0, *schema_));
+            return *this;
+        }
+
+        // keeps the given columns, in that order. Later stages see only them
+        LazyFrame& project(const size_t* cols, size_t num_cols) {
+            abort_if_not(num_cols > 0, "LazyFrame.project(): no columns");
+            StrBuff types;
+            for (size_t i = 0; i < num_cols; i++) {
+                abort_if_not(cols[i] < schema_->width(), "LazyFrame.project(): column %zu out of bounds", cols[i]);
+                char type[2] = {schema_->col_type(cols[i]), '\0'};
+                types.c(type);
+            }
+            stages_.push_back(new PlanStage(PROJECT_STAGE, nullptr, cols, num_cols, *schema_));
+            String* type_str = types.get();
+            delete schema_;
+            schema_ = new Schema(type_str->c_str());
+            delete type_str;
+            return *this;
+        }
+
+        // shows every row to r and keeps it
+        LazyFrame& map(Rower& r) {
+            stages_.push_back(new PlanStage(MAP_STAGE, &r, nullptr, 0, *schema_));
+            return *this;
+        }
+
+        Schema& get_schema() {
+            return *schema_;
+        }
+
+        // runs the plan over the rows stored on this node, the rows that come out are given to r
+        void local_map(Rower& r) {
+            PipelineRower pipeline(stages_.values_, stages_.size(), *schema_, r);
+            df_.local_map(pipeline);
+        }
+
+        // Runs the plan on every node and stores the rows that come out under key, they stay on
+        // the node they came out on. Every node has to call this.
+        DataFrame* collect(Key& key) {
+            Shuffle result(*schema_, key, df_.kv_);
+            CollectRower collector(result);
+            local_map(collector);
+            return result.finish();
+        }
+
+        // Runs the plan on every node and groups the rows that come out like DataFrame.group_by,
+        // the rows are aggregated as they come out. Every node has to call this.
+        DataFrame* group_by(const size_t* key_cols, size_t num_keys, Aggregate* aggs, size_t num_aggs, Key& key) {
+            Schema* out = group_by_schema(*schema_, key_cols, num_keys, aggs, num_aggs);
+            GroupByRower local(key_cols, num_keys, aggs, num_aggs, *out);
+            local_map(local);
+            DataFrame* ret = merge_groups(local, key, df_.kv_);
+            delete out;
+            return ret;
+        }
+};
+
+// this declaration must come after the declaration of LazyFrame
+LazyFrame DataFrame::lazy() {
+    return LazyFrame(*this);
+}
@@ -336,7 +336,61 @@ class Row : public Object {
         char col_type(size_t idx) {
             return s_.col_type(idx);
         }
+
+        /** Hash of the value of the field at the given position. Equal values of the
+         *  same type hash the same in every row, this is used to partition rows. */
+        size_t hash_field(size_t col) {
+            abort_if_not(col < width(), "Row.hash_field(): out of bounds");
+            size_t h = 0;
+            switch (s_.col_type(col)) {
+                case BOOL:
+                    h = get_bool(col);
+                    break;
+                case INT:
+                    h = (size_t) (long) get_int(col);
+                    break;
+                case DOUBLE:
+                {
+                    double d = get_double(col);
+                    memcpy(&h, &d, sizeof(double) < sizeof(size_t) ? sizeof(double) : sizeof(size_t));
+                    break;
+                }
+                case STRING:
+                    return get_string(col)->hash();
+                default:
+                    fail("Row.hash_field(): bad schema");
+            }
+            // spread the bits so that consecutive values do not land on consecutive nodes only
+            h *= 0x9E3779B97F4A7C15ULL;
+            return h ^ (h >> 32);
+        }
         
+        /** Compares the field at col with the field at other_col of other, which must have the
+         *  same type. Negative if this one is smaller, 0 if they are equal, positive otherwise.
+         *  Strings are compared byte by byte, false is smaller than true. */
+        int compare_field(size_t col, Row& other, size_t other_col) {
+            abort_if_not(col < width() && other_col < other.width(), "Row.compare_field(): out of bounds");
+            abort_if_not(s_.col_type(col) == other.col_type(other_col), "Row.compare_field(): fields have different types");
+            switch (s_.col_type(col)) {
+                case BOOL:
+                    return (int) get_bool(col) - (int) other.get_bool(other_col);
+                case INT:
+                {
+                    int a = get_int(col);
+                    int b = other.get_int(other_col);
+                    return a < b ? -1 : (a > b ? 1 : 0);
+                }
+                case DOUBLE:
+                {
+                    double a = get_double(col);
+                    double b = other.get_double(other_col);
+                    return a < b ? -1 : (a > b ? 1 : 0);
+                }
+                default:
+                    return strcmp(get_string(col)->c_str(), other.get_string(other_col)->c_str());
+            }
+        }
+
         /** Given a Fielder, visit every field of this row. The first argument is
             * index of the row in the dataframe.
             * Calling this method before the row's fields have been set is undefined. */
@@ -395,4 +449,24 @@ class Rower : public Object {
         virtual void join_delete(Rower* other)  {
             delete other;
         }
+
+        /** Whether accept() reads the given column. A DataFrame only fetches the
+            columns that are read, the other fields of the row are left as zeros
+            (nullptr for strings). Every column is read unless this is overriden. */
+        virtual bool reads_column(size_t col) {
+            return true;
+        }
+
+        /** The partial result of a rower that ran on another node, see DataFrame.ship.
+            Sets len to the length of the returned buffer, which is owned by the caller. */
+        virtual char* serialize_result(size_t& len) {
+            fail("Rower.serialize_result(): this rower cannot be shipped");
+            return nullptr;
+        }
+
+        /** Sets this rower to the partial result that serialize_result returned on
+            another node, so it can be joined with join_delete. */
+        virtual void deserialize_result(const char* buf, size_t len) {
+            fail("Rower.deserialize_result(): this rower cannot be shipped");
+        }
 };
\ No newline at end of file
@@ -87,6 +87,12 @@ class Schema : public Object {
             types_[types_len_++] = typ;
         }
 
+        // changes the type of the column at idx
+        void set_col_type(size_t idx, char typ) {
+            abort_if_not(idx < width(), "Schema.set_col_type(): out of bounds");
+            types_[idx] = typ;
+        }
+
         /** Return type of column at idx. An idx >= width is undefined. */
         char col_type(size_t idx) {
             abort_if_not(idx < width(), "Schema.col_type(): out of bounds");
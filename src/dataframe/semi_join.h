@@ -0,0 +1,407 @@
+//lang:Cpp
+#pragma once
+
+#include "row.h"
+#include "schema.h"
+#include "dataframe.h"
+#include "shuffle.h"
+
+#include "../util/object.h"
+#include "../util/map.h"
+#include "../util/config.h"
+
+#include "../kvstore/keyvalue.h"
+
+// how a Membership stores its keys
+enum MembershipKind {
+    EXACT_MEMBERS = 'E',  // one bit for every INT from the smallest key to the largest
+    BLOOM_MEMBERS = 'B'   // a Bloom filter, some keys that were not added test as members
+};
+
+/**
+ * The keys of the membership side of DataFrame.semi_join, as a bitmap that is broadcast to every
+ * node. An exact bitmap has a bit for every INT in the range of the keys. A Bloom filter sets
+ * BLOOM_HASHES bits for every key, in BLOOM_BITS_PER_KEY bits per key. Every node builds one of
+ * the same kind and size from its keys, they are merged by or-ing their bits.
+ * Serialized as <kind><base><num bits><num hashes>[words...]
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class Membership : public Object {
+    public:
+        char kind_;
+        int base_;  // the smallest key of an exact bitmap
+        size_t num_bits_;
+        size_t num_hashes_;  // bits set per key of a Bloom filter
+        size_t* words_;  // owned
+        KeyEncoder keys_;
+
+        Membership(char kind, int base, size_t num_bits, size_t num_hashes) {
+            abort_if_not(kind == EXACT_MEMBERS || kind == BLOOM_MEMBERS, "Membership(): unknown kind %c", kind);
+            kind_ = kind;
+            base_ = base;
+            num_bits_ = num_bits;
+            num_hashes_ = num_hashes;
+            words_ = new size_t[num_words()];
+            memset(words_, 0, num_words() * sizeof(size_t));
+        }
+
+        ~Membership() {
+            delete[] words_;
+        }
+
+        // the keys from min to max, one bit each
+        static Membership* exact(int min, int max) {
+            size_t bits = max < min ? 0 : (size_t) ((long) max - (long) min + 1);
+            return new Membership(EXACT_MEMBERS, min, bits, 0);
+        }
+
+        // a Bloom filter for count keys
+        static Membership* bloom(size_t count) {
+            size_t bits = count * Config::BLOOM_BITS_PER_KEY;
+            return new Membership(BLOOM_MEMBERS, 0, bits > 64 ? bits : 64, Config::BLOOM_HASHES);
+        }
+
+        size_t num_words() {
+            return (num_bits_ + sizeof(size_t) * 8 - 1) / (sizeof(size_t) * 8);
+        }
+
+        void set_bit_(size_t bit) {
+            size_t one = 1;
+            words_[bit / (sizeof(size_t) * 8)] |= one << (bit % (sizeof(size_t) * 8));
+        }
+
+        bool test_bit_(size_t bit) {
+            size_t one = 1;
+            return (words_[bit / (sizeof(size_t) * 8)] & (one << (bit % (sizeof(size_t) * 8)))) != 0;
+        }
+
+        // the i-th bit of a key of a Bloom filter, by double hashing
+        size_t bloom_bit_(size_t h, size_t i) {
+            size_t step = (h * 0x9E3779B97F4A7C15ULL) ^ (h >> 29);
+            return (h + i * (step | 1)) % num_bits_;
+        }
+
+        size_t hash_(Row& r, size_t col) {
+            GroupKey key(keys_.bytes(), keys_.encode(r, &col, 1), false);
+            return key.hash();
+        }
+
+        // adds the value in col of the row
+        void add(Row& r, size_t col) {
+            if (kind_ == EXACT_MEMBERS) {
+                long bit = (long) r.get_int(col) - (long) base_;
+                abort_if_not(bit >= 0 && (size_t) bit < num_bits_, "Membership.add(): %d is out of range", r.get_int(col));
+                set_bit_((size_t) bit);
+                return;
+            }
+            size_t h = hash_(r, col);
+            for (size_t i = 0; i < num_hashes_; i++) {
+                set_bit_(bloom_bit_(h, i));
+            }
+        }
+
+        // Whether the value in col of the row was added. A Bloom filter can be wrong about values
+        // that were not added, never about the ones that were
+        bool test(Row& r, size_t col) {
+            if (kind_ == EXACT_MEMBERS) {
+                long bit = (long) r.get_int(col) - (long) base_;
+                return bit >= 0 && (size_t) bit < num_bits_ && test_bit_((size_t) bit);
+            }
+            size_t h = hash_(r, col);
+            for (size_t i = 0; i < num_hashes_; i++) {
+                if (!test_bit_(bloom_bit_(h, i))) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        size_t serial_buf_size() {
+            return 1 + sizeof(int) + 2 * sizeof(size_t) + num_words() * sizeof(size_t);
+        }
+
+        // <kind><base><num bits><num hashes>[words...]
+        char* serialize() {
+            char* buf = new char[serial_buf_size()];
+            char* pos = buf;
+            pos[0] = kind_;
+            pos += 1;
+            memcpy(pos, &base_, sizeof(int));
+            pos += sizeof(int);
+            memcpy(pos, &num_bits_, sizeof(size_t));
+            pos += sizeof(size_t);
+            memcpy(pos, &num_hashes_, sizeof(size_t));
+            pos += sizeof(size_t);
+            memcpy(pos, words_, num_words() * sizeof(size_t));
+            return buf;
+        }
+
+        // ors the bits of a serialized membership of the same kind and size into this one
+        void merge(const char* buf, size_t len) {
+            abort_if_not(len == serial_buf_size() && buf[0] == kind_, "Membership.merge(): memberships do not match");
+            const char* pos = buf + 1 + sizeof(int) + 2 * sizeof(size_t);
+            for (size_t i = 0; i < num_words(); i++) {
+                size_t word;
+                memcpy(&word, pos + i * sizeof(size_t), sizeof(size_t));
+                words_[i] |= word;
+            }
+        }
+};
+
+/**
+ * MemberStatsRower is a subclass of Rower
+ * Counts the keys of the membership side of a semi join and, for an INT column, finds the
+ * smallest and the largest one. Serialized as <count><min><max>
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class MemberStatsRower : public Rower {
+    public:
+        size_t col_;
+        size_t count_;
+        int min_;
+        int max_;
+
+        MemberStatsRower(size_t col) {
+            col_ = col;
+            count_ = 0;
+            min_ = 0;
+            max_ = 0;
+        }
+
+        bool accept(Row& r) {
+            if (r.col_type(col_) == INT) {
+                int n = r.get_int(col_);
+                min_ = count_ == 0 || n < min_ ? n : min_;
+                max_ = count_ == 0 || n > max_ ? n : max_;
+            }
+            count_++;
+            return true;
+        }
+
+        bool reads_column(size_t col) {
+            return col == col_;
+        }
+
+        size_t serial_buf_size() {
+            return sizeof(size_t) + 2 * sizeof(int);
+        }
+
+        char* serialize() {
+            char* buf = new char[serial_buf_size()];
+            memcpy(buf, &count_, sizeof(size_t));
+            memcpy(buf + sizeof(size_t), &min_, sizeof(int));
+            memcpy(buf + sizeof(size_t) + sizeof(int), &max_, sizeof(int));
+            return buf;
+        }
+
+        // adds the stats that another node serialized
+        void merge(const char* buf) {
+            size_t count;
+            int min, max;
+            memcpy(&count, buf, sizeof(size_t));
+            memcpy(&min, buf + sizeof(size_t), sizeof(int));
+            memcpy(&max, buf + sizeof(size_t) + sizeof(int), sizeof(int));
+            if (count == 0) {
+                return;
+            }
+            min_ = count_ == 0 || min < min_ ? min : min_;
+            max_ = count_ == 0 || max > max_ ? max : max_;
+            count_ += count;
+        }
+};
+
+/**
+ * MembershipBuilder is a subclass of Rower
+ * Adds the keys of the membership side of a semi join to a Membership.
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class MembershipBuilder : public Rower {
+    public:
+        Membership& members_;  // external
+        size_t col_;
+
+        MembershipBuilder(Membership& members, size_t col) : members_(members) {
+            col_ = col;
+        }
+
+        bool accept(Row& r) {
+            members_.add(r, col_);
+            return true;
+        }
+
+        bool reads_column(size_t col) {
+            return col == col_;
+        }
+};
+
+/**
+ * SemiJoinRower is a subclass of Rower
+ * Sends the rows whose key tests as a member through a shuffle: to this node if the membership
+ * is exact, otherwise to the node the key hashes to, where it is checked against the keys.
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class SemiJoinRower : public Rower {
+    public:
+        Membership& members_;  // external
+        Shuffle& shuffle_;  // external
+        size_t col_;
+        KeyEncoder keys_;
+
+        SemiJoinRower(Membership& members, Shuffle& shuffle, size_t col) : members_(members), shuffle_(shuffle) {
+            col_ = col;
+        }
+
+        bool accept(Row& r) {
+            if (!members_.test(r, col_)) {
+                return false;
+            }
+            if (members_.kind_ == EXACT_MEMBERS) {
+                shuffle_.add(r, shuffle_.node_);
+            } else {
+                shuffle_.add(r, keys_.node_of(r, &col_, 1, shuffle_.num_nodes_));
+            }
+            return true;
+        }
+};
+
+/**
+ * MemberSetRower is a subclass of Rower
+ * Keeps the distinct keys of the rows it is given, they have the key in column 0.
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class MemberSetRower : public Rower {
+    public:
+        Map<GroupKey, GroupKey> keys_;  // every key maps to itself, owns the keys
+        KeyEncoder encoder_;
+
+        MemberSetRower() : keys_() { }
+
+        ~MemberSetRower() {
+            size_t num = keys_.size();
+            GroupKey** keys = keys_.keys();
+            for (size_t i = 0; i < num; i++) {
+                keys_.pop_item(keys[i]);
+                delete keys[i];
+            }
+            delete[] keys;
+        }
+
+        bool accept(Row& r) {
+            size_t col = 0;
+            size_t len = encoder_.encode(r, &col, 1);
+            GroupKey lookup(encoder_.bytes(), len, false);
+            if (keys_.get(&lookup) == nullptr) {
+                GroupKey* key = new GroupKey(encoder_.bytes(), len);
+                keys_.add(key, key);
+            }
+            return true;
+        }
+
+        // whether the value in col of the row is one of the keys
+        bool has(Row& r, size_t col) {
+            GroupKey lookup(encoder_.bytes(), encoder_.encode(r, &col, 1), false);
+            return keys_.get(&lookup) != nullptr;
+        }
+};
+
+/**
+ * MemberCheckRower is a subclass of Rower
+ * Adds the rows whose key is one of the keys of a MemberSetRower to the result, on this node.
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class MemberCheckRower : public Rower {
+    public:
+        MemberSetRower& members_;  // external
+        Shuffle& result_;  // external
+        size_t col_;
+
+        MemberCheckRower(MemberSetRower& members, Shuffle& result, size_t col) : members_(members), result_(result) {
+            col_ = col;
+        }
+
+        bool accept(Row& r) {
+            if (!members_.has(r, col_)) {
+                return false;
+            }
+            result_.add(r, result_.node_);
+            return true;
+        }
+};
+
+// this declaration must come after the declaration of MemberCheckRower
+DataFrame* DataFrame::semi_join(size_t col, DataFrame& membership, size_t member_col, Key& key) {
+    abort_if_not(col < ncols(), "DataFrame.semi_join(): column %zu out of bounds", col);
+    abort_if_not(member_col < membership.ncols(), "DataFrame.semi_join(): membership column %zu out of bounds", member_col);
+    char type = schema_.col_type(col);
+    abort_if_not(type == membership.schema_.col_type(member_col), "DataFrame.semi_join(): the columns have different types");
+    size_t num_nodes = kv_->num_nodes();
+
+    // every node learns how many keys there are, and their range, so they build the same kind of membership
+    MemberStatsRower stats(member_col);
+    membership.local_map(stats);
+    char* stats_buf = stats.serialize();
+    Value stats_val(stats.serial_buf_size(), stats_buf, true);
+    Value** node_stats = exchange_values(kv_, key, "~member-stats", stats_val);
+    MemberStatsRower total(member_col);
+    for (size_t n = 0; n < num_nodes; n++) {
+        total.merge(node_stats[n]->get());
+        delete node_stats[n];
+    }
+    delete[] node_stats;
+
+    // an exact bitmap is used when it is no bigger than a Bloom filter of the keys
+    bool exact = type == INT && (total.count_ == 0 || (size_t) ((long) total.max_ - (long) total.min_ + 1) <= total.count_ * Config::BLOOM_BITS_PER_KEY);
+    Membership* members = exact ? Membership::exact(total.min_, total.count_ == 0 ? total.min_ - 1 : total.max_) : Membership::bloom(total.count_);
+    MembershipBuilder builder(*members, member_col);
+    membership.local_map(builder);
+    char* members_buf = members->serialize();
+    Value members_val(members->serial_buf_size(), members_buf, true);
+    Value** node_members = exchange_values(kv_, key, "~members", members_val);
+    for (size_t n = 0; n < num_nodes; n++) {
+        members->merge(node_members[n]->get(), node_members[n]->size());
+        delete node_members[n];
+    }
+    delete[] node_members;
+
+    DataFrame* ret = nullptr;
+    if (exact) {
+        // the rows that are members stay where they are
+        Shuffle result(schema_, key, kv_);
+        SemiJoinRower scan(*members, result, col);
+        local_map(scan);
+        ret = result.finish();
+    } else {
+        // the rows that pass the Bloom filter meet the keys on the node their key hashes to
+        Key* candidates_key = suffixed_key(kv_, key, "~candidates");
+        Shuffle candidates_shuffle(schema_, *candidates_key, kv_);
+        candidates_shuffle.intermediate();
+        SemiJoinRower scan(*members, candidates_shuffle, col);
+        local_map(scan);
+        DataFrame* candidates = candidates_shuffle.finish();
+
+        char key_type[2] = {type, '\0'};
+        Schema keys_schema(key_type);
+        Key* keys_key = suffixed_key(kv_, key, "~keys");
+        Shuffle keys_shuffle(keys_schema, *keys_key, kv_);
+        keys_shuffle.intermediate();
+        PartitionRower partition(keys_shuffle, &member_col, 1, member_col);
+        membership.local_map(partition);
+        DataFrame* keys = keys_shuffle.finish();
+
+        MemberSetRower member_set;
+        keys->local_map(member_set);
+        Shuffle result(schema_, key, kv_);
+        MemberCheckRower check(member_set, result, col);
+        candidates->local_map(check);
+        candidates->retire_();
+        keys->retire_();
+        ret = result.finish();
+
+        delete keys;
+        delete keys_key;
+        delete candidates;
+        delete candidates_key;
+    }
+    delete members;
+    return ret;
+}
@@ -0,0 +1,230 @@
+//lang:Cpp
+#pragma once
+
+#include <pthread.h>
+
+#include "row.h"
+#include "dataframe.h"
+
+#include "../util/object.h"
+#include "../util/string.h"
+#include "../util/map.h"
+#include "../util/thread.h"
+
+#include "../kvstore/keyvaluestore.h"
+#include "../kvstore/keyvalue.h"
+
+// makes a rower from the arguments that were given to DataFrame.ship, the rower is owned by the caller
+typedef Rower* (*RowerMaker)(const char* args, size_t args_len);
+
+// a RowerMaker that can be kept in a Map
+// @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+class RowerFactory : public Object {
+    public:
+        RowerMaker make_;
+
+        RowerFactory(RowerMaker make) {
+            make_ = make;
+        }
+};
+
+/**
+ * The rowers that can be shipped to other nodes by name. A node only gets the name of a rower
+ * and runs the rower that is registered under that name on the node, so every node of an
+ * application has to register the same rowers before any of them is shipped.
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class RowerRegistry : public Object {
+    public:
+        Map<String, RowerFactory> factories_;  // owns the keys and the values
+        pthread_mutex_t lock_;  // locks factories_
+
+        RowerRegistry() : factories_() {
+            abort_if_not(pthread_mutex_init(&lock_, NULL) == 0, "RowerRegistry: Failed to create mutex");
+        }
+
+        ~RowerRegistry() {
+            factories_.delete_and_clear_items();
+            pthread_mutex_destroy(&lock_);
+        }
+
+        // the registry of this process
+        static RowerRegistry& rowers() {
+            static RowerRegistry registry;
+            return registry;
+        }
+
+        // registers make under name. Registering the same maker again does nothing
+        void add(const char* name, RowerMaker make) {
+            String key(name);
+            pthread_mutex_lock(&lock_);
+            RowerFactory* factory = factories_.get(&key);
+            if (factory == nullptr) {
+                factories_.add(key.clone(), new RowerFactory(make));
+            }
+            pthread_mutex_unlock(&lock_);
+            abort_if_not(factory == nullptr || factory->make_ == make, "RowerRegistry.add(): %s is already registered", name);
+        }
+
+        bool has(const char* name) {
+            String key(name);
+            pthread_mutex_lock(&lock_);
+            bool ret = factories_.get(&key) != nullptr;
+            pthread_mutex_unlock(&lock_);
+            return ret;
+        }
+
+        // makes the rower that is registered as name, returned rower is owned by the caller
+        Rower* create(const char* name, const char* args, size_t args_len) {
+            String key(name);
+            pthread_mutex_lock(&lock_);
+            RowerFactory* factory = factories_.get(&key);
+            pthread_mutex_unlock(&lock_);
+            abort_if_not(factory != nullptr, "RowerRegistry.create(): %s is not registered", name);
+            Rower* ret = factory->make_(args, args_len);
+            abort_if_not(ret != nullptr, "RowerRegistry.create(): the factory of %s made no rower", name);
+            return ret;
+        }
+};
+
+/**
+ * A request to run a registered rower over the local rows of a dataframe. Serialized as
+ * <name len><name><args len><args><dataframe descriptor>
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class ShipRequest : public Object {
+    public:
+        const char* name_;  // external
+        const char* args_;  // external
+        size_t args_len_;
+        const char* descriptor_;  // external
+
+        ShipRequest(const char* name, const char* args, size_t args_len, const char* descriptor) {
+            name_ = name;
+            args_ = args;
+            args_len_ = args_len;
+            descriptor_ = descriptor;
+        }
+
+        // the request is a view into buf, which has to outlive it
+        ShipRequest(const char* buf, size_t len) {
+            size_t name_len;
+            abort_if_not(len >= 2 * sizeof(size_t), "ShipRequest: request is too short");
+            memcpy(&name_len, buf, sizeof(size_t));
+            name_ = buf + sizeof(size_t);
+            const char* pos = name_ + name_len;
+            memcpy(&args_len_, pos, sizeof(size_t));
+            args_ = pos + sizeof(size_t);
+            descriptor_ = args_ + args_len_;
+            abort_if_not(descriptor_ <= buf + len, "ShipRequest: request is truncated");
+        }
+
+        // the request with a descriptor of descriptor_len bytes, owned by the caller
+        Value* serialize(size_t descriptor_len) {
+            size_t name_len = strlen(name_) + 1;
+            size_t len = 2 * sizeof(size_t) + name_len + args_len_ + descriptor_len;
+            char* buf = new char[len];
+            char* pos = buf;
+            memcpy(pos, &name_len, sizeof(size_t));
+            pos += sizeof(size_t);
+            memcpy(pos, name_, name_len);
+            pos += name_len;
+            memcpy(pos, &args_len_, sizeof(size_t));
+            pos += sizeof(size_t);
+            if (args_len_ > 0) {
+                memcpy(pos, args_, args_len_);
+                pos += args_len_;
+            }
+            memcpy(pos, descriptor_, descriptor_len);
+            return new Value(len, buf, true);
+        }
+};
+
+/**
+ * Runs the rowers that are shipped to this node with DataFrame.ship. The rower is made from the
+ * registry and mapped over the rows of the chunks that are stored on this node, its partial
+ * result is sent back.
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class RowerExecutor : public Executor {
+    public:
+        KVStore* kvs_;  // external
+
+        RowerExecutor(KVStore* kvs) {
+            kvs_ = kvs;
+        }
+
+        // makes sure that the rowers shipped to kvs are run
+        static void install(KVStore* kvs) {
+            if (kvs->executor() == nullptr) {
+                kvs->set_executor(new RowerExecutor(kvs));
+            }
+        }
+
+        Value* execute(const char* request, size_t len) {
+            ShipRequest req(request, len);
+            DataFrame* df = DataFrame::deserialize(req.descriptor_, kvs_);
+            Rower* rower = RowerRegistry::rowers().create(req.name_, req.args_, req.args_len_);
+
+            df->local_map(*rower);
+            size_t result_len = 0;
+            char* result = rower->serialize_result(result_len);
+
+            delete rower;
+            delete df;
+            return new Value(result_len, result, true);
+        }
+};
+
+// ExecThread is a subclass of Thread
+// Each ExecThread sends a shipped rower to one node and waits for its result
+class ExecThread : public Thread {
+    public:
+        KVStore* kvs_;  // external
+        size_t node_;
+        Value* request_;  // external
+        Value* result_;  // owned by whoever takes it after join
+
+        ExecThread(KVStore* kvs, size_t node, Value* request) {
+            kvs_ = kvs;
+            node_ = node;
+            request_ = request;
+            result_ = nullptr;
+        }
+
+        /** Subclass responsibility, the body of the run method */
+        virtual void run() {
+            result_ = kvs_->exec(node_, *request_);
+        }
+};
+
+// this declaration must come after the declaration of ExecThread
+void DataFrame::ship(const char* name, Rower& r, const char* args, size_t args_len) {
+    abort_if_not(RowerRegistry::rowers().has(name), "DataFrame.ship(): %s is not registered", name);
+    RowerExecutor::install(kv_);
+    // the other nodes read the chunks from the kvstore
+    commit_chunks();
+
+    char* descriptor = serialize();
+    ShipRequest req(name, args, args_len, descriptor);
+    Value* request = req.serialize(serial_buf_size());
+    delete[] descriptor;
+
+    size_t n = kv_->num_nodes();
+    ExecThread** pool = new ExecThread*[n];
+    for (size_t i = 0; i < n; i++) {
+        pool[i] = new ExecThread(kv_, i, request);
+        pool[i]->start();
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        pool[i]->join();
+        Rower* part = RowerRegistry::rowers().create(name, args, args_len);
+        part->deserialize_result(pool[i]->result_->get(), pool[i]->result_->size());
+        r.join_delete(part);
+        delete pool[i]->result_;
+        delete pool[i];
+    }
+    delete[] pool;
+    delete request;
+}
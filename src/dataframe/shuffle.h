@@ -0,0 +1,531 @@
+//lang:Cpp
+#pragma once
+
+#include "row.h"
+#include "schema.h"
+#include "column.h"
+#include "placement.h"
+#include "dataframe.h"
+
+#include "../util/object.h"
+#include "../util/string.h"
+
+#include "../kvstore/keyvaluestore.h"
+#include "../kvstore/keyvalue.h"
+
+/**
+ * The values of the key columns of a row, encoded into bytes so that rows can be found in a Map.
+ * Every node encodes the same values into the same bytes, so they agree on the node of a key.
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class GroupKey : public Object {
+    public:
+        char* bytes_;  // owned unless borrowed
+        size_t len_;
+        bool owned_;
+
+        // copies the bytes
+        GroupKey(const char* bytes, size_t len) {
+            bytes_ = new char[len];
+            memcpy(bytes_, bytes, len);
+            len_ = len;
+            owned_ = true;
+        }
+
+        // borrows the bytes, which have to outlive the key. Used to look up groups
+        GroupKey(char* bytes, size_t len, bool owned) {
+            bytes_ = bytes;
+            len_ = len;
+            owned_ = owned;
+        }
+
+        ~GroupKey() {
+            if (owned_) {
+                delete[] bytes_;
+            }
+        }
+
+        size_t hash_me() {
+            // FNV-1a, spread like Row.hash_field
+            size_t h = 14695981039346656037ULL;
+            for (size_t i = 0; i < len_; i++) {
+                h ^= (unsigned char) bytes_[i];
+                h *= 1099511628211ULL;
+            }
+            h ^= h >> 32;
+            return h == 0 ? 1 : h;
+        }
+
+        bool equals(Object* o) {
+            GroupKey* other = dynamic_cast<GroupKey*>(o);
+            return other != nullptr && other->len_ == len_ && memcmp(other->bytes_, bytes_, len_) == 0;
+        }
+};
+
+/**
+ * Encodes the values of some columns of a row into bytes, which GroupKey wraps. The buffer is
+ * reused for every row, so encoding does not allocate once it has grown to the longest key.
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class KeyEncoder : public Object {
+    public:
+        char* buf_;  // owned; the key of the last row
+        size_t cap_;
+
+        KeyEncoder() {
+            cap_ = 64;
+            buf_ = new char[cap_];
+        }
+
+        ~KeyEncoder() {
+            delete[] buf_;
+        }
+
+        void reserve_(size_t len) {
+            if (len <= cap_) {
+                return;
+            }
+            cap_ = len * 2;
+            char* grown = new char[cap_];
+            delete[] buf_;
+            buf_ = grown;
+        }
+
+        // the bytes of the last key that was encoded, valid until the next one is
+        char* bytes() {
+            return buf_;
+        }
+
+        // encodes the given columns of the row, returns the number of bytes
+        size_t encode(Row& r, const size_t* cols, size_t num_cols) {
+            size_t len = 0;
+            for (size_t i = 0; i < num_cols; i++) {
+                size_t col = cols[i];
+                switch (r.col_type(col)) {
+                    case BOOL:
+                    {
+                        reserve_(len + 1);
+                        buf_[len++] = r.get_bool(col) ? 1 : 0;
+                        break;
+                    }
+                    case INT:
+                    {
+                        int n = r.get_int(col);
+                        reserve_(len + sizeof(int));
+                        memcpy(buf_ + len, &n, sizeof(int));
+                        len += sizeof(int);
+                        break;
+                    }
+                    case DOUBLE:
+                    {
+                        double d = r.get_double(col);
+                        reserve_(len + sizeof(double));
+                        memcpy(buf_ + len, &d, sizeof(double));
+                        len += sizeof(double);
+                        break;
+                    }
+                    default:
+                    {
+                        // strings are prefixed with their length, so that keys can not run into each other
+                        String* s = r.get_string(col);
+                        size_t s_len = s->size();
+                        reserve_(len + sizeof(size_t) + s_len);
+                        memcpy(buf_ + len, &s_len, sizeof(size_t));
+                        memcpy(buf_ + len + sizeof(size_t), s->c_str(), s_len);
+                        len += sizeof(size_t) + s_len;
+                        break;
+                    }
+                }
+            }
+            return len;
+        }
+
+        // the node of num_nodes that the given columns of the row hash to
+        size_t node_of(Row& r, const size_t* cols, size_t num_cols, size_t num_nodes) {
+            GroupKey key(buf_, encode(r, cols, num_cols), false);
+            return key.hash() % num_nodes;
+        }
+};
+
+// sets field of to to the value of column col of from, strings are shared and not cloned
+inline void copy_field(Row& to, size_t field, Row& from, size_t col) {
+    switch (from.col_type(col)) {
+        case BOOL:
+            to.set(field, from.get_bool(col));
+            break;
+        case INT:
+            to.set(field, from.get_int(col));
+            break;
+        case DOUBLE:
+            to.set(field, from.get_double(col));
+            break;
+        default:
+            to.set(field, from.get_string(col));
+            break;
+    }
+}
+
+/**
+ * Encodes rows into one chunk per column, laid out like the chunks that push_back builds, so that
+ * a full chunk is put with a single put per column instead of a put per value.
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class ChunkBuilder : public Object {
+    public:
+        Schema schema_;
+        size_t chunk_size_;
+        size_t rows_;  // rows in the chunks being built
+        char** chunks_;  // owned; the chunk being built for each column
+        size_t* bytes_;  // owned; bytes used in each string chunk
+        size_t* cap_;  // owned; bytes allocated for each chunk
+
+        ChunkBuilder(Schema& schema, size_t chunk_size) : schema_(schema) {
+            chunk_size_ = chunk_size;
+            rows_ = 0;
+            chunks_ = new char*[schema_.width()];
+            bytes_ = new size_t[schema_.width()];
+            cap_ = new size_t[schema_.width()];
+            for (size_t i = 0; i < schema_.width(); i++) {
+                cap_[i] = fixed_chunk_bytes(schema_.col_type(i), chunk_size_);
+                if (cap_[i] == 0) {
+                    cap_[i] = chunk_size_ * 16;
+                }
+                new_chunk_(i);
+            }
+        }
+
+        ~ChunkBuilder() {
+            for (size_t i = 0; i < schema_.width(); i++) {
+                delete[] chunks_[i];
+            }
+            delete[] chunks_;
+            delete[] bytes_;
+            delete[] cap_;
+        }
+
+        void new_chunk_(size_t col) {
+            chunks_[col] = new char[cap_[col]];
+            memset(chunks_[col], 0, cap_[col]);
+            bytes_[col] = 0;
+        }
+
+        size_t rows() {
+            return rows_;
+        }
+
+        bool full() {
+            return rows_ == chunk_size_;
+        }
+
+        // copies the fields of the row into the chunks, the row has to have the schema of the builder
+        void add(Row& row) {
+            abort_if_not(!full(), "ChunkBuilder.add(): the chunks are full");
+            for (size_t i = 0; i < schema_.width(); i++) {
+                char* chunk = chunks_[i];
+                switch (schema_.col_type(i)) {
+                    case BOOL:
+                    {
+                        if (!row.get_bool(i)) {
+                            break;
+                        }
+                        size_t one = 1;
+                        size_t item_idx = rows_ / (sizeof(size_t) * 8);
+                        size_t word;
+                        memcpy(&word, chunk + item_idx * sizeof(size_t), sizeof(size_t));
+                        word |= one << (rows_ % (sizeof(size_t) * 8));
+                        memcpy(chunk + item_idx * sizeof(size_t), &word, sizeof(size_t));
+                        break;
+                    }
+                    case INT:
+                    {
+                        int n = row.get_int(i);
+                        memcpy(chunk + rows_ * sizeof(int), &n, sizeof(int));
+                        break;
+                    }
+                    case DOUBLE:
+                    {
+                        double d = row.get_double(i);
+                        memcpy(chunk + rows_ * sizeof(double), &d, sizeof(double));
+                        break;
+                    }
+                    default:
+                    {
+                        String* s = row.get_string(i);
+                        abort_if_not(s != nullptr, "ChunkBuilder.add(): missing string in column %zu", i);
+                        add_string_(i, s->c_str(), s->size());
+                        break;
+                    }
+                }
+            }
+            rows_++;
+        }
+
+        // every string is followed by its null terminator, like StringColumn lays them out
+        void add_string_(size_t col, const char* s, size_t len) {
+            if (bytes_[col] + len + 1 > cap_[col]) {
+                cap_[col] = (bytes_[col] + len + 1) * 2;
+                char* grown = new char[cap_[col]];
+                memcpy(grown, chunks_[col], bytes_[col]);
+                delete[] chunks_[col];
+                chunks_[col] = grown;
+            }
+            memcpy(chunks_[col] + bytes_[col], s, len + 1);
+            bytes_[col] += len + 1;
+        }
+
+        // hands the chunks being built to the given segment of df and starts new ones
+        void seal_into(DataFrame& df, size_t seg) {
+            if (rows_ == 0) {
+                return;
+            }
+            Value** chunks = new Value*[schema_.width()];
+            for (size_t i = 0; i < schema_.width(); i++) {
+                size_t fixed = fixed_chunk_bytes(schema_.col_type(i), chunk_size_);
+                chunks[i] = new Value(fixed > 0 ? fixed : bytes_[i], chunks_[i], true);
+                if (fixed == 0) {
+                    // the next chunk of strings likely needs about as many bytes
+                    cap_[i] = bytes_[i] > 0 ? bytes_[i] : cap_[i];
+                }
+                new_chunk_(i);
+            }
+            df.append_chunks_to_(seg, chunks, rows_);
+            delete[] chunks;
+            rows_ = 0;
+        }
+};
+
+// The key of an intermediate dataframe of an operation that stores its result under key, owned
+// by the caller. It holds an exchange id, so the keys of two calls that store their result under
+// the same key differ. Every node has to ask for it at the same point of the operation.
+inline Key* suffixed_key(KVStore* kvs, Key& key, const char* suffix) {
+    String* name = key.get_name();
+    StrBuff buf;
+    buf.c(*name);
+    buf.c(suffix);
+    buf.c("-");
+    buf.c(kvs->next_exchange_id());
+    String* suffixed = buf.get();
+    Key* ret = new Key(key.get_index(), suffixed->c_str());
+    delete suffixed;
+    delete name;
+    return ret;
+}
+
+// the key that node puts its value of the exchange with the given id under, homed on node. Owned by the caller
+inline Key* exchange_key(Key& key, const char* suffix, size_t id, size_t node) {
+    String* name = key.get_name();
+    StrBuff buf;
+    buf.c(*name);
+    buf.c(suffix);
+    buf.c("-");
+    buf.c(id);
+    buf.c("-");
+    buf.c(node);
+    String* node_name = buf.get();
+    Key* ret = new Key(node, node_name->c_str());
+    delete node_name;
+    delete name;
+    return ret;
+}
+
+// Puts v for the other nodes and returns what every node put, in the order of the nodes. Every
+// node has to call this with the same key and suffix, and run the same exchanges before it. The
+// value this node put is removed at the end of its next exchange, when every node has read it,
+// and so are the keys it retired before this exchange. The array and the values are owned by the caller
+inline Value** exchange_values(KVStore* kvs, Key& key, const char* suffix, Value& v) {
+    size_t num_nodes = kvs->num_nodes();
+    size_t node = kvs->node_index();
+    size_t id = kvs->next_exchange_id();
+    size_t retired = kvs->num_retired();
+    Key* own_key = exchange_key(key, suffix, id, node);
+    kvs->put(*own_key, v);
+
+    Value** ret = new Value*[num_nodes];
+    for (size_t n = 0; n < num_nodes; n++) {
+        if (n == node) {
+            ret[n] = new Value(v.size(), v.get());
+            continue;
+        }
+        Key* node_key = exchange_key(key, suffix, id, n);
+        ret[n] = kvs->getAndWait(*node_key);
+        delete node_key;
+    }
+    // every node has put its value, so it is done with everything it retired before that
+    kvs->remove_retired(retired);
+    kvs->retire(own_key);
+    return ret;
+}
+
+/**
+ * Sends rows to the nodes that should store them. Every node creates a Shuffle with the same
+ * schema and key, adds its rows with the node each of them goes to and calls finish(), which
+ * returns the same dataframe on every node.
+ *
+ * The dataframe is LOCAL placed with one segment for every pair of nodes: the rows that node m
+ * sends to node n are in segment n * num_nodes + m, which is homed on n. The segments are filled
+ * without any coordination, a full chunk of rows is put on its node in the background as one put
+ * per column. The segments of a node are next to each other, so local_map on node n visits every
+ * row that was sent to n.
+ *
+ * The descriptions of the parts are exchanged with exchange_values, so every node has to run the
+ * same shuffles in the same order. The chunks of the dataframe are named after the key, so a key
+ * can only hold the result of one shuffle at a time.
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class Shuffle : public Object {
+    public:
+        KVStore* kvs_;  // external
+        Key* key_;  // owned
+        Schema schema_;
+        size_t num_nodes_;
+        size_t node_;  // the node this runs on
+        Placement* placement_;  // owned
+        DataFrame* part_;  // owned; the rows sent from this node
+        ChunkBuilder** builders_;  // owned; the rows on their way to each node
+        size_t sorted_col_;  // the column the result is sorted by, MAX_SIZE_T if it is not
+        bool publish_;  // is the result put under the key?
+
+        Shuffle(Schema& schema, Key& key, KVStore* kvs) : schema_(schema) {
+            kvs_ = kvs;
+            key_ = key.clone();
+            num_nodes_ = kvs->num_nodes();
+            node_ = kvs->node_index();
+            placement_ = Placement::local(num_nodes_, num_nodes_);
+            part_ = new DataFrame(schema_, *key_, kvs_, *placement_, false);
+            sorted_col_ = Config::MAX_SIZE_T;
+            publish_ = true;
+            builders_ = new ChunkBuilder*[num_nodes_];
+            for (size_t i = 0; i < num_nodes_; i++) {
+                builders_[i] = new ChunkBuilder(schema_, kvs_->get_config().CHUNK_SIZE);
+            }
+        }
+
+        ~Shuffle() {
+            for (size_t i = 0; i < num_nodes_; i++) {
+                delete builders_[i];
+            }
+            delete[] builders_;
+            delete part_;
+            delete placement_;
+            delete key_;
+        }
+
+        // the segment that holds the rows this node sends to node
+        size_t seg_(size_t node) {
+            return node * num_nodes_ + node_;
+        }
+
+        // Records that the result is sorted by col. Every node has to send its rows only to itself,
+        // in order, and every row of node n has to come before the rows of node n + 1
+        void sorted_by(size_t col) {
+            sorted_col_ = col;
+        }
+
+        // Records that the result is only used by the operation that runs the shuffle: it is not put
+        // under the key, and every node hands its chunks to DataFrame.retire_ when it is done with it
+        void intermediate() {
+            publish_ = false;
+        }
+
+        // sends the row to the given node, the row has to have the schema of the shuffle
+        void add(Row& row, size_t node) {
+            abort_if_not(node < num_nodes_, "Shuffle.add(): node %zu out of bounds", node);
+            ChunkBuilder* builder = builders_[node];
+            builder->add(row);
+            if (builder->full()) {
+                builder->seal_into(*part_, seg_(node));
+            }
+        }
+
+        // Sends the rows that are left and waits for the rows of every other node. Returns the
+        // dataframe of all rows that were sent, owned by the caller. Node 0 puts it under the key,
+        // unless the result is intermediate.
+        DataFrame* finish() {
+            for (size_t i = 0; i < num_nodes_; i++) {
+                builders_[i]->seal_into(*part_, seg_(i));
+            }
+            // the chunks have to be stored before the other nodes read them
+            kvs_->flush_puts();
+
+            char* buf = part_->serialize();
+            Value v(part_->serial_buf_size(), buf, true);
+            Value** parts = exchange_values(kvs_, *key_, "~shuffle", v);
+
+            DataFrame* ret = new DataFrame(schema_, *key_, kvs_, *placement_, false);
+            for (size_t n = 0; n < num_nodes_; n++) {
+                DataFrame* node_part = DataFrame::deserialize(parts[n]->get(), kvs_);
+                ret->add_segs_(*node_part);
+                delete node_part;
+                delete parts[n];
+            }
+            delete[] parts;
+            ret->sorted_col_ = sorted_col_;
+            if (publish_ && node_ == 0) {
+                ret->add_self_to_kv_();
+            }
+            return ret;
+        }
+};
+
+/**
+ * PartitionRower is a subclass of Rower
+ * Sends the rows it is given through a shuffle to the node that the value of the key column
+ * hashes to. Only the given columns are sent, in the given order, so the schema of the shuffle
+ * has to have their types. The rower reads no other column, so only those are fetched.
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class PartitionRower : public Rower {
+    public:
+        Shuffle& shuffle_;  // external
+        const size_t* cols_;  // external
+        size_t num_cols_;
+        size_t key_col_;
+        Row* out_;  // owned; its strings belong to the row that is accepted
+        KeyEncoder keys_;
+
+        PartitionRower(Shuffle& shuffle, const size_t* cols, size_t num_cols, size_t key_col) : shuffle_(shuffle) {
+            cols_ = cols;
+            num_cols_ = num_cols;
+            key_col_ = key_col;
+            out_ = new Row(shuffle.schema_);
+        }
+
+        ~PartitionRower() {
+            delete out_;
+        }
+
+        bool accept(Row& r) {
+            for (size_t i = 0; i < num_cols_; i++) {
+                copy_field(*out_, i, r, cols_[i]);
+            }
+            shuffle_.add(*out_, keys_.node_of(r, &key_col_, 1, shuffle_.num_nodes_));
+            return true;
+        }
+
+        bool reads_column(size_t col) {
+            if (col == key_col_) {
+                return true;
+            }
+            for (size_t i = 0; i < num_cols_; i++) {
+                if (cols_[i] == col) {
+                    return true;
+                }
+            }
+            return false;
+        }
+};
+
+// this declaration must come after the declaration of PartitionRower
+DataFrame* DataFrame::repartition(size_t col, Key& key) {
+    abort_if_not(col < ncols(), "DataFrame.repartition(): column %zu out of bounds", col);
+    size_t* cols = new size_t[ncols()];
+    for (size_t i = 0; i < ncols(); i++) {
+        cols[i] = i;
+    }
+    Shuffle shuffle(schema_, key, kv_);
+    PartitionRower partition(shuffle, cols, ncols(), col);
+    local_map(partition);
+    DataFrame* ret = shuffle.finish();
+    delete[] cols;
+    return ret;
+}
@@ -3,45 +3,131 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "dataframe.h"
 #include "schema.h"
 #include "column.h"
+#include "field_scanner.h"
+#include "ingest.h"
+#include "shuffle.h"
 
 #include "../util/object.h"
 #include "../util/helper.h"
 
 #include "../util/config.h"
+#include "../util/thread.h"
 
 // Reads a file and determines the schema on read
+// The file is mapped into memory. Lines are found and fields are parsed straight from the
+// mapping: a field is a pointer into the mapping and a length, nothing is copied until the
+// value is converted. The fields of a line are found by a FieldScanner, every SOR has its own.
+// A SOR can read a projection of the fields of the file: the fields that are not selected are
+// skipped without being converted or stored, and only validated by the rows they are in.
 // @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
 class SOR : public Object {
     public:
-        FILE* file_;
+        char* filename_;  // owned
+        int fd_;  // -1 if the mapping is borrowed
+        const char* data_;  // the mapped file, nullptr if the file is empty
+        bool owns_map_;  // whether data_ is unmapped by this SOR
+        size_t size_;  // bytes in the file
         Key* key_;
         KVStore* kvs_;
+        Placement* placement_;  // owned; how the chunks of the dataframe are placed
+        size_t* fields_;  // owned; the fields of the file that are read, in column order, nullptr for all of them
+        size_t num_fields_;
 
-        SOR(const char* filename, Key* key, KVStore* kvs) { 
-            kvs_ = kvs;
-            key_ = key;
-            file_ = fopen(filename, "r");
-            abort_if_not(file_ != NULL, "File is null pointer");
+        FieldScanner scanner_;  // fields of the line that was scanned last, reused for every line
+
+        SOR(const char* filename, Key* key, KVStore* kvs, Placement& placement) {
+            init_(filename, key, kvs, placement.clone_empty());
+        }
+
+        SOR(const char* filename, Key* key, KVStore* kvs) {
+            init_(filename, key, kvs, Placement::round_robin(kvs->num_nodes()));
         }
 
         SOR(const char* filename, KVStore* kvs) : SOR(filename, new Key(0, filename), kvs) { }
 
+        // reads the file that mapped has mapped, without mapping it again; it has its own fields
+        // and scanner, but mapped must outlive it
+        SOR(SOR& mapped, Placement& placement) {
+            kvs_ = mapped.kvs_;
+            key_ = mapped.key_->clone();
+            placement_ = placement.clone_empty();
+            fields_ = nullptr;
+            num_fields_ = 0;
+            filename_ = duplicate(mapped.filename_);
+            fd_ = -1;
+            data_ = mapped.data_;
+            size_ = mapped.size_;
+            owns_map_ = false;
+        }
+
+        // NOTE: takes ownership of placement
+        void init_(const char* filename, Key* key, KVStore* kvs, Placement* placement) {
+            kvs_ = kvs;
+            key_ = key;
+            placement_ = placement;
+            fields_ = nullptr;
+            num_fields_ = 0;
+            filename_ = duplicate(filename);
+            fd_ = open(filename, O_RDONLY);
+            abort_if_not(fd_ >= 0, "File is null pointer");
+
+            struct stat st;
+            abort_if_not(fstat(fd_, &st) == 0, "SOR: failed to stat %s", filename);
+            size_ = st.st_size;
+            data_ = nullptr;
+            owns_map_ = true;
+            if (size_ > 0) {
+                void* mapped = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+                abort_if_not(mapped != MAP_FAILED, "SOR: failed to map %s", filename);
+                madvise(mapped, size_, MADV_SEQUENTIAL);
+                data_ = (const char*) mapped;
+            }
+        }
+
         ~SOR() {
-            fclose(file_);
+            if (owns_map_) {
+                if (data_ != nullptr) {
+                    munmap((void*) data_, size_);
+                }
+                close(fd_);
+            }
+            delete[] filename_;
             delete key_;
+            delete placement_;
+            delete[] fields_;
+        }
+
+        // Reads only the given fields of each line, column i of the dataframe is field fields[i]
+        // of the file. The fields must be in the file.
+        void select(const size_t* fields, size_t num_fields) {
+            abort_if_not(num_fields > 0, "SOR.select(): needs at least one field");
+            delete[] fields_;
+            num_fields_ = num_fields;
+            fields_ = new size_t[num_fields_];
+            memcpy(fields_, fields, num_fields_ * sizeof(size_t));
         }
-        
-        // Reads in the data from the file starting at the from byte 
+
+        // Reads in the data from the file starting at the from byte
         // and reading at most len bytes
+        // Unless the rows are segmented by placement, the lines are read, parsed and encoded into
+        // chunks on separate threads, see parse_pipelined_.
+        // The types of the columns are found while the rows are parsed, in the same pass.
         DataFrame* read(size_t from, size_t len) {
-            Schema* schema = infer_columns_(from, len);
+            Schema* schema = start_schema_(from, len);
             // don't add self to kvstore
-            DataFrame* df = new DataFrame(*schema, *key_, kvs_, false);
-            parse_(df, from, len);
+            DataFrame* df = new DataFrame(*schema, *key_, kvs_, *placement_, false);
+            if (placement_->segmented()) {
+                parse_(df, from, len);
+            } else {
+                parse_pipelined_(df, from, len, kvs_->get_config().INGEST_THREADS);
+            }
             delete schema;
             df->commit();
             return df;
@@ -52,16 +138,61 @@ class SOR : public Object {
             return read(0, Config::MAX_SIZE_T);
         }
 
-        // moves the file pointer to the start of the next line.
-        void seek_(size_t from) {
+        // reads the given fields of the whole file, see select
+        DataFrame* read_selected(const size_t* fields, size_t num_fields) {
+            select(fields, num_fields);
+            return read();
+        }
+
+        // Reads the whole file into one dataframe, every node has to call this with the same number
+        // of threads. The file is split into num_nodes * threads byte ranges; each thread of each node
+        // parses one range and puts its chunks on its own node. Returns the dataframe on every node,
+        // it is also put in the kvstore under the key of this SOR.
+        DataFrame* read_distributed(size_t threads);
+
+        // the key on node 0 that read_distributed puts the rows read by node under, owned by the caller
+        Key* ingest_key_(size_t node) {
+            String* name = key_->get_name();
+            StrBuff buf;
+            buf.c(*name);
+            buf.c("~ingest-");
+            buf.c(node);
+            String* ingest_name = buf.get();
+            Key* ret = new Key(0, ingest_name->c_str());
+            delete ingest_name;
+            delete name;
+            return ret;
+        }
+
+        // the offset of the first line that starts at or after from. A line that from falls in
+        // the middle of belongs to the reader of the bytes before from.
+        size_t line_start_(size_t from) {
             if (from == 0) {
-                fseek(file_, from, SEEK_SET);
-            } else {
-                char buf[Config::BUFF_LEN];
-                fseek(file_, from - 1, SEEK_SET);
-                char* ans = fgets(buf, Config::BUFF_LEN, file_);
-                abort_if_not(ans == buf || ans == nullptr, "Sorer.seek(): failed");
+                return 0;
+            }
+            if (from > size_) {
+                return size_;
+            }
+            const char* eol = (const char*) memchr(data_ + from - 1, '\n', size_ - (from - 1));
+            return eol == nullptr ? size_ : eol - data_ + 1;
+        }
+
+        // Finds the end of the line that starts at line: sets eol to the newline (or the end of the
+        // file) and next to the start of the line after it. len is the max bytes to read starting
+        // from the first line, total_bytes the bytes read so far. Returns false when there are no
+        // more lines to read.
+        bool next_line_(const char* line, const char*& eol, const char*& next, size_t len, size_t& total_bytes) {
+            const char* end = data_ + size_;
+            if (line >= end) {
+                return false;
             }
+            eol = (const char*) memchr(line, '\n', end - line);
+            next = eol == nullptr ? end : eol + 1;
+            if (eol == nullptr) {
+                eol = end;
+            }
+            total_bytes += next - line;
+            return total_bytes < len;
         }
 
         bool should_redefine_type_(char current_type, char inferred_type) {
@@ -70,195 +201,452 @@ class SOR : public Object {
 
         // infers and creates the column objects
         Schema* infer_columns_(size_t from, size_t len) {
-            seek_(from);
-            char buf[Config::BUFF_LEN];
+            return scan_columns_(from, len, true);
+        }
 
+        // The schema that parsing starts from: a column for each field found in the first lines,
+        // all of them BOOL. The columns are widened as the file is parsed, see ParseBatch.
+        Schema* start_schema_(size_t from, size_t len) {
+            return scan_columns_(from, len, false);
+        }
+
+        // Finds the columns in the first INFER_LINE_COUNT lines from the from byte, and their types
+        // if infer is true. Columns are BOOL otherwise, the values are not looked at.
+        Schema* scan_columns_(size_t from, size_t len, bool infer) {
+            const char* line = data_ + line_start_(from);
+            const char* eol = nullptr;
+            const char* next = nullptr;
             size_t total_bytes = 0;
             size_t row_count = 0;
 
             StrBuff col_types;
 
-            while (fgets(buf, Config::BUFF_LEN, file_) != nullptr && row_count < Config::INFER_LINE_COUNT) {
-                row_count++;
-                total_bytes += strlen(buf);
-                if (total_bytes >= len) {
-                    break;
+            // the fields after the last selected one are not looked at
+            size_t scan_fields = Config::MAX_SIZE_T;
+            if (fields_ != nullptr) {
+                scan_fields = 0;
+                for (size_t i = 0; i < num_fields_; i++) {
+                    scan_fields = fields_[i] + 1 > scan_fields ? fields_[i] + 1 : scan_fields;
                 }
-                size_t num_fields;
-                char** row = parse_row_(buf, &num_fields);
+            }
 
-                for (size_t i = 0; i < num_fields; i++) {
+            for (; row_count < Config::INFER_LINE_COUNT && next_line_(line, eol, next, len, total_bytes); line = next) {
+                row_count++;
+                size_t num_fields = scanner_.scan(line, eol, scan_fields);
 
-                    char inferred_type = infer_type(row[i]);
+                for (size_t i = 0; i < num_fields; i++) {
+                    char inferred_type = infer ? infer_type(scanner_.field(i), scanner_.field_len(i)) : BOOL;
                     if (should_redefine_type_(col_types.get(i), inferred_type)) {
                         col_types.set(i, inferred_type);
                     }
                 }
-                delete[] row;
-
             }
 
             String* schema_string = col_types.get();
+            if (fields_ != nullptr) {
+                // the columns are the selected fields, in the order they were selected
+                StrBuff selected;
+                for (size_t i = 0; i < num_fields_; i++) {
+                    abort_if_not(fields_[i] < schema_string->size(), "SOR: field %zu is not in %s", fields_[i], filename_);
+                    selected.set(i, schema_string->at(fields_[i]));
+                }
+                delete schema_string;
+                schema_string = selected.get();
+            }
             Schema* ret_val = new Schema(schema_string->c_str());
             delete schema_string;
             return ret_val;
         }
 
-        // Find the start of the field value and null terminate it.
+        // Finds the value of the field that starts at field (just after its '<') and ends before end.
+        // Returns the start of the value, or nullptr for a missing value. Sets val_len to the length
+        // of the value and stop to the char that ended it (the closing quote, '>' or ' ').
         // ASSUMPTION: input field is terminated by '>' char
-        // NOTE: will mutate the field value
-        // The value of len will be the offset of the null byte
-        char* parse_field_(char* field, int* len) {
-            char* ret = field;
-            int j = 0;
-            for (size_t i = 0; field[i] != '>'; i++) {
-                switch (field[i]) {
+        const char* scan_field_(const char* field, const char* end, size_t& val_len, const char*& stop) {
+            for (const char* c = field; c < end && *c != '>'; c++) {
+                switch (*c) {
                     case '<':  // Malformed input
                         fail("Multiple opening <");
                     case ' ': // extra space in front of field
-                        ret++;
                         break;
-                    case '"': // the start of a String
-                        ret++;
-                        j = i + 1;
-                        while (field[j] != '"') { // add every character until a end quote is met.
+                    case '"': // the start of a String, every character until the end quote
+                    {
+                        const char* start = c + 1;
+                        const char* j = start;
+                        while (j < end && *j != '"') {
+                            j++;
+                        }
+                        val_len = j - start;
+                        stop = j;
+                        return start;
+                    }
+                    default:  // every ASCII character up to the '>' or a space
+                    {
+                        const char* j = c;
+                        while (j < end && *j != '>' && *j != ' ') {
                             j++;
                         }
-                        field[j] = '\0';
-                        *len = j;
-                        return ret;
-                    default:  // add every ASCII character to field return value.
-                        for (j = i; field[j] != '>' && field[j] != ' '; j++);
-                        field[j] = '\0';
-                        *len = j;
-                        return ret;  
+                        val_len = j - c;
+                        stop = j;
+                        return c;
+                    }
                 }
             }
-            *len = 0;
+            val_len = 0;
+            stop = field;
             return nullptr;  // missing value
         }
 
+        // Scans the fields of the line from line up to eol into scanner_.
+        // Returns the number of fields.
+        size_t scan_row_(const char* line, const char* eol) {
+            return scanner_.scan(line, eol);
+        }
+
+        // Find the start of the field value and null terminate it.
+        // ASSUMPTION: input field is terminated by '>' char
+        // NOTE: will mutate the field value
+        // The value of len will be the offset of the null byte
+        char* parse_field_(char* field, int* len) {
+            size_t val_len;
+            const char* stop;
+            const char* ret = scan_field_(field, field + strlen(field), val_len, stop);
+            if (ret == nullptr) {
+                *len = 0;
+                return nullptr;  // missing value
+            }
+            field[stop - field] = '\0';
+            *len = stop - field;
+            return field + (ret - field);
+        }
+
         // parses a row and returns a list of field values as char*
         // NOTE: will mutate the row value.
         // The value of len will be the number of fields returned
         char** parse_row_(char* row, size_t *len) {
-            int cap = 16;
-            int l = 0;
-            char** output = new char*[cap];
-
-            for (size_t i = 0; row[i] != '\0'; i++) {
-                if (row[i] == '<') {
-                    int to_increment = 0;
-                    if (l >= cap) {
-                        cap*=2;
-                        char** temp = new char*[cap];
-                        for (int k = 0; k < l; k++) {
-                            temp[k] = output[k];
-                        }
-                        delete[] output;
-                        output = temp;
-                    }
-
-                    output[l++] = parse_field_(&row[i + 1], &to_increment);
-                    i = i + to_increment + 1;
+            size_t l = scan_row_(row, row + strlen(row));
+            char** output = new char*[l];
+            for (size_t i = 0; i < l; i++) {
+                output[i] = nullptr;
+                if (scanner_.field(i) != nullptr) {
+                    output[i] = row + (scanner_.field(i) - row);
+                    output[i][scanner_.field_len(i)] = '\0';
                 }
             }
-
             *len = l;
             return output;
         }
 
-
         // read the rows from the starting byte up to len bytes into Columns.
         void parse_(DataFrame* df, size_t from, size_t len) {
-            seek_(from);
-            char buf[Config::BUFF_LEN];
-            Schema schema = df->get_schema();
-            Row df_row(schema);
+            ParseBatch batch(df->get_schema(), kvs_->get_config().CHUNK_SIZE, fields_);
+            RowLines lines(df->get_placement(), df->ncols(), fields_);
+            const char* line = data_ + line_start_(from);
+            const char* eol = nullptr;
+            const char* next = nullptr;
+            size_t total_bytes = 0;
+
+            for (; next_line_(line, eol, next, len, total_bytes); line = next) {
+                add_line_(df, batch, lines, line, eol);
+            }
+            add_batch_(df, batch, lines);
+            df->commit(); // adds the latest chunks to the kvstore and adds the dataframe to the kvstore
+        }
 
+        // read the rows that start in the bytes [begin, end) into Columns. Every line belongs to
+        // exactly one range, so ranges that cover the file read every row once. The line of every
+        // row is added to lines, see RowLines.
+        void parse_range_(DataFrame* df, size_t begin, size_t end, RowLines& lines) {
+            ParseBatch batch(df->get_schema(), kvs_->get_config().CHUNK_SIZE, fields_);
+            const char* line = data_ + line_start_(begin);
+            const char* eol = nullptr;
+            const char* next = nullptr;
             size_t total_bytes = 0;
-            while (fgets(buf, Config::BUFF_LEN, file_) != nullptr) {
-                total_bytes += strlen(buf);
-                if (total_bytes >= len) {
-                    break;
-                }
 
-                size_t num_fields; 
-                // current row could have more columns than infered - parse the frist len_ columns
-                char** row = parse_row_(buf, &num_fields);
-                // skipping rows with too few fields
-                if (num_fields == 0) {
-                    delete[] row;
-                    continue;
-                }
+            for (; line < data_ + end && next_line_(line, eol, next, Config::MAX_SIZE_T, total_bytes); line = next) {
+                add_line_(df, batch, lines, line, eol);
+            }
+            add_batch_(df, batch, lines);
+        }
 
-                // we skip the row as soon as we find a field that does not match our schema
-                bool skip = false;
-                for (size_t i = 0; i < df->ncols(); i++) {
-                    if (i < num_fields && row[i] != nullptr && should_redefine_type_(schema.col_type(i), infer_type(row[i]))) {
-                        skip = true;
-                        break;
-                    }
-                }
-                if (skip) {
-                    delete[] row;
-                    continue;
-                }
+        // adds the line to the batch, the batch is added to the dataframe once it is full
+        void add_line_(DataFrame* df, ParseBatch& batch, RowLines& lines, const char* line, const char* eol) {
+            batch.add_line(line, eol);
+            if (batch.full()) {
+                add_batch_(df, batch, lines);
+            }
+        }
 
-                // add all fields in this row to columns
-                for (size_t i = 0; i < df->ncols(); i++) {
-                    if (i >= num_fields || row[i] == nullptr) {
-                        switch(schema.col_type(i)) {
-                            case BOOL:
-                                df_row.set(i, false);
-                                break;
-                            case INT:
-                                df_row.set(i, 0);
-                                break;
-                            case DOUBLE:
-                                df_row.set(i, 0.0);
-                                break;
-                            case STRING:
-                                df_row.set(i, new String(""));
-                                break;
-                            default:
-                                fail("SOR.parse(): empty value into unknown col type");    
-                        }
-                    } else {
-                        switch(schema.col_type(i)) {
-                            case BOOL:
-                            {
-                                df_row.set(i, as_bool(row[i]));
-                                break;
-                            }
-                            case INT:
-                            {
-                                df_row.set(i, as_int(row[i]));
-                                break;
-                            }
-                            case DOUBLE:
-                            {
-                                df_row.set(i, as_double(row[i]));
-                                break;
-                            }
-                            case STRING:
-                            {
-                                String* tmp = as_string(row[i]);
-                                df_row.set(i, tmp);
-                                break;
-                            }
-                            default:
-                            {
-                                fail("SOR.parse(): put value into unknown col type"); 
-                            }   
-                        }
-                    }
-                }
+        // parses the lines of the batch, adds the rows to the dataframe and empties the batch
+        void add_batch_(DataFrame* df, ParseBatch& batch, RowLines& lines) {
+            batch.parse(scanner_);
+            batch.add_rows_to(df, scanner_, lines);
+            batch.reset(df->get_schema());
+        }
+
+        // Reads the rows from the starting byte up to len bytes into the dataframe with a pipeline
+        // of threads: a LineReaderThread splits the bytes into batches of lines, parsers ParseThreads
+        // parse the batches, and this thread encodes the parsed rows into chunks in file order. The
+        // chunks are put in the background, so sending them overlaps with parsing. The stages are
+        // connected by bounded queues, and a fixed set of batches is passed around, so no stage can
+        // run ahead of the others by more than a few batches.
+        void parse_pipelined_(DataFrame* df, size_t from, size_t len, size_t parsers);
+};
+
+// ReadThread is a subclass of Thread
+// ReadThread is used by SOR.read_distributed
+// Each ReadThread parses one byte range of the file into its own segment of a LOCAL placed DataFrame
+class ReadThread : public Thread {
+    public:
+        SOR* mapped_;  // external; the SOR that mapped the file
+        Key* key_;  // external
+        KVStore* kvs_;  // external
+        Schema* schema_;  // external
+        Placement* placement_;  // external
+        const size_t* fields_;  // external; the fields to read, nullptr for all of them
+        size_t num_fields_;
+        size_t seg_;
+        size_t begin_;
+        size_t end_;
+        DataFrame* df_;  // owned, set by run
+        RowLines* lines_;  // owned, set by run; the lines of the rows of df_
+
+        ReadThread(SOR* mapped, Key* key, KVStore* kvs, Schema* schema, Placement* placement, const size_t* fields, size_t num_fields, size_t seg, size_t begin, size_t end) {
+            mapped_ = mapped;
+            fields_ = fields;
+            num_fields_ = num_fields;
+            key_ = key;
+            kvs_ = kvs;
+            schema_ = schema;
+            placement_ = placement;
+            seg_ = seg;
+            begin_ = begin;
+            end_ = end;
+            df_ = nullptr;
+            lines_ = nullptr;
+        }
+
+        ~ReadThread() {
+            delete df_;
+            delete lines_;
+        }
 
-                df->add_row(df_row, false, false); // try not to add anything to the kvstore
-                df_row.delete_strings();
-                delete[] row;
+        /** Subclass responsibility, the body of the run method */
+        virtual void run() {
+            // every thread has its own SOR, so that it has its own field buffers, the file is mapped once
+            SOR sorer(*mapped_, *placement_);
+            if (fields_ != nullptr) {
+                sorer.select(fields_, num_fields_);
             }
-            df->commit(); // adds the latest chunks to the kvstore and adds the dataframe to the kvstore
+            df_ = new DataFrame(*schema_, *key_, kvs_, *placement_, false);
+            df_->set_local_seg(seg_);
+            lines_ = new RowLines(*placement_, schema_->width(), fields_);
+            sorer.parse_range_(df_, begin_, end_, *lines_);
+            df_->commit_chunks();
         }
 };
+
+// LineReaderThread is a subclass of Thread
+// LineReaderThread is used by SOR.parse_pipelined_
+// It splits the bytes of the file that the SOR reads into batches of lines, numbered in file order
+class LineReaderThread : public Thread {
+    public:
+        SOR* sor_;  // external
+        size_t from_;
+        size_t len_;
+        Queue<ParseBatch>* free_;  // external; empty batches to fill
+        Queue<ParseBatch>* lines_;  // external; filled batches, closed once the bytes are read
+
+        LineReaderThread(SOR* sor, size_t from, size_t len, Queue<ParseBatch>* free, Queue<ParseBatch>* lines) {
+            sor_ = sor;
+            from_ = from;
+            len_ = len;
+            free_ = free;
+            lines_ = lines;
+        }
+
+        /** Subclass responsibility, the body of the run method */
+        virtual void run() {
+            const char* line = sor_->data_ + sor_->line_start_(from_);
+            const char* eol = nullptr;
+            const char* next = nullptr;
+            size_t total_bytes = 0;
+            size_t seq = 0;
+
+            ParseBatch* batch = free_->pop();
+            batch->seq_ = seq++;
+            for (; sor_->next_line_(line, eol, next, len_, total_bytes); line = next) {
+                batch->add_line(line, eol);
+                if (batch->full()) {
+                    lines_->push(batch);
+                    batch = free_->pop();
+                    batch->seq_ = seq++;
+                }
+            }
+            if (batch->num_lines_ > 0) {
+                lines_->push(batch);
+            } else {
+                free_->push(batch);
+            }
+            lines_->close();
+        }
+};
+
+// this definition must come after the declaration of LineReaderThread
+void SOR::parse_pipelined_(DataFrame* df, size_t from, size_t len, size_t parsers) {
+    abort_if_not(parsers > 0, "SOR.parse_pipelined_(): needs at least one parser");
+    // every batch is in one of the queues, being worked on, or waiting for the batches before it
+    size_t num_batches = 2 * parsers + 2;
+    Queue<ParseBatch> free(num_batches);
+    Queue<ParseBatch> lines(num_batches);
+    Queue<ParseBatch> parsed(num_batches);
+    ParseBatch** batches = new ParseBatch*[num_batches];
+    ParseBatch** waiting = new ParseBatch*[num_batches];  // parsed batches by seq, until their turn
+    for (size_t i = 0; i < num_batches; i++) {
+        batches[i] = new ParseBatch(df->get_schema(), kvs_->get_config().CHUNK_SIZE, fields_);
+        waiting[i] = nullptr;
+        free.push(batches[i]);
+    }
+
+    LineReaderThread reader(this, from, len, &free, &lines);
+    reader.start();
+    size_t running = parsers;
+    ParseThread** pool = new ParseThread*[parsers];
+    for (size_t i = 0; i < parsers; i++) {
+        pool[i] = new ParseThread(&lines, &parsed, &running);
+        pool[i]->start();
+    }
+
+    // parsers finish batches out of order, the rows are encoded in the order of the file
+    ChunkEncoder encoder(df, fields_);
+    size_t next_seq = 0;
+    ParseBatch* batch = parsed.pop();
+    while (batch != nullptr) {
+        waiting[batch->seq_ % num_batches] = batch;
+        ParseBatch* ready = waiting[next_seq % num_batches];
+        while (ready != nullptr && ready->seq_ == next_seq) {
+            waiting[next_seq % num_batches] = nullptr;
+            encoder.append(*ready);
+            ready->reset(df->get_schema());
+            free.push(ready);
+            next_seq++;
+            ready = waiting[next_seq % num_batches];
+        }
+        batch = parsed.pop();
+    }
+    encoder.finish();
+
+    reader.join();
+    for (size_t i = 0; i < parsers; i++) {
+        pool[i]->join();
+        delete pool[i];
+    }
+    kvs_->flush_puts();
+
+    for (size_t i = 0; i < num_batches; i++) {
+        delete batches[i];
+    }
+    delete[] pool;
+    delete[] waiting;
+    delete[] batches;
+}
+
+// this definition must come after the declaration of ReadThread
+// Every node puts a descriptor of the rows it read under "<name>~ingest-<node>" on node 0. Node 0
+// adds up the segments of all nodes into the descriptor of the whole dataframe and removes the
+// descriptors of the nodes. The nodes agree on the types of the columns before that, with
+// exchange_values: a column that is a string anywhere is a string in every chunk, and a thread that
+// wrote narrower values for it puts them again with the text of the file, see RowLines.
+DataFrame* SOR::read_distributed(size_t threads) {
+    abort_if_not(threads > 0, "SOR.read_distributed(): needs at least one thread");
+    size_t num_nodes = kvs_->num_nodes();
+    size_t node = kvs_->node_index();
+    size_t num_ranges = num_nodes * threads;
+
+    // every node finds the columns at the start of the file, so they all agree on them. The types
+    // are widened by each thread on its own, and then to the widest type any thread found
+    Schema* schema = start_schema_(0, Config::MAX_SIZE_T);
+    Placement* placement = Placement::local(num_nodes, threads);
+    placement->set_replicas(placement_->replicas());
+
+    ReadThread** pool = new ReadThread*[threads];
+    for (size_t t = 0; t < threads; t++) {
+        // range r of the file goes to segment r, so the rows keep the order of the file
+        size_t r = node * threads + t;
+        size_t begin = size_ / num_ranges * r;
+        size_t end = r + 1 == num_ranges ? size_ : size_ / num_ranges * (r + 1);
+        pool[t] = new ReadThread(this, key_, kvs_, schema, placement, fields_, num_fields_, r, begin, end);
+        pool[t]->start();
+    }
+
+    // the widest type of each column that any thread of any node found
+    size_t width = schema->width();
+    char* types = new char[width + 1];
+    for (size_t i = 0; i < width; i++) {
+        types[i] = schema->col_type(i);
+    }
+    types[width] = '\0';
+    for (size_t t = 0; t < threads; t++) {
+        pool[t]->join();
+        for (size_t i = 0; i < width; i++) {
+            types[i] = widen_type(types[i], pool[t]->df_->get_schema().col_type(i));
+        }
+    }
+    Value node_types(width + 1, types);
+    Value** all_types = exchange_values(kvs_, *key_, "~ingest-types", node_types);
+    for (size_t n = 0; n < num_nodes; n++) {
+        for (size_t i = 0; i < width; i++) {
+            types[i] = widen_type(types[i], all_types[n]->get()[i]);
+        }
+        delete all_types[n];
+    }
+    delete[] all_types;
+
+    // the rows this node read, described as one dataframe
+    DataFrame part(*schema, *key_, kvs_, *placement, false);
+    for (size_t t = 0; t < threads; t++) {
+        DataFrame* df = pool[t]->df_;
+        for (size_t i = 0; i < width; i++) {
+            if (types[i] == STRING && df->get_schema().col_type(i) != STRING) {
+                df->promote_column_(i, STRING);
+                pool[t]->lines_->restring(df, i, scanner_);
+            }
+        }
+        part.add_segs_(*df);
+        delete pool[t];
+    }
+    delete[] pool;
+    delete[] types;
+
+    Key* ingest_key = ingest_key_(node);
+    char* buf = part.serialize();
+    Value v(part.serial_buf_size(), buf, true);
+    kvs_->put(*ingest_key, v);
+    delete ingest_key;
+
+    DataFrame* ret = nullptr;
+    if (node == 0) {
+        // combine what every node read, node n only has rows in its own segments
+        ret = new DataFrame(*schema, *key_, kvs_, *placement, false);
+        for (size_t n = 0; n < num_nodes; n++) {
+            Key* node_key = ingest_key_(n);
+            Value* node_val = kvs_->getAndWait(*node_key);
+            DataFrame* node_part = DataFrame::deserialize(node_val->get(), kvs_);
+            ret->add_segs_(*node_part);
+            delete node_part;
+            delete node_val;
+            // every node has put its descriptor by now, it is not needed once it is merged
+            kvs_->remove(*node_key);
+            delete node_key;
+        }
+        ret->add_self_to_kv_();
+    } else {
+        Value* df_val = kvs_->getAndWait(*key_);
+        ret = DataFrame::deserialize(df_val->get(), kvs_);
+        delete df_val;
+    }
+
+    delete placement;
+    delete schema;
+    return ret;
+}
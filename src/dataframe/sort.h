@@ -0,0 +1,248 @@
+//lang:Cpp
+#pragma once
+
+#include <algorithm>
+
+#include "row.h"
+#include "schema.h"
+#include "dataframe.h"
+#include "shuffle.h"
+
+#include "../util/object.h"
+#include "../util/array.h"
+#include "../util/thread.h"
+#include "../util/config.h"
+
+#include "../kvstore/keyvalue.h"
+
+// orders rows by the value in one column, for std::sort
+class RowOrder : public Object {
+    public:
+        size_t col_;
+
+        RowOrder(size_t col) {
+            col_ = col;
+        }
+
+        bool operator()(Row* a, Row* b) {
+            return a->compare_field(col_, *b, col_) < 0;
+        }
+};
+
+/**
+ * RowCollector is a subclass of Rower
+ * Keeps a copy of every row it is given, with its strings.
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class RowCollector : public Rower {
+    public:
+        Schema& schema_;  // external
+        Array<Row> rows_;  // owns the rows and their strings
+
+        RowCollector(Schema& schema) : schema_(schema), rows_() { }
+
+        ~RowCollector() {
+            for (size_t i = 0; i < rows_.size(); i++) {
+                rows_.get(i)->delete_strings();
+                delete rows_.get(i);
+            }
+        }
+
+        bool accept(Row& r) {
+            Row* copy = new Row(schema_);
+            CopyRowFielder f(*copy);
+            r.visit(r.get_idx(), f);
+            rows_.push_back(copy);
+            return true;
+        }
+
+        size_t size() {
+            return rows_.size();
+        }
+
+        // the rows, in the order they were collected until sorted
+        Row** rows() {
+            return rows_.values_;
+        }
+};
+
+/**
+ * SampleRower is a subclass of Rower
+ * Sends every stride-th value of the sort column through a shuffle to this node, the shuffle
+ * has a single column of the type of the sort column.
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class SampleRower : public Rower {
+    public:
+        Shuffle& shuffle_;  // external
+        size_t col_;
+        size_t stride_;
+        size_t seen_;
+        Row* out_;  // owned; its string belongs to the row that is accepted
+
+        SampleRower(Shuffle& shuffle, size_t col, size_t stride) : shuffle_(shuffle) {
+            col_ = col;
+            stride_ = stride;
+            seen_ = 0;
+            out_ = new Row(shuffle.schema_);
+        }
+
+        ~SampleRower() {
+            delete out_;
+        }
+
+        bool accept(Row& r) {
+            if (seen_++ % stride_ == 0) {
+                copy_field(*out_, 0, r, col_);
+                shuffle_.add(*out_, shuffle_.node_);
+            }
+            return true;
+        }
+
+        bool reads_column(size_t col) {
+            return col == col_;
+        }
+};
+
+/**
+ * RangePartitionRower is a subclass of Rower
+ * Sends the rows it is given through a shuffle to the node whose range their value in the sort
+ * column falls in. Node n gets the values from splitter n - 1 up to, but not including, splitter n.
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class RangePartitionRower : public Rower {
+    public:
+        Shuffle& shuffle_;  // external
+        size_t col_;
+        Row** splitters_;  // external; one field rows in ascending order
+        size_t num_splitters_;
+
+        RangePartitionRower(Shuffle& shuffle, size_t col, Row** splitters, size_t num_splitters) : shuffle_(shuffle) {
+            col_ = col;
+            splitters_ = splitters;
+            num_splitters_ = num_splitters;
+        }
+
+        // the number of splitters that are at most the value of the row
+        size_t node_of(Row& r) {
+            size_t lo = 0;
+            size_t hi = num_splitters_;
+            while (lo < hi) {
+                size_t mid = lo + (hi - lo) / 2;
+                if (r.compare_field(col_, *splitters_[mid], 0) >= 0) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            return lo;
+        }
+
+        bool accept(Row& r) {
+            shuffle_.add(r, node_of(r));
+            return true;
+        }
+};
+
+// SortRunThread is a subclass of Thread
+// Each SortRunThread sorts one run of the rows of a node
+class SortRunThread : public Thread {
+    public:
+        Row** rows_;  // external
+        size_t start_;
+        size_t end_;
+        size_t col_;
+
+        SortRunThread(Row** rows, size_t start, size_t end, size_t col) {
+            rows_ = rows;
+            start_ = start;
+            end_ = end;
+            col_ = col;
+        }
+
+        /** Subclass responsibility, the body of the run method */
+        virtual void run() {
+            std::sort(rows_ + start_, rows_ + end_, RowOrder(col_));
+        }
+};
+
+// sorts the rows by col, runs of them are sorted in parallel and then merged
+inline void sort_rows(Row** rows, size_t len, size_t col) {
+    size_t threads = len < Config::SORT_THREADS ? 1 : Config::SORT_THREADS;
+    size_t* bounds = new size_t[threads + 1];
+    SortRunThread** pool = new SortRunThread*[threads];
+    for (size_t i = 0; i <= threads; i++) {
+        bounds[i] = len * i / threads;
+    }
+    for (size_t i = 0; i < threads; i++) {
+        pool[i] = new SortRunThread(rows, bounds[i], bounds[i + 1], col);
+        pool[i]->start();
+    }
+    for (size_t i = 0; i < threads; i++) {
+        pool[i]->join();
+        delete pool[i];
+    }
+    for (size_t i = 1; i < threads; i++) {
+        std::inplace_merge(rows, rows + bounds[i], rows + bounds[i + 1], RowOrder(col));
+    }
+    delete[] pool;
+    delete[] bounds;
+}
+
+// this declaration must come after the declaration of RangePartitionRower
+DataFrame* DataFrame::sort_by(size_t col, Key& key) {
+    abort_if_not(col < ncols(), "DataFrame.sort_by(): column %zu out of bounds", col);
+    size_t num_nodes = kv_->num_nodes();
+    size_t node = kv_->node_index();
+
+    // every node samples about SORT_SAMPLES values per range from its rows
+    size_t local_rows = nrows() / num_nodes;
+    size_t stride = local_rows / (Config::SORT_SAMPLES * num_nodes);
+    stride = stride > 0 ? stride : 1;
+    char sample_type[2] = {schema_.col_type(col), '\0'};
+    Schema sample_schema(sample_type);
+    Key* samples_key = suffixed_key(kv_, key, "~samples");
+    Shuffle sample_shuffle(sample_schema, *samples_key, kv_);
+    sample_shuffle.intermediate();
+    SampleRower sampler(sample_shuffle, col, stride);
+    local_map(sampler);
+    DataFrame* samples = sample_shuffle.finish();
+
+    // every node sees the same samples, so they pick the same splitters
+    RowCollector sampled(sample_schema);
+    samples->map(sampled);
+    samples->retire_();
+    sort_rows(sampled.rows(), sampled.size(), 0);
+    size_t num_splitters = sampled.size() > 0 ? num_nodes - 1 : 0;
+    Row** splitters = new Row*[num_nodes];
+    for (size_t i = 0; i < num_splitters; i++) {
+        splitters[i] = sampled.rows()[(i + 1) * sampled.size() / num_nodes];
+    }
+
+    Key* ranges_key = suffixed_key(kv_, key, "~ranges");
+    Shuffle range_shuffle(schema_, *ranges_key, kv_);
+    range_shuffle.intermediate();
+    RangePartitionRower partition(range_shuffle, col, splitters, num_splitters);
+    local_map(partition);
+    DataFrame* ranges = range_shuffle.finish();
+
+    RowCollector local(schema_);
+    ranges->local_map(local);
+    ranges->retire_();
+    sort_rows(local.rows(), local.size(), col);
+
+    // node n keeps the n-th range, so the rows of the result are in order node by node
+    Shuffle result(schema_, key, kv_);
+    result.sorted_by(col);
+    for (size_t i = 0; i < local.size(); i++) {
+        result.add(*local.rows()[i], node);
+    }
+    DataFrame* ret = result.finish();
+
+    delete ranges;
+    delete ranges_key;
+    delete[] splitters;
+    delete samples;
+    delete samples_key;
+    return ret;
+}
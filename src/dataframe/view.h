@@ -0,0 +1,228 @@
+//lang:Cpp
+#pragma once
+
+#include "row.h"
+#include "schema.h"
+#include "column.h"
+#include "dataframe.h"
+#include "shuffle.h"
+#include "group_by.h"
+#include "join.h"
+#include "plan.h"
+
+#include "../util/object.h"
+#include "../util/array.h"
+
+#include "../kvstore/keyvalue.h"
+
+// the rows from row to the end of the chunk of df that holds row
+inline size_t chunk_rows_from(DataFrame& df, size_t row) {
+    Column* first = df.cols_[0];
+    size_t chunk_idx, offset;
+    first->locate_(row, chunk_idx, offset);
+    return first->get_placement().chunk_rows(chunk_idx, first->size(), df.kv_->get_config().CHUNK_SIZE) - offset;
+}
+
+// The rows of one chunk of a dataframe that a FrameView keeps. The chunk is found by its segment and
+// position in it rather than by its row, so the selection still holds when rows are appended to
+// an earlier segment, see Placement.seg_pos
+class ChunkSelection : public Object {
+    public:
+        size_t seg_;  // the segment of the chunk
+        size_t seg_offset_;  // the position in seg_ that the offsets count from
+        size_t* rows_;  // owned; offsets of the kept rows from seg_offset_, ascending
+        size_t len_;
+
+        ChunkSelection(size_t seg, size_t seg_offset, const size_t* rows, size_t len) {
+            seg_ = seg;
+            seg_offset_ = seg_offset;
+            len_ = len;
+            rows_ = new size_t[len > 0 ? len : 1];
+            memcpy(rows_, rows, len * sizeof(size_t));
+        }
+
+        ~ChunkSelection() {
+            delete[] rows_;
+        }
+};
+
+/**
+ * The rows of a dataframe that a filter kept, without copying them: for every chunk of the
+ * dataframe that has such rows, the offsets of the rows in it. map, local_map, group_by and join
+ * read the rows from the chunks of the dataframe, so nothing is put in the kvstore until
+ * materialize is called. A view is built by DataFrame.filter_view, local_filter_view or
+ * where_view and must not outlive its dataframe.
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class FrameView : public Object {
+    public:
+        DataFrame& df_;  // external
+        KVStore* kv_;  // external
+        Array<ChunkSelection> chunks_;  // owns the selections, in the order of their rows
+        bool local_;  // whether only the chunks stored on this node were filtered
+        size_t nrows_;
+
+        FrameView(DataFrame& df, bool local) : df_(df), chunks_() {
+            kv_ = df.kv_;
+            local_ = local;
+            nrows_ = 0;
+        }
+
+        ~FrameView() {
+            for (size_t i = 0; i < chunks_.size(); i++) {
+                delete chunks_.get(i);
+            }
+        }
+
+        // keeps the rows first_row + rows[i], which have to come after the rows kept so far and be
+        // in the chunk that holds first_row
+        void add_chunk(size_t first_row, const size_t* rows, size_t len) {
+            if (len == 0) {
+                return;
+            }
+            size_t seg, seg_offset;
+            df_.cols_[0]->get_placement().seg_pos(first_row, seg, seg_offset);
+            chunks_.push_back(new ChunkSelection(seg, seg_offset, rows, len));
+            nrows_ += len;
+        }
+
+        // the row of the dataframe that the offsets of the selection count from
+        size_t first_row_(ChunkSelection* sel) {
+            return df_.cols_[0]->get_placement().row_of(sel->seg_, sel->seg_offset_);
+        }
+
+        /** The number of rows the view keeps. */
+        size_t nrows() {
+            return nrows_;
+        }
+
+        size_t ncols() {
+            return df_.ncols();
+        }
+
+        Schema& get_schema() {
+            return df_.get_schema();
+        }
+
+        // shows the kept rows of the given selection to r, only the columns in cols are filled in
+        void visit_(ChunkSelection* sel, Rower& r, Row& row, const bool* cols) {
+            size_t first = first_row_(sel);
+            for (size_t i = 0; i < sel->len_; i++) {
+                df_.fill_row(first + sel->rows_[i], row, cols);
+                r.accept(row);
+                row.delete_strings();
+            }
+        }
+
+        /** Visits the kept rows in order, only the columns that the rower reads are fetched. */
+        void map(Rower& r) {
+            bool* cols = df_.columns_read_by_(r);
+            Row row(df_.get_schema());
+            for (size_t i = 0; i < chunks_.size(); i++) {
+                visit_(chunks_.get(i), r, row, cols);
+            }
+            delete[] cols;
+        }
+
+        /** Visits the kept rows that are stored on this node. */
+        void local_map(Rower& r) {
+            if (chunks_.size() == 0) {
+                return;
+            }
+            bool* cols = df_.columns_read_by_(r);
+            Row row(df_.get_schema());
+            size_t start = 0;
+            size_t end = 0;
+            size_t next = 0;
+            while (next < chunks_.size() && df_.cols_[0]->get_next_local_rows(start, end)) {
+                while (next < chunks_.size() && first_row_(chunks_.get(next)) < start) {
+                    next++;
+                }
+                while (next < chunks_.size() && first_row_(chunks_.get(next)) < end) {
+                    visit_(chunks_.get(next), r, row, cols);
+                    next++;
+                }
+            }
+            delete[] cols;
+        }
+
+        /** Copies the kept rows into a dataframe under the given key. A view of the local chunks
+         *  keeps its rows on the node that has them, every node has to call this for it. */
+        DataFrame* materialize(Key& key) {
+            if (local_) {
+                Shuffle result(df_.get_schema(), key, kv_);
+                CollectRower collector(result);
+                local_map(collector);
+                return result.finish();
+            }
+            DataFrame* ret = new DataFrame(df_, key);
+            Row row(df_.get_schema());
+            for (size_t i = 0; i < chunks_.size(); i++) {
+                ChunkSelection* sel = chunks_.get(i);
+                size_t first = first_row_(sel);
+                for (size_t j = 0; j < sel->len_; j++) {
+                    df_.fill_row(first + sel->rows_[j], row);
+                    ret->add_row(row, false, false);
+                    row.delete_strings();
+                }
+            }
+            ret->commit();
+            return ret;
+        }
+
+        /** Like DataFrame.group_by over the kept rows. Every node has to call this. */
+        DataFrame* group_by(const size_t* key_cols, size_t num_keys, Aggregate* aggs, size_t num_aggs, Key& key) {
+            Schema* out = group_by_schema(df_.get_schema(), key_cols, num_keys, aggs, num_aggs);
+            GroupByRower local(key_cols, num_keys, aggs, num_aggs, *out);
+            local_map(local);
+            DataFrame* ret = merge_groups(local, key, kv_);
+            delete out;
+            return ret;
+        }
+
+        /** Like DataFrame.join with the kept rows as the left side. Every node has to call this. */
+        DataFrame* join(DataFrame& other, size_t left_col, size_t right_col, const size_t* left_cols, size_t num_left,
+                const size_t* right_cols, size_t num_right, Key& key) {
+            return hash_join(*this, other, left_col, right_col, left_cols, num_left, right_cols, num_right, key);
+        }
+
+        DataFrame* join(DataFrame& other, size_t left_col, size_t right_col, Key& key) {
+            return hash_join(*this, other, left_col, right_col, key);
+        }
+};
+
+// this declaration must come after the declaration of FrameView
+FrameView* DataFrame::filter_view_(Rower& r, bool local) {
+    FrameView* view = new FrameView(*this, local);
+    if (ncols() == 0 || nrows() == 0) {
+        return view;
+    }
+    bool* cols = columns_read_by_(r);
+    Row row(schema_);
+    size_t* sel = new size_t[kv_->get_config().CHUNK_SIZE];
+    size_t start = 0;
+    size_t end = local ? 0 : nrows();
+    while (!local || cols_[0]->get_next_local_rows(start, end)) {
+        // one selection per chunk, the rows are only looked at, not copied
+        size_t first = start;
+        while (first < end) {
+            size_t rows = chunk_rows_from(*this, first);
+            size_t len = 0;
+            for (size_t i = 0; i < rows; i++) {
+                fill_row(first + i, row, cols);
+                if (r.accept(row)) {
+                    sel[len++] = i;
+                }
+                row.delete_strings();
+            }
+            view->add_chunk(first, sel, len);
+            first += rows;
+        }
+        if (!local) {
+            break;
+        }
+    }
+    delete[] sel;
+    delete[] cols;
+    return view;
+}
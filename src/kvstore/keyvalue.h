@@ -1,93 +1,173 @@
 //lang::CwC
 #pragma once
 
+#include <stdint.h>
+
 #include "../util/object.h"
 #include "../util/string.h"
 
+enum KeyKind {
+    NAMED_KEY = 'N',  // user level key, identified by a String
+    CHUNK_KEY = 'C'   // column chunk key, identified by a column id and a chunk index
+};
+
 /*
-* A key is associates a String with a node index where the data is located
+* A key is associates a String with a node index where the data is located.
+* Chunk keys are a compact fixed size form (column id, chunk index, node index) that
+* do not allocate a String and hash in O(1). They are used for column chunks, named keys
+* are used for everything that a user can name.
 * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
 */
 class Key : public Object {
     public:
         size_t node_index_;  // the node where the value is stored
-        String* key_; // owned
+        String* key_; // owned, nullptr for chunk keys
+        size_t col_id_;  // only used by chunk keys
+        size_t chunk_idx_;  // only used by chunk keys
 
         Key(const char* key) : Key(0, key) {}
 
         Key(size_t node_index, const char* key) {
             node_index_ = node_index;
             key_ = new String(key);
+            col_id_ = 0;
+            chunk_idx_ = 0;
+        }
+
+        // builds a chunk key
+        Key(size_t node_index, size_t col_id, size_t chunk_idx) {
+            node_index_ = node_index;
+            key_ = nullptr;
+            col_id_ = col_id;
+            chunk_idx_ = chunk_idx;
         }
 
         ~Key() {
             delete key_;
         }
 
+        // returns a 64 bit FNV-1a hash of the given name, used as the id of a column in chunk keys
+        static size_t name_id(const char* name) {
+            uint64_t h = 14695981039346656037ULL;
+            for (size_t i = 0; name[i] != '\0'; i++) {
+                h ^= (unsigned char) name[i];
+                h *= 1099511628211ULL;
+            }
+            return (size_t) h;
+        }
+
+        bool is_chunk() {
+            return key_ == nullptr;
+        }
+
+        // returns the name of this key, chunk keys are named <col_id>:0x<chunk_idx>
         String* get_name() {
+            if (is_chunk()) {
+                char buf[3 * (2 * sizeof(size_t) + 3)];
+                snprintf(buf, sizeof(buf), "0x%zX:0x%zX", col_id_, chunk_idx_);
+                return new String(buf);
+            }
             return key_->clone();
         }
 
         size_t get_index() {
             return node_index_;
         }
-        
-        bool equals(Object* other) {
-            Key* k = dynamic_cast<Key*>(other);
-            if (k == nullptr) {
+
+        size_t get_col_id() {
+            return col_id_;
+        }
+
+        size_t get_chunk_idx() {
+            return chunk_idx_;
+        }
+
+        // used by the KVStore map, does not need a dynamic_cast
+        bool equals(Key* k) {
+            if (k == nullptr || node_index_ != k->node_index_ || is_chunk() != k->is_chunk()) {
                 return false;
             }
-            return key_->equals(k->key_) && node_index_ == k->node_index_;
+            if (is_chunk()) {
+                return col_id_ == k->col_id_ && chunk_idx_ == k->chunk_idx_;
+            }
+            return key_->equals(k->key_);
+        }
+        
+        bool equals(Object* other) {
+            return equals(dynamic_cast<Key*>(other));
         }
 
         size_t hash() {
+            if (is_chunk()) {
+                // mix the three fields, no need to look at any string
+                size_t h = col_id_ ^ (chunk_idx_ * 0x9E3779B97F4A7C15ULL);
+                h ^= (h >> 29) + (node_index_ << 2);
+                return h;
+            }
             return (key_->hash() << 2) + node_index_;
         }
 
         Key* clone() {
+            if (is_chunk()) {
+                return new Key(node_index_, col_id_, chunk_idx_);
+            }
             return new Key(node_index_, key_->c_str());
         }
 
         // Prints this key to stdout.
         void print() {
-            pln(key_->c_str());
+            String* name = get_name();
+            pln(name->c_str());
+            delete name;
         }
 
         // returns the size of the buffer needed to serialize this object
         size_t serial_buf_size() {
-            return sizeof(size_t) + key_->size() + 1;
+            if (is_chunk()) {
+                return 1 + 3 * sizeof(size_t);
+            }
+            return 1 + sizeof(size_t) + key_->size() + 1;
         }
 
         // Serialize this key into the given buffer. This assumes that there is enough
         // space in the buffer. 
-        // @returns: <node_index><null terminated key string>
+        // @returns: <kind><node_index><null terminated key string> or
+        //           <kind><node_index><col_id><chunk_idx> for chunk keys
         char* serialize(char* buf) {
-            memcpy(buf, &node_index_, sizeof(size_t));
-            memcpy(buf + sizeof(size_t), key_->c_str(), key_->size() + 1); 
+            buf[0] = is_chunk() ? CHUNK_KEY : NAMED_KEY;
+            memcpy(buf + 1, &node_index_, sizeof(size_t));
+            if (is_chunk()) {
+                memcpy(buf + 1 + sizeof(size_t), &col_id_, sizeof(size_t));
+                memcpy(buf + 1 + 2 * sizeof(size_t), &chunk_idx_, sizeof(size_t));
+            } else {
+                memcpy(buf + 1 + sizeof(size_t), key_->c_str(), key_->size() + 1); 
+            }
             return buf;
         }
 
         // returns a char* that holds bytes that represent this Key object.
-        // @returns: <node_index><null terminated key string>
         char* serialize() {
             char* buf = new char[serial_buf_size()];
             return serialize(buf);
         }
 
         // deserialize the char* buffer into a Key object 
-        // assumes that buf is long enough and is in the format of 
-        // <node_index><null terminated key string>
+        // assumes that buf is long enough and is in the format written by serialize
         static Key* deserialize(const char* buf) {
             size_t node_index = 0;
-            memcpy(&node_index, buf, sizeof(size_t));
+            memcpy(&node_index, buf + 1, sizeof(size_t));
 
-            size_t name_len = strlen(buf + sizeof(size_t)) + 1;
-            char* name = new char[name_len];
-            memcpy(name, buf + sizeof(size_t), name_len); 
+            if (buf[0] == CHUNK_KEY) {
+                size_t col_id, chunk_idx;
+                memcpy(&col_id, buf + 1 + sizeof(size_t), sizeof(size_t));
+                memcpy(&chunk_idx, buf + 1 + 2 * sizeof(size_t), sizeof(size_t));
+                return new Key(node_index, col_id, chunk_idx);
+            }
 
-            Key* ret = new Key(node_index, name);
-            delete[] name;
-            return ret;
+            if (buf[0] != NAMED_KEY) {
+                fail("Key.deserialize(): unknown key kind %d", buf[0]);
+            }
+            return new Key(node_index, buf + 1 + sizeof(size_t));
         }
 };
 
@@ -97,11 +177,13 @@ class Key : public Object {
 */
 class Value : public Object {
     public: 
-        char* val_;  // owned
+        char* val_;  // owned, unless the value was borrowed
         size_t bytes_;
+        bool owned_;  // is val_ deleted with this value?
 
         Value(size_t bytes, char* val, bool steal) {
             bytes_ = bytes;
+            owned_ = true;
             if (steal) {
                 val_ = val;
             } else {
@@ -117,7 +199,17 @@ class Value : public Object {
         }
 
         ~Value() {
-            delete[] val_;
+            if (owned_) {
+                delete[] val_;
+            }
+        }
+
+        // wraps bytes that are owned by someone else (e.g. a mapped file) without copying them,
+        // the bytes must outlive the returned value. Clones of the returned value own their bytes.
+        static Value* borrow(size_t bytes, char* val) {
+            Value* ret = new Value(bytes, val, true);
+            ret->owned_ = false;
+            return ret;
         }
 
         char* get() {
@@ -175,16 +267,19 @@ class KeyBuff : public Object {
     public:
         String* base_;
         size_t node_index_;
+        size_t base_id_;  // id of the base name used for chunk keys
 
         KeyBuff(Key* k) {
             base_ = k->get_name();
             node_index_ = k->get_index();
+            base_id_ = Key::name_id(base_->c_str());
             delete k;
         } 
 
         KeyBuff(String* k) {
             base_ = k->clone();
             node_index_ = 0;
+            base_id_ = Key::name_id(base_->c_str());
         }
 
         ~KeyBuff() {
@@ -211,6 +306,15 @@ class KeyBuff : public Object {
             return get(buf);
         }
 
+        // returns a compact chunk key for the given chunk of this base name
+        Key* get_chunk(size_t chunk_idx) {
+            return new Key(node_index_, base_id_, chunk_idx);
+        }
+
+        size_t get_base_id() {
+            return base_id_;
+        }
+
         size_t base_size() {
             return base_->size();
         }
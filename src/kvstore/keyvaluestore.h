@@ -4,14 +4,26 @@
 #include "network.h"
 #include "../util/map.h"
 #include "keyvalue.h"
+#include "spill.h"
 
 #include "../util/object.h"
 #include "../util/string.h"
 #include "../util/config.h"
+#include "../util/queue.h"
+#include "../util/thread.h"
 
 #include <pthread.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 class KVStore;
+
+// first bytes of every snapshot file
+static const char* SNAPSHOT_MAGIC = "EAU2SNAP";
+static const size_t SNAPSHOT_MAGIC_LEN = 8;
 /**
  * This is a message handler for the Key Value store. It can handle get and put requests
  * to the Key value store. 
@@ -32,11 +44,66 @@ class KVStoreMessageHandler : public MessageHandler {
         Response* handle_get(sockaddr_in server, size_t data_len, char* data);
         Response* handle_get_and_wait(sockaddr_in server, size_t data_len, char* data);
         Response* handle_put(sockaddr_in server, size_t data_len, char* data);
+        Response* handle_exec(sockaddr_in server, size_t data_len, char* data);
+};
+
+/**
+ * Runs the work that other nodes send to this node with KVStore.exec. The store only moves the
+ * request and the result between nodes, what the work is is up to the layer above it.
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class Executor : public Object {
+    public:
+        // runs the request of len bytes and returns its result, owned by the caller
+        virtual Value* execute(const char* request, size_t len) = 0;
+};
+
+// a put that was handed to KVStore.put_async and has not been sent yet
+class PendingPut : public Object {
+    public:
+        Key* key_;  // owned
+        Value* value_;  // owned
+
+        PendingPut(Key* key, Value* value) {
+            key_ = key;
+            value_ = value;
+        }
+
+        ~PendingPut() {
+            delete key_;
+            delete value_;
+        }
+};
+
+// PutThread is a subclass of Thread
+// PutThreads send the puts that were queued by KVStore.put_async, one at a time from their own
+// outbox, so a node never has more than one put in flight to another node
+class PutThread : public Thread {
+    public:
+        KVStore* kvs_;  // external
+        Queue<PendingPut>* outbox_;  // external
+
+        PutThread(KVStore* kvs, Queue<PendingPut>* outbox) {
+            kvs_ = kvs;
+            outbox_ = outbox;
+        }
+
+        /** Subclass responsibility, the body of the run method */
+        virtual void run();
 };
 
 /**
  * This is a mapping between Key and Value objects. This Key Value store can access other
  * KVStores that are on the same network.
+ *
+ * When a memory budget is set, the least recently used local values are spilled to segment
+ * files on local disk once the values in memory take more than the budget, and are faulted
+ * back in when they are used again. Local values are then returned as copies, because the
+ * value in the map may be spilled at any time. The copy on disk of a value that is replaced
+ * or removed is dropped, see SpillFile.release.
+ *
+ * The local values can be written to a snapshot file and read back in when the node
+ * starts again. A node with SNAPSHOT_DIR in its config restores its snapshot on startup.
  * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
  */
 class KVStore : public Object {
@@ -45,8 +112,32 @@ class KVStore : public Object {
         bool server_; 
         
         // map of local Key -> Value
-        Map<Key, Value> map_;
-        pthread_mutex_t lock_; // this locks the map of local values
+        Map<Key, StoredValue> map_;
+        pthread_mutex_t lock_; // this locks the map of local values, everything spill related and the executor
+
+        size_t budget_;  // max bytes of values kept in memory, 0 is unlimited
+        size_t resident_bytes_;  // bytes of values in memory
+        size_t use_clock_;  // incremented on every use of a local value
+        SpillFile* spill_;  // owned, nullptr until the first value is spilled
+        size_t spills_;  // number of values spilled to disk
+        size_t faults_;  // number of values faulted back in from disk
+        bool restored_;  // were the local values restored from a snapshot on startup?
+
+        // puts that are sent in the background, see put_async. The puts to node n wait in outbox
+        // n % Config::PUT_THREADS and are sent by the sender of that outbox
+        Queue<PendingPut>** outboxes_;  // owned, nullptr when no puts are in flight
+        PutThread** senders_;  // owned, Config::PUT_THREADS of them while outboxes_ is set
+        pthread_mutex_t outbox_lock_;  // locks outboxes_ and senders_
+        
+        Executor* executor_;  // owned, runs the work shipped to this node, nullptr until it is set
+        size_t executor_wait_;  // seconds that work shipped to this node waits for executor_ to be set
+
+        // the first byte of the response to work shipped to a node, see KVStore.exec
+        static const char EXEC_OK = 1;  // the result of the work follows
+        static const char EXEC_NO_EXECUTOR = 0;  // the node had no executor to run the work
+
+        size_t exchange_ids_;  // the number of ids handed out by next_exchange_id
+        Array<Key>* retired_;  // owned with its keys; local keys that are removed by remove_retired
         
         size_t node_index_;
 
@@ -59,6 +150,20 @@ class KVStore : public Object {
         KVStore(bool server) : map_(), config_() {
             abort_if_not(pthread_mutex_init(&lock_, NULL) == 0, "KVStore: Failed to create mutex");
             server_ = server;
+            budget_ = config_.MEMORY_BUDGET;
+            resident_bytes_ = 0;
+            use_clock_ = 0;
+            spill_ = nullptr;
+            spills_ = 0;
+            faults_ = 0;
+            restored_ = false;
+            outboxes_ = nullptr;
+            senders_ = nullptr;
+            abort_if_not(pthread_mutex_init(&outbox_lock_, NULL) == 0, "KVStore: Failed to create mutex");
+            executor_ = nullptr;
+            executor_wait_ = Config::EXECUTOR_WAIT;
+            exchange_ids_ = 0;
+            retired_ = new Array<Key>();
             
             if (server_) {
                 // this is to have a value to compare to and check that it has been set before continuing
@@ -73,12 +178,24 @@ class KVStore : public Object {
                 client_ = nullptr;
                 node_index_ = 0;
             }
+
+            if (config_.SNAPSHOT_DIR[0] != '\0') {
+                restored_ = restore(config_.SNAPSHOT_DIR);
+            }
         }
 
         ~KVStore() {
+            flush_puts();
+            pthread_mutex_destroy(&outbox_lock_);
             lock_map();
             // delete all keys and values in the map  -- map_.size() should be 0
             map_.delete_and_clear_items();
+            delete spill_;
+            delete executor_;
+            for (size_t i = 0; i < retired_->size(); i++) {
+                delete retired_->get(i);
+            }
+            delete retired_;
 
             if (server_) {  
                 delete client_->get_message_handler();
@@ -119,6 +236,224 @@ class KVStore : public Object {
             }
         }
 
+        // sets the number of bytes of values that are kept in memory, 0 is unlimited
+        void set_memory_budget(size_t budget) {
+            lock_map();
+            budget_ = budget;
+            evict_(nullptr);
+            unlock_map();
+        }
+
+        size_t memory_budget() {
+            return budget_;
+        }
+
+        // number of bytes of local values that are in memory
+        size_t resident_bytes() {
+            return resident_bytes_;
+        }
+
+        // number of times a value was spilled to disk
+        size_t spill_count() {
+            return spills_;
+        }
+
+        // number of times a spilled value was read back from disk
+        size_t fault_count() {
+            return faults_;
+        }
+
+        // number of bytes in the spill files of this node
+        size_t spilled_bytes() {
+            lock_map();
+            size_t ret = spill_ == nullptr ? 0 : spill_->disk_bytes();
+            unlock_map();
+            return ret;
+        }
+
+        // Forgets the copy on disk of a value that is about to be replaced or removed, so that its
+        // segment can be deleted once nothing in it is in use. The caller must hold the lock.
+        void drop_spilled_(StoredValue* stored) {
+            if (stored->on_disk_) {
+                spill_->release(stored->seg_, stored->bytes_);
+                stored->on_disk_ = false;
+            }
+        }
+
+        // Returns the value of the stored value, faulting it back in if it was spilled. The caller
+        // must hold the lock. The returned value is owned by the caller if owned is set to true.
+        Value* use_(StoredValue* stored, bool& owned) {
+            stored->last_use_ = ++use_clock_;
+            if (!stored->resident()) {
+                stored->value_ = spill_->read(stored->seg_, stored->offset_, stored->bytes_);
+                resident_bytes_ += stored->bytes_;
+                faults_++;
+                evict_(stored);
+            }
+            if (budget_ == 0) {
+                owned = false;
+                return stored->value_;
+            }
+            owned = true;
+            return stored->value_->clone();
+        }
+
+        // Spills the least recently used values other than keep until the values in memory fit
+        // well under the budget, so the next few puts do not have to spill again. The caller
+        // must hold the lock.
+        void evict_(StoredValue* keep) {
+            if (budget_ == 0 || resident_bytes_ <= budget_) {
+                return;
+            }
+            size_t target = budget_ - budget_ / 4;
+            size_t num = map_.size();
+            StoredValue** values = map_.values();
+            qsort(values, num, sizeof(StoredValue*), StoredValue::compare_last_use);
+
+            for (size_t i = 0; i < num && resident_bytes_ > target; i++) {
+                StoredValue* stored = values[i];
+                if (stored == keep || !stored->resident()) {
+                    continue;
+                }
+                if (!stored->on_disk_) {
+                    if (spill_ == nullptr) {
+                        spill_ = new SpillFile(config_.SPILL_DIR);
+                    }
+                    spill_->append(*stored->value_, stored->seg_, stored->offset_);
+                    stored->on_disk_ = true;
+                }
+                delete stored->value_;
+                stored->value_ = nullptr;
+                resident_bytes_ -= stored->bytes_;
+                spills_++;
+            }
+            delete[] values;
+        }
+
+        // the snapshot file of this node in dir, returned name is owned by the caller
+        char* snapshot_name_(const char* dir) {
+            size_t len = strlen(dir) + 64;
+            char* name = new char[len];
+            snprintf(name, len, "%s/node-%zu.snap", dir, node_index_);
+            return name;
+        }
+
+        // Writes every local key value pair to the snapshot file of this node in dir, replacing any
+        // earlier snapshot. The file is written next to the old one and renamed when it is complete.
+        // <magic><node_index><count>[<key_size><key><value_size><value>...]
+        void snapshot(const char* dir) {
+            char* name = snapshot_name_(dir);
+            size_t tmp_len = strlen(name) + 5;
+            char* tmp_name = new char[tmp_len];
+            snprintf(tmp_name, tmp_len, "%s.tmp", name);
+
+            FILE* file = fopen(tmp_name, "w");
+            abort_if_not(file != NULL, "KVStore.snapshot(): failed to open %s", tmp_name);
+
+            lock_map();
+            size_t num = map_.size();
+            Key** keys = map_.keys();
+            StoredValue** values = map_.values();
+            bool ok = fwrite(SNAPSHOT_MAGIC, 1, SNAPSHOT_MAGIC_LEN, file) == SNAPSHOT_MAGIC_LEN;
+            ok = ok && fwrite(&node_index_, sizeof(size_t), 1, file) == 1;
+            ok = ok && fwrite(&num, sizeof(size_t), 1, file) == 1;
+            for (size_t i = 0; i < num && ok; i++) {
+                char* key_buf = keys[i]->serialize();
+                size_t key_len = keys[i]->serial_buf_size();
+                // spilled values are read back for the snapshot without making them resident
+                Value* value = values[i]->resident() ? values[i]->value_ : spill_->read(values[i]->seg_, values[i]->offset_, values[i]->bytes_);
+                size_t value_len = value->size();
+
+                ok = fwrite(&key_len, sizeof(size_t), 1, file) == 1 && fwrite(key_buf, 1, key_len, file) == key_len
+                    && fwrite(&value_len, sizeof(size_t), 1, file) == 1 && fwrite(value->get(), 1, value_len, file) == value_len;
+
+                if (!values[i]->resident()) {
+                    delete value;
+                }
+                delete[] key_buf;
+            }
+            unlock_map();
+            delete[] keys;
+            delete[] values;
+
+            ok = fclose(file) == 0 && ok;
+            abort_if_not(ok, "KVStore.snapshot(): failed to write %s", tmp_name);
+            abort_if_not(rename(tmp_name, name) == 0, "KVStore.snapshot(): failed to rename %s", tmp_name);
+
+            delete[] tmp_name;
+            delete[] name;
+        }
+
+        // Reads the snapshot file of this node in dir into the map, replacing any values with the
+        // same keys. The file is mapped into memory, so values are copied straight from the page
+        // cache. Returns false if there is no snapshot for this node.
+        bool restore(const char* dir) {
+            char* name = snapshot_name_(dir);
+            int fd = open(name, O_RDONLY);
+            if (fd < 0) {
+                delete[] name;
+                return false;
+            }
+            struct stat st;
+            abort_if_not(fstat(fd, &st) == 0, "KVStore.restore(): failed to stat %s", name);
+            size_t file_len = st.st_size;
+            abort_if_not(file_len >= SNAPSHOT_MAGIC_LEN + 2 * sizeof(size_t), "KVStore.restore(): %s is too short", name);
+
+            char* mapped = (char*) mmap(nullptr, file_len, PROT_READ, MAP_PRIVATE, fd, 0);
+            abort_if_not(mapped != MAP_FAILED, "KVStore.restore(): failed to map %s", name);
+            abort_if_not(memcmp(mapped, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LEN) == 0, "KVStore.restore(): %s is not a snapshot", name);
+            madvise(mapped, file_len, MADV_SEQUENTIAL);
+
+            char* pos = mapped + SNAPSHOT_MAGIC_LEN;
+            size_t node_index, num;
+            memcpy(&node_index, pos, sizeof(size_t));
+            memcpy(&num, pos + sizeof(size_t), sizeof(size_t));
+            pos += 2 * sizeof(size_t);
+            abort_if_not(node_index == node_index_, "KVStore.restore(): %s belongs to node %zu", name, node_index);
+
+            char* end = mapped + file_len;
+            lock_map();
+            for (size_t i = 0; i < num; i++) {
+                size_t key_len, value_len;
+                abort_if_not(pos + sizeof(size_t) <= end, "KVStore.restore(): %s is truncated", name);
+                memcpy(&key_len, pos, sizeof(size_t));
+                Key* key = Key::deserialize(pos + sizeof(size_t));
+                pos += sizeof(size_t) + key_len;
+
+                abort_if_not(pos + sizeof(size_t) <= end, "KVStore.restore(): %s is truncated", name);
+                memcpy(&value_len, pos, sizeof(size_t));
+                pos += sizeof(size_t);
+                abort_if_not(pos + value_len <= end, "KVStore.restore(): %s is truncated", name);
+                Value* value = new Value(value_len, pos);
+                pos += value_len;
+
+                StoredValue* stored = map_.get(key);
+                if (stored == nullptr) {
+                    map_.add(key, new StoredValue(value, ++use_clock_));
+                } else {
+                    if (stored->resident()) {
+                        resident_bytes_ -= stored->bytes_;
+                    }
+                    drop_spilled_(stored);
+                    stored->set(value, ++use_clock_);
+                    delete key;
+                }
+                resident_bytes_ += value_len;
+                evict_(nullptr);
+            }
+            unlock_map();
+
+            munmap(mapped, file_len);
+            close(fd);
+            delete[] name;
+            return true;
+        }
+
+        // were the local values restored from a snapshot when this KVStore started?
+        bool restored() {
+            return restored_;
+        }
+
         // gets a value from the kv store using a key, returns clone of value
         // returned value is owned by caller
         Value* get(Key& key) {
@@ -143,7 +478,10 @@ class KVStore : public Object {
             if (key.get_index() == node_index_) {
                 owned = false;
                 lock_map();
-                ret = map_.get(&key);
+                StoredValue* stored = map_.get(&key);
+                if (stored != nullptr) {
+                    ret = use_(stored, owned);
+                }
                 unlock_map();
             // if the value is not stored in the local kvstore
             } else if (server_) {
@@ -191,7 +529,9 @@ class KVStore : public Object {
                 owned = false;
                 while (true) {
                     lock_map();
-                    if ((val = map_.get(&key)) != nullptr) {
+                    StoredValue* stored = map_.get(&key);
+                    if (stored != nullptr) {
+                        val = use_(stored, owned);
                         unlock_map();
                         break;
                     }
@@ -221,15 +561,22 @@ class KVStore : public Object {
             // if adding to the local kvstore
             if (key.get_index() == node_index_) {
                 lock_map();
-                Value* temp = map_.get(&key);
-                if (temp == nullptr) {
+                StoredValue* stored = map_.get(&key);
+                if (stored == nullptr) {
                     // key does not exist in map
-                    map_.add(key.clone(), value.clone());
-                } else if (!value.equals(temp)) {
-                    // key already exists so add a clone of the key, and delete the previous value
-                    map_.add(&key, value.clone());
-                    delete temp;
+                    stored = new StoredValue(value.clone(), ++use_clock_);
+                    map_.add(key.clone(), stored);
+                    resident_bytes_ += stored->bytes_;
+                } else if (!stored->resident() || !value.equals(stored->value_)) {
+                    // key already exists so replace the previous value, a spilled value is not read back to compare
+                    if (stored->resident()) {
+                        resident_bytes_ -= stored->bytes_;
+                    }
+                    drop_spilled_(stored);
+                    stored->set(value.clone(), ++use_clock_);
+                    resident_bytes_ += stored->bytes_;
                 }
+                evict_(stored);
                 unlock_map();
             // if not adding to the local kvstore
             } else if (server_) {
@@ -246,11 +593,163 @@ class KVStore : public Object {
             }
         }
 
+        // Removes a key that is stored on this node and its value, including its copy on disk if it
+        // was spilled. Returns false if the key was not in the store.
+        bool remove(Key& key) {
+            abort_if_not(key.get_index() == node_index_, "KVStore.remove(): the key is stored on node %zu, not on node %zu", key.get_index(), node_index_);
+            lock_map();
+            Key* stored_key = nullptr;
+            StoredValue* stored = map_.remove(&key, stored_key);
+            if (stored != nullptr && stored->resident()) {
+                resident_bytes_ -= stored->bytes_;
+            }
+            if (stored != nullptr) {
+                drop_spilled_(stored);
+            }
+            unlock_map();
+            delete stored_key;
+            delete stored;
+            return stored != nullptr;
+        }
+
+        // The id of the next exchange of values between nodes, the keys of an exchange contain it so
+        // that they differ from the keys of every other exchange. Every node hands out the same ids
+        // in the same order, so the nodes agree on the id as long as they run the same exchanges.
+        size_t next_exchange_id() {
+            return exchange_ids_++;
+        }
+
+        // Hands over a key stored on this node that this node does not read any more, it is removed
+        // by remove_retired once no other node reads it either.
+        // NOTE: takes ownership of key
+        void retire(Key* key) {
+            abort_if_not(key->get_index() == node_index_, "KVStore.retire(): the key is stored on node %zu, not on node %zu", key->get_index(), node_index_);
+            retired_->push_back(key);
+        }
+
+        size_t num_retired() {
+            return retired_->size();
+        }
+
+        // Removes the first num retired keys. An exchange calls this once it has the values of every
+        // node, with the number of keys that were retired before this node put its own value: every
+        // node had passed the point that they were retired at when it put its value, so they are
+        // read by no one.
+        void remove_retired(size_t num) {
+            Array<Key>* rest = new Array<Key>();
+            for (size_t i = 0; i < retired_->size(); i++) {
+                Key* key = retired_->get(i);
+                if (i < num) {
+                    remove(*key);
+                    delete key;
+                } else {
+                    rest->push_back(key);
+                }
+            }
+            delete retired_;
+            retired_ = rest;
+        }
+
+        // Puts the value in the background and returns right away, so the caller can go on while
+        // the value is sent over the network. The puts are sent by Config::PUT_THREADS threads,
+        // each of them sends the puts to its own share of the nodes in order, so puts to different
+        // nodes overlap but there is only one put in flight to any node. At most
+        // Config::PUT_QUEUE_LEN puts wait for a sender before put_async blocks. A get may not see
+        // the value until flush_puts() has returned.
+        // NOTE: takes ownership of key and value
+        void put_async(Key* key, Value* value) {
+            pthread_mutex_lock(&outbox_lock_);
+            if (outboxes_ == nullptr) {
+                outboxes_ = new Queue<PendingPut>*[Config::PUT_THREADS];
+                senders_ = new PutThread*[Config::PUT_THREADS];
+                for (size_t i = 0; i < Config::PUT_THREADS; i++) {
+                    outboxes_[i] = new Queue<PendingPut>(Config::PUT_QUEUE_LEN);
+                    senders_[i] = new PutThread(this, outboxes_[i]);
+                    senders_[i]->start();
+                }
+            }
+            Queue<PendingPut>* outbox = outboxes_[key->get_index() % Config::PUT_THREADS];
+            pthread_mutex_unlock(&outbox_lock_);
+            outbox->push(new PendingPut(key, value));
+        }
+
+        // waits until every value given to put_async has been put
+        void flush_puts() {
+            pthread_mutex_lock(&outbox_lock_);
+            if (outboxes_ != nullptr) {
+                for (size_t i = 0; i < Config::PUT_THREADS; i++) {
+                    outboxes_[i]->close();
+                }
+                for (size_t i = 0; i < Config::PUT_THREADS; i++) {
+                    senders_[i]->join();
+                    delete senders_[i];
+                    delete outboxes_[i];
+                }
+                delete[] senders_;
+                delete[] outboxes_;
+                senders_ = nullptr;
+                outboxes_ = nullptr;
+            }
+            pthread_mutex_unlock(&outbox_lock_);
+        }
+
+        // sets what runs the work that is shipped to this node, takes ownership of executor
+        void set_executor(Executor* executor) {
+            lock_map();
+            bool unset = executor_ == nullptr;
+            if (unset) {
+                executor_ = executor;
+            }
+            unlock_map();
+            abort_if_not(unset, "KVStore.set_executor(): the executor is already set");
+        }
+
+        // the executor of this node, nullptr if it is not set yet
+        Executor* executor() {
+            lock_map();
+            Executor* ret = executor_;
+            unlock_map();
+            return ret;
+        }
+
+        // Runs the request on the given node with its executor, waits for the work to be done and
+        // returns the result. Fails if the node has no executor, a remote node waits
+        // Config::EXECUTOR_WAIT seconds for it to be set. Returned value is owned by the caller.
+        Value* exec(size_t node, Value& request) {
+            if (node == node_index_) {
+                Executor* local = executor();
+                abort_if_not(local != nullptr, "KVStore.exec(): no executor on node %zu", node_index_);
+                return local->execute(request.get(), request.size());
+            }
+            abort_if_not(server_, "KVStore.exec(): Got a different node while client was not running");
+            size_t return_len = 0;
+            char* result = client_->exec(node, request.size(), request.get(), return_len);
+            if (result == nullptr || return_len == 0 || result[0] != EXEC_OK) {
+                delete[] result;
+                fail("KVStore.exec(): node %zu has no executor to run the request", node);
+            }
+            Value* ret = new Value(return_len - 1, result + 1);
+            delete[] result;
+            return ret;
+        }
+
         Config& get_config() {
             return config_;
         }
 };
 
+// PutThread methods
+
+// sends queued puts until the outbox is closed and empty
+void PutThread::run() {
+    PendingPut* put = outbox_->pop();
+    while (put != nullptr) {
+        kvs_->put(*put->key_, *put->value_);
+        delete put;
+        put = outbox_->pop();
+    }
+}
+
 
 // KVStoreMessageHandler methods
 
@@ -281,12 +780,16 @@ Response* KVStoreMessageHandler::handle_get(sockaddr_in server, size_t data_len,
     abort_if_not(key->get_index() == kvs_->node_index(), "KVStore got a GET request for the wrong node");
 
     Value* v = kvs_->get(*key, owned);
-    abort_if_not(!owned, "KVStore.handle_get(): Should not own the value");
+    delete key;
 
     if (v == nullptr) {
         return nullptr;
     }
-    return new Response(kvs_->get_sender(), v->size(), v->get());
+    Response* rv = new Response(kvs_->get_sender(), v->size(), v->get());
+    if (owned) {
+        delete v;
+    }
+    return rv;
 }
 
 // handle a generic get and wait coming from the given sender
@@ -300,9 +803,12 @@ Response* KVStoreMessageHandler::handle_get_and_wait(sockaddr_in server, size_t
     abort_if_not(key->get_index() == kvs_->node_index(), "KVStore on node %zu got a GET_AND_WAIT request for node %zu", kvs_->node_index(), key->get_index());
 
     Value* v = kvs_->getAndWait(*key, owned);
-    abort_if_not(!owned, "KVStore.handle_get_and_wait(): Should not own the value");
+    delete key;
 
     Response* rv = new Response(kvs_->get_sender(), v->size(), v->get());
+    if (owned) {
+        delete v;
+    }
     return rv;
 }
 
@@ -321,4 +827,30 @@ Response* KVStoreMessageHandler::handle_put(sockaddr_in server, size_t data_len,
     delete val;
 
     return nullptr;
-}
\ No newline at end of file
+}
+
+// handle a request to run work on this node coming from the given sender. The executor may not be
+// set yet if this node is still starting up, so wait for it, but only for executor_wait_ seconds.
+// return: the response, KVStore::EXEC_OK followed by the result of the work, or only
+//          KVStore::EXEC_NO_EXECUTOR if there was no executor to run it.
+Response* KVStoreMessageHandler::handle_exec(sockaddr_in server, size_t data_len, char* data) {
+    wait_for_node_index();
+    Executor* executor = kvs_->executor();
+    for (size_t waited = 0; executor == nullptr && waited < kvs_->executor_wait_; waited++) {
+        sleep(1);
+        executor = kvs_->executor();
+    }
+    if (executor == nullptr) {
+        char status = KVStore::EXEC_NO_EXECUTOR;
+        return new Response(kvs_->get_sender(), 1, &status);
+    }
+
+    Value* result = executor->execute(data, data_len);
+    char* buf = new char[result->size() + 1];
+    buf[0] = KVStore::EXEC_OK;
+    memcpy(buf + 1, result->get(), result->size());
+    Response* rv = new Response(kvs_->get_sender(), result->size() + 1, buf);
+    delete[] buf;
+    delete result;
+    return rv;
+}
@@ -18,6 +18,7 @@
 #include "../util/serial.h"
 #include "../util/thread.h"
 #include "../util/config.h"
+#include "../util/array.h"
 
 // to be implemented from
 // this is a class that has a callback method to be called when a message is returned
@@ -52,6 +53,13 @@ class MessageHandler : public Object {
         virtual Response* handle_put(sockaddr_in server, size_t data_len, char* data) {
             return nullptr;
         }
+
+        // handle a request to run work on this node coming from the given sender
+        // return: the response with the result of the work.
+        //          if respnse is nullptr then nothing is sent back.
+        virtual Response* handle_exec(sockaddr_in server, size_t data_len, char* data) {
+            return nullptr;
+        }
 };
 
 class Network;
@@ -87,32 +95,60 @@ class Network : public Object {
     public:
         bool quitting_; // is this network object quitting
 
-        // This is a pool of Thread objects that can start threads for each connection
-        ConnectionThread** connection_threads_;
+        // This is a pool of Thread objects that can start threads for each connection. It grows
+        // when every thread is in use, a get and wait keeps its thread until the value is put
+        Array<ConnectionThread> connection_threads_;  // owns the threads
         size_t connection_count_;
         
         Config config_;
 
-        Network() : config_() {
+        Network() : connection_threads_(), config_() {
             quitting_ = false;
-            connection_threads_ = new ConnectionThread*[config_.CLIENT_NUM];
             for (size_t i = 0; i < config_.CLIENT_NUM; i++) {
-                connection_threads_[i] = new ConnectionThread(this);
+                connection_threads_.push_back(new ConnectionThread(this));
             }
             connection_count_ = 0;
         }
 
         ~Network() {
-            for (size_t i = 0; i < config_.CLIENT_NUM; i++) {
-                delete connection_threads_[i];
+            for (size_t i = 0; i < connection_threads_.size(); i++) {
+                delete connection_threads_.get(i);
             }
-            delete[] connection_threads_;
         }
 
-        // sends a char* to the given file descriptor
+        // sends a char* to the given file descriptor, send may take only part of the bytes at once
         // returns true if all characters were sent, false otherwise
         bool send_chars(int fd, size_t num_bytes, const char *c) {
-            return (size_t)(send(fd, c, num_bytes, 0)) == num_bytes;
+            size_t sent = 0;
+            while (sent < num_bytes) {
+                ssize_t n = send(fd, c + sent, num_bytes - sent, 0);
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n <= 0) {
+                    return false;
+                }
+                sent += n;
+            }
+            return true;
+        }
+
+        // reads num_bytes from the given file descriptor into buf, read may return only part of
+        // the bytes that were sent at once
+        // returns true if all bytes were read, false if the connection was closed or failed first
+        bool read_chars(int fd, size_t num_bytes, char* buf) {
+            size_t got = 0;
+            while (got < num_bytes) {
+                ssize_t n = read(fd, buf + got, num_bytes - got);
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n <= 0) {
+                    return false;
+                }
+                got += n;
+            }
+            return true;
         }
 
         // sends the payload from the given header as packets of at most MAX_PACKET_LENGTH
@@ -150,9 +186,7 @@ class Network : public Object {
             // sending the header to the file descriptor
             abort_if_not(send_chars(fd, header.header_len(), header.get_header()), "Failed to send header of type %d", header.get_type());
 
-            int read_bytes = read(fd, buf, header.header_len());
-            // printf("Number of bytes returned for read: %d, header_len = %zu\n", read_bytes, header.header_len());
-            abort_if_not((size_t)read_bytes == header.header_len(), "send_message().check_header: Did not read the correct numnber of bytes");
+            abort_if_not(read_chars(fd, header.header_len(), buf), "send_message().check_header: Did not read the correct numnber of bytes");
             Header check_header(buf);
 
             // check that the returned header type
@@ -165,7 +199,7 @@ class Network : public Object {
                     send_payload_(fd, header);
                     
                     // check what is returned
-                    abort_if_not((size_t)(read(fd, buf, header.header_len())) == header.header_len(), "send_message().check_header2: Did not read the correct numnber of bytes");
+                    abort_if_not(read_chars(fd, header.header_len(), buf), "send_message().check_header2: Did not read the correct numnber of bytes");
                     check_header2 = new Header(buf);
                     
                     if (check_header2->get_type() == MsgKind::RESPONSE) {
@@ -200,7 +234,7 @@ class Network : public Object {
 
             for (size_t i = 0; i < payload_size; i += config_.MAX_PACKET_LENGTH) {
                 size_t packet_size = payload_size - i < config_.MAX_PACKET_LENGTH? payload_size - i : config_.MAX_PACKET_LENGTH;
-                abort_if_not(read(fd, payload + i, packet_size), "failed to receive a packet payload");
+                abort_if_not(read_chars(fd, packet_size, payload + i), "failed to receive a packet payload");
             }
             return payload;
         }
@@ -218,7 +252,7 @@ class Network : public Object {
 
             // deserialize the payload into a message. Set up return value.
             Header* rv = new T(check_header.get_sender(), check_header.get_payload_size(), payload);
-            delete payload;
+            delete[] payload;
 
             return rv;
         }
@@ -229,7 +263,7 @@ class Network : public Object {
             char buf[HEADER_SIZE];
 
             // read in the header of a message
-            abort_if_not(read(fd, buf, HEADER_SIZE), "Failed to receive message header");
+            abort_if_not(read_chars(fd, HEADER_SIZE, buf), "Failed to receive message header");
             Header check_header(buf);
 
             // check what the message is
@@ -258,6 +292,9 @@ class Network : public Object {
                 case MsgKind::RESPONSE:
                     rv = read_payload_<Response>(fd, check_header);
                     break;
+                case MsgKind::EXEC:
+                    rv = read_payload_<Exec>(fd, check_header);
+                    break;
                 case MsgKind::SHUTDOWN:
                     // Send an ack to close the connection
                     send_ack_(fd);
@@ -280,12 +317,16 @@ class Network : public Object {
             int ret_fd;
             abort_if_not((ret_fd = socket(AF_INET, SOCK_STREAM, 0)) != 0, "get_listen_socket(): failed to create socket");
             // attaching socket to the listen ip and port
-            abort_if_not(setsockopt(ret_fd, SOL_SOCKET, SO_REUSEADDR | SO_REUSEPORT, &opt, opt_len) != 0, "get_listen_socket(): failed to set socket options");
+            // the options are not flags, each one is set on its own
+            abort_if_not(setsockopt(ret_fd, SOL_SOCKET, SO_REUSEADDR, &opt, opt_len) == 0, "get_listen_socket(): failed to set socket options");
+            abort_if_not(setsockopt(ret_fd, SOL_SOCKET, SO_REUSEPORT, &opt, opt_len) == 0, "get_listen_socket(): failed to set socket options");
             adr.sin_family = AF_INET;
             abort_if_not(inet_pton(AF_INET, listen_ip, &adr.sin_addr) > 0, "get_listen_socket(): failed to convert string ip address to bytes");
             adr.sin_port = htons( listen_port ); // uses the listen port
             abort_if_not(bind(ret_fd, (struct sockaddr *)&adr, sizeof(adr))>=0, "get_listen_socket(): failed to bind on the file descriptor");
-            abort_if_not(listen(ret_fd, config_.CLIENT_NUM) >= 0, "get_listen_socket(): failed to listen to file descriptor");
+            // every node can have several puts and gets in flight to this one, the backlog holds
+            // the connections that come in while the pool is busy
+            abort_if_not(listen(ret_fd, SOMAXCONN) >= 0, "get_listen_socket(): failed to listen to file descriptor");
             return ret_fd;
         }
 
@@ -323,13 +364,19 @@ class Network : public Object {
                     new_fd = accept(fd, (struct sockaddr *)&client_addr, &addr_size);
                     abort_if_not(new_fd != -1, "Accept connection: failed to accept connection");
                     
-                    // can receive up to CLIENT_NUM connections at once
-                    connection_thread = connection_threads_[connection_count_++ % config_.CLIENT_NUM];
-                    while (connection_thread->is_in_use()) {
-                        // if the current thread is in use then move to the next one. 
-                        // There should always be at least one open connection thread 
-                        connection_thread = connection_threads_[connection_count_++ % config_.CLIENT_NUM];
+                    // take the next thread that is not in use, start one more if they all are
+                    connection_thread = nullptr;
+                    for (size_t i = 0; i < connection_threads_.size() && connection_thread == nullptr; i++) {
+                        ConnectionThread* next = connection_threads_.get(connection_count_++ % connection_threads_.size());
+                        if (!next->is_in_use()) {
+                            connection_thread = next;
+                        }
+                    }
+                    if (connection_thread == nullptr) {
+                        connection_thread = new ConnectionThread(this);
+                        connection_threads_.push_back(connection_thread);
                     }
+                    // in use from now on, not from when the thread gets to run, so it is not taken twice
                     connection_thread->set_fd(new_fd);
                     // start a new thread
                     connection_thread->start();
@@ -365,13 +412,13 @@ class Network : public Object {
 
 void ConnectionThread::set_fd(int fd) {
     fd_ = fd;
+    in_use_ = true;
 }
 
 // For each connection recieve the message and then handle the message
 // send a response if there is one and then close the connection.
 // the in_use_ varible is set when this thread is still running
 void ConnectionThread::run() {
-    in_use_ = true;
     Header* message = network_->recieve_message(fd_);
     Response* response = network_->handle_message(message);
     size_t return_msg_len;
@@ -759,6 +806,16 @@ class Client : public Network {
             abort_if_not(return_msg_len == 0 && rv == nullptr, "Got a response from a put message");
         }
 
+        // Run the work in the given payload on another node, the connection is kept open until the
+        // work is done.
+        // sets the return_msg_len to the number of bytes and returns the response if one was recieved
+        // if no response was sent then nullptr is returned and return_msg_len = 0
+        char* exec(size_t to_node_idx, size_t payload_len, char* payload, size_t &return_msg_len) {
+            Exec message(get_sockaddr(), payload_len, payload);
+
+            return send_to_node_(to_node_idx, &message, return_msg_len);
+        }
+
         // register this client against the server
         void server_register() {
             size_t resp_size;
@@ -795,6 +852,10 @@ class Client : public Network {
                 {  
                     return msg_handler_->handle_message(get_sockaddr(), msg->get_payload_size(), msg->get_payload());
                 }
+                case MsgKind::EXEC:
+                {
+                    return msg_handler_->handle_exec(get_sockaddr(), msg->get_payload_size(), msg->get_payload());
+                }
                 default:
                     fail("message_handler_dispatch: got an invalid msgkind");
                     return nullptr;
@@ -824,8 +885,9 @@ class Client : public Network {
                 case MsgKind::GETANDWAIT:
                 case MsgKind::PUT:
                 case MsgKind::MESSAGE:
+                case MsgKind::EXEC:
                 {  
-                    // GET, GETANDWAIT, PUT, and MESSAGE are all handled here
+                    // GET, GETANDWAIT, PUT, MESSAGE and EXEC are all handled here
                     rv = message_handler_dispatch(message);
                     break;
                 }
@@ -0,0 +1,219 @@
+//lang:Cpp
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "keyvalue.h"
+
+#include "../util/object.h"
+#include "../util/helper.h"
+#include "../util/config.h"
+
+/**
+ * A value that is held by a KVStore. The bytes of the value are either resident in
+ * memory, or they have been spilled to a segment file and have to be faulted back in.
+ * A value that was faulted back in and not changed since keeps its place on disk, so
+ * spilling it again does not write anything.
+ */
+class StoredValue : public Object {
+    public:
+        Value* value_;  // owned, nullptr while the value is spilled
+        size_t bytes_;  // size of the value
+        bool on_disk_;  // is there an up to date copy of the value in a segment file?
+        size_t seg_;  // segment file that holds the value, if on_disk_
+        size_t offset_;  // offset of the value in the segment file, if on_disk_
+        size_t last_use_;  // when the value was last used, larger is more recent
+
+        StoredValue(Value* value, size_t now) {
+            value_ = value;
+            bytes_ = value->size();
+            on_disk_ = false;
+            seg_ = 0;
+            offset_ = 0;
+            last_use_ = now;
+        }
+
+        ~StoredValue() {
+            delete value_;
+        }
+
+        bool resident() {
+            return value_ != nullptr;
+        }
+
+        // replaces the bytes of this value, any copy on disk is out of date after this
+        void set(Value* value, size_t now) {
+            delete value_;
+            value_ = value;
+            bytes_ = value->size();
+            on_disk_ = false;
+            last_use_ = now;
+        }
+
+        // qsort comparator that orders StoredValue pointers from least to most recently used
+        static int compare_last_use(const void* a, const void* b) {
+            StoredValue* left = *(StoredValue**) a;
+            StoredValue* right = *(StoredValue**) b;
+            if (left->last_use_ < right->last_use_) {
+                return -1;
+            }
+            return left->last_use_ > right->last_use_ ? 1 : 0;
+        }
+};
+
+/**
+ * Append-only segment files on local disk that hold spilled values. A new segment is
+ * started once the current one reaches its limit, Config::SPILL_SEGMENT_BYTES unless
+ * another one is given. Values are read back through mmap. The bytes of the values that
+ * are still in use are counted for every segment: a segment whose values were all
+ * replaced or removed is deleted, or emptied if it is the one that is appended to. The
+ * segment files that are left are deleted when the SpillFile is deleted.
+ */
+class SpillFile : public Object {
+    public:
+        char* dir_;  // owned; directory that holds the segment files
+        size_t id_;  // makes the file names unique for every spill file in this process
+        size_t seg_limit_;  // bytes after which a new segment is started
+        int* fds_;  // owned; file descriptor of each segment, -1 once the segment is deleted
+        size_t* written_;  // owned; bytes written to each segment
+        size_t* live_;  // owned; bytes of the values in each segment that are still in use
+        size_t num_segs_;
+        size_t cap_segs_;
+        size_t disk_bytes_;  // bytes in the segment files that were not deleted
+
+        SpillFile(const char* dir) : SpillFile(dir, Config::SPILL_SEGMENT_BYTES) { }
+
+        SpillFile(const char* dir, size_t seg_limit) {
+            static size_t next_id = 0;
+            dir_ = duplicate(dir);
+            id_ = __sync_fetch_and_add(&next_id, 1);
+            seg_limit_ = seg_limit;
+            cap_segs_ = Config::ARRAY_STARTING_CAP;
+            fds_ = new int[cap_segs_];
+            written_ = new size_t[cap_segs_];
+            live_ = new size_t[cap_segs_];
+            num_segs_ = 0;
+            disk_bytes_ = 0;
+        }
+
+        ~SpillFile() {
+            for (size_t i = 0; i < num_segs_; i++) {
+                delete_seg_(i);
+            }
+            delete[] fds_;
+            delete[] written_;
+            delete[] live_;
+            delete[] dir_;
+        }
+
+        // bytes in the segment files on disk
+        size_t disk_bytes() {
+            return disk_bytes_;
+        }
+
+        // the name of segment file seg, returned name is owned by the caller
+        char* seg_name_(size_t seg) {
+            size_t len = strlen(dir_) + 64;
+            char* name = new char[len];
+            snprintf(name, len, "%s/eau2-%d-%zu-%zu.seg", dir_, (int) getpid(), id_, seg);
+            return name;
+        }
+
+        void new_seg_() {
+            if (num_segs_ == cap_segs_) {
+                cap_segs_ *= 2;
+                int* fds = new int[cap_segs_];
+                size_t* written = new size_t[cap_segs_];
+                size_t* live = new size_t[cap_segs_];
+                memcpy(fds, fds_, num_segs_ * sizeof(int));
+                memcpy(written, written_, num_segs_ * sizeof(size_t));
+                memcpy(live, live_, num_segs_ * sizeof(size_t));
+                delete[] fds_;
+                delete[] written_;
+                delete[] live_;
+                fds_ = fds;
+                written_ = written;
+                live_ = live;
+            }
+            char* name = seg_name_(num_segs_);
+            int fd = open(name, O_RDWR | O_CREAT | O_TRUNC, 0600);
+            abort_if_not(fd >= 0, "SpillFile: failed to create segment file %s", name);
+            delete[] name;
+            fds_[num_segs_] = fd;
+            written_[num_segs_] = 0;
+            live_[num_segs_] = 0;
+            num_segs_++;
+        }
+
+        // closes and unlinks segment seg, unless that was done already
+        void delete_seg_(size_t seg) {
+            if (fds_[seg] < 0) {
+                return;
+            }
+            close(fds_[seg]);
+            fds_[seg] = -1;
+            char* name = seg_name_(seg);
+            unlink(name);
+            delete[] name;
+            disk_bytes_ -= written_[seg];
+        }
+
+        // appends the bytes of the value to the last segment and sets where they were written
+        void append(Value& value, size_t& seg, size_t& offset) {
+            if (num_segs_ == 0 || written_[num_segs_ - 1] + value.size() > seg_limit_) {
+                new_seg_();
+            }
+            seg = num_segs_ - 1;
+            offset = written_[seg];
+
+            size_t written = 0;
+            while (written < value.size()) {
+                ssize_t n = pwrite(fds_[seg], value.get() + written, value.size() - written, offset + written);
+                abort_if_not(n > 0, "SpillFile.append(): failed to write to segment %zu", seg);
+                written += n;
+            }
+            written_[seg] += value.size();
+            live_[seg] += value.size();
+            disk_bytes_ += value.size();
+        }
+
+        // Forgets the bytes bytes of a value in segment seg, which were replaced or removed. A
+        // segment that holds no value in use any more is deleted, the last one is emptied instead
+        // because values are still appended to it.
+        void release(size_t seg, size_t bytes) {
+            abort_if_not(seg < num_segs_ && live_[seg] >= bytes, "SpillFile.release(): segment %zu does not hold %zu bytes", seg, bytes);
+            live_[seg] -= bytes;
+            if (live_[seg] > 0) {
+                return;
+            }
+            if (seg + 1 < num_segs_) {
+                delete_seg_(seg);
+                return;
+            }
+            abort_if_not(ftruncate(fds_[seg], 0) == 0, "SpillFile.release(): failed to empty segment %zu", seg);
+            disk_bytes_ -= written_[seg];
+            written_[seg] = 0;
+        }
+
+        // reads bytes bytes at offset of segment seg back into a new Value, owned by the caller
+        Value* read(size_t seg, size_t offset, size_t bytes) {
+            abort_if_not(seg < num_segs_, "SpillFile.read(): segment %zu out of bounds", seg);
+            char* buf = new char[bytes];
+            if (bytes > 0) {
+                // mmap needs a page aligned offset
+                size_t page = sysconf(_SC_PAGESIZE);
+                size_t start = offset - offset % page;
+                size_t len = offset + bytes - start;
+                void* mapped = mmap(nullptr, len, PROT_READ, MAP_SHARED, fds_[seg], start);
+                abort_if_not(mapped != MAP_FAILED, "SpillFile.read(): failed to map segment %zu", seg);
+                memcpy(buf, (char*) mapped + (offset - start), bytes);
+                munmap(mapped, len);
+            }
+            return new Value(bytes, buf, true);
+        }
+};
@@ -16,12 +16,33 @@ class Config : public Object {
         static const int SERVER_LISTEN_PORT = 8080;     // port that the server listens on
         static const int MAX_PACKET_LENGTH = 1024; // 1048576;      // The maximum number of bytes in a package
 
+        // keyvaluestore.h
+        static const size_t SPILL_SEGMENT_BYTES = 64 * 1024 * 1024;  // max size of a spill segment file
+        static const size_t PUT_THREADS = 4;            // threads that send the puts of put_async, each to its own nodes
+        static const size_t PUT_QUEUE_LEN = 64;         // puts that can wait to be sent before put_async blocks
+        static const size_t EXECUTOR_WAIT = 10;         // seconds that work shipped to a node waits for its executor to be set
+
+        // sort.h
+        static const size_t SORT_SAMPLES = 32;          // values sampled per node and range to pick the splitters of sort_by
+        static const size_t SORT_THREADS = 4;           // threads per node that sort the runs of sort_by
+
+        // semi_join.h
+        static const size_t BLOOM_BITS_PER_KEY = 10;    // bits of the Bloom filter of semi_join per key, about 1% false positives
+        static const size_t BLOOM_HASHES = 7;           // bits set per key in the Bloom filter of semi_join
+
+        // index.h
+        static const size_t INDEX_BUCKET_ROWS = 64;     // rows per bucket of a column index when it is built
+
         // configuarable values
         size_t CLIENT_NUM = 3;                          // maximum number of clients
         char* CLIENT_IP;                                // ip address of each client
         char* SERVER_IP;                                // ip address of the server
         size_t CHUNK_SIZE = 1024;                       // how many elements per chunk in column
         size_t SERVER_UP_TIME = 20;                     // how long the server stays online for
+        size_t MEMORY_BUDGET = 0;                       // bytes of values a node keeps in memory, 0 is unlimited
+        char* SPILL_DIR;                                // directory of the files that values are spilled to
+        char* SNAPSHOT_DIR;                             // directory that node snapshots are restored from, empty is none
+        size_t INGEST_THREADS = 4;                      // threads per node that parse a file, the same on every node
         
         Config() {
             FILE* file = fopen("config.txt", "r");
@@ -35,6 +56,12 @@ class Config : public Object {
             SERVER_IP = new char[16];
             memset(SERVER_IP, 0, 16);
 
+            SPILL_DIR = new char[1024];
+            strcpy(SPILL_DIR, "/tmp");
+
+            SNAPSHOT_DIR = new char[1024];
+            memset(SNAPSHOT_DIR, 0, 1024);
+
             while(fgets(buff, 1024, file)) {
                 field = strtok(buff, "=");
                 value = strtok(NULL, "\n# ");  // this will get the value up to '#', ' ', or '\n' 
@@ -56,6 +83,18 @@ class Config : public Object {
                 else if (strcmp(field, "SERVER_IP") == 0) {
                     memcpy(SERVER_IP, value, strlen(value) + 1);
                 }
+                else if (strcmp(field, "MEMORY_BUDGET") == 0) {
+                    MEMORY_BUDGET = strtoull(value, nullptr, 10);
+                }
+                else if (strcmp(field, "SPILL_DIR") == 0) {
+                    memcpy(SPILL_DIR, value, strlen(value) + 1);
+                }
+                else if (strcmp(field, "SNAPSHOT_DIR") == 0) {
+                    memcpy(SNAPSHOT_DIR, value, strlen(value) + 1);
+                }
+                else if (strcmp(field, "INGEST_THREADS") == 0) {
+                    INGEST_THREADS = strtoull(value, nullptr, 10);
+                }
             }
             
             fclose(file);
@@ -64,6 +103,8 @@ class Config : public Object {
         ~Config() {
             delete[] CLIENT_IP;
             delete[] SERVER_IP;
+            delete[] SPILL_DIR;
+            delete[] SNAPSHOT_DIR;
         }
 };
 
@@ -152,6 +152,24 @@ class Map : public Object {
             return ret;
         }
 
+        /**
+        * Removes the element with the specified key and updates the size of the map
+        * @param key the key
+        * @param stored_key set to the key that the element was added with, so it can be deleted
+        * @return the value of the element removed, nullptr if there is no such element
+        */
+        V* remove(K* key, K*& stored_key) {
+            Bucket<K, V>* bucket = buckets_[key->hash() % num_buckets_];
+            int idx = bucket->keys_->indexOf(key);
+            if (idx < 0) {
+                stored_key = nullptr;
+                return nullptr;
+            }
+            stored_key = bucket->keys_->remove(idx);
+            size_--;
+            return bucket->values_->remove(idx);
+        }
+
         K** keys() {
             Bucket<K,V>* bucket = nullptr;
             K** ret = new K*[size_];
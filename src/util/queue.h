@@ -0,0 +1,89 @@
+//lang::CwC
+#pragma once
+
+#include <pthread.h>
+
+#include "object.h"
+
+// A bounded blocking queue of pointers that connects threads. push() waits while the queue
+// is full and pop() waits while it is empty, so a fast producer cannot run ahead of its
+// consumers by more than the capacity. Once close() is called, pop() returns nullptr after
+// the remaining items are taken. The queue does not own the items in it.
+// @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+template <class T>
+class Queue : public Object {
+    public:
+        T** values_;  // owned; ring buffer of cap_ items starting at head_
+        size_t head_;
+        size_t len_;
+        size_t cap_;
+        bool closed_;
+        pthread_mutex_t lock_;  // locks everything above
+        pthread_cond_t not_empty_;
+        pthread_cond_t not_full_;
+
+        Queue(size_t cap) {
+            abort_if_not(cap > 0, "Queue(): capacity has to be at least 1");
+            cap_ = cap;
+            values_ = new T*[cap_];
+            head_ = 0;
+            len_ = 0;
+            closed_ = false;
+            abort_if_not(pthread_mutex_init(&lock_, NULL) == 0, "Queue: Failed to create mutex");
+            abort_if_not(pthread_cond_init(&not_empty_, NULL) == 0, "Queue: Failed to create condition");
+            abort_if_not(pthread_cond_init(&not_full_, NULL) == 0, "Queue: Failed to create condition");
+        }
+
+        ~Queue() {
+            pthread_cond_destroy(&not_full_);
+            pthread_cond_destroy(&not_empty_);
+            pthread_mutex_destroy(&lock_);
+            delete[] values_;
+        }
+
+        // adds the item at the back, waits until there is room for it
+        void push(T* item) {
+            pthread_mutex_lock(&lock_);
+            while (len_ == cap_) {
+                pthread_cond_wait(&not_full_, &lock_);
+            }
+            abort_if_not(!closed_, "Queue.push(): queue is closed");
+            values_[(head_ + len_) % cap_] = item;
+            len_++;
+            pthread_cond_signal(&not_empty_);
+            pthread_mutex_unlock(&lock_);
+        }
+
+        // takes the item at the front, waits until there is one. Returns nullptr once the queue
+        // is closed and empty
+        T* pop() {
+            pthread_mutex_lock(&lock_);
+            while (len_ == 0 && !closed_) {
+                pthread_cond_wait(&not_empty_, &lock_);
+            }
+            T* ret = nullptr;
+            if (len_ > 0) {
+                ret = values_[head_];
+                head_ = (head_ + 1) % cap_;
+                len_--;
+                pthread_cond_signal(&not_full_);
+            }
+            pthread_mutex_unlock(&lock_);
+            return ret;
+        }
+
+        // no more items will be pushed, wakes up every thread that waits in pop()
+        void close() {
+            pthread_mutex_lock(&lock_);
+            closed_ = true;
+            pthread_cond_broadcast(&not_empty_);
+            pthread_mutex_unlock(&lock_);
+        }
+
+        size_t size() {
+            pthread_mutex_lock(&lock_);
+            size_t ret = len_;
+            pthread_mutex_unlock(&lock_);
+            return ret;
+        }
+};
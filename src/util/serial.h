@@ -17,6 +17,7 @@ enum class MsgKind {
     GETANDWAIT,     // 9
     PUT,            // 10
     RESPONSE,       // 11
+    EXEC,           // 12
 };
 
 const size_t HEADER_SIZE = sizeof(MsgKind) + sizeof(size_t) + sizeof(sockaddr_in);
@@ -371,3 +372,17 @@ class Response : public Message {
         ~Response() { }
 };
 
+/**
+ * This is a subclass of Message that can be sent over the network. This is used to run work on
+ * another node, the node answers with a response that holds the result of the work.
+ * @author: Chris Barth <barth.c@husky.neu.edu> and Aaron Wang <wang.aa@husky.neu.edu>
+ */
+class Exec : public Message {
+    public:
+        Exec(sockaddr_in sender, size_t payload_size, const char* payload) : Message(sender, payload_size, payload) {
+            kind_ = MsgKind::EXEC;
+        }
+
+        ~Exec() { }
+};
+
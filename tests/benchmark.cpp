@@ -0,0 +1,348 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/kvstore/keyvaluestore.h"
+#include "../src/dataframe/dataframe.h"
+#include "../src/dataframe/sorer.h"
+
+// Benchmarks for loading data into a KVStore. Run from a directory with a config.txt:
+//     ./benchmark [number of rows]
+// The input is a generated commits file with three int columns, like the Linus inputs.
+
+static const size_t DEFAULT_ROWS = 2 * 1000 * 1000;
+
+// seconds since an arbitrary point, for timing
+double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// writes rows lines of <int><int><int> to path, returns the size of the file in bytes
+size_t generate_commits(const char* path, size_t rows) {
+    FILE* file = fopen(path, "w");
+    assert(file != NULL);
+    srand(4500);
+    for (size_t i = 0; i < rows; i++) {
+        fprintf(file, "<%d><%d><%d>\n", rand() % 125000, rand() % 32000, rand() % 32000);
+    }
+    size_t bytes = ftell(file);
+    fclose(file);
+    return bytes;
+}
+
+// parses the file into a fresh KVStore, snapshots it, and restores the snapshot into another KVStore
+void bench_snapshot(const char* path, size_t bytes, size_t rows) {
+    const char* dir = "/tmp";
+    Key key(0, "commits");
+
+    KVStore* cold = new KVStore(false);
+    double start = now();
+    SOR sorer(path, key.clone(), cold);
+    DataFrame* df = sorer.read();
+    df->add_self_to_kv_();
+    double parse_time = now() - start;
+    assert(df->nrows() == rows);
+    delete df;
+
+    start = now();
+    cold->snapshot(dir);
+    double snapshot_time = now() - start;
+    delete cold;
+
+    KVStore* warm = new KVStore(false);
+    start = now();
+    // not inside the assert, which is compiled out with NDEBUG
+    bool restored_ok = warm->restore(dir);
+    assert(restored_ok);
+    (void) restored_ok;
+    Value* v = warm->get(key);
+    DataFrame* restored = DataFrame::deserialize(v->get(), warm);
+    double restore_time = now() - start;
+    assert(restored->nrows() == rows);
+
+    printf("snapshot: %zu rows, %.1f MB of text\n", rows, bytes / 1e6);
+    printf("    cold parse:    %8.3f s\n", parse_time);
+    printf("    snapshot:      %8.3f s\n", snapshot_time);
+    printf("    warm restore:  %8.3f s (%.1fx faster than parsing)\n", restore_time, parse_time / restore_time);
+
+    delete restored;
+    delete v;
+    delete warm;
+
+    char name[64];
+    snprintf(name, 64, "%s/node-0.snap", dir);
+    unlink(name);
+}
+
+// parses the file once, saves it in the binary columnar format, and loads the saved file
+void bench_save_load(const char* path, size_t bytes, size_t rows) {
+    const char* saved = "/tmp/eau2-benchmark-commits.df";
+    Key key(0, "commits");
+    Key loaded_key(0, "loaded");
+    KVStore kvs(false);
+
+    double start = now();
+    SOR sorer(path, key.clone(), &kvs);
+    DataFrame* df = sorer.read();
+    double parse_time = now() - start;
+
+    start = now();
+    df->save(saved);
+    double save_time = now() - start;
+
+    start = now();
+    DataFrame* loaded = DataFrame::load(&loaded_key, &kvs, saved);
+    double load_time = now() - start;
+    assert(loaded->nrows() == rows);
+    assert(loaded->get_int(2, rows - 1) == df->get_int(2, rows - 1));
+
+    printf("save/load: %zu rows, %.1f MB of text\n", rows, bytes / 1e6);
+    printf("    parse:         %8.3f s\n", parse_time);
+    printf("    save:          %8.3f s\n", save_time);
+    printf("    load:          %8.3f s (%.1fx faster than parsing)\n", load_time, parse_time / load_time);
+
+    delete df;
+    delete loaded;
+    unlink(saved);
+}
+
+// parses the file with one thread, then with every core of this node splitting it
+void bench_read_distributed(const char* path, size_t bytes, size_t rows) {
+    size_t threads = get_thread_count();
+    KVStore kvs(false);
+
+    double start = now();
+    SOR sorer(path, new Key(0, "serial"), &kvs);
+    DataFrame* df = sorer.read();
+    double serial_time = now() - start;
+
+    start = now();
+    SOR dist_sorer(path, new Key(0, "threaded"), &kvs);
+    DataFrame* dist = dist_sorer.read_distributed(threads);
+    double threaded_time = now() - start;
+    assert(dist->nrows() == rows);
+    assert(dist->get_int(0, rows - 1) == df->get_int(0, rows - 1));
+
+    printf("distributed read: %zu rows, %.1f MB of text\n", rows, bytes / 1e6);
+    printf("    read():        %8.3f s\n", serial_time);
+    printf("    %2zu threads:    %8.3f s (%.1fx faster)\n", threads, threaded_time, serial_time / threaded_time);
+
+    delete df;
+    delete dist;
+}
+
+// writes rows lines of 24 mixed fields to path, returns the size of the file in bytes
+size_t generate_wide(const char* path, size_t rows) {
+    FILE* file = fopen(path, "w");
+    assert(file != NULL);
+    srand(4500);
+    for (size_t i = 0; i < rows; i++) {
+        for (size_t j = 0; j < 8; j++) {
+            fprintf(file, "<%d> <%d.%03d> <\"name %d of the project\"> ", rand(), rand() % 1000, rand() % 1000, rand() % 5000);
+        }
+        fprintf(file, "\n");
+    }
+    size_t bytes = ftell(file);
+    fclose(file);
+    return bytes;
+}
+
+// finds the fields of every line of the file, returns the number of fields
+size_t scan_lines(FieldScanner& scanner, const char* data, size_t size) {
+    size_t fields = 0;
+    const char* end = data + size;
+    for (const char* line = data; line < end;) {
+        const char* eol = (const char*) memchr(line, '\n', end - line);
+        if (eol == nullptr) {
+            eol = end;
+        }
+        fields += scanner.scan(line, eol);
+        line = eol + 1;
+    }
+    return fields;
+}
+
+// compares finding the fields of a wide file with the byte loop and with the vectorized classifier
+// parses the file on the calling thread, then through the reader, parser and committer pipeline
+void bench_pipeline(const char* path, size_t bytes, size_t rows) {
+    size_t parsers = get_thread_count();
+    KVStore kvs(false);
+    SOR sorer(path, new Key(0, "pipeline"), &kvs);
+    Schema* schema = sorer.start_schema_(0, Config::MAX_SIZE_T);
+
+    Key serial_key("serial");
+    DataFrame serial(*schema, serial_key, &kvs, false);
+    double start = now();
+    sorer.parse_(&serial, 0, Config::MAX_SIZE_T);
+    double serial_time = now() - start;
+
+    Key piped_key("piped");
+    DataFrame piped(*schema, piped_key, &kvs, false);
+    start = now();
+    sorer.parse_pipelined_(&piped, 0, Config::MAX_SIZE_T, parsers);
+    piped.commit();
+    double piped_time = now() - start;
+    assert(piped.nrows() == rows);
+    assert(piped.get_int(0, rows - 1) == serial.get_int(0, rows - 1));
+
+    printf("pipelined read: %zu rows, %.1f MB of text\n", rows, bytes / 1e6);
+    printf("    serial:        %8.3f s\n", serial_time);
+    printf("    %2zu parsers:    %8.3f s (%.1fx faster)\n", parsers, piped_time, serial_time / piped_time);
+    delete schema;
+}
+
+void bench_scan(size_t rows) {
+    const char* path = "/tmp/eau2-benchmark-wide.txt";
+    size_t bytes = generate_wide(path, rows);
+    FILE* file = fopen(path, "r");
+    assert(file != NULL);
+    char* data = new char[bytes];
+    size_t read = fread(data, 1, bytes, file);
+    assert(read == bytes);
+    (void) read;
+    fclose(file);
+
+    FieldScanner scalar;
+    scalar.scalar_ = true;
+    double start = now();
+    size_t scalar_fields = scan_lines(scalar, data, bytes);
+    double scalar_time = now() - start;
+
+    FieldScanner simd;
+    start = now();
+    size_t simd_fields = scan_lines(simd, data, bytes);
+    double simd_time = now() - start;
+    assert(scalar_fields == simd_fields && simd_fields == rows * 24);
+
+    printf("field scan: %zu rows of 24 fields, %.1f MB of text\n", rows, bytes / 1e6);
+    printf("    byte loop:     %8.3f s (%.0f ns per row)\n", scalar_time, scalar_time * 1e9 / rows);
+    printf("    vectorized:    %8.3f s (%.0f ns per row, %.1fx faster)\n", simd_time, simd_time * 1e9 / rows, scalar_time / simd_time);
+
+    delete[] data;
+    unlink(path);
+}
+
+// parse throughput of the commits file, and the cost of converting its fields with infer_type
+// and a conversion (the old way) against validating and converting in one pass
+void bench_parse(const char* path, size_t bytes, size_t rows) {
+    KVStore kvs(false);
+    double start = now();
+    SOR sorer(path, new Key(0, "parsed"), &kvs);
+    DataFrame* df = sorer.read();
+    double parse_time = now() - start;
+    assert(df->nrows() == rows);
+    delete df;
+
+    // every field of the file, found once up front so only the conversions are timed
+    const char** fields = new const char*[rows * 3];
+    size_t* lens = new size_t[rows * 3];
+    size_t num_fields = 0;
+    const char* end = sorer.data_ + sorer.size_;
+    for (const char* line = sorer.data_; line < end && num_fields + 3 <= rows * 3;) {
+        const char* eol = (const char*) memchr(line, '\n', end - line);
+        size_t n = sorer.scan_row_(line, eol);
+        for (size_t i = 0; i < n; i++) {
+            fields[num_fields] = sorer.scanner_.field(i);
+            lens[num_fields++] = sorer.scanner_.field_len(i);
+        }
+        line = eol + 1;
+    }
+
+    long long sum = 0;
+    start = now();
+    for (size_t i = 0; i < num_fields; i++) {
+        if (infer_type(fields[i], lens[i]) != STRING) {
+            sum += atoi(std::string(fields[i], lens[i]).c_str());
+        }
+    }
+    double infer_int_time = now() - start;
+    start = now();
+    for (size_t i = 0; i < num_fields; i++) {
+        int n;
+        if (parse_int(fields[i], lens[i], n)) {
+            sum -= n;
+        }
+    }
+    double parse_int_time = now() - start;
+    assert(sum == 0);
+
+    double dsum = 0;
+    start = now();
+    for (size_t i = 0; i < num_fields; i++) {
+        if (infer_type(fields[i], lens[i]) != STRING) {
+            dsum += atof_(fields[i], lens[i]);
+        }
+    }
+    double infer_double_time = now() - start;
+    start = now();
+    for (size_t i = 0; i < num_fields; i++) {
+        double d;
+        if (parse_double(fields[i], lens[i], d)) {
+            dsum -= d;
+        }
+    }
+    double parse_double_time = now() - start;
+    assert(dsum == 0);
+
+    printf("parse: %zu rows, %.1f MB of text\n", rows, bytes / 1e6);
+    printf("    read:          %8.3f s (%.1f MB/s, %.2f M rows/s)\n", parse_time, bytes / 1e6 / parse_time, rows / 1e6 / parse_time);
+    printf("    %zu fields as ints:    infer + atoi %6.1f ns, parse_int %6.1f ns per field\n", num_fields,
+        infer_int_time * 1e9 / num_fields, parse_int_time * 1e9 / num_fields);
+    printf("    %zu fields as doubles: infer + atof %6.1f ns, parse_double %6.1f ns per field\n", num_fields,
+        infer_double_time * 1e9 / num_fields, parse_double_time * 1e9 / num_fields);
+
+    delete[] fields;
+    delete[] lens;
+}
+
+// reads every field of a wide file, then only two of its 24 fields
+void bench_select(size_t rows) {
+    const char* path = "/tmp/eau2-benchmark-wide.txt";
+    size_t bytes = generate_wide(path, rows);
+
+    KVStore kvs(false);
+    double start = now();
+    SOR all_sorer(path, new Key(0, "all"), &kvs);
+    DataFrame* all = all_sorer.read();
+    double all_time = now() - start;
+    size_t all_bytes = kvs.resident_bytes();
+
+    KVStore selected_kvs(false);
+    start = now();
+    SOR selected_sorer(path, new Key(0, "selected"), &selected_kvs);
+    size_t fields[] = {0, 3};
+    DataFrame* selected = selected_sorer.read_selected(fields, 2);
+    double selected_time = now() - start;
+    size_t selected_bytes = selected_kvs.resident_bytes();
+    assert(selected->nrows() == all->nrows());
+    assert(selected->get_int(1, rows - 1) == all->get_int(3, rows - 1));
+
+    printf("selected read: %zu rows of 24 fields, %.1f MB of text\n", rows, bytes / 1e6);
+    printf("    every field:   %8.3f s, %6.1f MB stored\n", all_time, all_bytes / 1e6);
+    printf("    2 fields:      %8.3f s, %6.1f MB stored (%.1fx faster)\n", selected_time, selected_bytes / 1e6, all_time / selected_time);
+
+    delete all;
+    delete selected;
+    unlink(path);
+}
+
+int main(int argc, char** argv) {
+    size_t rows = argc > 1 ? strtoull(argv[1], nullptr, 10) : DEFAULT_ROWS;
+    const char* path = "/tmp/eau2-benchmark-commits.txt";
+    size_t bytes = generate_commits(path, rows);
+
+    bench_parse(path, bytes, rows);
+    bench_snapshot(path, bytes, rows);
+    bench_save_load(path, bytes, rows);
+    bench_read_distributed(path, bytes, rows);
+    bench_pipeline(path, bytes, rows);
+    bench_scan(rows / 10);
+    bench_select(rows / 10);
+
+    unlink(path);
+    return 0;
+}
@@ -0,0 +1,17 @@
+#include <stdlib.h>
+
+#include "../src/application/cluster_check.h"
+#include "../src/kvstore/keyvaluestore.h"
+
+// Run on every node of a cluster, see ClusterCheck
+int main() {
+    KVStore kvs;
+    ClusterCheck check(kvs);
+
+    check.run_();
+
+    // the other nodes may still read the chunks of this node until the server shuts down
+    sleep(kvs.get_config().SERVER_UP_TIME);
+
+    return 0;
+}
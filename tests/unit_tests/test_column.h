@@ -707,3 +707,135 @@ TEST(testColumn, testStringColumnSerialBufSize) {
 }
 
 
+
+// The descriptor of a column does not grow with the number of chunks
+void test_column_descriptor_size() {
+    KVStore kvs(false); 
+    String s("foobar");
+    IntColumn small(&s, &kvs);
+    IntColumn large(&s, &kvs);
+    size_t chunk_size = kvs.get_config().CHUNK_SIZE;
+
+    small.push_back(1, true);
+    for (size_t i = 0; i < 4 * chunk_size; i++) {
+        large.push_back((int) i, false);
+    }
+    large.commit_cache();
+
+    EXPECT_EQ(small.num_chunks(), 1);
+    EXPECT_EQ(large.num_chunks(), 4);
+    EXPECT_EQ(small.serial_buf_size(), large.serial_buf_size());
+
+    // the column ends exactly on a chunk boundary
+    char* buf = large.serialize();
+    IntColumn* large2 = Column::deserialize(buf, &kvs)->as_int();
+
+    EXPECT_EQ(large2->size(), large.size());
+    EXPECT_EQ(large2->num_chunks(), large.num_chunks());
+    EXPECT_EQ(large2->get(0), 0);
+    EXPECT_EQ(large2->get(4 * chunk_size - 1), 4 * chunk_size - 1);
+
+    delete[] buf;
+    delete large2;
+}
+
+TEST(testColumn, testColumnDescriptorSize) {
+    test_column_descriptor_size();
+}
+
+// a promoted column reads the chunks of the narrower type that were written before it was promoted
+void test_column_promoted() {
+    KVStore kvs(false);
+    String s("promoted");
+    IntColumn ints(&s, &kvs);
+    size_t chunk_size = kvs.get_config().CHUNK_SIZE;
+    size_t rows = 2 * chunk_size + chunk_size / 2;
+    for (size_t i = 0; i < rows; i++) {
+        ints.push_back((int) i - 5, false);
+    }
+    ints.commit_cache();
+
+    Column* doubles = ints.promoted(DOUBLE);
+    EXPECT_EQ(doubles->get_type(), DOUBLE);
+    EXPECT_EQ(doubles->size(), rows);
+    EXPECT_EQ(doubles->as_double()->get(0), -5.0);
+    EXPECT_EQ(doubles->as_double()->get(rows - 1), (double) rows - 6);
+    // the last chunk is filled up as doubles
+    doubles->push_back(0.5, true);
+    EXPECT_EQ(doubles->as_double()->get(rows), 0.5);
+    EXPECT_EQ(doubles->as_double()->get(rows - 1), (double) rows - 6);
+    EXPECT_EQ(doubles->chunk_encoding(0), INT);
+    EXPECT_EQ(doubles->chunk_encoding(2), DOUBLE);
+
+    Column* strings = doubles->promoted(STRING);
+    strings->push_back(&s, true);
+    String* first = strings->as_string()->get(0);
+    String* half = strings->as_string()->get(rows);
+    String* last = strings->as_string()->get(rows + 1);
+    EXPECT_STREQ(first->c_str(), "-5");
+    EXPECT_STREQ(half->c_str(), "0.5");
+    EXPECT_TRUE(last->equals(&s));
+    delete first;
+    delete half;
+    delete last;
+
+    // the descriptor keeps the encodings, as runs of chunks
+    char* buf = strings->serialize();
+    Column* copy = Column::deserialize(buf, &kvs);
+    EXPECT_EQ(copy->serial_buf_size(), strings->serial_buf_size());
+    EXPECT_EQ(copy->chunk_encoding(1), INT);
+    EXPECT_EQ(copy->chunk_encoding(2), STRING);
+    String* copied = copy->as_string()->get(chunk_size + 1);
+    EXPECT_EQ(atoi(copied->c_str()), (int) chunk_size - 4);
+    delete copied;
+
+    delete[] buf;
+    delete copy;
+    delete strings;
+    delete doubles;
+}
+
+TEST(testColumn, testColumnPromoted) {
+    test_column_promoted();
+}
+
+// parsing a field validates it against the column type and gives the same values as atoi and atof
+void test_parse_fields() {
+    bool b;
+    EXPECT_TRUE(parse_bool("1", 1, b));
+    EXPECT_TRUE(b);
+    EXPECT_FALSE(parse_bool("10", 2, b));
+
+    int n;
+    EXPECT_TRUE(parse_int("-1234>", 5, n));
+    EXPECT_EQ(n, -1234);
+    EXPECT_TRUE(parse_int("+7", 2, n));
+    EXPECT_EQ(n, 7);
+    EXPECT_FALSE(parse_int("12.5", 4, n));
+    EXPECT_EQ(n, 12);
+    EXPECT_FALSE(parse_int("", 0, n));
+    EXPECT_TRUE(parse_int("2147483647", 10, n));
+    EXPECT_EQ(n, 2147483647);
+    EXPECT_TRUE(parse_int("-2147483648", 11, n));
+    EXPECT_EQ(n, -2147483647 - 1);
+    // does not fit an int, the column is widened to DOUBLE
+    EXPECT_FALSE(parse_int("2147483648", 10, n));
+    EXPECT_FALSE(parse_int("-2147483649", 11, n));
+    EXPECT_FALSE(parse_int("99999999999", 11, n));
+
+    const char* doubles[] = {"1.5", "-123.938", "+444", "0.1", ".25", "-0", "12444.21123", "3.14159265358979323846264338",
+        "123456789012345678901234", "0.0000000000000000000000000001"};
+    for (size_t i = 0; i < 10; i++) {
+        double d;
+        EXPECT_TRUE(parse_double(doubles[i], strlen(doubles[i]), d));
+        EXPECT_EQ(d, atof(doubles[i]));
+    }
+    double d;
+    EXPECT_FALSE(parse_double("1.2.3", 5, d));
+    EXPECT_FALSE(parse_double("1e5", 3, d));
+    EXPECT_FALSE(parse_double("hello", 5, d));
+}
+
+TEST(testColumn, testParseFields) {
+    test_parse_fields();
+}
@@ -415,6 +415,86 @@ TEST(testDataFrame, testDataFrameMap) {
 }
 
 
+// sums the int column, declares that it is the only column it reads
+class IntSummer : public Rower {
+    public:
+        long sum_ = 0;
+
+        bool accept(Row& r) {
+            sum_ += r.get_int(1);
+            return true;
+        }
+
+        bool reads_column(size_t col) { return col == 1; }
+};
+
+// keeps the rows whose bool is true, declares that it only reads the bool column
+class TrueFilter : public Rower {
+    public:
+        bool accept(Row& r) {
+            return r.get_bool(0);
+        }
+
+        bool reads_column(size_t col) { return col == 0; }
+};
+
+/**
+ * map, local_map and filter only fetch the columns that the rower reads.
+ */
+void test_projected_map() {
+    Key key(0, "projected");
+    KVStore kvs(false);
+    int size = 3 * kvs.get_config().CHUNK_SIZE + 5;
+    String s("apple");
+    DataFrame* df = build_data_frame(size, s, key, kvs);
+    df->commit();
+    long expected = (long) size * (size - 1) / 2;
+
+    Value* v = kvs.get(key);
+    ASSERT_NE(v, nullptr);
+    DataFrame* loaded = DataFrame::deserialize(v->get(), &kvs);
+    IntSummer summer;
+    loaded->map(summer);
+    EXPECT_EQ(summer.sum_, expected);
+    EXPECT_EQ(loaded->cols_[0]->cached_chunk_value_, nullptr);
+    EXPECT_EQ(loaded->cols_[2]->cached_chunk_value_, nullptr);
+    EXPECT_EQ(loaded->cols_[3]->cached_chunk_value_, nullptr);
+    delete loaded;
+
+    // the columns can be given explicitly
+    loaded = DataFrame::deserialize(v->get(), &kvs);
+    IntSummer local_summer;
+    size_t cols[] = {1};
+    loaded->local_map(local_summer, cols, 1);
+    EXPECT_EQ(local_summer.sum_, expected);
+    EXPECT_EQ(loaded->cols_[3]->cached_chunk_value_, nullptr);
+    delete loaded;
+
+    // the rows that are kept are complete
+    loaded = DataFrame::deserialize(v->get(), &kvs);
+    TrueFilter even;
+    Key filtered_key(0, "projected-filtered");
+    DataFrame* filtered = loaded->filter(even, filtered_key);
+    ASSERT_EQ(filtered->nrows(), (size_t) (size + 1) / 2);
+    for (size_t i = 0; i < filtered->nrows(); i += 101) {
+        EXPECT_TRUE(filtered->get_bool(0, i));
+        EXPECT_EQ(filtered->get_int(1, i), (int) i * 2);
+        EXPECT_DOUBLE_EQ(filtered->get_double(2, i), (i * 2.0) / (1.0 * size));
+        String* got = filtered->get_string(3, i);
+        EXPECT_TRUE(got->equals(&s));
+        delete got;
+    }
+
+    delete filtered;
+    delete loaded;
+    delete v;
+    delete df;
+}
+
+TEST(testDataFrame, testDataFrameProjectedMap) {
+    test_projected_map();
+}
+
 // ********************* Submitted test 3 *******************************
 // uses FilterOddRower from above
 
@@ -552,4 +632,48 @@ void test_dataframe_serialize() {
 
 TEST(testDataFrame, testDataFrameSerialize) {
     test_dataframe_serialize();
-}
\ No newline at end of file
+}
+// a saved dataframe loads back with the same values under a new key
+void test_dataframe_save_load() {
+    Key key(0, "saved");
+    Key loaded_key(0, "loaded");
+    KVStore kvs(false);
+    int size = 3 * kvs.get_config().CHUNK_SIZE + 5;
+    String s("apple");
+    DataFrame* df = build_data_frame(size, s, key, kvs);
+    const char* path = "/tmp/eau2-test-save.df";
+
+    df->save(path);
+    DataFrame* df2 = DataFrame::load(&loaded_key, &kvs, path);
+
+    ASSERT_EQ(df2->ncols(), df->ncols());
+    ASSERT_EQ(df2->nrows(), df->nrows());
+    for (size_t i = 0; i < df->ncols(); i++) {
+        EXPECT_EQ(df2->get_schema().col_type(i), df->get_schema().col_type(i));
+    }
+    for (int i = 0; i < size; i += 97) {
+        EXPECT_EQ(df2->get_bool(0, i), df->get_bool(0, i));
+        EXPECT_EQ(df2->get_int(1, i), df->get_int(1, i));
+        EXPECT_FLOAT_EQ(df2->get_double(2, i), df->get_double(2, i));
+        String* got = df2->get_string(3, i);
+        EXPECT_TRUE(got->equals(&s));
+        delete got;
+    }
+    EXPECT_EQ(df2->get_int(1, size - 1), size - 1);
+
+    // the loaded dataframe is in the kvstore
+    Value* v = kvs.get(loaded_key);
+    ASSERT_NE(v, nullptr);
+    DataFrame* df3 = DataFrame::deserialize(v->get(), &kvs);
+    EXPECT_EQ(df3->nrows(), df->nrows());
+
+    unlink(path);
+    delete v;
+    delete df;
+    delete df2;
+    delete df3;
+}
+
+TEST(testDataFrame, testDataFrameSaveLoad) {
+    test_dataframe_save_load();
+}
@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+
+#include "test_macros.h"
+#include "test_frames.h"
+#include "../../src/dataframe/expr.h"
+#include "../../src/dataframe/dataframe.h"
+
+// *************************** Expression Tests ***********************************
+
+// row i of a dataframe with the schema "IIDBS", see fill_frame
+void set_expr_row(Row& row, size_t i) {
+    row.set(0, (int) i);
+    row.set(1, (int) (i % 7));
+    row.set(2, i * 0.5);
+    row.set(3, i % 3 == 0);
+    row.set(4, new String(i % 2 == 0 ? "even" : "odd"));
+}
+
+/**
+ * where keeps the rows a predicate holds for, in order, across chunks.
+ */
+void test_where() {
+    Key key(0, "expr-in");
+    Key out_key(0, "expr-out");
+    KVStore kvs(false);
+    size_t size = 2 * kvs.get_config().CHUNK_SIZE + 5;
+    Schema schema("IIDBS");
+    DataFrame df(schema, key, &kvs);
+    fill_frame(df, 0, size, set_expr_row);
+
+    DataFrame* out = df.where(col<int>(0) > 5 && col<int>(1) == 3 && col<const char*>(4) == "odd", out_key);
+    ASSERT_EQ(out->ncols(), 5);
+    size_t expected = 0;
+    for (size_t i = 0; i < size; i++) {
+        if (i > 5 && i % 7 == 3 && i % 2 == 1) {
+            ASSERT_LT(expected, out->nrows());
+            EXPECT_EQ(out->get_int(0, expected), (int) i);
+            EXPECT_EQ(out->get_double(2, expected), i * 0.5);
+            EXPECT_EQ(out->get_bool(3, expected), i % 3 == 0);
+            String* s = out->get_string(4, expected);
+            EXPECT_STREQ(s->c_str(), "odd");
+            delete s;
+            expected++;
+        }
+    }
+    EXPECT_EQ(out->nrows(), expected);
+    delete out;
+}
+
+TEST(testExpr, testWhere) {
+    test_where();
+}
+
+/**
+ * The comparisons work on every type, and between columns, and combine with || and !.
+ */
+void test_count_where() {
+    Key key(0, "expr-count");
+    KVStore kvs(false);
+    size_t size = 3 * kvs.get_config().CHUNK_SIZE + 1;
+    Schema schema("IIDBS");
+    DataFrame df(schema, key, &kvs);
+    fill_frame(df, 0, size, set_expr_row);
+
+    size_t bools = 0;
+    size_t doubles = 0;
+    size_t either = 0;
+    size_t strings = 0;
+    size_t cols = 0;
+    for (size_t i = 0; i < size; i++) {
+        bools += i % 3 == 0 ? 1 : 0;
+        doubles += i * 0.5 < 100.0 ? 1 : 0;
+        either += i % 7 <= 1 || i % 3 != 0 ? 1 : 0;
+        strings += i % 2 == 0 ? 1 : 0;
+        cols += i % 7 >= i * 0.5 ? 1 : 0;
+    }
+    EXPECT_EQ(df.count_where(col<bool>(3) == true), bools);
+    EXPECT_EQ(df.count_where(col<double>(2) < 100.0), doubles);
+    EXPECT_EQ(df.count_where(col<int>(1) <= 1 || !(col<bool>(3) != false)), either);
+    EXPECT_EQ(df.count_where(col<const char*>(4) < "f"), strings);
+    EXPECT_EQ(df.count_where(col<int>(1) >= col<double>(2)), cols);
+    EXPECT_EQ(df.count_where(col<int>(0) >= 0), size);
+}
+
+TEST(testExpr, testCountWhere) {
+    test_count_where();
+}
+
+// a column past the last one of the dataframe
+void test_count_where_out_of_bounds() {
+    Key key(0, "expr-bounds");
+    KVStore kvs(false);
+    Schema schema("II");
+    DataFrame df(schema, key, &kvs);
+    Row row(df.get_schema());
+    row.set(0, 1);
+    row.set(1, 2);
+    df.add_row(row, false, false);
+    df.commit();
+    df.count_where(col<int>(7) > 5);
+    exit(0);
+}
+
+TEST(testExpr, testCountWhereExitOnOutOfBounds) {
+    CS4500_ASSERT_EXIT_255(test_count_where_out_of_bounds);
+}
+
+// a STRING column read as an int
+void test_where_wrong_type() {
+    Key key(0, "expr-type");
+    Key out_key(0, "expr-type-out");
+    KVStore kvs(false);
+    Schema schema("IIDBS");
+    DataFrame df(schema, key, &kvs);
+    fill_frame(df, 0, 10, set_expr_row);
+    df.where(col<int>(0) > 5 && col<int>(4) == 0, out_key);
+    exit(0);
+}
+
+TEST(testExpr, testWhereExitOnWrongType) {
+    CS4500_ASSERT_EXIT_255(test_where_wrong_type);
+}
+
+// the columns are checked even if there are no rows to read them for
+void test_where_view_wrong_type() {
+    Key key(0, "expr-view-type");
+    KVStore kvs(false);
+    Schema schema("ID");
+    DataFrame df(schema, key, &kvs);
+    df.where_view(col<int>(1) > 5);
+    exit(0);
+}
+
+TEST(testExpr, testWhereViewExitOnWrongType) {
+    CS4500_ASSERT_EXIT_255(test_where_view_wrong_type);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "../../src/dataframe/dataframe.h"
+#include "../../src/dataframe/row.h"
+
+// sets the values of row i of a test dataframe, strings are new and deleted once the row is added
+typedef void (*RowSetter)(Row& row, size_t i);
+
+// adds the rows first to first + size - 1 to df, set fills in each of them, and commits df
+void fill_frame(DataFrame& df, size_t first, size_t size, RowSetter set) {
+    Row row(df.get_schema());
+    for (size_t i = first; i < first + size; i++) {
+        set(row, i);
+        df.add_row(row, false, false);
+        row.delete_strings();
+    }
+    df.commit();
+}
@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+
+#include "test_macros.h"
+#include "../../src/dataframe/group_by.h"
+#include "../../src/dataframe/dataframe.h"
+
+// *************************** Group By Tests ***********************************
+
+// the words that test_group_by counts
+static const char* GROUP_WORDS[] = {"apple", "pear", "fig", "plum", "kiwi"};
+static const size_t NUM_GROUP_WORDS = 5;
+
+/**
+ * Every group gets one row with its count, sum, min and max.
+ */
+void test_group_by() {
+    Key key(0, "words");
+    Key out_key(0, "word-stats");
+    KVStore kvs(false);
+    size_t size = 3 * kvs.get_config().CHUNK_SIZE + 1;
+    Schema schema("SID");
+    DataFrame df(schema, key, &kvs);
+    Row row(df.get_schema());
+    for (size_t i = 0; i < size; i++) {
+        String word(GROUP_WORDS[i % NUM_GROUP_WORDS]);
+        row.set(0, &word);
+        row.set(1, (int) i);
+        row.set(2, 1.5);
+        df.add_row(row, false, false);
+    }
+    df.commit();
+
+    size_t key_cols[] = {0};
+    Aggregate aggs[] = {Aggregate::count(), Aggregate::sum(1), Aggregate::min(1), Aggregate::max(1), Aggregate::sum(2)};
+    DataFrame* groups = df.group_by(key_cols, 1, aggs, 5, out_key);
+
+    ASSERT_EQ(groups->nrows(), NUM_GROUP_WORDS);
+    ASSERT_EQ(groups->ncols(), 6);
+    EXPECT_EQ(groups->get_schema().col_type(0), STRING);
+    EXPECT_EQ(groups->get_schema().col_type(1), INT);
+    EXPECT_EQ(groups->get_schema().col_type(5), DOUBLE);
+    bool seen[NUM_GROUP_WORDS] = {false};
+    for (size_t g = 0; g < groups->nrows(); g++) {
+        String* word = groups->get_string(0, g);
+        size_t w = 0;
+        while (w < NUM_GROUP_WORDS && strcmp(word->c_str(), GROUP_WORDS[w]) != 0) {
+            w++;
+        }
+        ASSERT_LT(w, NUM_GROUP_WORDS);
+        EXPECT_FALSE(seen[w]);
+        seen[w] = true;
+
+        int count = 0, sum = 0;
+        for (size_t i = w; i < size; i += NUM_GROUP_WORDS) {
+            count++;
+            sum += (int) i;
+        }
+        EXPECT_EQ(groups->get_int(1, g), count);
+        EXPECT_EQ(groups->get_int(2, g), sum);
+        EXPECT_EQ(groups->get_int(3, g), (int) w);
+        EXPECT_EQ(groups->get_int(4, g), (int) (w + (count - 1) * NUM_GROUP_WORDS));
+        EXPECT_DOUBLE_EQ(groups->get_double(5, g), count * 1.5);
+        delete word;
+    }
+    delete groups;
+}
+
+TEST(testGroupBy, testGroupBy) {
+    test_group_by();
+}
+
+/**
+ * Groups can have more than one key column.
+ */
+void test_group_by_keys() {
+    Key key(0, "pairs");
+    Key out_key(0, "pair-counts");
+    KVStore kvs(false);
+    size_t size = 1000;
+    Schema schema("IBI");
+    DataFrame df(schema, key, &kvs);
+    Row row(df.get_schema());
+    for (size_t i = 0; i < size; i++) {
+        row.set(0, (int) (i % 4));
+        row.set(1, i % 2 == 0);
+        row.set(2, (int) i);
+        df.add_row(row, false, false);
+    }
+    df.commit();
+
+    size_t key_cols[] = {1, 0};
+    Aggregate aggs[] = {Aggregate::count()};
+    DataFrame* groups = df.group_by(key_cols, 2, aggs, 1, out_key);
+
+    // i % 4 decides i % 2, so there are only 4 groups
+    ASSERT_EQ(groups->nrows(), 4);
+    for (size_t g = 0; g < groups->nrows(); g++) {
+        EXPECT_EQ(groups->get_bool(0, g), groups->get_int(1, g) % 2 == 0);
+        EXPECT_EQ(groups->get_int(2, g), (int) size / 4);
+    }
+    delete groups;
+}
+
+TEST(testGroupBy, testGroupByKeys) {
+    test_group_by_keys();
+}
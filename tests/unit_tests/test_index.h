@@ -0,0 +1,161 @@
+#include <gtest/gtest.h>
+
+#include "test_macros.h"
+#include "test_frames.h"
+#include "../../src/dataframe/index.h"
+#include "../../src/dataframe/shuffle.h"
+#include "../../src/dataframe/dataframe.h"
+
+// *************************** Index Tests ***********************************
+
+// row i of a dataframe with the schema "ISI", see fill_frame
+void set_index_row(Row& row, size_t i) {
+    char name[16];
+    snprintf(name, sizeof(name), "name%zu", i % 7);
+    row.set(0, (int) (i % 50));
+    row.set(1, new String(name));
+    row.set(2, (int) i);
+}
+
+/**
+ * Point and range lookups find the same rows with and without an index.
+ */
+void test_index_lookup() {
+    Key key(0, "index-in");
+    KVStore kvs(false);
+    size_t size = 3 * kvs.get_config().CHUNK_SIZE + 5;
+    Schema schema("ISI");
+    DataFrame df(schema, key, &kvs);
+    fill_frame(df, 0, size, set_index_row);
+
+    RowIds* scanned = df.lookup(0, 7);
+    RowIds* scanned_range = df.lookup_range(0, 10, 12);
+    df.build_index(0);
+    df.build_index(1);
+    RowIds* found = df.lookup(0, 7);
+    RowIds* found_range = df.lookup_range(0, 10, 12);
+
+    ASSERT_EQ(found->size(), scanned->size());
+    EXPECT_EQ(found->size(), size / 50 + (size % 50 > 7 ? 1 : 0));
+    for (size_t i = 0; i < found->size(); i++) {
+        EXPECT_EQ(found->get(i), scanned->get(i));
+        EXPECT_EQ(df.get_int(0, found->get(i)), 7);
+    }
+    ASSERT_EQ(found_range->size(), scanned_range->size());
+    for (size_t i = 0; i < found_range->size(); i++) {
+        EXPECT_EQ(found_range->get(i), scanned_range->get(i));
+    }
+
+    RowIds* names = df.lookup(1, "name3");
+    size_t expected = 0;
+    for (size_t i = 0; i < size; i++) {
+        if (i % 7 == 3) {
+            ASSERT_LT(expected, names->size());
+            EXPECT_EQ(names->get(expected), i);
+            expected++;
+        }
+    }
+    EXPECT_EQ(names->size(), expected);
+
+    RowIds* missing = df.lookup(0, 50);
+    EXPECT_EQ(missing->size(), 0);
+
+    // the entries that were sent to build the index are removed once they are in their buckets
+    Key build(0, "index-in~index-0~build-0-0");
+    EXPECT_EQ(kvs.get(build), nullptr);
+
+    delete missing;
+    delete names;
+    delete found_range;
+    delete found;
+    delete scanned_range;
+    delete scanned;
+}
+
+TEST(testIndex, testIndexLookup) {
+    test_index_lookup();
+}
+
+/**
+ * Rows that are appended after the index is built are found, also when they are appended to a
+ * segment in the middle of the rows.
+ */
+void test_index_append() {
+    Key key(0, "index-append");
+    Key parted_key(0, "index-parted");
+    KVStore kvs(false);
+    size_t size = kvs.get_config().CHUNK_SIZE + 3;
+    Schema schema("ISI");
+    DataFrame df(schema, key, &kvs);
+    fill_frame(df, 0, size, set_index_row);
+    df.build_index(2);
+    fill_frame(df, size, 10, set_index_row);
+
+    RowIds* found = df.lookup(2, (int) (size + 4));
+    ASSERT_EQ(found->size(), 1);
+    EXPECT_EQ(found->get(0), size + 4);
+
+    // a segmented copy, rows are added to the segment of this node
+    DataFrame* parted = df.repartition(0, parted_key);
+    parted->build_index(2);
+    fill_frame(*parted, size + 10, 5, set_index_row);
+    for (int value = 0; value < (int) (size + 15); value += 97) {
+        RowIds* ids = parted->lookup(2, value);
+        ASSERT_EQ(ids->size(), 1);
+        EXPECT_EQ(parted->get_int(2, ids->get(0)), value);
+        delete ids;
+    }
+    RowIds* last = parted->lookup(2, (int) (size + 14));
+    ASSERT_EQ(last->size(), 1);
+    EXPECT_EQ(parted->get_int(2, last->get(0)), (int) (size + 14));
+
+    delete last;
+    delete parted;
+    delete found;
+}
+
+TEST(testIndex, testIndexAppend) {
+    test_index_append();
+}
+
+/**
+ * A dataframe read back from its descriptor has the index of the original, and rows appended to
+ * it are added to the same buckets.
+ */
+void test_index_descriptor() {
+    Key key(0, "index-descriptor");
+    KVStore kvs(false);
+    size_t size = 2 * kvs.get_config().CHUNK_SIZE + 5;
+    Schema schema("ISI");
+    DataFrame df(schema, key, &kvs);
+    fill_frame(df, 0, size, set_index_row);
+    df.build_index(0);
+
+    Value* descriptor = kvs.getAndWait(key);
+    DataFrame* copy = DataFrame::deserialize(descriptor->get(), &kvs);
+    delete descriptor;
+    ColumnIndex* index = index_of(*copy, 0);
+    ASSERT_NE(index, nullptr);
+    EXPECT_EQ(index->num_buckets(), index_of(df, 0)->num_buckets());
+    EXPECT_EQ(index_of(*copy, 2), nullptr);
+
+    RowIds* found = copy->lookup(0, 7);
+    RowIds* original = df.lookup(0, 7);
+    ASSERT_EQ(found->size(), original->size());
+    for (size_t i = 0; i < found->size(); i++) {
+        EXPECT_EQ(found->get(i), original->get(i));
+    }
+
+    fill_frame(*copy, size, 50, set_index_row);
+    RowIds* appended = df.lookup(0, 7);
+    EXPECT_EQ(appended->size(), found->size() + 1);
+
+    delete appended;
+    delete original;
+    delete found;
+    delete copy;
+}
+
+TEST(testIndex, testIndexDescriptor) {
+    test_index_descriptor();
+}
@@ -0,0 +1,185 @@
+#include <gtest/gtest.h>
+
+#include "test_macros.h"
+#include "../../src/dataframe/join.h"
+#include "../../src/dataframe/dataframe.h"
+
+// *************************** Join Tests ***********************************
+
+/**
+ * Every order is joined with the user that placed it, orders of unknown users are dropped.
+ * The orders are the bigger side, so the users are built into the hash table.
+ */
+void test_join() {
+    Key users_key(0, "users");
+    Key orders_key(0, "orders");
+    Key out_key(0, "user-orders");
+    KVStore kvs(false);
+    size_t num_users = 50;
+    size_t num_orders = 2 * kvs.get_config().CHUNK_SIZE + 7;
+
+    Schema user_schema("IS");
+    DataFrame users(user_schema, users_key, &kvs);
+    Row user(users.get_schema());
+    for (size_t i = 0; i < num_users; i++) {
+        StrBuff buf;
+        buf.c("user-");
+        buf.c(i);
+        String* name = buf.get();
+        user.set(0, (int) i);
+        user.set(1, name);
+        users.add_row(user, false, false);
+        delete name;
+    }
+    users.commit();
+
+    // orders of the users 0 to 59, the last ten users do not exist
+    Schema order_schema("IID");
+    DataFrame orders(order_schema, orders_key, &kvs);
+    Row order(orders.get_schema());
+    size_t matched = 0;
+    for (size_t i = 0; i < num_orders; i++) {
+        order.set(0, (int) i);
+        order.set(1, (int) (i % 60));
+        order.set(2, i * 0.5);
+        orders.add_row(order, false, false);
+        matched += i % 60 < num_users ? 1 : 0;
+    }
+    orders.commit();
+
+    DataFrame* joined = orders.join(users, 1, 0, out_key);
+    ASSERT_EQ(joined->ncols(), 4);
+    ASSERT_EQ(joined->nrows(), matched);
+    EXPECT_EQ(joined->get_schema().col_type(2), DOUBLE);
+    EXPECT_EQ(joined->get_schema().col_type(3), STRING);
+    bool* seen = new bool[num_orders];
+    for (size_t i = 0; i < num_orders; i++) {
+        seen[i] = false;
+    }
+    for (size_t r = 0; r < joined->nrows(); r++) {
+        int id = joined->get_int(0, r);
+        int uid = joined->get_int(1, r);
+        ASSERT_LT((size_t) id, num_orders);
+        EXPECT_FALSE(seen[id]);
+        seen[id] = true;
+        EXPECT_EQ(uid, id % 60);
+        EXPECT_DOUBLE_EQ(joined->get_double(2, r), id * 0.5);
+        String* name = joined->get_string(3, r);
+        StrBuff buf;
+        buf.c("user-");
+        buf.c((size_t) uid);
+        String* expected = buf.get();
+        EXPECT_STREQ(name->c_str(), expected->c_str());
+        delete expected;
+        delete name;
+    }
+    delete[] seen;
+    delete joined;
+}
+
+TEST(testJoin, testJoin) {
+    test_join();
+}
+
+/**
+ * Only the given columns are joined, every pair of rows with the same key is in the result.
+ * The left side is smaller here, so it is built into the hash table.
+ */
+void test_join_columns() {
+    Key left_key(0, "left");
+    Key right_key(0, "right");
+    Key out_key(0, "left-right");
+    KVStore kvs(false);
+
+    Schema left_schema("BII");
+    DataFrame left(left_schema, left_key, &kvs);
+    Row l(left.get_schema());
+    for (size_t i = 0; i < 10; i++) {
+        l.set(0, i % 2 == 0);
+        l.set(1, (int) (i % 5));
+        l.set(2, (int) i);
+        left.add_row(l, false, false);
+    }
+    left.commit();
+
+    Schema right_schema("IB");
+    DataFrame right(right_schema, right_key, &kvs);
+    Row r(right.get_schema());
+    for (size_t i = 0; i < 100; i++) {
+        r.set(0, (int) (i % 10));
+        r.set(1, i % 3 == 0);
+        right.add_row(r, false, false);
+    }
+    right.commit();
+
+    // the keys 0 to 4 are twice on the left and ten times on the right
+    size_t left_cols[] = {2};
+    size_t right_cols[] = {1, 0};
+    DataFrame* joined = left.join(right, 1, 0, left_cols, 1, right_cols, 2, out_key);
+    ASSERT_EQ(joined->ncols(), 3);
+    ASSERT_EQ(joined->nrows(), 100);
+    EXPECT_EQ(joined->get_schema().col_type(0), INT);
+    EXPECT_EQ(joined->get_schema().col_type(1), BOOL);
+    EXPECT_EQ(joined->get_schema().col_type(2), INT);
+    size_t trues = 0;
+    for (size_t i = 0; i < joined->nrows(); i++) {
+        EXPECT_EQ(joined->get_int(0, i) % 5, joined->get_int(2, i));
+        trues += joined->get_bool(1, i) ? 1 : 0;
+    }
+    // the right rows with keys 0 to 4 and i % 3 == 0, each joined with two left rows
+    size_t expected = 0;
+    for (size_t i = 0; i < 100; i++) {
+        expected += i % 10 < 5 && i % 3 == 0 ? 2 : 0;
+    }
+    EXPECT_EQ(trues, expected);
+    delete joined;
+}
+
+TEST(testJoin, testJoinColumns) {
+    test_join_columns();
+}
+
+/**
+ * Joining twice under the same key gives the same rows. Only the result and the value this node
+ * put for the last exchange are left in the store, the partitioned sides are removed.
+ */
+void test_join_twice() {
+    Key left_key(0, "twice-left");
+    Key right_key(0, "twice-right");
+    Key out_key(0, "twice-joined");
+    KVStore kvs(false);
+
+    Schema schema("II");
+    DataFrame left(schema, left_key, &kvs);
+    DataFrame right(schema, right_key, &kvs);
+    Row row(schema);
+    for (size_t i = 0; i < 3 * kvs.get_config().CHUNK_SIZE; i++) {
+        row.set(0, (int) (i % 40));
+        row.set(1, (int) i);
+        left.add_row(row, false, false);
+        if (i < 80) {
+            right.add_row(row, false, false);
+        }
+    }
+    left.commit();
+    right.commit();
+
+    for (size_t call = 0; call < 2; call++) {
+        size_t stored = kvs.map_.size();
+        DataFrame* joined = left.join(right, 0, 0, out_key);
+        EXPECT_EQ(joined->nrows(), 2 * 3 * kvs.get_config().CHUNK_SIZE);
+        size_t result_chunks = 0;
+        for (size_t c = 0; c < joined->ncols(); c++) {
+            result_chunks += joined->cols_[c]->num_chunks();
+        }
+        // the first call adds the chunks, the descriptor and the exchange value of the result,
+        // the second one overwrites them and replaces the exchange value of the first
+        EXPECT_EQ(kvs.map_.size(), call == 0 ? stored + result_chunks + 2 : stored);
+        EXPECT_EQ(kvs.num_retired(), 1);
+        delete joined;
+    }
+}
+
+TEST(testJoin, testJoinTwice) {
+    test_join_twice();
+}
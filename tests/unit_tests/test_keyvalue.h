@@ -124,6 +124,75 @@ TEST(testKey, testKeySerialBufSize) {
     test_key_serial_buf_size();
 }
 
+void test_chunk_key_equals() {
+    size_t id = Key::name_id("df:0x0");
+    Key key(1, id, 7);
+    Key same(1, id, 7);
+    Key other_node(2, id, 7);
+    Key other_chunk(1, id, 8);
+    Key other_col(1, Key::name_id("df:0x1"), 7);
+    Key named(1, "df:0x0");
+
+    EXPECT_TRUE(key.is_chunk());
+    EXPECT_FALSE(named.is_chunk());
+
+    EXPECT_TRUE(key.equals(&same));
+    EXPECT_EQ(key.hash(), same.hash());
+
+    EXPECT_FALSE(key.equals(&other_node));
+    EXPECT_FALSE(key.equals(&other_chunk));
+    EXPECT_FALSE(key.equals(&other_col));
+    EXPECT_FALSE(key.equals(&named));
+    EXPECT_FALSE(named.equals(&key));
+
+    EXPECT_NE(key.hash(), other_node.hash());
+    EXPECT_NE(key.hash(), other_chunk.hash());
+    EXPECT_NE(key.hash(), other_col.hash());
+}
+
+TEST(testKey, testChunkKeyEquals) {
+    test_chunk_key_equals();
+}
+
+void test_chunk_key_serialize() {
+    Key key(3, Key::name_id("some column"), 12345);
+
+    char* buf = key.serialize();
+    Key* other = Key::deserialize(buf);
+
+    EXPECT_TRUE(other->is_chunk());
+    EXPECT_TRUE(key.equals(other));
+    EXPECT_EQ(other->get_index(), 3);
+    EXPECT_EQ(other->get_chunk_idx(), 12345);
+
+    Key* copy = key.clone();
+    EXPECT_TRUE(key.equals(copy));
+
+    delete[] buf;
+    delete other;
+    delete copy;
+}
+
+TEST(testKey, testChunkKeySerialize) {
+    test_chunk_key_serialize();
+}
+
+void test_key_buff_get_chunk() {
+    String base("df:0x2");
+    KeyBuff kb(&base);
+    kb.set_node_index(4);
+
+    Key* k = kb.get_chunk(9);
+    Key expected(4, Key::name_id("df:0x2"), 9);
+    EXPECT_TRUE(k->equals(&expected));
+
+    delete k;
+}
+
+TEST(testKey, testKeyBuffGetChunk) {
+    test_key_buff_get_chunk();
+}
+
 // *************************** Value Tests ***********************************
 
 void test_value_get() {
@@ -2,6 +2,7 @@
 
 #include "../../src/kvstore/keyvaluestore.h"
 #include "../../src/kvstore/keyvalue.h"
+#include "../../src/dataframe/column.h"
 
 #include "test_macros.h"
 
@@ -15,10 +16,10 @@ void test_kvstore_put_get() {
     memcpy(v_buf, "A VALUE TEST", 13);
 
     char v2_buf[16];
-    memcpy(v_buf, "different value", 16);
+    memcpy(v2_buf, "different value", 16);
 
-    Value v(15, v_buf);
-    Value v2(20, v2_buf);
+    Value v(13, v_buf);
+    Value v2(16, v2_buf);
 
     EXPECT_EQ(kvs.get(key1), nullptr);
     EXPECT_EQ(kvs.get(other_node), nullptr);
@@ -41,9 +42,297 @@ void test_kvstore_put_get() {
     EXPECT_TRUE(v2.equals(kvs.get(key1)));
     EXPECT_EQ(kvs.get(other_node), nullptr);
     EXPECT_TRUE(v.equals(kvs.get(key2)));
+
+    size_t resident = kvs.resident_bytes();
+    EXPECT_TRUE(kvs.remove(key1));
+    EXPECT_FALSE(kvs.remove(key1));
+    EXPECT_EQ(kvs.get(key1), nullptr);
+    EXPECT_TRUE(v.equals(kvs.get(key2)));
+    EXPECT_EQ(kvs.resident_bytes(), resident - 16);
+    EXPECT_EQ(kvs.map_.size(), 1);
 }
 
 TEST(testKVStore, testKVStorePutGet) {
     test_kvstore_put_get();
 }
 
+
+void test_kvstore_chunk_keys() {
+    KVStore kvs(false);
+    Key named(0, "col");
+    Key chunk0(0, Key::name_id("col"), 0);
+    Key chunk1(0, Key::name_id("col"), 1);
+
+    char v_buf[6];
+    memcpy(v_buf, "chunk", 6);
+    char v2_buf[6];
+    memcpy(v2_buf, "named", 6);
+    Value v(6, v_buf);
+    Value v2(6, v2_buf);
+
+    kvs.put(chunk0, v);
+    kvs.put(named, v2);
+
+    Value* got = kvs.get(chunk0);
+    EXPECT_TRUE(v.equals(got));
+    delete got;
+
+    got = kvs.get(named);
+    EXPECT_TRUE(v2.equals(got));
+    delete got;
+
+    EXPECT_EQ(kvs.get(chunk1), nullptr);
+
+    // retired keys are removed in the order they were retired
+    kvs.retire(chunk0.clone());
+    kvs.retire(named.clone());
+    kvs.remove_retired(1);
+    EXPECT_EQ(kvs.get(chunk0), nullptr);
+    EXPECT_EQ(kvs.num_retired(), 1);
+    got = kvs.get(named);
+    EXPECT_TRUE(v2.equals(got));
+    delete got;
+    kvs.remove_retired(1);
+    EXPECT_EQ(kvs.map_.size(), 0);
+}
+
+TEST(testKVStore, testKVStoreChunkKeys) {
+    test_kvstore_chunk_keys();
+}
+
+// hands the request back as its result
+class EchoExecutor : public Executor {
+    public:
+        Value* execute(const char* request, size_t len) {
+            return new Value(len, (char*) request);
+        }
+};
+
+// work shipped to a node without an executor is refused once the wait is over, and the result of
+// the work follows the status byte once the executor is set
+void test_kvstore_exec_handler() {
+    KVStore kvs(false);
+    kvs.executor_wait_ = 0;
+    KVStoreMessageHandler handler(&kvs);
+    sockaddr_in sender = { 0 };
+    char request[] = "work";
+
+    Response* refused = handler.handle_exec(sender, 4, request);
+    ASSERT_EQ(refused->get_payload_size(), 1);
+    EXPECT_TRUE(refused->get_payload()[0] == KVStore::EXEC_NO_EXECUTOR);
+    delete refused;
+
+    kvs.set_executor(new EchoExecutor());
+    Response* done = handler.handle_exec(sender, 4, request);
+    ASSERT_EQ(done->get_payload_size(), 5);
+    EXPECT_TRUE(done->get_payload()[0] == KVStore::EXEC_OK);
+    EXPECT_EQ(memcmp(done->get_payload() + 1, "work", 4), 0);
+    delete done;
+}
+
+TEST(testKVStore, testKVStoreExecHandler) {
+    test_kvstore_exec_handler();
+}
+
+// values over the memory budget are spilled to disk and read back unchanged
+void test_kvstore_spill() {
+    KVStore kvs(false);
+    kvs.set_memory_budget(100);
+    size_t num = 20;
+    char buf[40];
+
+    for (size_t i = 0; i < num; i++) {
+        Key k(0, Key::name_id("spill"), i);
+        memset(buf, 'a' + i, 40);
+        Value v(40, buf);
+        kvs.put(k, v);
+        EXPECT_LE(kvs.resident_bytes(), 100);
+    }
+    EXPECT_GT(kvs.spill_count(), 0);
+
+    // replace a value that was spilled
+    Key first(0, Key::name_id("spill"), 0);
+    memset(buf, 'z', 40);
+    Value replaced(40, buf);
+    kvs.put(first, replaced);
+
+    for (size_t i = 0; i < num; i++) {
+        Key k(0, Key::name_id("spill"), i);
+        memset(buf, i == 0 ? 'z' : 'a' + i, 40);
+        Value expected(40, buf);
+        Value* got = kvs.get(k);
+        EXPECT_TRUE(expected.equals(got));
+        delete got;
+    }
+    EXPECT_GT(kvs.fault_count(), 0);
+    EXPECT_LE(kvs.resident_bytes(), 100);
+}
+
+TEST(testKVStore, testKVStoreSpill) {
+    test_kvstore_spill();
+}
+
+// the copies on disk of values that are replaced or removed are dropped, and so are their segments
+void test_kvstore_spill_reclaim() {
+    KVStore kvs(false);
+    kvs.set_memory_budget(100);
+    size_t num = 20;
+    char buf[40];
+    for (size_t i = 0; i < num; i++) {
+        Key k(0, Key::name_id("reclaim"), i);
+        memset(buf, 'a' + i, 40);
+        Value v(40, buf);
+        kvs.put(k, v);
+    }
+    size_t spilled = kvs.spilled_bytes();
+    EXPECT_GT(spilled, 0);
+
+    Key first(0, Key::name_id("reclaim"), 0);
+    memset(buf, 'z', 40);
+    Value replaced(40, buf);
+    kvs.put(first, replaced);
+    for (size_t i = 1; i < num; i++) {
+        Key k(0, Key::name_id("reclaim"), i);
+        EXPECT_TRUE(kvs.remove(k));
+    }
+    EXPECT_EQ(kvs.spilled_bytes(), 0);
+    struct stat st;
+    char* name = kvs.spill_->seg_name_(0);
+    ASSERT_EQ(stat(name, &st), 0);
+    EXPECT_EQ(st.st_size, 0);
+    delete[] name;
+    Value* got = kvs.get(first);
+    EXPECT_TRUE(replaced.equals(got));
+    delete got;
+
+    // a segment that values are no longer appended to is deleted
+    SpillFile spill("/tmp", 100);
+    size_t segs[5];
+    size_t offsets[5];
+    Value v(40, buf);
+    for (size_t i = 0; i < 5; i++) {
+        spill.append(v, segs[i], offsets[i]);
+    }
+    EXPECT_EQ(spill.num_segs_, 3);
+    EXPECT_EQ(spill.disk_bytes(), 200);
+    spill.release(segs[0], 40);
+    EXPECT_EQ(spill.disk_bytes(), 200);
+    spill.release(segs[1], 40);
+    EXPECT_EQ(spill.disk_bytes(), 120);
+    name = spill.seg_name_(0);
+    EXPECT_NE(access(name, F_OK), 0);
+    delete[] name;
+    Value* read = spill.read(segs[2], offsets[2], 40);
+    EXPECT_TRUE(v.equals(read));
+    delete read;
+}
+
+TEST(testKVStore, testKVStoreSpillReclaim) {
+    test_kvstore_spill_reclaim();
+}
+
+// a column that does not fit in the budget is still read back in full
+void test_kvstore_spill_column() {
+    KVStore kvs(false);
+    size_t chunk_bytes = kvs.get_config().CHUNK_SIZE * sizeof(int);
+    kvs.set_memory_budget(2 * chunk_bytes);
+    String s("spilled");
+    IntColumn ic(&s, &kvs);
+    size_t num = 10 * kvs.get_config().CHUNK_SIZE;
+
+    for (size_t i = 0; i < num; i++) {
+        ic.push_back((int) i, false);
+    }
+    ic.commit_cache();
+
+    for (size_t i = 0; i < num; i += 7) {
+        EXPECT_EQ(ic.get(i), (int) i);
+    }
+    EXPECT_GT(kvs.spill_count(), 0);
+    EXPECT_GT(kvs.fault_count(), 0);
+}
+
+TEST(testKVStore, testKVStoreSpillColumn) {
+    test_kvstore_spill_column();
+}
+
+// a snapshot restores every local value, including spilled ones
+void test_kvstore_snapshot() {
+    const char* dir = "/tmp";
+    char buf[40];
+    KVStore* kvs = new KVStore(false);
+    kvs->set_memory_budget(100);
+    for (size_t i = 0; i < 10; i++) {
+        Key k(0, Key::name_id("snap"), i);
+        memset(buf, 'a' + i, 40);
+        Value v(40, buf);
+        kvs->put(k, v);
+    }
+    Key named(0, "named");
+    Value v(6, (char*) "named");
+    kvs->put(named, v);
+    kvs->snapshot(dir);
+    delete kvs;
+
+    KVStore restored(false);
+    EXPECT_FALSE(restored.restored());
+    EXPECT_TRUE(restored.restore(dir));
+    for (size_t i = 0; i < 10; i++) {
+        Key k(0, Key::name_id("snap"), i);
+        memset(buf, 'a' + i, 40);
+        Value expected(40, buf);
+        Value* got = restored.get(k);
+        EXPECT_TRUE(expected.equals(got));
+        delete got;
+    }
+    Value* got = restored.get(named);
+    EXPECT_TRUE(v.equals(got));
+    delete got;
+
+    unlink("/tmp/node-0.snap");
+    EXPECT_FALSE(restored.restore(dir));
+}
+
+TEST(testKVStore, testKVStoreSnapshot) {
+    test_kvstore_snapshot();
+}
+
+void test_kvstore_put_async() {
+    KVStore kvs(false);
+    // more puts than fit in the queue, so put_async has to wait for the senders
+    size_t puts = Config::PUT_QUEUE_LEN * 3;
+    for (size_t i = 0; i < puts; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "async-%zu", i);
+        Value* v = new Value(sizeof(size_t));
+        memcpy(v->get(), &i, sizeof(size_t));
+        kvs.put_async(new Key(0, name), v);
+    }
+    kvs.flush_puts();
+
+    for (size_t i = 0; i < puts; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "async-%zu", i);
+        Key k(name);
+        Value* v = kvs.get(k);
+        ASSERT_NE(v, nullptr);
+        size_t stored;
+        memcpy(&stored, v->get(), sizeof(size_t));
+        EXPECT_EQ(stored, i);
+        delete v;
+    }
+
+    // the store can put in the background again after a flush
+    Value* again = new Value(sizeof(size_t));
+    memcpy(again->get(), &puts, sizeof(size_t));
+    kvs.put_async(new Key(0, "again"), again);
+    kvs.flush_puts();
+    Key k("again");
+    Value* v = kvs.get(k);
+    ASSERT_NE(v, nullptr);
+    delete v;
+}
+
+TEST(testKVStore, testKVStorePutAsync) {
+    test_kvstore_put_async();
+}
@@ -0,0 +1,324 @@
+#include <gtest/gtest.h>
+
+#include "../../src/dataframe/placement.h"
+#include "../../src/dataframe/dataframe.h"
+#include "../../src/kvstore/keyvaluestore.h"
+
+#include "test_macros.h"
+
+// *************************** Placement Tests ***********************************
+
+void test_placement_home() {
+    Placement* rr = Placement::round_robin(3);
+    Placement* range = Placement::range(3, 2);
+    Placement* single = Placement::single_node(3, 1);
+    Placement* hash = Placement::hash(3, 0);
+
+    size_t rr_homes[] = {0, 1, 2, 0, 1, 2, 0};
+    size_t range_homes[] = {0, 0, 1, 1, 2, 2, 0};
+    for (size_t i = 0; i < 7; i++) {
+        EXPECT_EQ(rr->home(i), rr_homes[i]);
+        EXPECT_EQ(range->home(i), range_homes[i]);
+        EXPECT_EQ(single->home(i), 1);
+        EXPECT_EQ(hash->home(i), i % 3);
+    }
+
+    delete rr;
+    delete range;
+    delete single;
+    delete hash;
+}
+
+TEST(testPlacement, testPlacementHome) {
+    test_placement_home();
+}
+
+// rows of a HASH placement are stored segment by segment
+void test_placement_hash_segments() {
+    size_t chunk_size = 4;
+    Placement hash(HASH, 3, 0);
+    size_t chunk_idx, offset;
+
+    // 5 rows on node 1, 2 rows on node 2, none on node 0
+    for (size_t i = 0; i < 5; i++) {
+        hash.append_slot(0, 1, chunk_size, chunk_idx, offset);
+        EXPECT_EQ(chunk_idx, (i / chunk_size) * 3 + 1);
+        EXPECT_EQ(offset, i % chunk_size);
+        hash.appended(1);
+    }
+    hash.appended(2);
+    hash.appended(2);
+
+    EXPECT_EQ(hash.seg_start(1), 0);
+    EXPECT_EQ(hash.seg_start(2), 5);
+
+    hash.locate(4, chunk_size, chunk_idx, offset);
+    EXPECT_EQ(chunk_idx, 4);
+    EXPECT_EQ(offset, 0);
+
+    hash.locate(6, chunk_size, chunk_idx, offset);
+    EXPECT_EQ(chunk_idx, 2);
+    EXPECT_EQ(offset, 1);
+
+    size_t start = 0;
+    size_t end = 0;
+    EXPECT_FALSE(hash.next_local_rows(0, 7, chunk_size, start, end));
+    end = 0;
+    EXPECT_TRUE(hash.next_local_rows(1, 7, chunk_size, start, end));
+    EXPECT_EQ(start, 0);
+    EXPECT_EQ(end, 5);
+    EXPECT_FALSE(hash.next_local_rows(1, 7, chunk_size, start, end));
+    end = 0;
+    EXPECT_TRUE(hash.next_local_rows(2, 7, chunk_size, start, end));
+    EXPECT_EQ(start, 5);
+    EXPECT_EQ(end, 7);
+}
+
+TEST(testPlacement, testPlacementHashSegments) {
+    test_placement_hash_segments();
+}
+
+// contiguous local chunks are returned as one run
+void test_placement_local_runs() {
+    size_t chunk_size = 10;
+    size_t len = 95;  // 10 chunks
+    Placement range(RANGE, 2, 3);
+    Placement rr(ROUND_ROBIN, 2, 0);
+    size_t start = 0;
+    size_t end = 0;
+
+    // chunks 0-2 and 6-8 are on node 0
+    EXPECT_TRUE(range.next_local_rows(0, len, chunk_size, start, end));
+    EXPECT_EQ(start, 0);
+    EXPECT_EQ(end, 30);
+    EXPECT_TRUE(range.next_local_rows(0, len, chunk_size, start, end));
+    EXPECT_EQ(start, 60);
+    EXPECT_EQ(end, 90);
+    EXPECT_FALSE(range.next_local_rows(0, len, chunk_size, start, end));
+
+    // chunks 3-5 and 9 are on node 1, chunk 9 is not full
+    start = end = 0;
+    EXPECT_TRUE(range.next_local_rows(1, len, chunk_size, start, end));
+    EXPECT_EQ(start, 30);
+    EXPECT_EQ(end, 60);
+    EXPECT_TRUE(range.next_local_rows(1, len, chunk_size, start, end));
+    EXPECT_EQ(start, 90);
+    EXPECT_EQ(end, 95);
+
+    start = end = 0;
+    EXPECT_TRUE(rr.next_local_rows(1, len, chunk_size, start, end));
+    EXPECT_EQ(start, 10);
+    EXPECT_EQ(end, 20);
+}
+
+TEST(testPlacement, testPlacementLocalRuns) {
+    test_placement_local_runs();
+}
+
+void test_placement_serialize() {
+    Placement hash(HASH, 3, 2);
+    hash.appended(0);
+    hash.appended(2);
+    hash.appended(2);
+
+    char* buf = new char[hash.serial_buf_size()];
+    hash.serialize(buf);
+    Placement* other = Placement::deserialize(buf);
+
+    EXPECT_TRUE(hash.equals(other));
+    EXPECT_EQ(other->key_col(), 2);
+    EXPECT_EQ(other->seg_len(0), 1);
+    EXPECT_EQ(other->seg_len(1), 0);
+    EXPECT_EQ(other->seg_len(2), 2);
+
+    delete[] buf;
+    delete other;
+}
+
+TEST(testPlacement, testPlacementSerialize) {
+    test_placement_serialize();
+}
+
+// a HASH placed DataFrame stages rows and keeps all of them
+void test_dataframe_hash_placement() {
+    KVStore kvs(false);
+    Key key(0, "hashed");
+    Schema schema("IS");
+    Placement* placement = Placement::hash(kvs.num_nodes(), 0);
+    DataFrame df(schema, key, &kvs, *placement, false);
+    Row row(schema);
+    size_t num_rows = 3 * kvs.get_config().CHUNK_SIZE + 7;
+    String s("value");
+
+    for (size_t i = 0; i < num_rows; i++) {
+        row.set(0, (int) i);
+        row.set(1, &s);
+        df.add_row(row, false, false);
+    }
+    df.commit();
+
+    ASSERT_EQ(df.nrows(), num_rows);
+    EXPECT_EQ(df.get_int(0, 0), 0);
+    EXPECT_EQ(df.get_int(0, num_rows - 1), (int) num_rows - 1);
+    String* got = df.get_string(1, num_rows - 1);
+    EXPECT_TRUE(got->equals(&s));
+    delete got;
+
+    char* buf = df.serialize();
+    DataFrame* df2 = DataFrame::deserialize(buf, &kvs);
+    EXPECT_EQ(df2->get_placement().kind(), HASH);
+    EXPECT_EQ(df2->nrows(), num_rows);
+    EXPECT_EQ(df2->get_int(0, 1234), 1234);
+
+    delete[] buf;
+    delete df2;
+    delete placement;
+}
+
+TEST(testPlacement, testDataFrameHashPlacement) {
+    test_dataframe_hash_placement();
+}
+
+// every copy of a replicated chunk is on a different node, and reads stay local when possible
+void test_placement_replicas() {
+    Placement rr(ROUND_ROBIN, 4, 0);
+    rr.set_replicas(2);
+
+    // chunk 3 is homed on node 3 and copied to node 0
+    EXPECT_EQ(rr.replica(3, 0), 3);
+    EXPECT_EQ(rr.replica(3, 1), 0);
+    EXPECT_TRUE(rr.is_replica(3, 0));
+    EXPECT_FALSE(rr.is_replica(3, 1));
+    EXPECT_EQ(rr.nearest(3, 0), 0);
+    EXPECT_EQ(rr.nearest(3, 1), 3);
+
+    Placement* broadcast = Placement::broadcast(4);
+    EXPECT_EQ(broadcast->replicas(), 4);
+    for (size_t node = 0; node < 4; node++) {
+        EXPECT_EQ(broadcast->nearest(5, node), node);
+    }
+    EXPECT_FALSE(broadcast->equals(&rr));
+
+    char* buf = new char[broadcast->serial_buf_size()];
+    broadcast->serialize(buf);
+    Placement* other = Placement::deserialize(buf);
+    EXPECT_TRUE(broadcast->equals(other));
+    EXPECT_EQ(other->replicas(), 4);
+
+    delete[] buf;
+    delete other;
+    delete broadcast;
+}
+
+TEST(testPlacement, testPlacementReplicas) {
+    test_placement_replicas();
+}
+
+// LOCAL segments are homed on the node that owns them, and segments of different length leave gaps in the chunk indices
+void test_placement_local() {
+    Placement* local = Placement::local(2, 3);
+    EXPECT_EQ(local->num_segs(), 6);
+    EXPECT_EQ(local->seg_node(2), 0);
+    EXPECT_EQ(local->seg_node(3), 1);
+    EXPECT_EQ(local->home(4), 1);
+    EXPECT_EQ(local->home(7), 0);
+
+    // 5 rows in segment 0, 2 rows in segment 1, 3 rows in segment 4, with chunks of 2 rows
+    size_t chunk_idx, offset;
+    size_t lens[] = {5, 2, 0, 0, 3, 0};
+    for (size_t seg = 0; seg < 6; seg++) {
+        for (size_t i = 0; i < lens[seg]; i++) {
+            local->append_slot(0, seg, 2, chunk_idx, offset);
+            local->appended(seg);
+        }
+    }
+    EXPECT_EQ(local->seg_start(4), 7);
+    local->locate(4, 2, chunk_idx, offset);
+    EXPECT_EQ(chunk_idx, 12);
+    EXPECT_EQ(offset, 0);
+    local->locate(9, 2, chunk_idx, offset);
+    EXPECT_EQ(chunk_idx, 10);
+    EXPECT_EQ(offset, 0);
+    EXPECT_EQ(local->chunk_slots(10, 2), 13);
+    EXPECT_TRUE(local->has_chunk(12, 10, 2));
+    EXPECT_FALSE(local->has_chunk(7, 10, 2));
+    EXPECT_FALSE(local->has_chunk(2, 10, 2));
+
+    // node 0 has the rows of segments 0 and 1, node 1 the rows of segment 4
+    size_t start = 0;
+    size_t end = 0;
+    EXPECT_TRUE(local->next_local_rows(0, 10, 2, start, end));
+    EXPECT_EQ(start, 0);
+    EXPECT_EQ(end, 7);
+    EXPECT_FALSE(local->next_local_rows(0, 10, 2, start, end));
+    start = 0;
+    end = 0;
+    EXPECT_TRUE(local->next_local_rows(1, 10, 2, start, end));
+    EXPECT_EQ(start, 7);
+    EXPECT_EQ(end, 10);
+
+    Placement* other = Placement::local(2, 3);
+    other->add_segs(*local);
+    EXPECT_EQ(other->seg_len(4), 3);
+
+    char* buf = new char[local->serial_buf_size()];
+    local->serialize(buf);
+    Placement* copy = Placement::deserialize(buf);
+    EXPECT_TRUE(local->equals(copy));
+    EXPECT_EQ(copy->seg_len(0), 5);
+    EXPECT_EQ(copy->seg_len(4), 3);
+
+    delete[] buf;
+    delete copy;
+    delete other;
+    delete local;
+}
+
+TEST(testPlacement, testPlacementLocal) {
+    test_placement_local();
+}
+
+// a LOCAL dataframe with a short segment skips chunk indices, saving and loading keeps them
+void test_dataframe_local_placement() {
+    KVStore kvs(false);
+    size_t chunk_size = kvs.get_config().CHUNK_SIZE;
+    Schema schema("I");
+    Key key("local-df");
+    Placement* placement = Placement::local(1, 2);
+    DataFrame df(schema, key, &kvs, *placement, false);
+    Row row(schema);
+    size_t first = chunk_size * 2 + 10;
+    size_t second = chunk_size / 2;
+    for (size_t i = 0; i < first + second; i++) {
+        if (i == first) {
+            df.set_local_seg(1);
+        }
+        row.set(0, (int) i);
+        df.add_row(row, false, false);
+    }
+    df.commit();
+
+    ASSERT_EQ(df.nrows(), first + second);
+    EXPECT_EQ(df.cols_[0]->num_chunks(), 4);
+    EXPECT_EQ(df.cols_[0]->chunk_slots(), 5);
+    EXPECT_FALSE(df.cols_[0]->has_chunk(3));
+    EXPECT_EQ(df.get_int(0, first - 1), (int) first - 1);
+    EXPECT_EQ(df.get_int(0, first), (int) first);
+
+    const char* path = "/tmp/eau2-test-local.df";
+    df.save(path);
+    Key loaded_key("local-loaded");
+    DataFrame* loaded = DataFrame::load(&loaded_key, &kvs, path);
+    EXPECT_EQ(loaded->get_placement().kind(), LOCAL);
+    ASSERT_EQ(loaded->nrows(), first + second);
+    EXPECT_EQ(loaded->get_int(0, first - 1), (int) first - 1);
+    EXPECT_EQ(loaded->get_int(0, first + second - 1), (int) (first + second - 1));
+
+    unlink(path);
+    delete loaded;
+    delete placement;
+}
+
+TEST(testPlacement, testDataFrameLocalPlacement) {
+    test_dataframe_local_placement();
+}
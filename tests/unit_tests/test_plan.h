@@ -0,0 +1,180 @@
+#include <gtest/gtest.h>
+
+#include "test_macros.h"
+#include "../../src/dataframe/plan.h"
+#include "../../src/dataframe/dataframe.h"
+
+// *************************** Lazy Plan Tests ***********************************
+
+// accepts the rows whose int in column col_ is even
+class EvenFilter : public Rower {
+    public:
+        size_t col_;
+        size_t seen_;
+
+        EvenFilter(size_t col) {
+            col_ = col;
+            seen_ = 0;
+        }
+
+        bool accept(Row& r) {
+            seen_++;
+            return r.get_int(col_) % 2 == 0;
+        }
+
+        bool reads_column(size_t col) {
+            return col == col_;
+        }
+};
+
+// sums column 0 of the rows it sees
+class FirstSummer : public Rower {
+    public:
+        int sum_;
+
+        FirstSummer() {
+            sum_ = 0;
+        }
+
+        bool accept(Row& r) {
+            sum_ += r.get_int(0);
+            return true;
+        }
+
+        bool reads_column(size_t col) {
+            return col == 0;
+        }
+};
+
+/**
+ * The stages of a plan run in one pass, each sees the columns of the stage before it.
+ */
+void test_lazy_collect() {
+    Key key(0, "lazy-in");
+    Key out_key(0, "lazy-out");
+    KVStore kvs(false);
+    size_t size = 3 * kvs.get_config().CHUNK_SIZE + 9;
+    Schema schema("IIDS");
+    DataFrame df(schema, key, &kvs);
+    Row row(df.get_schema());
+    String word("word");
+    for (size_t i = 0; i < size; i++) {
+        row.set(0, (int) i);
+        row.set(1, (int) (i / 3));
+        row.set(2, i * 0.5);
+        row.set(3, &word);
+        df.add_row(row, false, false);
+    }
+    df.commit();
+
+    // keep the rows with an even column 0, then the ones with an even column 1 among them
+    EvenFilter first(0);
+    EvenFilter second(0);
+    FirstSummer summer;
+    size_t cols[] = {1, 3};
+    DataFrame* out = df.lazy().filter(first).project(cols, 2).filter(second).map(summer).collect(out_key);
+
+    EXPECT_EQ(first.seen_, size);
+    ASSERT_EQ(out->ncols(), 2);
+    EXPECT_EQ(out->get_schema().col_type(0), INT);
+    EXPECT_EQ(out->get_schema().col_type(1), STRING);
+    size_t expected = 0;
+    int sum = 0;
+    for (size_t i = 0; i < size; i++) {
+        if (i % 2 == 0 && (i / 3) % 2 == 0) {
+            ASSERT_LT(expected, out->nrows());
+            EXPECT_EQ(out->get_int(0, expected), (int) (i / 3));
+            expected++;
+            sum += (int) (i / 3);
+        }
+    }
+    EXPECT_EQ(out->nrows(), expected);
+    EXPECT_EQ(second.seen_, size / 2 + size % 2);
+    EXPECT_EQ(summer.sum_, sum);
+    String* s = out->get_string(1, 0);
+    EXPECT_STREQ(s->c_str(), "word");
+    delete s;
+    delete out;
+}
+
+TEST(testPlan, testLazyCollect) {
+    test_lazy_collect();
+}
+
+/**
+ * A pipeline only reads the columns that some stage reads, traced back through projections.
+ */
+void test_lazy_columns() {
+    Key key(0, "lazy-cols");
+    KVStore kvs(false);
+    Schema schema("IIII");
+    DataFrame df(schema, key, &kvs);
+
+    EvenFilter filter(3);
+    FirstSummer summer;
+    size_t cols[] = {2, 1};
+    LazyFrame plan = df.lazy();
+    plan.filter(filter).project(cols, 2);
+    PipelineRower pipeline(plan.stages_.values_, plan.stages_.size(), plan.get_schema(), summer);
+    EXPECT_FALSE(pipeline.reads_column(0));
+    EXPECT_FALSE(pipeline.reads_column(1));
+    EXPECT_TRUE(pipeline.reads_column(2));
+    EXPECT_TRUE(pipeline.reads_column(3));
+}
+
+TEST(testPlan, testLazyColumns) {
+    test_lazy_columns();
+}
+
+/**
+ * A plan that ends in a group by aggregates the rows as they come out of the filter.
+ */
+void test_lazy_group_by() {
+    Key key(0, "lazy-groups-in");
+    Key out_key(0, "lazy-groups");
+    Key eager_key(0, "eager-groups");
+    Key filtered_key(0, "eager-filtered");
+    KVStore kvs(false);
+    size_t size = 2 * kvs.get_config().CHUNK_SIZE + 1;
+    Schema schema("III");
+    DataFrame df(schema, key, &kvs);
+    Row row(df.get_schema());
+    for (size_t i = 0; i < size; i++) {
+        row.set(0, (int) i);
+        row.set(1, (int) (i % 7));
+        row.set(2, (int) (i % 4));
+        df.add_row(row, false, false);
+    }
+    df.commit();
+
+    EvenFilter even(0);
+    size_t cols[] = {1, 2};
+    size_t key_cols[] = {0};
+    Aggregate aggs[] = {Aggregate::count(), Aggregate::sum(1)};
+    DataFrame* lazy = df.lazy().filter(even).project(cols, 2).group_by(key_cols, 1, aggs, 2, out_key);
+
+    // the same query, one operator at a time
+    DataFrame* filtered = df.filter(even, filtered_key);
+    size_t eager_keys[] = {1};
+    Aggregate eager_aggs[] = {Aggregate::count(), Aggregate::sum(2)};
+    DataFrame* eager = filtered->group_by(eager_keys, 1, eager_aggs, 2, eager_key);
+
+    ASSERT_EQ(lazy->nrows(), 7);
+    ASSERT_EQ(eager->nrows(), 7);
+    for (size_t i = 0; i < lazy->nrows(); i++) {
+        size_t j = 0;
+        while (j < eager->nrows() && eager->get_int(0, j) != lazy->get_int(0, i)) {
+            j++;
+        }
+        ASSERT_LT(j, eager->nrows());
+        EXPECT_EQ(lazy->get_int(1, i), eager->get_int(1, j));
+        EXPECT_EQ(lazy->get_int(2, i), eager->get_int(2, j));
+    }
+    delete eager;
+    delete filtered;
+    delete lazy;
+}
+
+TEST(testPlan, testLazyGroupBy) {
+    test_lazy_group_by();
+}
@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+
+#include "test_macros.h"
+#include "../../src/dataframe/semi_join.h"
+#include "../../src/dataframe/dataframe.h"
+
+// *************************** Semi Join Tests ***********************************
+
+/**
+ * Commits of the tagged users are kept. The uids are a small range, so the membership is an
+ * exact bitmap.
+ */
+void test_semi_join_exact() {
+    Key commits_key(0, "semi-commits");
+    Key tagged_key(0, "semi-tagged");
+    Key out_key(0, "semi-out");
+    KVStore kvs(false);
+    size_t size = 3 * kvs.get_config().CHUNK_SIZE + 11;
+    Schema commit_schema("II");
+    DataFrame commits(commit_schema, commits_key, &kvs);
+    Row commit(commits.get_schema());
+    for (size_t i = 0; i < size; i++) {
+        commit.set(0, (int) i);
+        commit.set(1, (int) (i % 100));
+        commits.add_row(commit, false, false);
+    }
+    commits.commit();
+
+    // the uids 10, 15, ..., 95, twice each
+    Schema tagged_schema("I");
+    DataFrame tagged(tagged_schema, tagged_key, &kvs);
+    Row uid(tagged.get_schema());
+    for (size_t i = 0; i < 36; i++) {
+        uid.set(0, (int) (10 + (i % 18) * 5));
+        tagged.add_row(uid, false, false);
+    }
+    tagged.commit();
+
+    Membership* exact = Membership::exact(10, 95);
+    EXPECT_EQ(exact->kind_, EXACT_MEMBERS);
+    delete exact;
+
+    DataFrame* kept = commits.semi_join(1, tagged, 0, out_key);
+    size_t expected = 0;
+    for (size_t i = 0; i < size; i++) {
+        expected += i % 100 >= 10 && i % 5 == 0 ? 1 : 0;
+    }
+    ASSERT_EQ(kept->nrows(), expected);
+    for (size_t i = 0; i < kept->nrows(); i++) {
+        int u = kept->get_int(1, i);
+        EXPECT_TRUE(u >= 10 && u % 5 == 0);
+        EXPECT_EQ(kept->get_int(0, i) % 100, u);
+    }
+    delete kept;
+}
+
+TEST(testSemiJoin, testSemiJoinExact) {
+    test_semi_join_exact();
+}
+
+/**
+ * Strings are kept in a Bloom filter, the rows that pass it by mistake are dropped by the exact check.
+ */
+void test_semi_join_bloom() {
+    Key words_key(0, "semi-words");
+    Key members_key(0, "semi-members");
+    Key out_key(0, "semi-words-out");
+    KVStore kvs(false);
+    size_t size = 2000;
+    Schema word_schema("SI");
+    DataFrame words(word_schema, words_key, &kvs);
+    Row word(words.get_schema());
+    for (size_t i = 0; i < size; i++) {
+        StrBuff buf;
+        buf.c("w");
+        buf.c(i % 500);
+        String* s = buf.get();
+        word.set(0, s);
+        word.set(1, (int) i);
+        words.add_row(word, false, false);
+        delete s;
+    }
+    words.commit();
+
+    // every seventh word, and words that are not in words
+    Schema member_schema("S");
+    DataFrame members(member_schema, members_key, &kvs);
+    Row member(members.get_schema());
+    for (size_t i = 0; i < 500; i += 7) {
+        StrBuff buf;
+        buf.c(i % 2 == 0 ? "w" : "x");
+        buf.c(i);
+        String* s = buf.get();
+        member.set(0, s);
+        members.add_row(member, false, false);
+        delete s;
+    }
+    members.commit();
+
+    // the filter has no false negatives
+    Membership* bloom = Membership::bloom(members.nrows());
+    MembershipBuilder builder(*bloom, 0);
+    members.map(builder);
+    Row check(members.get_schema());
+    for (size_t i = 0; i < members.nrows(); i++) {
+        members.fill_row(i, check);
+        EXPECT_TRUE(bloom->test(check, 0));
+        check.delete_strings();
+    }
+    delete bloom;
+
+    DataFrame* kept = words.semi_join(0, members, 0, out_key);
+    size_t expected = 0;
+    for (size_t i = 0; i < size; i++) {
+        size_t w = i % 500;
+        expected += w % 7 == 0 && w % 2 == 0 ? 1 : 0;
+    }
+    ASSERT_EQ(kept->nrows(), expected);
+    for (size_t i = 0; i < kept->nrows(); i++) {
+        size_t w = kept->get_int(1, i) % 500;
+        EXPECT_TRUE(w % 7 == 0 && w % 2 == 0);
+    }
+    delete kept;
+}
+
+TEST(testSemiJoin, testSemiJoinBloom) {
+    test_semi_join_bloom();
+}
@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+
+#include "test_macros.h"
+#include "../../src/dataframe/shipping.h"
+#include "../../src/dataframe/dataframe.h"
+
+// *************************** Shipping Tests ***********************************
+
+// sums an int column, the column is given as the argument of the factory
+class ColumnSummer : public Rower {
+    public:
+        size_t col_;
+        long sum_;
+        size_t rows_;
+
+        ColumnSummer(size_t col) {
+            col_ = col;
+            sum_ = 0;
+            rows_ = 0;
+        }
+
+        static Rower* make(const char* args, size_t args_len) {
+            size_t col = 0;
+            if (args_len == sizeof(size_t)) {
+                memcpy(&col, args, sizeof(size_t));
+            }
+            return new ColumnSummer(col);
+        }
+
+        bool accept(Row& r) {
+            sum_ += r.get_int(col_);
+            rows_++;
+            return true;
+        }
+
+        bool reads_column(size_t col) { return col == col_; }
+
+        void join_delete(Rower* other) {
+            ColumnSummer* o = dynamic_cast<ColumnSummer*>(other);
+            abort_if_not(o != nullptr, "ColumnSummer.join_delete(): not a ColumnSummer");
+            sum_ += o->sum_;
+            rows_ += o->rows_;
+            delete o;
+        }
+
+        char* serialize_result(size_t& len) {
+            len = sizeof(long) + sizeof(size_t);
+            char* buf = new char[len];
+            memcpy(buf, &sum_, sizeof(long));
+            memcpy(buf + sizeof(long), &rows_, sizeof(size_t));
+            return buf;
+        }
+
+        void deserialize_result(const char* buf, size_t len) {
+            abort_if_not(len == sizeof(long) + sizeof(size_t), "ColumnSummer: bad result");
+            memcpy(&sum_, buf, sizeof(long));
+            memcpy(&rows_, buf + sizeof(long), sizeof(size_t));
+        }
+};
+
+/**
+ * A shipped rower runs where the chunks are and its result is joined into the given rower.
+ */
+void test_ship_rower() {
+    RowerRegistry::rowers().add("column-summer", ColumnSummer::make);
+    EXPECT_TRUE(RowerRegistry::rowers().has("column-summer"));
+    EXPECT_FALSE(RowerRegistry::rowers().has("no-such-rower"));
+
+    Key key(0, "shipped");
+    KVStore kvs(false);
+    size_t size = 3 * kvs.get_config().CHUNK_SIZE + 11;
+    Schema schema("II");
+    DataFrame df(schema, key, &kvs);
+    Row row(df.get_schema());
+    for (size_t i = 0; i < size; i++) {
+        row.set(0, (int) i);
+        row.set(1, 2);
+        df.add_row(row);
+    }
+
+    ColumnSummer summer(0);
+    df.ship("column-summer", summer);
+    EXPECT_EQ(summer.sum_, (long) size * (size - 1) / 2);
+    EXPECT_EQ(summer.rows_, size);
+
+    // the factory gets the arguments
+    size_t col = 1;
+    ColumnSummer second(1);
+    df.ship("column-summer", second, (const char*) &col, sizeof(size_t));
+    EXPECT_EQ(second.sum_, (long) size * 2);
+}
+
+TEST(testShipping, testShipRower) {
+    test_ship_rower();
+}
+
+/**
+ * A ship request survives serialization.
+ */
+void test_ship_request() {
+    const char* descriptor = "descriptor";
+    const char* args = "abc";
+    ShipRequest req("name", args, 3, descriptor);
+    Value* v = req.serialize(strlen(descriptor) + 1);
+
+    ShipRequest got(v->get(), v->size());
+    EXPECT_STREQ(got.name_, "name");
+    EXPECT_EQ(got.args_len_, 3);
+    EXPECT_EQ(memcmp(got.args_, args, 3), 0);
+    EXPECT_STREQ(got.descriptor_, descriptor);
+    delete v;
+}
+
+TEST(testShipping, testShipRequest) {
+    test_ship_request();
+}
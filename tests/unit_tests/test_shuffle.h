@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+
+#include "test_macros.h"
+#include "../../src/dataframe/shuffle.h"
+#include "../../src/dataframe/dataframe.h"
+
+// *************************** Shuffle Tests ***********************************
+
+/**
+ * Rows sent through a shuffle come out complete, in the order they were added, in chunks that
+ * read back like pushed ones.
+ */
+void test_shuffle() {
+    Key key(0, "shuffled");
+    KVStore kvs(false);
+    size_t size = 2 * kvs.get_config().CHUNK_SIZE + 17;
+    Schema schema("BIDS");
+    Shuffle shuffle(schema, key, &kvs);
+    Row row(schema);
+    String apple("apple");
+    String empty("");
+    for (size_t i = 0; i < size; i++) {
+        row.set(0, i % 3 == 0);
+        row.set(1, (int) i);
+        row.set(2, i * 0.5);
+        row.set(3, i % 2 == 0 ? &apple : &empty);
+        shuffle.add(row, 0);
+    }
+    DataFrame* df = shuffle.finish();
+
+    ASSERT_EQ(df->nrows(), size);
+    EXPECT_EQ(df->get_placement().kind(), LOCAL);
+    for (size_t i = 0; i < size; i += 7) {
+        EXPECT_EQ(df->get_bool(0, i), i % 3 == 0);
+        EXPECT_EQ(df->get_int(1, i), (int) i);
+        EXPECT_DOUBLE_EQ(df->get_double(2, i), i * 0.5);
+        String* s = df->get_string(3, i);
+        EXPECT_TRUE(s->equals(i % 2 == 0 ? &apple : &empty));
+        delete s;
+    }
+    EXPECT_EQ(df->get_int(1, size - 1), (int) size - 1);
+
+    // node 0 put the dataframe under the key
+    Value* v = kvs.get(key);
+    ASSERT_NE(v, nullptr);
+    DataFrame* stored = DataFrame::deserialize(v->get(), &kvs);
+    EXPECT_EQ(stored->nrows(), size);
+    delete stored;
+    delete v;
+    delete df;
+}
+
+TEST(testShuffle, testShuffle) {
+    test_shuffle();
+}
+
+/**
+ * A repartitioned dataframe has every row of the original once, grouped on the node of its key.
+ */
+void test_repartition() {
+    Key key(0, "commits");
+    Key out_key(0, "commits-by-project");
+    KVStore kvs(false);
+    size_t size = 3 * kvs.get_config().CHUNK_SIZE + 5;
+    Schema schema("II");
+    DataFrame df(schema, key, &kvs);
+    Row row(df.get_schema());
+    for (size_t i = 0; i < size; i++) {
+        row.set(0, (int) (i % 11));
+        row.set(1, (int) i);
+        df.add_row(row, false, false);
+    }
+    df.commit();
+
+    DataFrame* parts = df.repartition(0, out_key);
+    ASSERT_EQ(parts->nrows(), size);
+    ASSERT_EQ(parts->ncols(), 2);
+    bool* seen = new bool[size];
+    for (size_t i = 0; i < size; i++) {
+        seen[i] = false;
+    }
+    for (size_t i = 0; i < size; i++) {
+        int id = parts->get_int(1, i);
+        ASSERT_LT((size_t) id, size);
+        EXPECT_FALSE(seen[id]);
+        seen[id] = true;
+        EXPECT_EQ(parts->get_int(0, i), id % 11);
+    }
+    delete[] seen;
+    delete parts;
+}
+
+TEST(testShuffle, testRepartition) {
+    test_repartition();
+}
@@ -206,6 +206,134 @@ void test_read() {
     OK("read test.");
 }
 
+// Columns are widened when a value that does not fit them comes after whole chunks of narrower
+// values. Every row is kept, the chunks that were already written are converted when read.
+void test_read_promoted() {
+    KVStore kvs(false);
+    size_t rows = 3 * kvs.get_config().CHUNK_SIZE + 7;
+    const char* path = "/tmp/eau2-test-promoted.sor";
+    FILE* file = fopen(path, "w");
+    for (size_t i = 0; i < rows; i++) {
+        if (i + 1 < rows) {
+            fprintf(file, "<%zu> <%zu> <%zu> <%zu>\n", i, i % 2, i, i);
+        } else {
+            fprintf(file, "<name> <7> <2.5> <%zu>\n", i);
+        }
+    }
+    fclose(file);
+
+    // pipelined, and row by row under a HASH placement on the column that is never widened
+    Placement* hash = Placement::hash(1, 3);
+    SOR piped_reader(path, new Key(0, "piped"), &kvs);
+    SOR rows_reader(path, new Key(0, "rows"), &kvs, *hash);
+    DataFrame* dfs[] = {piped_reader.read(), rows_reader.read()};
+    delete hash;
+
+    for (size_t d = 0; d < 2; d++) {
+        DataFrame* df = dfs[d];
+        test(df->nrows() == rows, "promoted read keeps every row");
+        test(df->get_schema().col_type(0) == STRING, "promoted to string");
+        test(df->get_schema().col_type(1) == INT, "promoted to int");
+        test(df->get_schema().col_type(2) == DOUBLE, "promoted to double");
+        test(df->get_schema().col_type(3) == INT, "not promoted");
+        test(df->get_string(0, 0), "0", "promoted string of an int");
+        bool same = true;
+        for (size_t i = 0; i + 1 < rows; i++) {
+            String* name = df->get_string(0, i);
+            same = same && (size_t) atoi(name->c_str()) == i;
+            same = same && df->get_int(1, i) == (int) (i % 2) && df->get_double(2, i) == (double) i;
+            delete name;
+        }
+        test(same, "promoted values");
+        test(df->get_string(0, rows - 1), "name", "value that promoted to string");
+        test(df->get_int(1, rows - 1) == 7, "value that promoted to int");
+        test(df->get_double(2, rows - 1) == 2.5, "value that promoted to double");
+        delete df;
+    }
+
+    unlink(path);
+    OK("promoted read test.");
+}
+
+// A column that becomes a string keeps the text of the file in the chunks that were written
+// before it did, like in the rows after: "007" is not "7" and a missing value is "", not "0"
+void test_read_promoted_text() {
+    KVStore kvs(false);
+    size_t rows = 3 * kvs.get_config().CHUNK_SIZE + 7;
+    const char* path = "/tmp/eau2-test-promoted-text.sor";
+    FILE* file = fopen(path, "w");
+    for (size_t i = 0; i < rows; i++) {
+        if (i + 1 < rows) {
+            // an empty line in every chunk, it is skipped and does not move the rows
+            fprintf(file, i % 100 == 50 ? "\n<%zu> <007>\n" : i % 2 == 0 ? "<%zu> <007>\n" : "<%zu> <>\n", i);
+        } else {
+            fprintf(file, "<%zu> <abc>\n", i);
+        }
+    }
+    fclose(file);
+
+    SOR reader(path, new Key(0, "promoted-text"), &kvs);
+    DataFrame* df = reader.read();
+    test(df->nrows() == rows, "promoted text keeps every row");
+    test(df->get_schema().col_type(1) == STRING, "promoted text to string");
+    bool same = true;
+    for (size_t i = 0; i + 1 < rows; i++) {
+        String* s = df->get_string(1, i);
+        same = same && strcmp(s->c_str(), i % 2 == 0 ? "007" : "") == 0 && df->get_int(0, i) == (int) i;
+        delete s;
+    }
+    test(same, "promoted text values");
+    test(df->get_string(1, 0), "007", "promoted text of the first row");
+    test(df->get_string(1, 1), "", "promoted missing value of the first chunk");
+    test(df->get_string(1, rows - 2), "", "promoted missing value of the last chunk");
+    test(df->get_string(1, rows - 1), "abc", "value that promoted to string");
+    delete df;
+
+    unlink(path);
+    OK("promoted text read test.");
+}
+
+// only the selected fields are read, in the order they were selected
+void test_read_selected() {
+    KVStore kvs(false);
+    SOR reader("../../data/test.sor", &kvs);
+    size_t fields[] = {4, 1, 2};
+    DataFrame* df = reader.read_selected(fields, 3);
+    Schema schema = df->get_schema();
+
+    test(df->ncols() == 3, "selected number of columns");
+    test(df->nrows() == 9, "selected number of rows");
+    test(schema.col_type(0) == STRING, "selected type of column 0");
+    test(schema.col_type(1) == INT, "selected type of column 1");
+    test(schema.col_type(2) == DOUBLE, "selected type of column 2");
+    test(df->get_string(0, 0), "hello world", "selected value at column 0 row 0");
+    test(df->get_string(0, 4), "", "selected missing value at column 0 row 4");
+    test(df->get_int(1, 1) == 133454, "selected value at column 1 row 1");
+    test(df->get_int(1, 7) == 7, "selected value at column 1 row 7");
+    test(df->get_double(2, 1), -123.938, 0.001, "selected value at column 2 row 1");
+    test(df->get_double(2, 7) == 444, "selected value at column 2 row 7");
+    delete df;
+
+    // a selection read in parallel gives the same columns as reading every field
+    SOR all_reader("../../data/generated_commits.txt", new Key(0, "all"), &kvs);
+    DataFrame* all = all_reader.read();
+    SOR dist_reader("../../data/generated_commits.txt", new Key(0, "selected"), &kvs);
+    size_t commit_fields[] = {2, 0};
+    dist_reader.select(commit_fields, 2);
+    DataFrame* dist = dist_reader.read_distributed(3);
+    test(dist->ncols() == 2, "selected distributed number of columns");
+    test(dist->nrows() == all->nrows(), "selected distributed number of rows");
+    bool same = true;
+    for (size_t i = 0; i < all->nrows(); i++) {
+        same = same && dist->get_int(0, i) == all->get_int(2, i) && dist->get_int(1, i) == all->get_int(0, i);
+    }
+    test(same, "selected distributed values");
+    delete dist;
+    delete all;
+
+    OK("selected read test.");
+}
+
 void test_partial_file_read() {
     KVStore kvs(false);
     SOR reader("../../data/test.sor", &kvs);
@@ -255,12 +383,210 @@ void test_partial_file_read() {
     OK("end middle of file read test.");
 }
 
+// the vectorized and the byte loop classifiers find the same fields, also across block boundaries
+bool scan_wrapper(FieldScanner& scanner, const char* line, const char** expected, size_t num_expected) {
+    size_t num_fields = scanner.scan(line, line + strlen(line));
+    if (num_fields != num_expected) {
+        return false;
+    }
+    for (size_t i = 0; i < num_fields; i++) {
+        if (expected[i] == nullptr || scanner.field(i) == nullptr) {
+            if (expected[i] != scanner.field(i)) {
+                return false;
+            }
+        } else if (strlen(expected[i]) != scanner.field_len(i) || strncmp(expected[i], scanner.field(i), scanner.field_len(i)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void test_field_scanner() {
+    FieldScanner simd;
+    FieldScanner scalar;
+    scalar.scalar_ = true;
+    FieldScanner* scanners[] = {&simd, &scalar};
+
+    for (size_t s = 0; s < 2; s++) {
+        FieldScanner& scanner = *scanners[s];
+        const char* expected[] = {"1", "2", "3", "4", "5"};
+        test(scan_wrapper(scanner, "<1> <2> <3> <4> <5>", expected, 5), "scan() - all ints");
+        const char* expected2[] = {nullptr, nullptr, nullptr};
+        test(scan_wrapper(scanner, "<> <   > <", expected2, 3), "scan() - missing values");
+        const char* expected3[] = {"Hello World", "-1234", "0", "1.44322", nullptr};
+        test(scan_wrapper(scanner, "   <   \"Hello World\"   >    <-1234> <  0   >    <1.44322    >   <>", expected3, 5), "scan() - different types");
+        const char* expected4[] = {"<>", "a", "unterminated value"};
+        test(scan_wrapper(scanner, "<\"<>\"   ><a b c>   <\"unterminated value", expected4, 3), "scan() - quoted brackets and unterminated quote");
+        const char* expected5[] = {"a field that is longer than one block of thirty two bytes", "x", "quoted across the block boundary ><"};
+        test(scan_wrapper(scanner, "<\"a field that is longer than one block of thirty two bytes\">                           <x><\"quoted across the block boundary ><\">", expected5, 3), "scan() - fields across blocks");
+        const char* expected6[] = {"end"};
+        test(scan_wrapper(scanner, "<end", expected6, 1), "scan() - line ends in a value");
+    }
+
+    // more fields than the initial buffer holds
+    StrBuff wide;
+    for (size_t i = 0; i < 100; i++) {
+        wide.c("<").c(i).c("> ");
+    }
+    String* line = wide.get();
+    test(simd.scan(line->c_str(), line->c_str() + line->size()) == 100, "scan() - wide line");
+    test(simd.field_len(99) == 2 && strncmp(simd.field(99), "99", 2) == 0, "scan() - last field of wide line");
+    test(simd.scan(line->c_str(), line->c_str() + line->size(), 3) == 3, "scan() - stops after max fields");
+    test(simd.field_len(2) == 1 && simd.field(2)[0] == '2', "scan() - last of max fields");
+    delete line;
+
+    OK("field scanner test.");
+}
+
+// reading with several threads gives the same rows as reading the file in one go
+void test_read_distributed() {
+    KVStore kvs(false);
+    const char* files[] = {"../../data/test.sor", "../../data/generated_commits.txt"};
+    size_t threads[] = {4, 3};
+
+    for (size_t f = 0; f < 2; f++) {
+        SOR reader(files[f], new Key(0, "whole"), &kvs);
+        DataFrame* df = reader.read();
+        SOR dist_reader(files[f], new Key(0, "split"), &kvs);
+        DataFrame* dist = dist_reader.read_distributed(threads[f]);
+
+        test(dist->get_placement().kind() == LOCAL, "read_distributed places rows locally");
+        test(dist->get_schema().equals(&df->get_schema()), "read_distributed schema");
+        test(dist->nrows() == df->nrows(), "read_distributed number of rows");
+        Row row(df->get_schema());
+        Row dist_row(df->get_schema());
+        bool same = true;
+        for (size_t i = 0; i < df->nrows(); i++) {
+            df->fill_row(i, row);
+            dist->fill_row(i, dist_row);
+            for (size_t j = 0; j < df->ncols(); j++) {
+                same = same && row.hash_field(j) == dist_row.hash_field(j);
+            }
+            row.delete_strings();
+            dist_row.delete_strings();
+        }
+        test(same, "read_distributed values");
+
+        Key split("split");
+        Value* v = kvs.get(split);
+        test(v != nullptr, "read_distributed puts the dataframe in the kvstore");
+        DataFrame* stored = DataFrame::deserialize(v->get(), &kvs);
+        test(stored->nrows() == df->nrows(), "read_distributed stored number of rows");
+        test(stored->get_int(1, df->nrows() - 1) == df->get_int(1, df->nrows() - 1), "read_distributed stored value");
+        Key ingest("split~ingest-0");
+        test(kvs.get(ingest) == nullptr, "read_distributed removes the merged descriptors");
+
+        delete stored;
+        delete v;
+        delete dist;
+        delete df;
+    }
+
+    OK("distributed read test.");
+}
+
+// A column of ints with leading zeros and signs that only becomes a string near the end of the
+// file keeps the text of the file whichever way it is read: the pipelined read, the row by row
+// read of a HASH placement and read_distributed, whose first threads never see the string
+void test_read_distributed_promoted_text() {
+    KVStore kvs(false);
+    size_t rows = 5 * kvs.get_config().CHUNK_SIZE + 3;
+    const char* path = "/tmp/eau2-test-distributed-text.sor";
+    const char* texts[] = {"007", "+1", "", "-02"};
+    FILE* file = fopen(path, "w");
+    for (size_t i = 0; i + 1 < rows; i++) {
+        fprintf(file, "<%zu> <%s>\n", i, texts[i % 4]);
+    }
+    fprintf(file, "<%zu> <abc>\n", rows - 1);
+    fclose(file);
+
+    SOR reader(path, new Key(0, "text-whole"), &kvs);
+    DataFrame* df = reader.read();
+    Placement* hash = Placement::hash(1, 0);
+    SOR hash_reader(path, new Key(0, "text-hash"), &kvs, *hash);
+    DataFrame* hashed = hash_reader.read();
+    SOR dist_reader(path, new Key(0, "text-split"), &kvs);
+    DataFrame* dist = dist_reader.read_distributed(3);
+
+    test(df->get_schema().col_type(1) == STRING, "distributed text column is a string");
+    test(hashed->get_schema().col_type(1) == STRING && dist->get_schema().col_type(1) == STRING, "every read makes the column a string");
+    test(hashed->nrows() == rows && dist->nrows() == rows, "distributed text keeps every row");
+    bool same = true;
+    for (size_t i = 0; i < rows; i++) {
+        const char* expected = i + 1 < rows ? texts[i % 4] : "abc";
+        String* s = df->get_string(1, i);
+        String* h = hashed->get_string(1, i);
+        String* d = dist->get_string(1, i);
+        same = same && strcmp(s->c_str(), expected) == 0 && strcmp(h->c_str(), expected) == 0 && strcmp(d->c_str(), expected) == 0;
+        delete s;
+        delete h;
+        delete d;
+    }
+    test(same, "read, HASH read and read_distributed keep the text");
+    test(dist->get_string(1, 0), "007", "read_distributed text of the first row");
+    test(dist->get_string(1, 1), "+1", "read_distributed sign of the second row");
+    test(dist->get_string(1, 2), "", "read_distributed missing value");
+
+    delete dist;
+    delete hashed;
+    delete hash;
+    delete df;
+    unlink(path);
+    OK("distributed promoted text read test.");
+}
+
+// the pipelined read has to give the same dataframe as the serial one, for any number of parsers
+void test_read_pipelined() {
+    KVStore kvs(false);
+    const char* files[] = {"../../data/test.sor", "../../data/generated_commits.txt"};
+    size_t parsers[] = {1, 3};
+
+    for (size_t f = 0; f < 2; f++) {
+        for (size_t p = 0; p < 2; p++) {
+            SOR reader(files[f], new Key(0, "serial"), &kvs);
+            Schema* schema = reader.infer_columns_(0, Config::MAX_SIZE_T);
+            Key serial("serial");
+            Key piped_key("piped");
+            DataFrame df(*schema, serial, &kvs, false);
+            reader.parse_(&df, 0, Config::MAX_SIZE_T);
+            DataFrame piped(*schema, piped_key, &kvs, false);
+            reader.parse_pipelined_(&piped, 0, Config::MAX_SIZE_T, parsers[p]);
+            piped.commit();
+
+            test(piped.nrows() == df.nrows(), "pipelined read number of rows");
+            Row row(df.get_schema());
+            Row piped_row(df.get_schema());
+            bool same = true;
+            for (size_t i = 0; i < df.nrows(); i++) {
+                df.fill_row(i, row);
+                piped.fill_row(i, piped_row);
+                for (size_t j = 0; j < df.ncols(); j++) {
+                    same = same && row.hash_field(j) == piped_row.hash_field(j);
+                }
+                row.delete_strings();
+                piped_row.delete_strings();
+            }
+            test(same, "pipelined read values");
+            delete schema;
+        }
+    }
+
+    OK("pipelined read test.");
+}
+
 void run_sorer_tests() {
     test_parse_field_();
     test_parse_row_();
     test_infer_columns_();
+    test_field_scanner();
     test_read();
     test_partial_file_read();
+    test_read_selected();
+    test_read_promoted();
+    test_read_promoted_text();
+    test_read_distributed();
+    test_read_distributed_promoted_text();
+    test_read_pipelined();
 
     printf("All sorer tests are good.\n");
     printf("===================================================================\n\n");
@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+
+#include "test_macros.h"
+#include "../../src/dataframe/sort.h"
+#include "../../src/dataframe/dataframe.h"
+
+// *************************** Sort Tests ***********************************
+
+/**
+ * A sorted dataframe has every row once, in ascending order of the column, and its descriptor
+ * records the order.
+ */
+void test_sort_by() {
+    Key key(0, "unsorted");
+    Key out_key(0, "sorted");
+    KVStore kvs(false);
+    size_t size = 4 * kvs.get_config().CHUNK_SIZE + 3;
+    Schema schema("IDS");
+    DataFrame df(schema, key, &kvs);
+    Row row(df.get_schema());
+    for (size_t i = 0; i < size; i++) {
+        // a permutation of 0 .. size - 1, 7919 is prime and does not divide size
+        int n = (int) ((i * 7919) % size);
+        String s(n % 2 == 0 ? "even" : "odd");
+        row.set(0, n);
+        row.set(1, n * 0.25);
+        row.set(2, &s);
+        df.add_row(row, false, false);
+    }
+    df.commit();
+    EXPECT_TRUE(df.sorted_by() == Config::MAX_SIZE_T);
+
+    DataFrame* sorted = df.sort_by(0, out_key);
+    ASSERT_EQ(sorted->nrows(), size);
+    EXPECT_EQ(sorted->sorted_by(), 0);
+    for (size_t i = 0; i < size; i++) {
+        ASSERT_EQ(sorted->get_int(0, i), (int) i);
+        EXPECT_DOUBLE_EQ(sorted->get_double(1, i), i * 0.25);
+    }
+    String* s = sorted->get_string(2, 5);
+    EXPECT_STREQ(s->c_str(), "odd");
+    delete s;
+
+    // the order is part of the descriptor
+    Value* v = kvs.get(out_key);
+    ASSERT_NE(v, nullptr);
+    DataFrame* stored = DataFrame::deserialize(v->get(), &kvs);
+    EXPECT_EQ(stored->sorted_by(), 0);
+    delete stored;
+    delete v;
+    delete sorted;
+}
+
+TEST(testSort, testSortBy) {
+    test_sort_by();
+}
+
+/**
+ * Strings sort byte by byte, equal values stay next to each other.
+ */
+void test_sort_by_string() {
+    Key key(0, "words-unsorted");
+    Key out_key(0, "words-sorted");
+    KVStore kvs(false);
+    const char* words[] = {"pear", "apple", "fig", "apple", "banana", "fig", "cherry"};
+    Schema schema("SI");
+    DataFrame df(schema, key, &kvs);
+    Row row(df.get_schema());
+    for (size_t i = 0; i < 7; i++) {
+        String s(words[i]);
+        row.set(0, &s);
+        row.set(1, (int) i);
+        df.add_row(row, false, false);
+    }
+    df.commit();
+
+    DataFrame* sorted = df.sort_by(0, out_key);
+    const char* expected[] = {"apple", "apple", "banana", "cherry", "fig", "fig", "pear"};
+    ASSERT_EQ(sorted->nrows(), 7);
+    for (size_t i = 0; i < 7; i++) {
+        String* s = sorted->get_string(0, i);
+        EXPECT_STREQ(s->c_str(), expected[i]);
+        delete s;
+    }
+    EXPECT_EQ(sorted->get_int(1, 6), 0);
+    delete sorted;
+}
+
+TEST(testSort, testSortByString) {
+    test_sort_by_string();
+}
+
+/**
+ * A range filter keeps the rows in range, whether or not the dataframe is sorted by the column.
+ */
+void test_filter_range() {
+    Key key(0, "range-unsorted");
+    Key sorted_key(0, "range-sorted");
+    Key out_key(0, "range-out");
+    Key scan_key(0, "range-scan");
+    KVStore kvs(false);
+    size_t size = 5 * kvs.get_config().CHUNK_SIZE;
+    Schema schema("II");
+    DataFrame df(schema, key, &kvs);
+    Row row(df.get_schema());
+    for (size_t i = 0; i < size; i++) {
+        row.set(0, (int) ((size - i) / 3));
+        row.set(1, (int) i);
+        df.add_row(row, false, false);
+    }
+    df.commit();
+
+    // every value from 100 to 199 is there three times, at most
+    DataFrame* scanned = df.filter_range(0, 100, 199, scan_key);
+    EXPECT_TRUE(scanned->sorted_by() == Config::MAX_SIZE_T);
+    DataFrame* sorted = df.sort_by(0, sorted_key);
+    DataFrame* ranged = sorted->filter_range(0, 100, 199, out_key);
+    EXPECT_EQ(ranged->sorted_by(), 0);
+    ASSERT_EQ(ranged->nrows(), scanned->nrows());
+    ASSERT_EQ(ranged->nrows(), 300);
+    for (size_t i = 0; i < ranged->nrows(); i++) {
+        EXPECT_EQ(ranged->get_int(0, i), (int) (100 + i / 3));
+        EXPECT_EQ((int) (size - ranged->get_int(1, i)) / 3, ranged->get_int(0, i));
+    }
+    delete ranged;
+    delete sorted;
+    delete scanned;
+}
+
+TEST(testSort, testFilterRange) {
+    test_filter_range();
+}
@@ -9,7 +9,18 @@
 #include "test_schema.h"
 #include "test_row.h"
 #include "test_dataframe.h"
+#include "test_placement.h"
 #include "test_linus.h"
+#include "test_shipping.h"
+#include "test_shuffle.h"
+#include "test_group_by.h"
+#include "test_join.h"
+#include "test_sort.h"
+#include "test_semi_join.h"
+#include "test_plan.h"
+#include "test_expr.h"
+#include "test_view.h"
+#include "test_index.h"
 
 int main(int argc, char **argv) {
 
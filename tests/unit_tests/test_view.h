@@ -0,0 +1,235 @@
+#include <gtest/gtest.h>
+
+#include "test_macros.h"
+#include "test_frames.h"
+#include "../../src/dataframe/view.h"
+#include "../../src/dataframe/expr.h"
+#include "../../src/dataframe/dataframe.h"
+
+// *************************** View Tests ***********************************
+
+// accepts the rows whose int in column 0 is a multiple of mod_
+class MultipleFilter : public Rower {
+    public:
+        int mod_;
+
+        MultipleFilter(int mod) {
+            mod_ = mod;
+        }
+
+        bool accept(Row& r) {
+            return r.get_int(0) % mod_ == 0;
+        }
+
+        bool reads_column(size_t col) {
+            return col == 0;
+        }
+};
+
+// sums column 1 of the rows it sees
+class SecondSummer : public Rower {
+    public:
+        int sum_;
+
+        SecondSummer() {
+            sum_ = 0;
+        }
+
+        bool accept(Row& r) {
+            sum_ += r.get_int(1);
+            return true;
+        }
+
+        bool reads_column(size_t col) {
+            return col == 1;
+        }
+};
+
+// row i of a dataframe with the schema "IIS", see fill_frame
+void set_view_row(Row& row, size_t i) {
+    row.set(0, (int) i);
+    row.set(1, (int) (i % 5));
+    row.set(2, new String(i % 5 < 2 ? "low" : "high"));
+}
+
+/**
+ * A filter view keeps the same rows as filter, without copying them until it is materialized.
+ */
+void test_filter_view() {
+    Key key(0, "view-in");
+    Key eager_key(0, "view-eager");
+    Key out_key(0, "view-out");
+    KVStore kvs(false);
+    size_t size = 3 * kvs.get_config().CHUNK_SIZE + 7;
+    Schema schema("IIS");
+    DataFrame df(schema, key, &kvs);
+    fill_frame(df, 0, size, set_view_row);
+
+    MultipleFilter filter(3);
+    FrameView* view = df.filter_view(filter);
+    DataFrame* eager = df.filter(filter, eager_key);
+    ASSERT_EQ(view->nrows(), eager->nrows());
+
+    SecondSummer summer;
+    view->map(summer);
+    SecondSummer eager_summer;
+    eager->map(eager_summer);
+    EXPECT_EQ(summer.sum_, eager_summer.sum_);
+
+    DataFrame* out = view->materialize(out_key);
+    ASSERT_EQ(out->nrows(), eager->nrows());
+    for (size_t i = 0; i < out->nrows(); i++) {
+        EXPECT_EQ(out->get_int(0, i), eager->get_int(0, i));
+        EXPECT_EQ(out->get_int(1, i), eager->get_int(1, i));
+    }
+    String* s = out->get_string(2, 1);
+    EXPECT_STREQ(s->c_str(), "high");
+    delete s;
+
+    FrameView* local = df.local_filter_view(filter);
+    EXPECT_EQ(local->nrows(), view->nrows());
+    SecondSummer local_summer;
+    local->local_map(local_summer);
+    EXPECT_EQ(local_summer.sum_, summer.sum_);
+
+    delete local;
+    delete out;
+    delete eager;
+    delete view;
+}
+
+TEST(testView, testFilterView) {
+    test_filter_view();
+}
+
+/**
+ * group_by and join read the rows of a view from the chunks of its dataframe.
+ */
+void test_view_consumers() {
+    Key key(0, "view-consumers");
+    Key other_key(0, "view-other");
+    Key where_key(0, "view-where");
+    Key groups_key(0, "view-groups");
+    Key eager_groups_key(0, "view-eager-groups");
+    Key join_key(0, "view-join");
+    Key eager_join_key(0, "view-eager-join");
+    KVStore kvs(false);
+    size_t size = 2 * kvs.get_config().CHUNK_SIZE + 3;
+    Schema schema("IIS");
+    DataFrame df(schema, key, &kvs);
+    fill_frame(df, 0, size, set_view_row);
+
+    // a name for every value of column 1
+    Schema other_schema("IS");
+    DataFrame other(other_schema, other_key, &kvs);
+    Row row(other.get_schema());
+    String name("name");
+    for (int i = 0; i < 5; i++) {
+        row.set(0, i);
+        row.set(1, &name);
+        other.add_row(row, false, false);
+    }
+    other.commit();
+
+    FrameView* view = df.where_view(col<int>(1) < 3 && col<int>(0) > 10);
+    DataFrame* eager = df.where(col<int>(1) < 3 && col<int>(0) > 10, where_key);
+    ASSERT_EQ(view->nrows(), eager->nrows());
+
+    size_t key_cols[] = {1};
+    Aggregate aggs[] = {Aggregate::count(), Aggregate::sum(0)};
+    DataFrame* groups = view->group_by(key_cols, 1, aggs, 2, groups_key);
+    DataFrame* eager_groups = eager->group_by(key_cols, 1, aggs, 2, eager_groups_key);
+    ASSERT_EQ(groups->nrows(), 3);
+    ASSERT_EQ(eager_groups->nrows(), 3);
+    for (size_t i = 0; i < groups->nrows(); i++) {
+        size_t j = 0;
+        while (j < eager_groups->nrows() && eager_groups->get_int(0, j) != groups->get_int(0, i)) {
+            j++;
+        }
+        ASSERT_LT(j, eager_groups->nrows());
+        EXPECT_EQ(groups->get_int(1, i), eager_groups->get_int(1, j));
+        EXPECT_EQ(groups->get_int(2, i), eager_groups->get_int(2, j));
+    }
+
+    DataFrame* joined = view->join(other, 1, 0, join_key);
+    DataFrame* eager_joined = eager->join(other, 1, 0, eager_join_key);
+    ASSERT_EQ(joined->ncols(), 4);
+    EXPECT_EQ(joined->nrows(), eager->nrows());
+    EXPECT_EQ(eager_joined->nrows(), eager->nrows());
+    int sum = 0;
+    int eager_sum = 0;
+    for (size_t i = 0; i < joined->nrows(); i++) {
+        sum += joined->get_int(0, i);
+        eager_sum += eager_joined->get_int(0, i);
+    }
+    EXPECT_EQ(sum, eager_sum);
+
+    delete eager_joined;
+    delete joined;
+    delete eager_groups;
+    delete groups;
+    delete eager;
+    delete view;
+}
+
+TEST(testView, testViewConsumers) {
+    test_view_consumers();
+}
+
+// appends a chunk of rows <first + i><i % 5> to the given segment of df, which has the schema "II"
+void append_view_chunk(DataFrame& df, size_t seg, int first) {
+    size_t chunk_size = df.kv_->get_config().CHUNK_SIZE;
+    ChunkBuilder builder(df.get_schema(), chunk_size);
+    Row row(df.get_schema());
+    for (size_t i = 0; i < chunk_size; i++) {
+        row.set(0, first + (int) i);
+        row.set(1, (int) (i % 5));
+        builder.add(row);
+    }
+    builder.seal_into(df, seg);
+    df.kv_->flush_puts();
+}
+
+/**
+ * A view of a segmented dataframe keeps the same rows when rows are appended to a segment before
+ * the ones it keeps, which moves those rows to higher row indices.
+ */
+void test_view_segment_append() {
+    Key key(0, "view-segs");
+    Key out_key(0, "view-segs-out");
+    KVStore kvs(false);
+    size_t chunk_size = kvs.get_config().CHUNK_SIZE;
+    Schema schema("II");
+    Placement* placement = Placement::local(1, 2);
+    DataFrame df(schema, key, &kvs, *placement, false);
+    delete placement;
+    append_view_chunk(df, 0, 0);
+    append_view_chunk(df, 1, 100000);
+
+    FrameView* view = df.where_view(col<int>(0) >= 100000 && col<int>(0) < 200000);
+    ASSERT_EQ(view->nrows(), chunk_size);
+    append_view_chunk(df, 0, 200000);
+
+    SecondSummer summer;
+    view->map(summer);
+    SecondSummer local_summer;
+    view->local_map(local_summer);
+    int expected = 0;
+    for (size_t i = 0; i < chunk_size; i++) {
+        expected += i % 5;
+    }
+    EXPECT_EQ(summer.sum_, expected);
+    EXPECT_EQ(local_summer.sum_, expected);
+
+    DataFrame* out = view->materialize(out_key);
+    ASSERT_EQ(out->nrows(), chunk_size);
+    for (size_t i = 0; i < out->nrows(); i++) {
+        EXPECT_EQ(out->get_int(0, i), 100000 + (int) i);
+    }
+    delete out;
+    delete view;
+}
+
+TEST(testView, testViewSegmentAppend) {
+    test_view_segment_append();
+}